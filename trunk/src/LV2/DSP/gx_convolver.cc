@@ -239,9 +239,13 @@ bool __rt_func GxSimpleConvolver::compute(int32_t count, float* input, float *ou
     {
       memcpy(inpdata(0), input, count * sizeof(float));
 
+#ifdef ZITA_CONVOLVER_OUTPUT_BUFFERS
+      flags = process(sync, &output);
+#else
       flags = process(sync);
 
       memcpy(output, outdata(0), count * sizeof(float));
+#endif
     } else {
       float *in, *out;
       in = inpdata(0);
@@ -347,10 +351,15 @@ bool __rt_func GxSimpleConvolver::compute_stereo(int32_t count, float* input, fl
       memcpy(inpdata(0), input, count * sizeof(float));
       memcpy(inpdata(1), input1, count * sizeof(float));
 
+#ifdef ZITA_CONVOLVER_OUTPUT_BUFFERS
+      float *outp[2] = { output, output1 };
+      flags = process(sync, outp);
+#else
       flags = process(sync);
 
       memcpy(output, outdata(0), count * sizeof(float));
       memcpy(output1, outdata(1), count * sizeof(float));
+#endif
     } else {
         float *in, *in1, *out, *out1;
       in = inpdata(0);
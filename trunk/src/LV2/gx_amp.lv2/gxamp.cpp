@@ -79,6 +79,160 @@ inline bool atomic_compare_and_exchange(T **p, T *oldv, T *newv)
 
 #include "gx_mlock.cc"
 
+/****************************************************************
+ ** ConvFader: two convolver instances; a new impulse response is
+ ** loaded into the spare instance by the worker thread and the run
+ ** thread crossfades (equal power) from the old to the new one
+ */
+
+class ConvFader
+{
+private:
+  GxSimpleConvolver            conv1;
+  GxSimpleConvolver            conv2;
+  GxSimpleConvolver*           conv;     // run thread: current instance
+  GxSimpleConvolver*           pending;  // set by fade_to(), taken over by run thread
+  GxSimpleConvolver*           fading;   // run thread: instance being faded out
+  int32_t                      fade_pos;
+  int32_t                      fade_len;
+  float                        fade_sin, fade_cos;   // run thread: crossfade gains
+  float                        fade_dsin, fade_dcos; // rotation per sample
+  void wait_stop(GxSimpleConvolver& c);
+public:
+  ConvFader(gx_resample::BufferResampler& resamp);
+  ~ConvFader();
+  bool configure(int32_t count, float *impresp, uint32_t imprate,
+                 uint32_t rate, uint32_t bufsize, int32_t prio);
+  void stop_all();
+  GxSimpleConvolver *get_spare();
+  bool fade_to(GxSimpleConvolver *spare, int32_t prio);
+  void compute(uint32_t n_samples, float *buffer);
+};
+
+ConvFader::ConvFader(gx_resample::BufferResampler& resamp) :
+  conv1(resamp),
+  conv2(resamp),
+  conv(&conv1),
+  pending(NULL),
+  fading(NULL),
+  fade_pos(0),
+  fade_len(0),
+  fade_sin(0),
+  fade_cos(1),
+  fade_dsin(0),
+  fade_dcos(1)
+{
+}
+
+ConvFader::~ConvFader()
+{
+  conv1.stop_process();
+  conv1.cleanup();
+  conv2.stop_process();
+  conv2.cleanup();
+}
+
+// the convolver threads finish their current partition first
+void ConvFader::wait_stop(GxSimpleConvolver& c)
+{
+  while (!c.checkstate())
+    usleep(1000);
+}
+
+// stop both instances and cancel a running crossfade
+void ConvFader::stop_all()
+{
+  conv1.set_not_runnable();
+  conv2.set_not_runnable();
+  atomic_set_0(&pending);
+  atomic_set_0(&fading);
+  conv1.stop_process();
+  conv2.stop_process();
+  wait_stop(conv1);
+  wait_stop(conv2);
+}
+
+// load the current instance directly (setup and buffersize change)
+bool ConvFader::configure(int32_t count, float *impresp, uint32_t imprate,
+                          uint32_t rate, uint32_t bufsize, int32_t prio)
+{
+  stop_all();
+  fade_len = rate / 50; // 20ms crossfade
+  fade_dsin = sin(M_PI_2 / fade_len);
+  fade_dcos = cos(M_PI_2 / fade_len);
+  conv->set_samplerate(rate);
+  conv->set_buffersize(bufsize);
+  if (!conv->configure(count, impresp, imprate))
+    return false;
+  return conv->start(prio, SCHED_FIFO);
+}
+
+// returns the stopped spare instance, or NULL while a crossfade
+// is running or the spare threads didn't stop yet (never blocks)
+GxSimpleConvolver *ConvFader::get_spare()
+{
+  if (atomic_get(pending) || atomic_get(fading))
+    return NULL;
+  GxSimpleConvolver *spare = (conv == &conv1 ? &conv2 : &conv1);
+  if (spare->is_runnable())
+    {
+      spare->set_not_runnable();
+      spare->stop_process();
+    }
+  if (!spare->checkstate())
+    return NULL;
+  return spare;
+}
+
+// start the configured spare instance and let the run thread
+// crossfade to it
+bool ConvFader::fade_to(GxSimpleConvolver *spare, int32_t prio)
+{
+  if (!spare->start(prio, SCHED_FIFO))
+    return false;
+  atomic_set(&pending, spare);
+  return true;
+}
+
+void __rt_func ConvFader::compute(uint32_t n_samples, float *buffer)
+{
+  // fading is cleared by stop_all() from the worker thread,
+  // so read it only once
+  GxSimpleConvolver *f = atomic_get(fading);
+  GxSimpleConvolver *p = atomic_get(pending);
+  if (p && !f)
+    {
+      f = conv;
+      conv = p;
+      fade_pos = 0;
+      fade_sin = 0;
+      fade_cos = 1;
+      atomic_set(&fading, f);
+      atomic_set_0(&pending);
+    }
+  if (!f)
+    {
+      GxSimpleConvolver::run_static(n_samples, conv, buffer);
+      return;
+    }
+  float old[n_samples];
+  memcpy(old, buffer, n_samples * sizeof(float));
+  GxSimpleConvolver::run_static(n_samples, f, old);
+  GxSimpleConvolver::run_static(n_samples, conv, buffer);
+  // equal power gains sin / cos from a recursive oscillator
+  int32_t n = min(static_cast<int32_t>(n_samples), fade_len - fade_pos);
+  for (int32_t i = 0; i < n; ++i)
+    {
+      buffer[i] = buffer[i] * fade_sin + old[i] * fade_cos;
+      float s = fade_sin * fade_dcos + fade_cos * fade_dsin;
+      fade_cos = fade_cos * fade_dcos - fade_sin * fade_dsin;
+      fade_sin = s;
+    }
+  fade_pos += n;
+  if (fade_pos >= fade_len)
+    atomic_set_0(&fading);
+}
+
 //////////////////////// define dsp namespaces /////////////////////////
 
 #define declare(n) namespace n { PluginLV2 *plugin(); }
@@ -211,10 +365,10 @@ private:
   uint32_t                     t_model_;
   uint32_t                     t_max;
   gx_resample::BufferResampler resamp;
-  GxSimpleConvolver            cabconv;
+  ConvFader                    cabconv;
   Impf                         impf;
   gx_resample::BufferResampler resamp1;
-  GxSimpleConvolver            ampconv;
+  ConvFader                    ampconv;
   Ampf                         ampf;
   uint32_t                     bufsize;
   uint32_t                     cur_bufsize;
@@ -241,8 +395,6 @@ private:
     {return abs(bufsize - cur_bufsize) != 0;}
   inline void update_cab() 
     {cab = (clevel_ + c_model_); c_old_model_ = c_model_;}
-  inline bool change_cab() 
-    {return abs(c_old_model_ - c_model_) > 0.1;}
   inline bool pre_changed() 
     {return abs(pre - alevel_) > 0.1;}
   inline void update_pre() 
@@ -261,6 +413,8 @@ private:
   inline void connect_mono(uint32_t port,void* data);
   inline void init_dsp_mono(uint32_t rate, uint32_t bufsize_);
   inline void do_work_mono();
+  inline bool load_cab(GxSimpleConvolver *spare);
+  inline bool load_pre(GxSimpleConvolver *spare);
   inline void connect_all_mono_ports(uint32_t port, void* data);
   inline void activate_f();
   inline void deactivate_f();
@@ -303,9 +457,9 @@ GxPluginMono::GxPluginMono() :
   a_model_(0), 
   t_model(NULL),
   t_model_(1),
-  cabconv(GxSimpleConvolver(resamp)),
+  cabconv(resamp),
   impf(Impf()),
-  ampconv(GxSimpleConvolver(resamp1)),
+  ampconv(resamp1),
   ampf(Ampf()),
   bufsize(0),
   cur_bufsize(0),
@@ -327,101 +481,82 @@ GxPluginMono::GxPluginMono() :
   // destructor
 GxPluginMono::~GxPluginMono()
 {
-  cabconv.stop_process();
-  cabconv.cleanup();
-  ampconv.stop_process();
-  ampconv.cleanup();
 };
 
 // plugin stuff
 
+// cabinet impulse response with the level applied; loaded into
+// spare, or directly into the current instance when spare is NULL
+bool GxPluginMono::load_cab(GxSimpleConvolver *spare)
+{
+  CabDesc& cab = *getCabEntry(static_cast<uint32_t>(c_model_)).data;
+  float cab_irdata_c[cab.ir_count];
+  float adjust_1x8 = 1;
+  if ( c_model_ == 17.0) adjust_1x8 = 0.5;
+  impf.compute(cab.ir_count, cab.ir_data, cab_irdata_c, (clevel_ * adjust_1x8) );
+  if (!spare)
+    return cabconv.configure(cab.ir_count, cab_irdata_c, cab.ir_sr, s_rate, bufsize, prio);
+  spare->set_samplerate(s_rate);
+  spare->set_buffersize(bufsize);
+  return spare->configure(cab.ir_count, cab_irdata_c, cab.ir_sr) && cabconv.fade_to(spare, prio);
+}
+
+// presence impulse response, see load_cab()
+bool GxPluginMono::load_pre(GxSimpleConvolver *spare)
+{
+  float pre_irdata_c[contrast_ir_desc.ir_count];
+  ampf.compute(contrast_ir_desc.ir_count,contrast_ir_desc.ir_data, pre_irdata_c, alevel_);
+  if (!spare)
+    return ampconv.configure(contrast_ir_desc.ir_count, pre_irdata_c, contrast_ir_desc.ir_sr, s_rate, bufsize, prio);
+  spare->set_samplerate(s_rate);
+  spare->set_buffersize(bufsize);
+  return spare->configure(contrast_ir_desc.ir_count, pre_irdata_c, contrast_ir_desc.ir_sr) && ampconv.fade_to(spare, prio);
+}
+
+// runs on the worker thread; a changed impulse response is loaded
+// into the spare convolver and crossfaded, so switching doesn't
+// mute or click. While a crossfade is still running the work is
+// left undone and scheduled again by the next run() call
 void GxPluginMono::do_work_mono()
 {
   if (buffsize_changed()) 
    {
      printf("buffersize changed to %u\n",cur_bufsize);
-     if (cabconv.is_runnable())
-        {
-          cabconv.set_not_runnable();
-          cabconv.stop_process();
-        }
-     if (ampconv.is_runnable())
-        {
-          ampconv.set_not_runnable();
-          ampconv.stop_process();
-        }
      bufsize = cur_bufsize;
-
-	 cabconv.cleanup();
-     CabDesc& cab = *getCabEntry(static_cast<uint32_t>(c_model_)).data;
-     cabconv.cab_count = cab.ir_count;
-     cabconv.cab_sr = cab.ir_sr;
-     cabconv.cab_data = cab.ir_data;
-     cabconv.set_samplerate(s_rate);
-     cabconv.set_buffersize(bufsize);
-     cabconv.configure(cabconv.cab_count, cabconv.cab_data, cabconv.cab_sr);
-     while (!cabconv.checkstate());
-     if(!cabconv.start(prio, SCHED_FIFO))
+     if (!load_cab(NULL))
         printf("cabinet convolver update buffersize fail\n");
-
-     ampconv.cleanup();
-     ampconv.set_samplerate(s_rate);
-     ampconv.set_buffersize(bufsize);
-     ampconv.configure(contrast_ir_desc.ir_count, contrast_ir_desc.ir_data, contrast_ir_desc.ir_sr);
-     while (!ampconv.checkstate());
-     if(!ampconv.start(prio, SCHED_FIFO))
+     update_cab();
+     if (!load_pre(NULL))
         printf("presence convolver update buffersize fail\n");
+     update_pre();
    }
   if (cab_changed())
     {
-      if (cabconv.is_runnable())
+     if (c_model_ < cab_table_size) {
+      GxSimpleConvolver *spare = cabconv.get_spare();
+      if (!spare)
         {
-          cabconv.set_not_runnable();
-          cabconv.stop_process();
+          atomic_set(&schedule_wait,0);
+          return;
         }
-     if (c_model_ < cab_table_size) {
-      // selected cabinet have changed?
-      if (change_cab())
-      {
-       
-        cabconv.cleanup();
-        CabDesc& cab = *getCabEntry(static_cast<uint32_t>(c_model_)).data;
-        cabconv.cab_count = cab.ir_count;
-        cabconv.cab_sr = cab.ir_sr;
-        cabconv.cab_data = cab.ir_data;
-        
-        cabconv.set_samplerate(s_rate);
-        cabconv.set_buffersize(bufsize);
-        cabconv.configure(cabconv.cab_count, cabconv.cab_data, cabconv.cab_sr);
-        //printf("cabconv.changed.\n");
-      }
-      float cab_irdata_c[cabconv.cab_count];
-      float adjust_1x8 = 1;
-      if ( c_model_ == 17.0) adjust_1x8 = 0.5;
-      impf.compute(cabconv.cab_count, cabconv.cab_data, cab_irdata_c, (clevel_ * adjust_1x8) );
-      cabconv.cab_data_new = cab_irdata_c;
-      while (!cabconv.checkstate());
-      if (!cabconv.update(cabconv.cab_count, cabconv.cab_data_new, cabconv.cab_sr))
-        printf("cabconv.update fail.\n");
-      if(!cabconv.start(prio, SCHED_FIFO))
+      if (!load_cab(spare))
         printf("cabinet convolver disabled\n");
       update_cab();
       //printf("cabinet convolver updated\n");
-    } // else printf("cabinet convolver disabled\n");
+     } else {
+      cabconv.stop_all();
+      //printf("cabinet convolver disabled\n");
+     }
     }
   if (pre_changed())
     {
-      if (ampconv.is_runnable())
+      GxSimpleConvolver *spare = ampconv.get_spare();
+      if (!spare)
         {
-          ampconv.set_not_runnable();
-          ampconv.stop_process();
+          atomic_set(&schedule_wait,0);
+          return;
         }
-      float pre_irdata_c[contrast_ir_desc.ir_count];
-      ampf.compute(contrast_ir_desc.ir_count,contrast_ir_desc.ir_data, pre_irdata_c, alevel_);
-      while (!ampconv.checkstate());
-      if (!ampconv.update(contrast_ir_desc.ir_count, pre_irdata_c, contrast_ir_desc.ir_sr))
-        printf("ampconv.update fail.\n");
-      if(!ampconv.start(prio, SCHED_FIFO))
+      if (!load_pre(spare))
         printf("presence convolver disabled\n");
       update_pre();
       //printf("presence convolver updated\n");
@@ -462,22 +597,10 @@ void GxPluginMono::init_dsp_mono(uint32_t rate, uint32_t bufsize_)
 #endif
       // set cabinet data
       CabDesc& cab = *getCabEntry(static_cast<uint32_t>(c_model_)).data;
-      cabconv.cab_count = cab.ir_count;
-      cabconv.cab_sr = cab.ir_sr;
-      cabconv.cab_data = cab.ir_data;
-        
-      cabconv.set_samplerate(rate);
-      cabconv.set_buffersize(bufsize);
-      cabconv.configure(cabconv.cab_count, cabconv.cab_data, cabconv.cab_sr);
-      while (!cabconv.checkstate());
-      if(!cabconv.start(prio, SCHED_FIFO))
+      if (!cabconv.configure(cab.ir_count, cab.ir_data, cab.ir_sr, rate, bufsize, prio))
         printf("cabinet convolver disabled\n");
 
-      ampconv.set_samplerate(rate);
-      ampconv.set_buffersize(bufsize);
-      ampconv.configure(contrast_ir_desc.ir_count, contrast_ir_desc.ir_data, contrast_ir_desc.ir_sr);
-      while (!ampconv.checkstate());
-      if(!ampconv.start(prio, SCHED_FIFO))
+      if (!ampconv.configure(contrast_ir_desc.ir_count, contrast_ir_desc.ir_data, contrast_ir_desc.ir_sr, rate, bufsize, prio))
         printf("presence convolver disabled\n");
     }
   else
@@ -539,13 +662,13 @@ void GxPluginMono::run_dsp_mono(uint32_t n_samples)
   a_model_ = min(a_max, static_cast<uint32_t>(*(a_model)));
   amplifier[a_model_]->mono_audio(static_cast<int>(n_samples), input, output, amplifier[a_model_]);
   // run presence convolver
-  ampconv.run_static(n_samples, &ampconv, output);
+  ampconv.compute(n_samples, output);
   // run selected tonestack
   t_model_ =  static_cast<uint32_t>(*(t_model));
   if (t_model_<=t_max)
     tonestack[t_model_]->mono_audio(static_cast<int>(n_samples), output, output, tonestack[t_model_]);
   // run selected cabinet convolver
-  cabconv.run_static(n_samples, &cabconv, output);
+  cabconv.compute(n_samples, output);
 
   // work ?
   if (!atomic_get(schedule_wait) && ( val_changed() || buffsize_changed())) 
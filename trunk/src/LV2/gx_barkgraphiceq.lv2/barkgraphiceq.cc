@@ -11,9 +11,8 @@ private:
 	//First elements in both arrays are common gains
 	float* fslider[BARK_NUMBER_OF_BANDS]; 
 	float* fbargraph[BARK_NUMBER_OF_BANDS];
-	//EQ's, first used for indication, second - for audio signal processing
-	orfanidis_eq::eq1* p_eq1;
-	orfanidis_eq::eq2* p_eq2;
+	//EQ filter bank, also measures the band levels for the bars
+	orfanidis_eq::eq_bank* p_eq;
 	
 	void connect(uint32_t port,void* data);
 	void clear_state_f();
@@ -45,8 +44,7 @@ Dsp::Dsp()
 	clear_state = clear_state_f_static;
 	delete_instance = del_instance;
 	
-	p_eq1 = NULL;
-	p_eq2 = NULL;
+	p_eq = NULL;
 	
 	clear_state_f();
 
@@ -79,9 +77,9 @@ inline void Dsp::init(unsigned int samplingFreq)
 	for (unsigned int i = 0; i < BARK_NUMBER_OF_BANDS; i++)
 		fg.add_band(bark_center_freqs[i], bark_bands_widths[i]);
 		
-	//Create Butterworth EQ object's
-	p_eq1 = new orfanidis_eq::eq1(fg, orfanidis_eq::butterworth);
-	p_eq2 = new orfanidis_eq::eq2(fg, orfanidis_eq::butterworth);
+	//Create Butterworth EQ bank
+	delete p_eq;
+	p_eq = new orfanidis_eq::eq_bank(fg, fSamplingFreq);
 	
 	clear_state_f();
 }
@@ -93,29 +91,16 @@ void Dsp::init_static(unsigned int samplingFreq, PluginLV2 *p)
 
 void always_inline Dsp::compute(int count, FAUSTFLOAT *input0, FAUSTFLOAT *output0)
 {
-	//Set params
-	for(unsigned int j = 0; j < BARK_NUMBER_OF_BANDS; j++) {
-		p_eq1->change_band_gain_db(j, *fslider[j]);
-		p_eq2->change_band_gain_db(j, *fslider[j]);
-	}
+	//Set params, coefficients are only recomputed for changed bands
+	for(unsigned int j = 0; j < BARK_NUMBER_OF_BANDS; j++)
+		p_eq->change_band_gain_db(j, *fslider[j]);
 	
 	//Process audio
-	double aver_out = 0;
-	for (int i=0; i<count; i++) {
-		double input = input0[i];	
-		double out = 0;
-		p_eq2->sbs_process(&input, &out);
-		output0[i] = out;
-		aver_out += out*out;
-	}
+	p_eq->process(count, input0, output0);
 	
 	//Update bars
-	for(unsigned int j = 0; j < BARK_NUMBER_OF_BANDS; j++) {
-		double input = aver_out/count;
-		double band_out = 0;
-		p_eq1->sbs_process_band(j, &input, &band_out);
-		*fbargraph[j] = BARK_NUMBER_OF_BANDS*band_out*band_out;				
-	}
+	for(unsigned int j = 0; j < BARK_NUMBER_OF_BANDS; j++)
+		*fbargraph[j] = BARK_NUMBER_OF_BANDS*p_eq->get_band_power(j);
 }
 
 void __rt_func Dsp::compute_static(int count, FAUSTFLOAT *input0, FAUSTFLOAT *output0, PluginLV2 *p)
@@ -289,9 +274,8 @@ PluginLV2 *plugin() {
 
 void Dsp::del_instance(PluginLV2 *p)
 {
-	//Delete eq's
-	delete static_cast<Dsp*>(p)->p_eq1;
-	delete static_cast<Dsp*>(p)->p_eq2;
+	//Delete eq
+	delete static_cast<Dsp*>(p)->p_eq;
 	delete static_cast<Dsp*>(p);
 }
 
@@ -2,7 +2,11 @@
 #define ORFANIDIS_EQ_H_
 
 #include <math.h>
+#include <string.h>
 #include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -161,6 +165,7 @@ private:
 public:
 	freq_grid(){}
 	freq_grid(const freq_grid& fg){this->freqs_ = fg.freqs_;}
+	freq_grid& operator=(const freq_grid& fg){this->freqs_ = fg.freqs_; return *this;}
 	~freq_grid(){}
 
 	eq_error_t set_band(eq_double_t fmin, eq_double_t f0, eq_double_t fmax) {
@@ -942,7 +947,7 @@ public:
 	
 	~eq_channel(){cleanup_filters_array();}
 	
-	eq_error_t set_channel(filter_type ft, eq_single_t fs) {
+	eq_error_t set_channel(filter_type ft, eq_single_t /*fs*/) {
 		
 		eq_double_t wb = conversions::hz_2_rad(fb_, sampling_frequency_);
         eq_double_t w0 = conversions::hz_2_rad(f0_, sampling_frequency_);
@@ -1121,11 +1126,11 @@ public:
     eq_error_t change_band_gain_db(unsigned int band_number, 
 		eq_single_t band_gain) {
 		if(band_number < channels_.size())
-			    channels_[band_number]->set_gain_db(band_gain);
-		    else
-		    	return invalid_input_data_error;
+			channels_[band_number]->set_gain_db(band_gain);
+		else
+			return invalid_input_data_error;
 
-			return no_error;
+		return no_error;
     }
     
     eq_error_t sbs_process_band(unsigned int band_number, 
@@ -1157,5 +1162,403 @@ public:
 	const char* get_version(){return eq_version;}
 };
 
+// ------------ eq_bank ------------
+// Butterworth equalizer kept as a structure of arrays.
+// Band coefficients are recomputed only when a gain changes and flat
+// bands are bypassed. The same process() call runs a fixed bandpass
+// bank over the result to measure the power of every band, two bands
+// per SSE2 register. The meter of a band runs at the lowest rate of
+// fs, fs/2, fs/4, fs/8 which still covers the band; each rate is
+// produced by a halfband decimator from the one above.
+static const unsigned int eq_bank_max_bands = 32;
+static const unsigned int eq_bank_sections = 2; // fourth order bands
+static const eq_single_t eq_bank_flat_gain_db = 0.005;
+static const unsigned int eq_bank_meter_levels = 4;
+static const unsigned int eq_bank_meter_chunk = 256;
+// highest band frequency at a decimated level, relative to the rate
+// before decimation (passband edge of the halfband filter)
+static const eq_double_t eq_bank_meter_passband = 0.18;
+
+// halfband lowpass, decimating by 2 (47 taps, Blackman windowed sinc)
+class halfband_decimator
+{
+	static const unsigned int pairs = 12;
+	static const unsigned int len = 4*pairs - 1;
+	static const unsigned int centre = 2*pairs - 1;
+	eq_single_t c_[pairs]; // taps at distance 2k+1 from the centre
+	eq_single_t hist_[2*len]; // delay line stored twice
+	unsigned int pos_;
+	bool phase_;
+
+public:
+	halfband_decimator() {
+	    eq_double_t sum = 0;
+	    for(unsigned int k = 0; k < pairs; k++) {
+	        int d = 2*k + 1;
+	        eq_double_t w = 0.42 + 0.5*cos(pi*d/(centre+1))
+	            + 0.08*cos(2*pi*d/(centre+1));
+	        c_[k] = w*sin(pi*d/2)/(pi*d);
+	        sum += c_[k];
+	    }
+	    // unity gain at DC
+	    for(unsigned int k = 0; k < pairs; k++)
+	        c_[k] *= 0.25/sum;
+	    clear();
+	}
+
+	void clear() {
+	    memset(hist_, 0, sizeof(hist_));
+	    pos_ = 0;
+	    phase_ = false;
+	}
+
+	// returns the number of samples written to out
+	int process(int count, const eq_single_t *in, eq_single_t *out) {
+	    int n = 0;
+	    for(int i = 0; i < count; i++) {
+	        pos_ = (pos_ == 0 ? len : pos_) - 1;
+	        hist_[pos_] = hist_[pos_+len] = in[i];
+	        phase_ = !phase_;
+	        if (phase_)
+	            continue;
+	        const eq_single_t *x = hist_ + pos_ + centre;
+	        eq_single_t v = 0.5*x[0];
+	        for(unsigned int k = 0; k < pairs; k++)
+	            v += c_[k]*(x[-(int)(2*k+1)] + x[2*k+1]);
+	        out[n++] = v;
+	    }
+	    return n;
+	}
+};
+
+class eq_bank
+{
+	// fourth order sections, indexed [section][tap][band]
+	struct section_array {
+		eq_single_t b[eq_bank_sections][5][eq_bank_max_bands];
+		eq_single_t a[eq_bank_sections][fo_section_order][eq_bank_max_bands];
+		eq_single_t x[eq_bank_sections][fo_section_order][eq_bank_max_bands];
+		eq_single_t y[eq_bank_sections][fo_section_order][eq_bank_max_bands];
+	};
+
+	// one section held in registers while a block is processed,
+	// T is eq_single_t or a vector of bands
+	template <class T>
+	struct fo_regs {
+		T b0, b1, b2, b3, b4, a1, a2, a3, a4;
+		T x0, x1, x2, x3, y0, y1, y2, y3;
+
+		inline T process(T v) {
+			// feedback of the last output goes in last to keep the
+			// recursion short
+			T o = ((b0*v + ((b1*x0 + b2*x1) + (b3*x2 + b4*x3)))
+			       - ((a2*y1 + a3*y2) + a4*y3)) - a1*y0;
+			x3 = x2; x2 = x1; x1 = x0; x0 = v;
+			y3 = y2; y2 = y1; y1 = y0; y0 = o;
+			return o;
+		}
+	};
+
+	static inline void get(eq_single_t& r, const eq_single_t *p) { r = *p; }
+	static inline void put(eq_single_t r, eq_single_t *p) { *p = r; }
+#if defined(__SSE2__)
+	// __m128d without its aliasing attribute, usable as template argument
+	typedef eq_single_t sse_pd __attribute__((vector_size(16)));
+	static inline void get(sse_pd& r, const eq_single_t *p) { r = _mm_loadu_pd(p); }
+	static inline void put(sse_pd r, eq_single_t *p) { _mm_storeu_pd(p, r); }
+#endif
+
+	template <class T>
+	static inline void load(fo_regs<T>& r, const section_array& s,
+		unsigned int k, unsigned int j) {
+		get(r.b0, &s.b[k][0][j]); get(r.b1, &s.b[k][1][j]);
+		get(r.b2, &s.b[k][2][j]); get(r.b3, &s.b[k][3][j]);
+		get(r.b4, &s.b[k][4][j]);
+		get(r.a1, &s.a[k][0][j]); get(r.a2, &s.a[k][1][j]);
+		get(r.a3, &s.a[k][2][j]); get(r.a4, &s.a[k][3][j]);
+		get(r.x0, &s.x[k][0][j]); get(r.x1, &s.x[k][1][j]);
+		get(r.x2, &s.x[k][2][j]); get(r.x3, &s.x[k][3][j]);
+		get(r.y0, &s.y[k][0][j]); get(r.y1, &s.y[k][1][j]);
+		get(r.y2, &s.y[k][2][j]); get(r.y3, &s.y[k][3][j]);
+	}
+
+	template <class T>
+	static inline void store(const fo_regs<T>& r, section_array& s,
+		unsigned int k, unsigned int j) {
+		put(r.x0, &s.x[k][0][j]); put(r.x1, &s.x[k][1][j]);
+		put(r.x2, &s.x[k][2][j]); put(r.x3, &s.x[k][3][j]);
+		put(r.y0, &s.y[k][0][j]); put(r.y1, &s.y[k][1][j]);
+		put(r.y2, &s.y[k][2][j]); put(r.y3, &s.y[k][3][j]);
+	}
+
+	eq_double_t sampling_frequency_;
+	freq_grid freq_grid_;
+	unsigned int bands_;
+	eq_double_t w0_[eq_bank_max_bands];
+	eq_double_t wb_[eq_bank_max_bands];
+	eq_single_t gain_db_[eq_bank_max_bands];
+	bool active_[eq_bank_max_bands];
+	eq_single_t power_[eq_bank_max_bands];
+	section_array eq_;
+	// meters: band i runs in slot meter_slot_[i] of level meter_level_[i]
+	section_array meter_[eq_bank_meter_levels];
+	unsigned int meter_bands_[eq_bank_meter_levels];
+	unsigned int meter_depth_; // number of levels in use
+	unsigned int meter_level_[eq_bank_max_bands];
+	unsigned int meter_slot_[eq_bank_max_bands];
+	eq_single_t meter_acc_[eq_bank_meter_levels][eq_bank_max_bands];
+	unsigned int meter_count_[eq_bank_meter_levels];
+	halfband_decimator decimator_[eq_bank_meter_levels-1];
+
+	eq_bank(const eq_bank&);
+
+	static void clear_band(section_array& s, unsigned int band) {
+		for(unsigned int k = 0; k < eq_bank_sections; k++)
+			for(unsigned int t = 0; t < fo_section_order; t++) {
+				s.x[k][t][band] = 0;
+				s.y[k][t][band] = 0;
+			}
+	}
+
+	// same design as butterworth_bp_filter, without allocation
+	static void set_butterworth_band(section_array& s, unsigned int band,
+	        eq_double_t w0, eq_double_t wb,
+	        eq_double_t G, eq_double_t Gb, eq_double_t G0) {
+	    const unsigned int N = 2*eq_bank_sections;
+
+	    G = conversions::db_2_lin(G);
+	    Gb = conversions::db_2_lin(Gb);
+	    G0 = conversions::db_2_lin(G0);
+
+	    eq_double_t epsilon = pow(((eq_double_t)(G*G - Gb*Gb))/
+	    	(Gb*Gb - G0*G0),0.5);
+	    eq_double_t g = pow(((eq_double_t)G),1.0/((eq_double_t)N));
+	    eq_double_t g0 = pow(((eq_double_t)G0),1.0/((eq_double_t)N));
+	    eq_double_t beta = pow(((eq_double_t)epsilon), -1.0/((eq_double_t)N))*
+	    	tan(wb/2.0);
+
+	    eq_double_t c0 = cos(w0);
+	    if (w0 == 0) c0 = 1;
+	    if (w0 == pi/2) c0=0;
+	    if (w0 == pi) c0 =- 1;
+
+	    for(unsigned int k = 0; k < eq_bank_sections; k++) {
+	        eq_double_t si = sin(pi*((2.0*(k+1)-1)/N)/2.0);
+	        eq_double_t D = beta*beta + 2*si*beta + 1;
+
+	        s.b[k][0][band] = (g*g*beta*beta + 2*g*g0*si*beta + g0*g0)/D;
+	        s.b[k][1][band] = -4*c0*(g0*g0 + g*g0*si*beta)/D;
+	        s.b[k][2][band] = 2*(g0*g0*(1 + 2*c0*c0) - g*g*beta*beta)/D;
+	        s.b[k][3][band] = -4*c0*(g0*g0 - g*g0*si*beta)/D;
+	        s.b[k][4][band] = (g*g*beta*beta - 2*g*g0*si*beta + g0*g0)/D;
+
+	        s.a[k][0][band] = -4*c0*(1 + si*beta)/D;
+	        s.a[k][1][band] = 2*(1 + 2*c0*c0 - beta*beta)/D;
+	        s.a[k][2][band] = -4*c0*(1 - si*beta)/D;
+	        s.a[k][3][band] = (beta*beta - 2*si*beta + 1)/D;
+	    }
+	}
+
+	void process_cascade(int count, float *out) {
+	    for(unsigned int j = 0; j < bands_; j++) {
+	        if (!active_[j])
+	            continue;
+	        fo_regs<eq_single_t> s0, s1;
+	        load(s0, eq_, 0, j);
+	        load(s1, eq_, 1, j);
+	        for(int i = 0; i < count; i++)
+	            out[i] = s1.process(s0.process(out[i]));
+	        store(s0, eq_, 0, j);
+	        store(s1, eq_, 1, j);
+	    }
+	}
+
+#if defined(__SSE2__)
+	void process_meter_level(unsigned int l, int count, const eq_single_t *in) {
+	    // lanes past meter_bands_[l] have zero coefficients and stay silent
+	    section_array& m = meter_[l];
+	    for(unsigned int j = 0; j < meter_bands_[l]; j += 2) {
+	        fo_regs<sse_pd> s0, s1;
+	        load(s0, m, 0, j);
+	        load(s1, m, 1, j);
+	        __m128d acc = _mm_loadu_pd(&meter_acc_[l][j]);
+	        for(int i = 0; i < count; i++) {
+	            __m128d v = s1.process(s0.process(_mm_set1_pd(in[i])));
+	            acc = _mm_add_pd(acc, _mm_mul_pd(v, v));
+	        }
+	        store(s0, m, 0, j);
+	        store(s1, m, 1, j);
+	        _mm_storeu_pd(&meter_acc_[l][j], acc);
+	    }
+	    meter_count_[l] += count;
+	}
+#else
+	void process_meter_level(unsigned int l, int count, const eq_single_t *in) {
+	    section_array& m = meter_[l];
+	    for(unsigned int j = 0; j < meter_bands_[l]; j++) {
+	        fo_regs<eq_single_t> s0, s1;
+	        load(s0, m, 0, j);
+	        load(s1, m, 1, j);
+	        eq_single_t acc = meter_acc_[l][j];
+	        for(int i = 0; i < count; i++) {
+	            eq_single_t v = s1.process(s0.process(in[i]));
+	            acc += v*v;
+	        }
+	        store(s0, m, 0, j);
+	        store(s1, m, 1, j);
+	        meter_acc_[l][j] = acc;
+	    }
+	    meter_count_[l] += count;
+	}
+#endif
+
+	void process_meters(int count, const float *in) {
+	    eq_single_t buf[2][eq_bank_meter_chunk];
+	    memset(meter_acc_, 0, sizeof(meter_acc_));
+	    memset(meter_count_, 0, sizeof(meter_count_));
+	    for(int i = 0; i < count; i += eq_bank_meter_chunk) {
+	        int n = count - i;
+	        if (n > (int)eq_bank_meter_chunk)
+	            n = eq_bank_meter_chunk;
+	        eq_single_t *p = buf[0];
+	        for(int k = 0; k < n; k++)
+	            p[k] = in[i+k];
+	        for(unsigned int l = 0; l < meter_depth_; l++) {
+	            if (l) {
+	                eq_single_t *q = buf[l%2];
+	                n = decimator_[l-1].process(n, p, q);
+	                p = q;
+	            }
+	            process_meter_level(l, n, p);
+	        }
+	    }
+	    // a level without new samples keeps its last value
+	    for(unsigned int j = 0; j < bands_; j++) {
+	        unsigned int l = meter_level_[j];
+	        if (meter_count_[l])
+	            power_[j] = meter_acc_[l][meter_slot_[j]]/meter_count_[l];
+	    }
+	}
+
+public:
+	eq_bank(const freq_grid &fg, eq_double_t fs) {
+	    sampling_frequency_ = fs;
+	    set_eq(fg);
+	}
+	~eq_bank(){}
+
+	eq_error_t set_eq(const freq_grid& fg) {
+	    freq_grid_ = fg;
+	    memset(&eq_, 0, sizeof(eq_));
+	    memset(meter_, 0, sizeof(meter_));
+	    memset(meter_bands_, 0, sizeof(meter_bands_));
+	    meter_depth_ = 0;
+	    memset(power_, 0, sizeof(power_));
+	    for(unsigned int l = 0; l < eq_bank_meter_levels-1; l++)
+	        decimator_[l].clear();
+	    bands_ = 0;
+	    if (freq_grid_.get_number_of_bands() > eq_bank_max_bands)
+	        return invalid_input_data_error;
+	    bands_ = freq_grid_.get_number_of_bands();
+
+	    std::vector<band_freqs> freqs = freq_grid_.get_freqs();
+	    for(unsigned int i = 0; i < bands_; i++) {
+	        wb_[i] = conversions::hz_2_rad(
+	                freqs[i].max_freq - freqs[i].min_freq,
+	                sampling_frequency_);
+	        w0_[i] = conversions::hz_2_rad(
+	                freqs[i].center_freq, sampling_frequency_);
+	        gain_db_[i] = p_eq_default_gain_db;
+	        active_[i] = false;
+	        // lowest meter rate that still covers the band
+	        unsigned int l = eq_bank_meter_levels-1;
+	        while (l > 0 && freqs[i].max_freq >= eq_bank_meter_passband
+	               * sampling_frequency_ / (1 << (l-1)))
+	            l--;
+	        meter_level_[i] = l;
+	        meter_slot_[i] = meter_bands_[l]++;
+	        if (l >= meter_depth_)
+	            meter_depth_ = l+1;
+	        eq_double_t fs = sampling_frequency_ / (1 << l);
+	        eq_double_t w0 = conversions::hz_2_rad(freqs[i].center_freq, fs);
+	        if (w0 < pi)
+	            set_butterworth_band(meter_[l], meter_slot_[i], w0,
+	                    conversions::hz_2_rad(freqs[i].max_freq
+	                            - freqs[i].min_freq, fs),
+	                    max_base_gain_db, butterworth_band_gain_db,
+	                    min_base_gain_db);
+	    }
+	    return no_error;
+	}
+
+	eq_error_t set_sample_rate(eq_double_t sr) {
+	    std::vector<eq_single_t> gains(gain_db_, gain_db_ + bands_);
+	    sampling_frequency_ = sr;
+	    eq_error_t err = set_eq(freq_grid_);
+	    if (err == no_error)
+	        err = change_gains_db(gains);
+	    return err;
+	}
+
+	eq_error_t change_gains_db(std::vector<eq_single_t> band_gains) {
+	    if(band_gains.size() != bands_)
+	        return invalid_input_data_error;
+	    for(unsigned int j = 0; j < bands_; j++)
+	        change_band_gain_db(j, band_gains[j]);
+	    return no_error;
+	}
+
+	// cheap when the gain is unchanged, so it can be called every cycle
+	eq_error_t change_band_gain_db(unsigned int band_number,
+		eq_single_t band_gain) {
+	    if(band_number >= bands_)
+	        return invalid_input_data_error;
+	    if (band_gain > p_eq_min_max_gain_db)
+	        band_gain = p_eq_min_max_gain_db;
+	    else if (band_gain < -p_eq_min_max_gain_db)
+	        band_gain = -p_eq_min_max_gain_db;
+	    if (band_gain == gain_db_[band_number])
+	        return no_error;
+	    gain_db_[band_number] = band_gain;
+
+	    if (fabs(band_gain) < eq_bank_flat_gain_db
+	        || w0_[band_number] >= pi) {
+	        active_[band_number] = false;
+	        return no_error;
+	    }
+	    if (!active_[band_number]) {
+	        clear_band(eq_, band_number);
+	        active_[band_number] = true;
+	    }
+	    set_butterworth_band(eq_, band_number, w0_[band_number],
+	            wb_[band_number], band_gain,
+	            butterworth_bp_filter::compute_bw_gain_db(band_gain),
+	            p_eq_default_gain_db);
+	    return no_error;
+	}
+
+	// in and out may point to the same buffer
+	void process(int count, const float *in, float *out) {
+	    if (count <= 0)
+	        return;
+	    if (in != out)
+	        memcpy(out, in, count*sizeof(float));
+	    process_cascade(count, out);
+	    process_meters(count, out);
+	}
+
+	// mean power of each band in the last processed block
+	eq_single_t get_band_power(unsigned int band_number) {
+	    if(band_number < bands_)
+	        return power_[band_number];
+	    return 0;
+	}
+
+	unsigned int get_number_of_bands() {
+		return bands_;
+	}
+	const char* get_version(){return eq_version;}
+};
+
 } //namespace orfanidis_eq
 #endif //ORFANIDIS_EQ_H_
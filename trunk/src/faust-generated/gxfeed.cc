@@ -44,7 +44,7 @@ public:
 Dsp::Dsp()
 	: PluginDef() {
 	version = PLUGINDEF_VERSION;
-	flags = 0;
+	flags = PGN_MONO_SAFE;
 	id = "gxfeed";
 	name = "?gxfeed";
 	groups = 0;
@@ -154,6 +154,11 @@ void always_inline Dsp::compute(int count, FAUSTFLOAT *input0, FAUSTFLOAT *input
 
 void __rt_func Dsp::compute_static(int count, FAUSTFLOAT *input0, FAUSTFLOAT *input1, FAUSTFLOAT *output0, FAUSTFLOAT *output1, PluginDef *p)
 {
+	if (!output1) {
+		// mono: both channels carry the signal of input0 / output0
+		static_cast<Dsp*>(p)->compute(count, input0, input0, output0, output0);
+		return;
+	}
 	static_cast<Dsp*>(p)->compute(count, input0, input1, output0, output1);
 }
 
@@ -158,6 +158,41 @@ bool read_audio(const std::string& filename, unsigned int *audio_size, int *audi
  ** GxConvolverBase
  */
 
+/*
+** the fftw plans of the convolvers are made with FFTW_MEASURE;
+** the accumulated fftw wisdom is kept in a file in the user
+** directory so that planning is fast after the first start
+*/
+
+std::string GxConvolverBase::wisdom_file;
+
+void GxConvolverBase::load_wisdom(const std::string& fname) {
+    wisdom_file = fname;
+    FILE *fp = fopen(fname.c_str(), "r");
+    if (!fp) {
+        return; // not yet created
+    }
+    if (!fftwf_import_wisdom_from_file(fp)) {
+        gx_print_warning(
+            "convolver", Glib::ustring::compose("can't read fftw wisdom from %1", fname));
+    }
+    fclose(fp);
+}
+
+void GxConvolverBase::save_wisdom() {
+    if (wisdom_file.empty()) {
+        return;
+    }
+    FILE *fp = fopen(wisdom_file.c_str(), "w");
+    if (!fp) {
+        gx_print_warning(
+            "convolver", Glib::ustring::compose("can't write fftw wisdom to %1", wisdom_file));
+        return;
+    }
+    fftwf_export_wisdom_to_file(fp);
+    fclose(fp);
+}
+
 GxConvolverBase::~GxConvolverBase() {
     if (is_runnable()) {
 	stop_process();
@@ -443,10 +478,15 @@ bool __rt_func GxConvolver::compute(int count, float* input1, float *input2,
     memcpy(inpdata(0), input1, count * sizeof(float));
     memcpy(inpdata(1), input2, count * sizeof(float));
 
+#ifdef ZITA_CONVOLVER_OUTPUT_BUFFERS
+    float *outp[2] = { output1, output2 };
+    int flags = process(sync, outp);
+#else
     int flags = process(sync);
 
     memcpy(output1, outdata(0), count * sizeof(float));
     memcpy(output2, outdata(1), count * sizeof(float));
+#endif
     return flags == 0;
 }
 
@@ -501,50 +541,128 @@ bool __rt_func GxConvolver::compute(int count, float* input, float *output) {
     }
     memcpy(inpdata(0), input, count * sizeof(float));
 
+#ifdef ZITA_CONVOLVER_OUTPUT_BUFFERS
+    int flags = process(sync, &output);
+#else
     int flags = process(sync);
 
     memcpy(output, outdata(0), count * sizeof(float));
+#endif
     return flags == 0;
 }
 
 
 /****************************************************************
- ** GxSimpleConvolver
+ ** IRCache
  */
 
-class CheckResample {
-private:
-    float *vec;
-    gx_resample::BufferResampler& resamp;
-public:
-    CheckResample(gx_resample::BufferResampler& resamp_): vec(0), resamp(resamp_) {}
-    float *resample(int *count, float *impresp, unsigned int imprate, unsigned int samplerate) {
-	if (imprate != samplerate) {
-	    vec = resamp.process(imprate, *count, impresp, samplerate, count);
-	    if (!vec) {
-		boost::format msg = boost::format("failed to resample %1% -> %2%") % imprate % samplerate;
-		if (samplerate) {
-		    gx_print_error("convolver", msg);
-		} else {
-		    // not need for extra error when no samplerate (probably not connected to jack)
-		    gx_print_warning("convolver", msg);
-		}
-		return 0;
-	    }
-	    return vec;
-	}
-        return impresp;
+IRCache IRCache::instance;
+
+IRCache::~IRCache() {
+    for (std::list<Entry*>::iterator i = entries.begin(); i != entries.end(); ++i) {
+        delete *i;
     }
-    ~CheckResample() {
-	if (vec) {
-	    delete vec;
-	}
+}
+
+uint64_t IRCache::calc_hash(int count, const float *impresp) {
+    // FNV-1a, 64 bit
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(impresp);
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned int i = 0; i < count * sizeof(float); ++i) {
+        h = (h ^ p[i]) * 1099511628211ULL;
     }
-};
+    return h;
+}
+
+void IRCache::trim() {
+    int unused = 0;
+    for (std::list<Entry*>::iterator i = entries.begin(); i != entries.end(); ) {
+        if ((*i)->refcount == 0 && ++unused > max_unused) {
+            delete *i;
+            i = entries.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+IRCache::Entry *IRCache::acquire(
+    gx_resample::BufferResampler& resamp, int count, float *impresp,
+    unsigned int imprate, unsigned int samplerate) {
+    uint64_t hash = calc_hash(count, impresp);
+    boost::mutex::scoped_lock lock(mutex);
+    for (std::list<Entry*>::iterator i = entries.begin(); i != entries.end(); ++i) {
+        Entry *e = *i;
+        if (e->hash == hash && e->count == count
+            && e->imprate == imprate && e->samplerate == samplerate) {
+            e->refcount++;
+            entries.splice(entries.begin(), entries, i);
+            return e;
+        }
+    }
+    int olen;
+    float *vec = resamp.process(imprate, count, impresp, samplerate, &olen);
+    if (!vec) {
+        boost::format msg = boost::format("failed to resample %1% -> %2%") % imprate % samplerate;
+        if (samplerate) {
+            gx_print_error("convolver", msg);
+        } else {
+            // not need for extra error when no samplerate (probably not connected to jack)
+            gx_print_warning("convolver", msg);
+        }
+        return 0;
+    }
+    Entry *e = new Entry;
+    e->hash = hash;
+    e->imprate = imprate;
+    e->samplerate = samplerate;
+    e->count = count;
+    e->data.assign(vec, vec + olen);
+    e->refcount = 1;
+    delete[] vec;
+    entries.push_front(e);
+    trim();
+    return e;
+}
+
+void IRCache::release(Entry *e) {
+    if (!e) {
+        return;
+    }
+    boost::mutex::scoped_lock lock(mutex);
+    e->refcount--;
+    trim();
+}
+
+
+/****************************************************************
+ ** GxSimpleConvolver
+ */
+
+GxSimpleConvolver::~GxSimpleConvolver() {
+    IRCache::instance.release(ir);
+}
+
+// returns the impulse response at the convolver samplerate; a
+// resampled version is taken from the IRCache and held until the
+// next call (Convproc copies the data in configure / update)
+float *GxSimpleConvolver::get_ir(int *count, float *impresp, unsigned int imprate) {
+    IRCache::Entry *e = 0;
+    if (imprate != samplerate) {
+        e = IRCache::instance.acquire(resamp, *count, impresp, imprate, samplerate);
+        if (!e) {
+            return 0;
+        }
+        *count = e->size();
+        impresp = e->get();
+    }
+    IRCache::instance.release(ir);
+    ir = e;
+    return impresp;
+}
 
 bool GxSimpleConvolver::configure(int count, float *impresp, unsigned int imprate) {
-    CheckResample r(resamp);
-    impresp = r.resample(&count, impresp, imprate, samplerate);
+    impresp = get_ir(&count, impresp, imprate);
     if (!impresp) {
 	return false;
     }
@@ -566,8 +684,7 @@ bool GxSimpleConvolver::configure(int count, float *impresp, unsigned int imprat
 }
 
 bool GxSimpleConvolver::update(int count, float *impresp, unsigned int imprate) {
-    CheckResample r(resamp);
-    impresp = r.resample(&count, impresp, imprate, samplerate);
+    impresp = get_ir(&count, impresp, imprate);
     if (!impresp) {
 	return false;
     }
@@ -593,9 +710,13 @@ bool __rt_func GxSimpleConvolver::compute(int count, float* input, float *output
     }
     memcpy(inpdata(0), input, count * sizeof(float));
 
+#ifdef ZITA_CONVOLVER_OUTPUT_BUFFERS
+    int flags = process(sync, &output);
+#else
     int flags = process(sync);
 
     memcpy(output, outdata(0), count * sizeof(float));
+#endif
     return flags == 0;
 }
 
@@ -251,8 +251,11 @@ GxEngine::GxEngine(const string& plugin_dir, ParameterGroups& groups, const gx_s
       contrast(*this, sigc::mem_fun(mono_chain, &MonoModuleChain::sync), resamp),
       loop(get_param(), sigc::mem_fun(mono_chain,&MonoModuleChain::sync),options.get_loop_dir()),
       record(*this, 1), record_st(*this, 2),
-      detune(get_param(), *this, sigc::mem_fun(mono_chain, &MonoModuleChain::sync)) {
+      detune(get_param(), *this, sigc::mem_fun(mono_chain, &MonoModuleChain::sync)),
+      multitrack(*this, get_param(), groups) {
     set_overload_interval(options.get_sporadic_overload());
+    set_pipeline_stages(options.get_rack_stages());
+    GxConvolverBase::load_wisdom(options.get_user_filepath("fftw_wisdom"));
     if (!options.get_convolver_watchdog()) {
 	ov_disabled |= ov_Convolver;
     }
@@ -295,6 +298,7 @@ GxEngine::GxEngine(const string& plugin_dir, ParameterGroups& groups, const gx_s
 
 GxEngine::~GxEngine() {
     pluginlist.cleanup();
+    GxConvolverBase::save_wisdom();
 }
 
 void GxEngine::load_static_plugins() {
@@ -309,7 +313,7 @@ void GxEngine::load_static_plugins() {
 
     // rack pre mono modules inserted here
 
-    pl.add(builtin_amp_plugins,                   PLUGIN_POS_START, PGN_ALTERNATIVE|PGN_POST);
+    pl.add(builtin_amp_plugins,                   PLUGIN_POS_START, PGN_ALTERNATIVE|PGN_POST|PGN_OVERSAMPLE);
     pl.add(&ampstack.plugin,                      PLUGIN_POS_START, PGN_POST);
     pl.add(gx_effects::softclip::plugin(),        PLUGIN_POS_START, PGN_GUI|PGN_FIXED_GUI|PGN_POST);
 
@@ -350,13 +354,13 @@ void GxEngine::load_static_plugins() {
     pl.add(&loop.plugin,                          PLUGIN_POS_RACK, PGN_GUI);
     pl.add(&record.plugin,                        PLUGIN_POS_RACK, PGN_GUI);
     pl.add(&detune.plugin,                        PLUGIN_POS_RACK, PGN_GUI);
-    pl.add(gx_effects::gx_distortion::plugin(),   PLUGIN_POS_RACK, PGN_GUI);
+    pl.add(gx_effects::gx_distortion::plugin(),   PLUGIN_POS_RACK, PGN_GUI|PGN_OVERSAMPLE);
     pl.add(gx_effects::bitdowner::plugin(),       PLUGIN_POS_RACK, PGN_GUI);
-    pl.add(pluginlib::ts9sim::plugin(),           PLUGIN_POS_RACK, PGN_GUI);
+    pl.add(pluginlib::ts9sim::plugin(),           PLUGIN_POS_RACK, PGN_GUI|PGN_OVERSAMPLE);
     pl.add(gx_effects::impulseresponse::plugin(), PLUGIN_POS_RACK, PGN_GUI);
     pl.add(gx_effects::compressor::plugin(),      PLUGIN_POS_RACK, PGN_GUI);
     pl.add(gx_effects::expander::plugin(),        PLUGIN_POS_RACK, PGN_GUI);
-    pl.add(gx_effects::overdrive::plugin(),       PLUGIN_POS_RACK, PGN_GUI);
+    pl.add(gx_effects::overdrive::plugin(),       PLUGIN_POS_RACK, PGN_GUI|PGN_OVERSAMPLE);
     pl.add(gx_effects::echo::plugin(),            PLUGIN_POS_RACK, PGN_GUI);
     pl.add(gx_effects::delay::plugin(),           PLUGIN_POS_RACK, PGN_GUI);
     pl.add(&mono_convolver.plugin,                PLUGIN_POS_RACK, PGN_GUI);
@@ -388,11 +392,11 @@ void GxEngine::load_static_plugins() {
 	pl.add(gx_effects::duck_delay::plugin(),      PLUGIN_POS_RACK, PGN_GUI);
 	pl.add(pluginlib::reversedelay::plugin(),     PLUGIN_POS_RACK, PGN_GUI);
 	pl.add(gx_effects::baxandall::plugin(),       PLUGIN_POS_RACK, PGN_GUI);
-	pl.add(gx_effects::distortion2::plugin(),     PLUGIN_POS_RACK, PGN_GUI);
-	pl.add(gx_effects::fuzzface::plugin(),        PLUGIN_POS_RACK, PGN_GUI);
+	pl.add(gx_effects::distortion2::plugin(),     PLUGIN_POS_RACK, PGN_GUI|PGN_OVERSAMPLE);
+	pl.add(gx_effects::fuzzface::plugin(),        PLUGIN_POS_RACK, PGN_GUI|PGN_OVERSAMPLE);
 	pl.add(gx_effects::trbuff::plugin(),          PLUGIN_POS_RACK, PGN_GUI);
-	pl.add(pluginlib::fuzzfacefm::plugin(),       PLUGIN_POS_RACK, PGN_GUI);
-	pl.add(pluginlib::fuzzfacerm::plugin(),       PLUGIN_POS_RACK, PGN_GUI);
+	pl.add(pluginlib::fuzzfacefm::plugin(),       PLUGIN_POS_RACK, PGN_GUI|PGN_OVERSAMPLE);
+	pl.add(pluginlib::fuzzfacerm::plugin(),       PLUGIN_POS_RACK, PGN_GUI|PGN_OVERSAMPLE);
 	pl.add(pluginlib::hornet::plugin(),           PLUGIN_POS_RACK, PGN_GUI);
 	pl.add(pluginlib::susta::plugin(),            PLUGIN_POS_RACK, PGN_GUI);
 	pl.add(pluginlib::hfb::plugin(),              PLUGIN_POS_RACK, PGN_GUI);
@@ -517,4 +521,103 @@ void GxEngine::ladspaloader_update_plugins() {
     plugin_changed(0, PluginChange::update);
 }
 
+
+/****************************************************************
+ ** class OfflineRender
+ */
+
+OfflineRender::OfflineRender(GxEngine& engine_, unsigned int buffersize_)
+    : engine(engine_),
+      buffersize(buffersize_) {
+}
+
+void OfflineRender::set_convolver_sync(bool v) {
+    engine.mono_convolver.set_sync(v);
+    engine.stereo_convolver.set_sync(v);
+    engine.cabinet.set_sync(v);
+    engine.preamp.set_sync(v);
+    engine.contrast.set_sync(v);
+}
+
+bool OfflineRender::render(const std::string& infile, const std::string& outfile) {
+    SF_INFO info;
+    info.format = 0;
+    SNDFILE *in = sf_open(infile.c_str(), SFM_READ, &info);
+    if (!in) {
+	gx_print_error(
+	    "render", boost::format(_("can't open %1%: %2%")) % infile % sf_strerror(0));
+	return false;
+    }
+    int channels = info.channels;
+    info.channels = 2;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+    SNDFILE *out = sf_open(outfile.c_str(), SFM_WRITE, &info);
+    if (!out) {
+	gx_print_error(
+	    "render", boost::format(_("can't create %1%: %2%")) % outfile % sf_strerror(0));
+	sf_close(in);
+	return false;
+    }
+
+    // configure with the chains stopped, so nothing waits for
+    // an rt thread
+    engine.set_stateflag(GxEngine::SF_INITIALIZING);
+    set_convolver_sync(true);
+    engine.init(info.samplerate, buffersize, SCHED_OTHER, 0);
+    engine.update_module_lists();
+    engine.clear_rack_changed();
+    engine.check_module_lists();
+    engine.clear_stateflag(GxEngine::SF_INITIALIZING);
+    // no fade-in: the first input sample must reach the output
+    // at full level
+    engine.set_ramp_off();
+
+    const sf_count_t bs = buffersize;
+    std::vector<float> ibuf(channels * buffersize);
+    std::vector<float> obuf(2 * buffersize);
+    std::vector<float> mono(buffersize), amp(buffersize), out1(buffersize), out2(buffersize);
+    // skip the output delay of units reporting latency and of
+    // a pipelined rack (mono and stereo chain each add stages-1
+    // periods)
+    sf_count_t skip = engine.get_pipeline_latency() * buffersize + engine.get_mono_latency();
+    sf_count_t remaining = info.frames;
+    while (remaining > 0) {
+	sf_count_t n = sf_readf_float(in, &ibuf[0], bs);
+	if (n < 0) {
+	    n = 0;
+	}
+	// use the first channel; after end of input (pipeline
+	// flush) feed silence
+	for (sf_count_t i = 0; i < bs; i++) {
+	    mono[i] = (i < n ? ibuf[i*channels] : 0.0);
+	}
+	engine.mono_chain.process(buffersize, &mono[0], &amp[0]);
+	engine.stereo_chain.process(buffersize, &amp[0], &amp[0], &out1[0], &out2[0]);
+	engine.mono_chain.post_rt_finished();
+	engine.stereo_chain.post_rt_finished();
+	sf_count_t offset = 0;
+	if (skip > 0) {
+	    offset = min(skip, bs);
+	    skip -= offset;
+	}
+	sf_count_t k = min(bs - offset, remaining);
+	for (sf_count_t i = 0; i < k; i++) {
+	    obuf[2*i] = out1[offset+i];
+	    obuf[2*i+1] = out2[offset+i];
+	}
+	if (k > 0 && sf_writef_float(out, &obuf[0], k) != k) {
+	    gx_print_error(
+		"render", boost::format(_("write error on %1%: %2%")) % outfile % sf_strerror(out));
+	    break;
+	}
+	remaining -= k;
+    }
+
+    engine.set_stateflag(GxEngine::SF_INITIALIZING);
+    set_convolver_sync(false);
+    sf_close(in);
+    sf_close(out);
+    return remaining == 0;
+}
+
 } /* end of gx_engine namespace */
@@ -28,6 +28,166 @@
 
 namespace gx_engine {
 
+/****************************************************************
+ ** class RackPipeline
+ */
+
+RackPipeline::RackPipeline()
+    : stages(1),
+      channels(0),
+      bufsize(0),
+      workers(),
+      buffers(),
+      mono(),
+      mem(0),
+      done(),
+      func(0),
+      stage_data(),
+      count(0),
+      quit(false),
+      running(false),
+      nthreads(0),
+      policy(),
+      priority() {
+    sem_init(&done, 0, 0);
+}
+
+RackPipeline::~RackPipeline() {
+    stop_threads();
+    sem_destroy(&done);
+    delete[] mem;
+}
+
+void RackPipeline::set_buffersize(unsigned int bs, int nchannels) {
+    if (stages < 2 || (bs == bufsize && nchannels == channels)) {
+	return;
+    }
+    delete[] mem;
+    bufsize = bs;
+    channels = nchannels;
+    mem = new float[stages * channels * bufsize];
+    memset(mem, 0, stages * channels * bufsize * sizeof(float));
+    for (int i = 0; i < stages; i++) {
+	for (int j = 0; j < max_channels; j++) {
+	    buffers[i][j] = (j < channels ? mem + (i * channels + j) * bufsize : 0);
+	}
+    }
+}
+
+void *RackPipeline::run_thread(void *p) {
+    Worker& w = *static_cast<Worker*>(p);
+    while (true) {
+	sem_wait(&w.start);
+	if (w.pipe->quit) {
+	    break;
+	}
+	w.pipe->run_stage(w.stage);
+	sem_post(&w.pipe->done);
+    }
+    return NULL;
+}
+
+void __rt_func RackPipeline::run_stage(int stage) {
+    mono[stage] = func(stage_data[stage], count, buffers[stage][0], buffers[stage][1], mono[stage]);
+}
+
+// must not be called while the rt thread is running the pipeline
+void RackPipeline::start_threads(int policy_, int priority_) {
+    if (stages < 2) {
+	return;
+    }
+    if (running) {
+	if (policy_ == policy && priority_ == priority) {
+	    return;
+	}
+	stop_threads(); // restart workers with new scheduling parameters
+    }
+    policy = policy_;
+    priority = priority_;
+    quit = false;
+    for (nthreads = 1; nthreads < stages; nthreads++) {
+	Worker& w = workers[nthreads];
+	w.pipe = this;
+	w.stage = nthreads;
+	sem_init(&w.start, 0, 0);
+	pthread_attr_t      attr;
+	struct sched_param  spar;
+	spar.sched_priority = priority;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+	pthread_attr_setschedpolicy(&attr, policy);
+	pthread_attr_setschedparam(&attr, &spar);
+	pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	int rc = pthread_create(&w.pthr, &attr, run_thread, &w);
+	pthread_attr_destroy(&attr);
+	if (rc) {
+	    sem_destroy(&w.start);
+	    gx_print_error(
+		"RackPipeline",
+		_("can't create realtime thread - running rack on one core"));
+	    running = true;
+	    stop_threads();
+	    return;
+	}
+    }
+    running = true;
+}
+
+void RackPipeline::stop_threads() {
+    if (!running) {
+	return;
+    }
+    running = false;
+    quit = true;
+    for (int i = 1; i < nthreads; i++) {
+	sem_post(&workers[i].start);
+	pthread_join(workers[i].pthr, NULL);
+	sem_destroy(&workers[i].start);
+    }
+    nthreads = 0;
+}
+
+void __rt_func RackPipeline::process(int count_, float *in1, float *in2, float *out1, float *out2,
+				     stagefunc f, void **stage_list) {
+    // the last stage buffer is free after it has been copied to the
+    // output, it receives the new input; all other buffers move one
+    // stage down the line (together with its mono state)
+    float *b[max_channels];
+    for (int j = 0; j < max_channels; j++) {
+	b[j] = buffers[stages-1][j];
+	for (int i = stages-1; i > 0; i--) {
+	    buffers[i][j] = buffers[i-1][j];
+	}
+	buffers[0][j] = b[j];
+    }
+    for (int i = stages-1; i > 0; i--) {
+	mono[i] = mono[i-1];
+    }
+    mono[0] = (in1 == in2);
+    memcpy(buffers[0][0], in1, count_*sizeof(float));
+    if (channels > 1 && !mono[0]) {
+	memcpy(buffers[0][1], in2, count_*sizeof(float));
+    }
+    func = f;
+    count = count_;
+    for (int i = 0; i < stages; i++) {
+	stage_data[i] = stage_list[i];
+    }
+    for (int i = 1; i < stages; i++) {
+	sem_post(&workers[i].start);
+    }
+    run_stage(0);
+    for (int i = 1; i < stages; i++) {
+	while (sem_wait(&done) == -1 && errno == EINTR);
+    }
+    memcpy(out1, buffers[stages-1][0], count_*sizeof(float));
+    if (channels > 1) {
+	memcpy(out2, buffers[stages-1][mono[stages-1] ? 0 : 1], count_*sizeof(float));
+    }
+}
+
+
 /****************************************************************
  ** class ProcessingChainBase
  */
@@ -41,12 +201,14 @@ ProcessingChainBase::ProcessingChainBase():
     steps_up(),
     steps_up_dead(),
     steps_down(),
+    samplerate(),
     modules(),
     next_commit_needs_ramp() {
     sem_init(&sync_sem, 0, 0);
 }
 
-void ProcessingChainBase::set_samplerate(int samplerate) {
+void ProcessingChainBase::set_samplerate(int samplerate_) {
+    samplerate = samplerate_;
     //steps_down = (256 * samplerate) / 48000;
     //steps_up = 8 * steps_down;
     steps_down = (64 * samplerate) / 48000;
@@ -193,10 +355,42 @@ bool lists_equal(const list<Plugin*>& p1, const list<Plugin*>& p2, bool *need_ra
     return ret;
 }
 
+// called with the chain ramped down (from commit())
+void ProcessingChainBase::update_oversample() {
+    for (list<Plugin*>::const_iterator p = modules.begin(); p != modules.end(); ++p) {
+	if ((*p)->oversample_changed()) {
+	    (*p)->update_oversample(samplerate);
+	}
+    }
+}
+
+int ProcessingChainBase::get_oversample_latency() {
+    int n = 0;
+    for (list<Plugin*>::const_iterator p = modules.begin(); p != modules.end(); ++p) {
+	n += (*p)->get_oversample_latency();
+    }
+    return n;
+}
+
 bool ProcessingChainBase::set_plugin_list(const list<Plugin*> &p) {
-    if (lists_equal(p, modules, &next_commit_needs_ramp)) {
+    bool oversample_changed = false;
+    for (list<Plugin*>::const_iterator i = p.begin(); i != p.end(); ++i) {
+	if ((*i)->oversample_changed()) {
+	    oversample_changed = true;
+	    break;
+	}
+    }
+    if (lists_equal(p, modules, &next_commit_needs_ramp) && !oversample_changed) {
 	return false;
     }
+    if (oversample_changed) {
+	// filter states and plugin samplerate change
+	next_commit_needs_ramp = true;
+    }
+    if (pipeline.get_stages() > 1) {
+	// modules might move to another stage
+	next_commit_needs_ramp = true;
+    }
     wait_latch();
     if (check_release()) {
 	release();
@@ -252,15 +446,49 @@ void ProcessingChainBase::print_chain_state(const char *title) {
  ** MonoModuleChain, StereoModuleChain
  */
 
+inline void monochain_data::run_oversampled(int count, float *buf) {
+    int factor = oversampler->get_factor();
+    for (int i = 0; i < count; i += gx_resample::Oversampler::block_size) {
+	int n = min(count - i, int(gx_resample::Oversampler::block_size));
+	float *p = oversampler->up(0, n, buf + i);
+	func(n * factor, p, p, plugin);
+	oversampler->down(0, n, buf + i);
+    }
+}
+
+bool __rt_func monochain_data::process_stage(void *stage, int count, float *buf1, float *buf2, bool mono) {
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (monochain_data *p = static_cast<monochain_data*>(stage); p->func; ++p) {
+	if (p->oversampler && p->oversampler->get_factor() > 1) {
+	    p->run_oversampled(count, buf1);
+	} else {
+	    p->func(count, buf1, buf1, p->plugin);
+	}
+	RecordTrack *t = gx_system::atomic_get(*p->rec_track);
+	if (t) {
+	    t->write(count, buf1, 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	p->load->add(t1, t0);
+	t0 = t1;
+    }
+    return mono;
+}
+
 void __rt_func MonoModuleChain::process(int count, float *input, float *output) {
     RampMode rm = get_ramp_mode();
     if (rm == ramp_mode_down_dead) {
 	memset(output, 0, count*sizeof(float));
 	return;
     }
-    memcpy(output, input, count*sizeof(float));
-    for (monochain_data *p = get_rt_chain(); p->func; ++p) {
-	p->func(count, output, output, p->plugin);
+    if (pipeline.is_active()) {
+	void *stage_list[RackPipeline::max_stages];
+	get_rt_stages(get_rt_chain(), stage_list);
+	pipeline.process(count, input, 0, output, 0, monochain_data::process_stage, stage_list);
+    } else {
+	memcpy(output, input, count*sizeof(float));
+	process_serial(count, output, 0, false);
     }
     if (rm == ramp_mode_off) {
 	return;
@@ -312,6 +540,50 @@ void __rt_func MonoModuleChain::process(int count, float *input, float *output)
     try_set_ramp_mode(rm, rm1, rv, rv1);
 }
 
+inline void stereochain_data::run_oversampled(int count, float *buf1, float *buf2) {
+    int factor = oversampler->get_factor();
+    for (int i = 0; i < count; i += gx_resample::Oversampler::block_size) {
+	int n = min(count - i, int(gx_resample::Oversampler::block_size));
+	float *p1 = oversampler->up(0, n, buf1 + i);
+	float *p2 = oversampler->up(1, n, buf2 + i);
+	func(n * factor, p1, p2, p1, p2, plugin);
+	oversampler->down(0, n, buf1 + i);
+	oversampler->down(1, n, buf2 + i);
+    }
+}
+
+bool __rt_func stereochain_data::process_stage(void *stage, int count, float *buf1, float *buf2, bool mono) {
+    // while mono is set buf2 is not filled: snoop units see buf1 on
+    // both channels, PGN_MONO_SAFE units only compute the first
+    // channel; the first other unit gets its own copy in buf2
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (stereochain_data *p = static_cast<stereochain_data*>(stage); p->func; ++p) {
+	bool oversample = (p->oversampler && p->oversampler->get_factor() > 1);
+	if (mono && (oversample || !(p->plugin->flags & (PGN_SNOOP|PGN_MONO_SAFE)))) {
+	    memcpy(buf2, buf1, count*sizeof(float));
+	    mono = false;
+	}
+	if (oversample) {
+	    p->run_oversampled(count, buf1, buf2);
+	} else if (!mono) {
+	    (p->func)(count, buf1, buf2, buf1, buf2, p->plugin);
+	} else if (p->plugin->flags & PGN_SNOOP) {
+	    (p->func)(count, buf1, buf1, buf1, buf1, p->plugin);
+	} else {
+	    (p->func)(count, buf1, 0, buf1, 0, p->plugin);
+	}
+	RecordTrack *t = gx_system::atomic_get(*p->rec_track);
+	if (t) {
+	    t->write(count, buf1, mono ? buf1 : buf2);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	p->load->add(t1, t0);
+	t0 = t1;
+    }
+    return mono;
+}
+
 void __rt_func StereoModuleChain::process(int count, float *input1, float *input2, float *output1, float *output2) {
     // run stereo rack
     RampMode rm = get_ramp_mode();
@@ -320,10 +592,19 @@ void __rt_func StereoModuleChain::process(int count, float *input1, float *input
 	memset(output2, 0, count*sizeof(float));
 	return;
     }
-    memcpy(output1, input1, count*sizeof(float));
-    memcpy(output2, input2, count*sizeof(float));
-    for (stereochain_data *p = get_rt_chain(); p->func; ++p) {
-	(p->func)(count, output1, output2, output1, output2, p->plugin);
+    if (pipeline.is_active()) {
+	void *stage_list[RackPipeline::max_stages];
+	get_rt_stages(get_rt_chain(), stage_list);
+	pipeline.process(count, input1, input2, output1, output2, stereochain_data::process_stage, stage_list);
+    } else {
+	bool mono = (input1 == input2);
+	memcpy(output1, input1, count*sizeof(float));
+	if (!mono) {
+	    memcpy(output2, input2, count*sizeof(float));
+	}
+	if (process_serial(count, output1, output2, mono)) {
+	    memcpy(output2, output1, count*sizeof(float));
+	}
     }
     if (rm == ramp_mode_off) {
 	return;
@@ -467,6 +748,9 @@ EngineControl::EngineControl()
       samplerate_change(),
       buffersize(0),
       samplerate(0),
+      unit_latency(),
+      mono_latency(0),
+      latency_change(),
       pluginlist(*this) {
 }
 
@@ -517,12 +801,34 @@ void EngineControl::set_buffersize(unsigned int buffersize_) {
     buffersize_change(buffersize);
 }
 
+void EngineControl::set_unit_latency(const char *id, int frames) {
+    if (frames) {
+	unit_latency[id] = frames;
+    } else {
+	unit_latency.erase(id);
+    }
+    int n = 0;
+    for (map<string, int>::iterator i = unit_latency.begin(); i != unit_latency.end(); ++i) {
+	n += i->second;
+    }
+    if (n != mono_latency) {
+	gx_system::atomic_set(&mono_latency, n);
+	latency_change();
+    }
+}
+
 void EngineControl::init(unsigned int samplerate_, unsigned int buffersize_,
 			 int policy_, int priority_) {
     if (policy_ != policy || priority_ != priority) {
 	policy = policy_;
 	priority = priority_;
-	set_buffersize(buffersize_);
+	if (buffersize_ == buffersize) {
+	    // same size: still notify so rt helper threads
+	    // (rack pipeline, convolvers) restart with new priority
+	    buffersize_change(buffersize);
+	} else {
+	    set_buffersize(buffersize_);
+	}
 	set_samplerate(samplerate_);
 	return;
     }
@@ -560,6 +866,8 @@ ModuleSequencer::ModuleSequencer()
       stereo_chain() {
     overload_detected.connect(
 	sigc::mem_fun(this, &ModuleSequencer::check_overload));
+    buffersize_change.connect(
+	sigc::mem_fun(this, &ModuleSequencer::on_buffersize_change));
 }
 
 ModuleSequencer::~ModuleSequencer() {
@@ -601,6 +909,14 @@ bool ModuleSequencer::update_module_lists() {
     return false;
 }
 
+// called with chains stopped (engine init or jack reconfig)
+void ModuleSequencer::on_buffersize_change(unsigned int bs) {
+    mono_chain.set_buffersize(bs);
+    stereo_chain.set_buffersize(bs);
+    mono_chain.start_pipeline(policy, priority);
+    stereo_chain.start_pipeline(policy, priority);
+}
+
 void ModuleSequencer::set_samplerate(unsigned int samplerate) {
     mono_chain.set_samplerate(samplerate);
     stereo_chain.set_samplerate(samplerate);
@@ -660,6 +976,7 @@ void ModuleSequencer::commit_module_lists() {
 	stereo_chain.wait_ramp_down_finished();
     }
     stereo_chain.commit(stereo_chain.next_commit_needs_ramp, get_param());
+    set_unit_latency("oversample", mono_chain.get_oversample_latency());
     if (monoramp) {
 	mono_chain.start_ramp_up();
 	mono_chain.next_commit_needs_ramp = false;
@@ -27,6 +27,9 @@
 
 #include "engine.h"
 #include "gx_faust_support.h"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace gx_engine {
 
@@ -604,7 +607,17 @@ int ConvolverMonoAdapter::activate(bool start, PluginDef *p) {
 
 BaseConvolver::BaseConvolver(EngineControl& engine_, sigc::slot<void> sync_, gx_resample::BufferResampler& resamp)
     : PluginDef(),
-      conv(resamp),
+      conv1(resamp),
+      conv2(resamp),
+      pending(0),
+      fading(0),
+      fade_pos(0),
+      fade_len(0),
+      fade_sin(0),
+      fade_cos(1),
+      fade_dsin(0),
+      fade_dcos(1),
+      conv(&conv1),
       activate_mutex(),
       engine(engine_),
       sync(sync_),
@@ -624,10 +637,11 @@ BaseConvolver::~BaseConvolver() {
 
 void BaseConvolver::change_buffersize(unsigned int bufsize) {
     boost::mutex::scoped_lock lock(activate_mutex);
-    conv.set_buffersize(bufsize);
+    conv1.set_buffersize(bufsize);
+    conv2.set_buffersize(bufsize);
     if (activated) {
 	if (!bufsize) {
-	    conv.stop_process();
+	    stop_all();
 	} else {
 	    start(true);
 	}
@@ -637,16 +651,24 @@ void BaseConvolver::change_buffersize(unsigned int bufsize) {
 void BaseConvolver::init(unsigned int samplingFreq, PluginDef *p) {
     BaseConvolver& self = *static_cast<BaseConvolver*>(p);
     boost::mutex::scoped_lock lock(self.activate_mutex);
-    self.conv.set_samplerate(samplingFreq);
+    self.conv1.set_samplerate(samplingFreq);
+    self.conv2.set_samplerate(samplingFreq);
+    self.fade_len = samplingFreq / 50; // 20ms crossfade
+    self.fade_dsin = sin(M_PI_2 / self.fade_len);
+    self.fade_dcos = cos(M_PI_2 / self.fade_len);
     if (self.activated) {
 	self.start(true);
     }
 }
 
+// the spare instance is configured here, in the GUI thread, like
+// the stop / configure / restart path before it; the RT thread
+// keeps running the current instance meanwhile
 bool BaseConvolver::check_update_timeout() {
     if (!activated || !plugin.get_on_off()) {
 	return false;
     }
+    get_spare(); // stops the instance faded out by the last switch
     check_update();
     return true;
 }
@@ -655,7 +677,7 @@ int BaseConvolver::activate(bool start, PluginDef *p) {
     BaseConvolver& self = *static_cast<BaseConvolver*>(p);
     boost::mutex::scoped_lock lock(self.activate_mutex);
     if (start) {
-	if (!self.conv.get_buffersize()) {
+	if (!self.conv->get_buffersize()) {
 	    start = false;
 	}
     }
@@ -669,7 +691,7 @@ int BaseConvolver::activate(bool start, PluginDef *p) {
 	self.update_conn = Glib::signal_timeout().connect(
 	    sigc::mem_fun(self, &BaseConvolver::check_update_timeout), 200);
     } else {
-	self.conv.stop_process();
+	self.stop_all();
     }
     self.activated = start;
     return 0;
@@ -678,7 +700,95 @@ int BaseConvolver::activate(bool start, PluginDef *p) {
 int BaseConvolver::conv_start() {
     int policy, priority;
     engine.get_sched_priority(policy, priority);
-    return conv.start(policy, priority);
+    return conv->start(policy, priority);
+}
+
+// wait until the threads of the current instance have stopped
+// (they finish their current partition first)
+void BaseConvolver::wait_stop() {
+    while (!conv->checkstate()) {
+	usleep(1000);
+    }
+}
+
+// stop both instances and cancel a running switch; no switch
+// to the spare instance is done after this call
+void BaseConvolver::stop_all() {
+    if (conv1.is_runnable() || conv2.is_runnable()) {
+	conv1.set_not_runnable();
+	conv2.set_not_runnable();
+	sync();
+    }
+    gx_system::atomic_set_0(&pending);
+    gx_system::atomic_set_0(&fading);
+    conv1.stop_process();
+    conv2.stop_process();
+}
+
+// returns the instance which can be loaded with a new impulse
+// response, or 0 if a switch is in progress or the instance is
+// not yet stopped (never blocks)
+GxSimpleConvolver *BaseConvolver::get_spare() {
+    if (gx_system::atomic_get(pending) || gx_system::atomic_get(fading)) {
+	return 0;
+    }
+    GxSimpleConvolver *spare = (conv == &conv1 ? &conv2 : &conv1);
+    if (spare->is_runnable()) {
+	spare->set_not_runnable();
+	spare->stop_process();
+    }
+    if (!spare->checkstate()) {
+	return 0;
+    }
+    return spare;
+}
+
+// start the configured spare instance and let the RT thread
+// crossfade to it
+bool BaseConvolver::fade_to(GxSimpleConvolver *spare) {
+    int policy, priority;
+    engine.get_sched_priority(policy, priority);
+    if (!spare->start(policy, priority)) {
+	return false;
+    }
+    gx_system::atomic_set(&pending, spare);
+    return true;
+}
+
+bool __rt_func BaseConvolver::conv_compute(int count, float *buffer) {
+    // fading is cleared by stop_all() from outside the RT thread,
+    // so read it only once
+    GxSimpleConvolver *f = gx_system::atomic_get(fading);
+    GxSimpleConvolver *p = gx_system::atomic_get(pending);
+    if (p && !f) {
+	f = conv;
+	conv = p;
+	fade_pos = 0;
+	fade_sin = 0;
+	fade_cos = 1;
+	gx_system::atomic_set(&fading, f);
+	gx_system::atomic_set_0(&pending);
+    }
+    if (!f) {
+	return conv->compute(count, buffer);
+    }
+    float old[count];
+    memcpy(old, buffer, count * sizeof(float));
+    bool ret = f->compute(count, old);
+    ret = conv->compute(count, buffer) && ret;
+    // equal power gains sin / cos from a recursive oscillator
+    int n = min(count, fade_len - fade_pos);
+    for (int i = 0; i < n; ++i) {
+	buffer[i] = buffer[i] * fade_sin + old[i] * fade_cos;
+	float s = fade_sin * fade_dcos + fade_cos * fade_dsin;
+	fade_cos = fade_cos * fade_dcos - fade_sin * fade_dsin;
+	fade_sin = s;
+    }
+    fade_pos += n;
+    if (fade_pos >= fade_len) {
+	gx_system::atomic_set_0(&fading);
+    }
+    return ret;
 }
 
 /****************************************************************
@@ -790,10 +900,14 @@ CabinetConvolver::~CabinetConvolver() {
 
 bool CabinetConvolver::do_update() {
     bool configure = cabinet_changed();
-    if (conv.is_runnable()) {
-	conv.set_not_runnable();
-	sync();
-	conv.stop_process();
+    GxSimpleConvolver *spare = 0;
+    if (conv->is_runnable() && current_cab != -1) {
+	spare = get_spare();
+	if (!spare) {
+	    return true; // switch in progress, retried by check_update()
+	}
+    } else {
+	stop_all();
     }
     CabDesc& cab = *getCabEntry(cabinet).data;
     if (current_cab == -1) {
@@ -802,13 +916,21 @@ bool CabinetConvolver::do_update() {
     float cab_irdata_c[cab.ir_count];
     impf.clear_state_f();
     impf.compute(cab.ir_count,cab.ir_data,cab_irdata_c);
-    while (!conv.checkstate());
+    if (spare) {
+	if (!spare->configure(cab.ir_count, cab_irdata_c, cab.ir_sr)) {
+	    return false;
+	}
+	update_cabinet();
+	update_sum();
+	return fade_to(spare);
+    }
+    wait_stop();
     if (configure) {
-	if (!conv.configure(cab.ir_count, cab_irdata_c, cab.ir_sr)) {
+	if (!conv->configure(cab.ir_count, cab_irdata_c, cab.ir_sr)) {
 	    return false;
 	}
     } else {
-	if (!conv.update(cab.ir_count, cab_irdata_c, cab.ir_sr)) {
+	if (!conv->update(cab.ir_count, cab_irdata_c, cab.ir_sr)) {
 	    return false;
 	}
     }
@@ -824,8 +946,8 @@ bool CabinetConvolver::start(bool force) {
     if (cabinet_changed() || sum_changed()) {
 	return do_update();
     } else {
-	while (!conv.checkstate());
-	if (!conv.is_runnable()) {
+	wait_stop();
+	if (!conv->is_runnable()) {
 	    return conv_start();
 	}
 	return true;
@@ -840,7 +962,7 @@ void CabinetConvolver::check_update() {
 
 void CabinetConvolver::run_cab_conf(int count, float *input0, float *output0, PluginDef *p) {
     CabinetConvolver& self = *static_cast<CabinetConvolver*>(p);
-    if (!self.conv.compute(count, output0)) {
+    if (!self.conv_compute(count, output0)) {
 	self.engine.overload(EngineControl::ov_Convolver, "cab");
     }
 }
@@ -955,10 +1077,14 @@ PreampConvolver::~PreampConvolver() {
 
 bool PreampConvolver::do_update() {
     bool configure = preamp_changed();
-    if (conv.is_runnable()) {
-	conv.set_not_runnable();
-	sync();
-	conv.stop_process();
+    GxSimpleConvolver *spare = 0;
+    if (conv->is_runnable() && current_pre != -1) {
+	spare = get_spare();
+	if (!spare) {
+	    return true; // switch in progress, retried by check_update()
+	}
+    } else {
+	stop_all();
     }
     PreDesc& pre = *getPreEntry(preamp).data;
     if (current_pre == -1) {
@@ -967,13 +1093,21 @@ bool PreampConvolver::do_update() {
     float pre_irdata_c[pre.ir_count];
     impf.clear_state_f();
     impf.compute(pre.ir_count,pre.ir_data,pre_irdata_c);
-    while (!conv.checkstate());
+    if (spare) {
+	if (!spare->configure(pre.ir_count, pre_irdata_c, pre.ir_sr)) {
+	    return false;
+	}
+	update_preamp();
+	update_sum();
+	return fade_to(spare);
+    }
+    wait_stop();
     if (configure) {
-	if (!conv.configure(pre.ir_count, pre_irdata_c, pre.ir_sr)) {
+	if (!conv->configure(pre.ir_count, pre_irdata_c, pre.ir_sr)) {
 	    return false;
 	}
     } else {
-	if (!conv.update(pre.ir_count, pre_irdata_c, pre.ir_sr)) {
+	if (!conv->update(pre.ir_count, pre_irdata_c, pre.ir_sr)) {
 	    return false;
 	}
     }
@@ -989,8 +1123,8 @@ bool PreampConvolver::start(bool force) {
     if (preamp_changed() || sum_changed()) {
 	return do_update();
     } else {
-	while (!conv.checkstate());
-	if (!conv.is_runnable()) {
+	wait_stop();
+	if (!conv->is_runnable()) {
 	    return conv_start();
 	}
 	return true;
@@ -1005,7 +1139,7 @@ void PreampConvolver::check_update() {
 
 void PreampConvolver::run_pre_conf(int count, float *input0, float *output0, PluginDef *p) {
     PreampConvolver& self = *static_cast<PreampConvolver*>(p);
-    if (!self.conv.compute(count, output0)) {
+    if (!self.conv_compute(count, output0)) {
 	self.engine.overload(EngineControl::ov_Convolver, "pre");
     }
 }
@@ -1042,23 +1176,34 @@ ContrastConvolver::~ContrastConvolver() {
 
 bool ContrastConvolver::do_update() {
     bool configure = (sum == no_sum);
-    if (conv.is_runnable()) {
-	conv.set_not_runnable();
-	sync();
-	conv.stop_process();
+    GxSimpleConvolver *spare = 0;
+    if (conv->is_runnable() && !configure) {
+	spare = get_spare();
+	if (!spare) {
+	    return true; // switch in progress, retried by check_update()
+	}
+    } else {
+	stop_all();
     }
     if (configure) {
 	presl.init(contrast_ir_desc.ir_sr);
     }
     float contrast_irdata_c[contrast_ir_desc.ir_count];
     presl.compute(contrast_ir_desc.ir_count,contrast_ir_desc.ir_data,contrast_irdata_c);
-    while (!conv.checkstate());
+    if (spare) {
+	if (!spare->configure(contrast_ir_desc.ir_count, contrast_irdata_c, contrast_ir_desc.ir_sr)) {
+	    return false;
+	}
+	update_sum();
+	return fade_to(spare);
+    }
+    wait_stop();
     if (configure) {
-	if (!conv.configure(contrast_ir_desc.ir_count, contrast_irdata_c, contrast_ir_desc.ir_sr)) {
+	if (!conv->configure(contrast_ir_desc.ir_count, contrast_irdata_c, contrast_ir_desc.ir_sr)) {
 	    return false;
 	}
     } else {
-	if (!conv.update(contrast_ir_desc.ir_count, contrast_irdata_c, contrast_ir_desc.ir_sr)) {
+	if (!conv->update(contrast_ir_desc.ir_count, contrast_irdata_c, contrast_ir_desc.ir_sr)) {
 	    return false;
 	}
     }
@@ -1073,8 +1218,8 @@ bool ContrastConvolver::start(bool force) {
     if (sum_changed()) {
 	return do_update();
     } else {
-	while (!conv.checkstate());
-	if (!conv.is_runnable()) {
+	wait_stop();
+	if (!conv->is_runnable()) {
 	    return conv_start();
 	}
 	return true;
@@ -1096,7 +1241,7 @@ int ContrastConvolver::register_con(const ParamReg& reg) {
 
 void ContrastConvolver::run_contrast(int count, float *input0, float *output0, PluginDef *p) {
     ContrastConvolver& self = *static_cast<ContrastConvolver*>(p);
-    if (!self.conv.compute(count, output0)) {
+    if (!self.conv_compute(count, output0)) {
 	self.engine.overload(EngineControl::ov_Convolver, "contrast");
     }
 }
@@ -1136,46 +1281,203 @@ void ContrastConvolver::run_contrast(int count, float *input0, float *output0, P
 *
 *****************************************************************************/ 
 
-bool smbPitchShift::setParameters(int sampleRate_)
+/*
+ *  float polar / rectangular conversion for the phase vocoder
+ *
+ *  atan2 is a minimax polynomial on [0, 1] (error < 1e-5 rad),
+ *  sin is a taylor polynomial on [-pi/2, pi/2] (error < 4e-6)
+ *  after folding the argument from [-pi, pi]; the SSE2 kernels
+ *  do 4 bins at once and select with masks instead of branching,
+ *  the scalar code does the tail
+ */
+
+static const float pv_pi = 3.14159265f;
+static const float pv_halfpi = 1.57079633f;
+static const float pv_twopi = 6.28318531f;
+
+static inline float pv_atan2(float y, float x) {
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float t = min(ax, ay) / (max(ax, ay) + 1e-30f);
+    float s = t * t;
+    float r = (((((-0.013480470f * s + 0.057477314f) * s - 0.121239071f) * s
+                 + 0.195635925f) * s - 0.332994597f) * s + 0.999995630f) * t;
+    if (ay > ax) r = pv_halfpi - r;
+    if (x < 0) r = pv_pi - r;
+    return y < 0 ? -r : r;
+}
+
+static inline float pv_sin(float x) { // x in [-pi, pi]
+    float ax = fabsf(x);
+    ax = min(ax, pv_pi - ax);
+    x = (x < 0 ? -ax : ax);
+    float s = x * x;
+    return x * (1.0f + s * (-1.6666667e-1f + s * (8.3333333e-3f + s * (-1.9841270e-4f + s * 2.7557319e-6f))));
+}
+
+static inline float pv_cos(float x) { // x in [-pi, pi]
+    x += pv_halfpi;
+    if (x > pv_pi) x -= pv_twopi;
+    return pv_sin(x);
+}
+
+#if defined(__SSE2__)
+static inline __m128 pv_select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 pv_sin4(__m128 x) { // x in [-pi, pi]
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(sign, x);
+    ax = _mm_min_ps(ax, _mm_sub_ps(_mm_set1_ps(pv_pi), ax));
+    x = _mm_or_ps(ax, _mm_and_ps(x, sign));
+    __m128 s = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(2.7557319e-6f);
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(-1.9841270e-4f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(8.3333333e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(-1.6666667e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(p, x);
+}
+#endif
+
+// magn[k] = |re[k] + i*im[k]|, phase[k] = arg(re[k] + i*im[k])
+static inline void pv_polar(const float *re, const float *im, float *magn, float *phase, int n) {
+    int k = 0;
+#if defined(__SSE2__)
+    {
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 tiny = _mm_set1_ps(1e-30f);
+        const __m128 pi = _mm_set1_ps(pv_pi);
+        const __m128 halfpi = _mm_set1_ps(pv_halfpi);
+        for (; k <= n-4; k += 4) {
+            __m128 x = _mm_loadu_ps(re+k);
+            __m128 y = _mm_loadu_ps(im+k);
+            _mm_storeu_ps(magn+k, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+            __m128 ax = _mm_andnot_ps(sign, x);
+            __m128 ay = _mm_andnot_ps(sign, y);
+            __m128 t = _mm_div_ps(_mm_min_ps(ax, ay), _mm_add_ps(_mm_max_ps(ax, ay), tiny));
+            __m128 s = _mm_mul_ps(t, t);
+            __m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-0.013480470f), s), _mm_set1_ps(0.057477314f));
+            r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.121239071f));
+            r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.195635925f));
+            r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.332994597f));
+            r = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.999995630f)), t);
+            r = pv_select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(halfpi, r), r);
+            r = pv_select(_mm_cmplt_ps(x, zero), _mm_sub_ps(pi, r), r);
+            _mm_storeu_ps(phase+k, _mm_or_ps(r, _mm_and_ps(y, sign)));
+        }
+    }
+#endif
+    for (; k < n; k++) {
+        magn[k] = sqrtf(re[k]*re[k] + im[k]*im[k]);
+        phase[k] = pv_atan2(im[k], re[k]);
+    }
+}
+
+// re[k] + i*im[k] = magn[k] * exp(i*phase[k]), phase in [-pi, pi]
+static inline void pv_rect(const float *magn, const float *phase, float *re, float *im, int n) {
+    int k = 0;
+#if defined(__SSE2__)
+    {
+        const __m128 pi = _mm_set1_ps(pv_pi);
+        const __m128 halfpi = _mm_set1_ps(pv_halfpi);
+        const __m128 twopi = _mm_set1_ps(pv_twopi);
+        for (; k <= n-4; k += 4) {
+            __m128 m = _mm_loadu_ps(magn+k);
+            __m128 p = _mm_loadu_ps(phase+k);
+            __m128 c = _mm_add_ps(p, halfpi);
+            c = _mm_sub_ps(c, _mm_and_ps(_mm_cmpgt_ps(c, pi), twopi));
+            _mm_storeu_ps(re+k, _mm_mul_ps(m, pv_sin4(c)));
+            _mm_storeu_ps(im+k, _mm_mul_ps(m, pv_sin4(p)));
+        }
+    }
+#endif
+    for (; k < n; k++) {
+        re[k] = magn[k] * pv_cos(phase[k]);
+        im[k] = magn[k] * pv_sin(phase[k]);
+    }
+}
+
+// map phase values into [-pi, pi]
+static inline void pv_wrap(float *phase, int n) {
+    int k = 0;
+#if defined(__SSE2__)
+    {
+        const __m128 itwopi = _mm_set1_ps(1.0f / pv_twopi);
+        const __m128 twopi = _mm_set1_ps(pv_twopi);
+        for (; k <= n-4; k += 4) {
+            __m128 p = _mm_loadu_ps(phase+k);
+            __m128 q = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(p, itwopi)));
+            _mm_storeu_ps(phase+k, _mm_sub_ps(p, _mm_mul_ps(q, twopi)));
+        }
+    }
+#endif
+    for (; k < n; k++) {
+        phase[k] -= pv_twopi * floorf(phase[k] * (1.0f / pv_twopi) + 0.5f);
+    }
+}
+
+// FFT size (at 48 kHz, scaled for higher rates) and overlap factor
+// for the latency settings
+static const struct {
+    int fftsize;
+    int osamp;
+} pv_settings[] = {
+    { 2048, 8 },  // high quality: 1792 frames latency
+    { 1024, 4 },  // low quality: 768 frames
+    {  512, 4 },  // realtime: 384 frames
+};
+
+static inline int pv_align(int n) { // keep the buffers 32 byte aligned
+    return (n + 7) & ~7;
+}
+
+void smbPitchShift::setParameters(int sampleRate_)
 {
-    numSampsToProcess = int(engine.get_buffersize());
-    fftFrameSize = numSampsToProcess/4;
     sampleRate = int(sampleRate_);
     assert(sampleRate>0);
-    osamp = 8;
-    osamp1 = 1./osamp;
-    osamp2 = 2.*M_PI*osamp1;
-    mpi = (1./(2.*M_PI)) * osamp;
-    mpi1 = 1./M_PI;
-    fpb = 0; 
-    expect = 0; 
-    hanning = 0; 
-    hanningd = 0;
-    resampin = 0;
-    resampout = 0;
-    indata2 = 0;
-    ftPlanForward = 0;
-    ftPlanInverse = 0;
-    resamp.setup(sampleRate,4);
-    mem_allocated = false;
-    gRover = inFifoLatency;
-    return true;
+    if (mem_allocated) {
+        mem_free();
+        mem_alloc();
+    }
 }
 
 smbPitchShift::smbPitchShift(ParamMap& param_, EngineControl& engine_, sigc::slot<void> sync_):
   PluginDef(),
   engine(engine_),
+  mem_allocated(false),
   sync(sync_),
   ready(false),
   param(param_),
+  mem(0),
+  gInFIFO(0),
+  gOutFIFO(0),
+  gOutputAccum(0),
+  hanning(0),
+  hanningd(0),
+  fft_time(0),
+  fft_re(0),
+  fft_im(0),
+  gLastPhase(0),
+  gSumPhase(0),
+  gAnaFreq(0),
+  gAnaMagn(0),
+  gSynFreq(0),
+  gSynMagn(0),
+  fpb(0),
+  expect(0),
+  sampleRate(0),
+  fftFrameSize(0),
+  fftFrameSize2(0),
+  osamp(0),
+  stepSize(0),
+  inFifoLatency(0),
+  gRover(0),
+  ftPlanForward(0),
+  ftPlanInverse(0),
   plugin() {
-    memset(gInFIFO, 0, MAX_FRAME_LENGTH*sizeof(float));
-    memset(gOutFIFO, 0, MAX_FRAME_LENGTH*sizeof(float));
-    memset(gLastPhase, 0, (MAX_FRAME_LENGTH/2+1)*sizeof(float));
-    memset(gSumPhase, 0, (MAX_FRAME_LENGTH/2+1)*sizeof(float));
-    memset(gOutputAccum, 0, 2*MAX_FRAME_LENGTH*sizeof(float));
-    memset(gAnaFreq, 0, MAX_FRAME_LENGTH*sizeof(float));
-    memset(gAnaMagn, 0, MAX_FRAME_LENGTH*sizeof(float));
     version = PLUGINDEF_VERSION;
     id = "smbPitchShift";
     name = N_("Detune");
@@ -1190,8 +1492,6 @@ smbPitchShift::smbPitchShift(ParamMap& param_, EngineControl& engine_, sigc::slo
     delete_instance = del_instance;
     load_ui = load_ui_f_static;
     plugin = this;
-    engine.signal_buffersize_change().connect(
-    sigc::mem_fun(*this, &smbPitchShift::change_buffersize));
 }
 
 void smbPitchShift::init(unsigned int samplingFreq, PluginDef *plugin) {
@@ -1201,48 +1501,28 @@ void smbPitchShift::init(unsigned int samplingFreq, PluginDef *plugin) {
 
 void smbPitchShift::clear_state()
 {
-    stepSize = fftFrameSize/osamp;
-    freqPerBin = (double)(sampleRate/4)/(double)fftFrameSize;
-    freqPerBin1 = (1/freqPerBin)*osamp2;
-    freqPerBin2 = freqPerBin*mpi;
-    expct = 2.*M_PI*(double)stepSize/(double)fftFrameSize;
-    inFifoLatency = fftFrameSize-stepSize;
-    fftFrameSize3 = 2. * (1./ ((double)(fftFrameSize2)*osamp));
-    fftFrameSize4 = 1./(double)fftFrameSize;
-    ai = 0;
-    aio = 0;
-    ii = 0;
-    tone =0;
-    memset(gInFIFO, 0, MAX_FRAME_LENGTH*sizeof(float));
-    memset(gOutFIFO, 0, MAX_FRAME_LENGTH*sizeof(float));
-    memset(gLastPhase, 0, (MAX_FRAME_LENGTH/2+1)*sizeof(float));
-    memset(gSumPhase, 0, (MAX_FRAME_LENGTH/2+1)*sizeof(float));
-    memset(gOutputAccum, 0, 2*MAX_FRAME_LENGTH*sizeof(float));
-    memset(gAnaFreq, 0, MAX_FRAME_LENGTH*sizeof(float));
-    memset(gAnaMagn, 0, MAX_FRAME_LENGTH*sizeof(float));
-    for (k = 0; k < fftFrameSize2;k++) {
+    double freqPerBin = (double)sampleRate/(double)fftFrameSize;
+    double expct = 2.*M_PI*(double)stepSize/(double)fftFrameSize;
+    freqPerBin1 = (1/freqPerBin)*2.*M_PI/osamp;
+    freqPerBin2 = freqPerBin*osamp/(2.*M_PI);
+    // gain bands a .. d, limits relative to 1/8 of the sample rate
+    double bandwidth = sampleRate/8.;
+    band1 = int(0.20*bandwidth/freqPerBin);
+    band2 = int(0.45*bandwidth/freqPerBin);
+    band3 = int(0.667*bandwidth/freqPerBin);
+    memset(gInFIFO, 0, fftFrameSize*sizeof(float));
+    memset(gOutFIFO, 0, stepSize*sizeof(float));
+    memset(gOutputAccum, 0, 2*fftFrameSize*sizeof(float));
+    memset(gLastPhase, 0, (fftFrameSize2+1)*sizeof(float));
+    memset(gSumPhase, 0, (fftFrameSize2+1)*sizeof(float));
+    for (int k = 0; k <= fftFrameSize2; k++) {
         fpb[k] = (double)k*freqPerBin;
+        // only used modulo 2*pi, keep it small for float precision
+        expect[k] = remainder((double)k*expct, 2.*M_PI);
     }
-    for (k = 0; k < fftFrameSize2;k++) {
-        expect[k] = (double)k*expct;
-    }
-    for (k = 0; k < fftFrameSize;k++) {
+    for (int k = 0; k < fftFrameSize; k++) {
         hanning[k] = 0.5*(1-cos(2.*M_PI*(double)k/((double)fftFrameSize)));
-    }
-    for (k = 0; k < fftFrameSize;k++) {
-        hanningd[k] = 0.5*(1-cos(2.*M_PI*(double)k * fftFrameSize4)) * fftFrameSize3; 
-    }
-    for (k = 0; k < fftFrameSize;k++) {
-        resampin[k] = 0.0; 
-    }
-    for (k = 0; k < fftFrameSize;k++) {
-        resampin2[k] = 0.0; 
-    }
-    for (k = 0; k < fftFrameSize*4;k++) {
-        resampout[k] = 0.0; 
-    }
-    for (k = 0; k < fftFrameSize*4;k++) {
-        indata2[k] = 0.0; 
+        hanningd[k] = hanning[k] * 2. / ((double)fftFrameSize2*osamp);
     }
     gRover = inFifoLatency;
     mem_allocated = true;
@@ -1251,72 +1531,73 @@ void smbPitchShift::clear_state()
 
 void smbPitchShift::mem_alloc()
 {
-    numSampsToProcess = int(engine.get_buffersize());
-    assert(numSampsToProcess>0);
-    numSampsToResamp = numSampsToProcess/4;
-    sampleRate = int(engine.get_samplerate());
     assert(sampleRate>0);
-    
-    switch(latency) {
-      case(0):
-        if (numSampsToProcess <= 2048) {
-          fftFrameSize = 512 ; 
-        } else {
-          fftFrameSize = numSampsToProcess*0.25 ;
-        }
-        break;
-      case(1):
-        fftFrameSize = numSampsToProcess;
-        break;
-      case(2):
-        fftFrameSize = numSampsToProcess*0.25;
-        break;
-      default:
-        if (numSampsToProcess <= 2048) {
-          fftFrameSize = 512 ; 
-        } else {
-          fftFrameSize = numSampsToProcess*0.25 ;
-        }
-        break;
-    }
+    int setting = (latency >= 0 && latency <= 2) ? latency : 0;
+    int mult = sampleRate > 128000 ? 4 : (sampleRate > 64000 ? 2 : 1);
+    fftFrameSize = pv_settings[setting].fftsize * mult;
     fftFrameSize2 = fftFrameSize/2;
+    osamp = pv_settings[setting].osamp;
+    stepSize = fftFrameSize/osamp;
+    inFifoLatency = fftFrameSize-stepSize;
 
-    try {
-        //create FFTW plan
-        ftPlanForward = fftwf_plan_dft_1d(fftFrameSize, fftw_in, fftw_out, FFTW_FORWARD, FFTW_ESTIMATE);
-        ftPlanInverse = fftwf_plan_dft_1d(fftFrameSize, fftw_in, fftw_out, FFTW_BACKWARD, FFTW_ESTIMATE);
-        // alloc buffers
-        fpb = new float[fftFrameSize2];
-        expect = new float[fftFrameSize2];
-        hanning = new float[fftFrameSize];
-        hanningd = new float[fftFrameSize];
-        resampin = new float[fftFrameSize];
-        resampin2 = new float[fftFrameSize];
-        resampout = new float[fftFrameSize*4];
-        indata2 = new float[fftFrameSize*4];
-    } catch(...) {
-            gx_print_error("detune", "cant allocate memory pool");
-            return;
-        }
+    int n = pv_align(fftFrameSize);
+    int n2 = pv_align(fftFrameSize2+1);
+    mem = static_cast<float*>(fftwf_malloc((6*n + pv_align(stepSize) + 10*n2) * sizeof(float)));
+    if (!mem) {
+        gx_print_error("detune", "cant allocate memory pool");
+        return;
+    }
+    float *p = mem;
+    gInFIFO = p; p += n;
+    gOutputAccum = p; p += 2*n;
+    hanning = p; p += n;
+    hanningd = p; p += n;
+    fft_time = p; p += n;
+    gOutFIFO = p; p += pv_align(stepSize);
+    fft_re = p; p += n2;
+    fft_im = p; p += n2;
+    gLastPhase = p; p += n2;
+    gSumPhase = p; p += n2;
+    gAnaFreq = p; p += n2;
+    gAnaMagn = p; p += n2;
+    gSynFreq = p; p += n2;
+    gSynMagn = p; p += n2;
+    fpb = p; p += n2;
+    expect = p;
+
+    //create FFTW plans, real data with split complex spectrum
+    fftwf_iodim dim = { fftFrameSize, 1, 1 };
+    ftPlanForward = fftwf_plan_guru_split_dft_r2c(1, &dim, 0, 0, fft_time, fft_re, fft_im, FFTW_ESTIMATE);
+    ftPlanInverse = fftwf_plan_guru_split_dft_c2r(1, &dim, 0, 0, fft_re, fft_im, fft_time, FFTW_ESTIMATE);
+    if (!ftPlanForward || !ftPlanInverse) {
+        mem_free();
+        gx_print_error("detune", "cant create fft plan");
+        return;
+    }
     clear_state();
+    report_latency();
 }
 
 void smbPitchShift::mem_free()
 {
     ready = false;
+    bool report = mem_allocated;
     mem_allocated = false;
-    if (fpb) { delete fpb; fpb = 0; }
-    if (expect) { delete expect; expect = 0; }
-    if (hanning) { delete hanning; hanning = 0; }
-    if (hanningd) { delete hanningd; hanningd = 0; }
-    if (resampin) { delete resampin; resampin = 0; }
-    if (resampin2) { delete resampin2; resampin2 = 0; }
-    if (resampout) { delete resampout; resampout = 0; }
-    if (indata2) { delete indata2; indata2 = 0; }
     if (ftPlanForward)
         {fftwf_destroy_plan(ftPlanForward);ftPlanForward = 0; }
     if (ftPlanInverse) 
         { fftwf_destroy_plan(ftPlanInverse);ftPlanInverse = 0; }
+    if (mem) { fftwf_free(mem); mem = 0; }
+    if (report) {
+        report_latency();
+    }
+}
+
+// with latency compensation the dry signal is delayed to match the
+// wet signal, so the whole output is late by the analysis latency
+void smbPitchShift::report_latency()
+{
+    engine.set_unit_latency(id, (mem_allocated && l) ? inFifoLatency : 0);
 }
 
 int smbPitchShift::activate(bool start)
@@ -1331,16 +1612,6 @@ int smbPitchShift::activate(bool start)
     return 0;
 }
 
-void smbPitchShift::change_buffersize(unsigned int size)
-{
-    sync();
-    ready = false;
-    if (mem_allocated) {
-        mem_free();
-        mem_alloc();
-    }
-}
-
 void smbPitchShift::change_latency()
 {
     sync();
@@ -1353,18 +1624,11 @@ void smbPitchShift::change_latency()
 
 smbPitchShift::~smbPitchShift()
 {
-    if (fpb) { delete fpb; fpb = 0; }
-    if (expect) { delete expect; expect = 0; }
-    if (hanning) { delete hanning; hanning = 0; }
-    if (hanningd) { delete hanningd; hanningd = 0; }
-    if (resampin) { delete resampin; resampin = 0; }
-    if (resampin2) { delete resampin2; resampin2 = 0; }
-    if (resampout) { delete resampout; resampout = 0; }
-    if (indata2) { delete indata2; indata2 = 0; }
     if (ftPlanForward)
         {fftwf_destroy_plan(ftPlanForward);ftPlanForward = 0; }
     if (ftPlanInverse)
         {fftwf_destroy_plan(ftPlanInverse);ftPlanInverse = 0; }
+    if (mem) { fftwf_free(mem); mem = 0; }
 }
 
 // -----------------------------------------------------------------------------------------------------------------
@@ -1373,176 +1637,119 @@ void __rt_func smbPitchShift::compute_static(int count, float *input0, float *ou
     static_cast<smbPitchShift*>(p)->PitchShift(count, input0, output0);
 }
 
+// one analysis / synthesis step on the input FIFO, adds stepSize
+// frames to the output FIFO
+inline void smbPitchShift::process_frame(float pitchShift)
+{
+    int bins = fftFrameSize2+1;
+
+    /* do windowing */
+    for (int k = 0; k < fftFrameSize; k++) {
+        fft_time[k] = gInFIFO[k] * hanning[k];
+    }
+
+    /* ***************** ANALYSIS ******************* */
+    /* do transform */
+    fftwf_execute(ftPlanForward);
+
+    /* compute magnitude and phase */
+    pv_polar(fft_re, fft_im, gAnaMagn, gAnaFreq, bins);
+
+    /* compute phase difference, subtract expected phase difference */
+    for (int k = 0; k < bins; k++) {
+        float phase = gAnaFreq[k];
+        gAnaFreq[k] = phase - gLastPhase[k] - expect[k];
+        gLastPhase[k] = phase;
+    }
+
+    /* map delta phase into +/- Pi interval */
+    pv_wrap(gAnaFreq, bins);
+
+    /* compute the k-th partials' true frequency */
+    for (int k = 0; k < bins; k++) {
+        gAnaFreq[k] = fpb[k] + gAnaFreq[k]*freqPerBin2;
+    }
+
+    /* ***************** PROCESSING ******************* */
+    /* this does the actual pitch shifting */
+    memset(gSynMagn, 0, bins*sizeof(float));
+    memset(gSynFreq, 0, bins*sizeof(float));
+    for (int k = 1; k < fftFrameSize2-2; k++) {
+        int index = k*pitchShift;
+        if (index >= fftFrameSize2) {
+            break;
+        }
+        float g = index < band1 ? a : (index < band2 ? b : (index < band3 ? c : d));
+        gSynMagn[index] += gAnaMagn[k]*g;
+        gSynFreq[index] = gAnaFreq[k] * pitchShift;
+    }
+
+    /* ***************** SYNTHESIS ******************* */
+    /* bin deviation from frequency deviation plus the overlap phase
+       advance, accumulated to get the bin phase */
+    for (int k = 0; k < bins; k++) {
+        gSumPhase[k] += ((gSynFreq[k] - fpb[k]) * freqPerBin1) + expect[k];
+    }
+    pv_wrap(gSumPhase, bins);
+
+    /* get real and imag part */
+    pv_rect(gSynMagn, gSumPhase, fft_re, fft_im, bins);
+
+    /* do inverse transform */
+    fftwf_execute(ftPlanInverse);
+
+    /* do windowing and add to output accumulator */
+    for (int k = 0; k < fftFrameSize; k++) {
+        gOutputAccum[k] += hanningd[k] * fft_time[k];
+    }
+    memcpy(gOutFIFO, gOutputAccum, stepSize*sizeof(float));
+
+    /* shift accumulator */
+    memmove(gOutputAccum, gOutputAccum+stepSize, fftFrameSize*sizeof(float));
+
+    /* move input FIFO */
+    memmove(gInFIFO, gInFIFO+stepSize, inFifoLatency*sizeof(float));
+}
 
 void always_inline smbPitchShift::PitchShift(int count, float *indata, float *outdata)
 {
-    
-    if (!ready || count != numSampsToProcess)  {
+    if (!ready) {
         memcpy(outdata,indata,count*sizeof(float));
         return;
     }
-    
-    resamp.down(numSampsToResamp,indata,resampin);
-    double     fSlow0 = (0.01 * wet);
-    double     fSlow1 = (0.01 * dry);
-
-    // collect data for latency compensation
-    for (i = 0; i < count; i++){
-        indata2[ii] = indata[i];
-        ii++;
-    }
-    // collect data for fft
-    for (i = 0; i < numSampsToResamp; i++){
-        resampin2[ai] = resampin[i];
-        ai++;
-    }
-    // now we have enough data
-    if (ai>=fftFrameSize) {
-        ai = 0;
-        ii = 0;
-        switch(octave) {
-          case(0):
-            tone =0;
-            break;
-          case(1):
-            tone =12;
-            break;
-          case(2):
-            tone =-12;
-            break;
-          default:
-            tone =0;
-            break;
-        }
-        float pitchShift = pow(2., (semitones+tone)*0.0833333333);
-        /* main processing loop */
-        for (i = 0; i < fftFrameSize; i++){
-
-            /* As long as we have not yet collected enough data just read in */
-            float fTemp = resampin2[i];
-            gInFIFO[gRover] = fTemp;
-            resampin2[i] = gOutFIFO[gRover-inFifoLatency];
-            gRover++;
-
-            /* now we have enough data for processing */
-            if (gRover >= fftFrameSize) {
-                gRover = inFifoLatency;
-
-                /* do windowing and re,im interleave */
-                for (k = 0; k < fftFrameSize;k++) {
-                    fftw_in[k][0] = gInFIFO[k] * hanning[k];
-                    fftw_in[k][1] = 0.0;
-                }
-
-
-                /* ***************** ANALYSIS ******************* */
-                /* do transform */
-                fftwf_execute(ftPlanForward);
-
-                /* this is the analysis step */
-                for (k = 0; k < fftFrameSize2; k++) {
-
-                    /* de-interlace FFT buffer */
-                    real = fftw_out[k][0];
-                    imag = fftw_out[k][1];
-
-                    /* compute magnitude and phase */
-                    magn = 2.*sqrt(real*real + imag*imag);
-                    phase = atan2(imag,real);
-
-                    /* compute phase difference */
-                    tmp = phase - gLastPhase[k];
-                    gLastPhase[k] = phase;
-
-                    /* subtract expected phase difference */
-                    tmp -= expect[k];
-
-                    /* map delta phase into +/- Pi interval */
-                    qpd = tmp*mpi1;
-                    if (qpd >= 0) qpd += qpd&1;
-                    else qpd -= qpd&1;
-                    tmp -= M_PI*(double)qpd;
-
-                    /* get deviation from bin frequency from the +/- Pi interval */
-                    /* compute the k-th partials' true frequency */
-                    tmp = fpb[k] + tmp*freqPerBin2;
-
-                    /* store magnitude and true frequency in analysis arrays */
-                    gAnaMagn[k] = magn;
-                    gAnaFreq[k] = tmp;
-
-                }
-
-                /* ***************** PROCESSING ******************* */
-                /* this does the actual pitch shifting */
-                memset(gSynMagn, 0, fftFrameSize*sizeof(float));
-                memset(gSynFreq, 0, fftFrameSize*sizeof(float));
-                for (k = 1; k < fftFrameSize2-2; k++) { 
-                    index = k*pitchShift;
-                    if (index < fftFrameSize2) { 
-                        if (index < fftFrameSize2*0.20)
-                            gSynMagn[index] += gAnaMagn[k]*a; 
-                        else if (index < fftFrameSize2*0.45)
-                            gSynMagn[index] += gAnaMagn[k]*b; 
-                        else if (index < fftFrameSize2*0.667)
-                            gSynMagn[index] += gAnaMagn[k]*c; 
-                        else 
-                            gSynMagn[index] += gAnaMagn[k]*d; 
-                           gSynFreq[index] = gAnaFreq[k] * pitchShift; 
-                    } 
-                }
-                
-                /* ***************** SYNTHESIS ******************* */
-                /* this is the synthesis step */
-                for (k = 0; k < fftFrameSize2; k++) {
-
-                    /* get magnitude and true frequency from synthesis arrays */
-                    magn = gSynMagn[k];
-                    //tmp = gSynFreq[k];
-
-                    /* subtract bin mid frequency */
-                    /* get bin deviation from freq deviation */
-                    /* take osamp into account */
-                    /* add the overlap phase advance back in */
-                    tmp = ((gSynFreq[k] - fpb[k]) * freqPerBin1) + expect[k];
-
-                    /* accumulate delta phase to get bin phase */
-                    gSumPhase[k] += tmp;
-                    phase = gSumPhase[k];
-                    if (magn == 0.0) continue;
-
-                    /* get real and imag part and re-interleave */                
-                    fftw_in[k][0] = magn * cos (phase);
-                    fftw_in[k][1] = magn * sin (phase);
-                } 
-
-                /* do inverse transform */
-                fftwf_execute(ftPlanInverse);
-                /* do windowing and add to output accumulator */ 
-                for(k=0; k < fftFrameSize; k++) {
-                    gOutputAccum[k] += hanningd[k] * fftw_out[ k][0] ;
-                }
-                for (k = 0; k < stepSize; k++) gOutFIFO[k] = gOutputAccum[k];
-
-                /* shift accumulator */
-                memmove(gOutputAccum, gOutputAccum+stepSize, fftFrameSize*sizeof(float));
-
-                /* move input FIFO */
-                for (k = 0; k < inFifoLatency; k++) gInFIFO[k] = gInFIFO[k+stepSize];
-            }
-        }
-        resamp.up(fftFrameSize,resampin2,resampout);
-        aio = 0;
+    float fSlow0 = (0.01f * wet);
+    float fSlow1 = (0.01f * dry);
+    float tone;
+    switch(octave) {
+      case(1):
+        tone =12;
+        break;
+      case(2):
+        tone =-12;
+        break;
+      default:
+        tone =0;
+        break;
     }
-    if(l) {
-        for (i = 0; i < count; i++){
-            outdata[i] = ((fSlow0 * resampout[aio]) + (fSlow1 *indata2[aio]));
-            aio++;
+    float pitchShift = powf(2.f, (semitones+tone)*(1.f/12.f));
+    int i = 0;
+    while (i < count) {
+        int n = min(count - i, fftFrameSize - gRover);
+        // the FIFOs hold wet and dry signal inFifoLatency frames back
+        const float *wetp = gOutFIFO + (gRover - inFifoLatency);
+        const float *dryp = l ? gInFIFO + (gRover - inFifoLatency) : indata + i;
+        float *in = gInFIFO + gRover;
+        for (int j = 0; j < n; j++) {
+            float dr = dryp[j];
+            in[j] = indata[i+j];
+            outdata[i+j] = (fSlow0 * wetp[j]) + (fSlow1 * dr);
         }
-    } else {
-        for (i = 0; i < count; i++){
-            outdata[i] = ((fSlow0 * resampout[aio]) + (fSlow1 *indata[i]));
-            aio++;
+        i += n;
+        gRover += n;
+        /* now we have enough data for processing */
+        if (gRover >= fftFrameSize) {
+            gRover = inFifoLatency;
+            process_frame(pitchShift);
         }
     }
 }
@@ -1564,6 +1771,8 @@ int smbPitchShift::register_par(const ParamReg& reg)
     reg.registerVar("smbPitchShift.d", N_("treble"), "S", N_("treble"), &d, 1.0, 0.0, 2.0, 0.01);
     param["smbPitchShift.latency"].signal_changed_int().connect(
         sigc::hide(sigc::mem_fun(this, &smbPitchShift::change_latency)));
+    param["smbPitchShift.l"].signal_changed_float().connect(
+        sigc::hide(sigc::mem_fun(this, &smbPitchShift::report_latency)));
     return 0;
 }
 
@@ -48,6 +48,7 @@ void MonoMute::process(int count, float *input, float *output, PluginDef*) {
 StereoMute::StereoMute()
     : PluginDef() {
     version = PLUGINDEF_VERSION;
+    flags = PGN_MONO_SAFE;
     id = "stereomute";
     name = "?stereomute";
     stereo_audio = process;
@@ -56,7 +57,9 @@ StereoMute::StereoMute()
 void StereoMute::process(int count, float *input0, float *input1,
 			 float *output0, float *output1, PluginDef*) {
     (void)memset(output0, 0, count*sizeof(float));
-    (void)memset(output1, 0, count*sizeof(float));
+    if (output1) {
+	(void)memset(output1, 0, count*sizeof(float));
+    }
 }
 
 MaxLevel::MaxLevel()
@@ -135,6 +135,8 @@ GxJack::GxJack(gx_engine::GxEngine& engine_)
     GxExit::get_instance().signal_exit().connect(
 	sigc::mem_fun(*this, &GxJack::cleanup_slot));
     xrun.connect(sigc::mem_fun(this, &GxJack::report_xrun));
+    engine.signal_latency_change().connect(
+	sigc::mem_fun(this, &GxJack::on_latency_change));
 }
 
 GxJack::~GxJack() {
@@ -377,6 +379,7 @@ void GxJack::cleanup_slot(bool otherthread) {
 		engine.wait_ramp_down_finished();
 	    }
 	    jack_deactivate(client);
+	    engine.get_param().get_update_queue().rt_stopped();
 	    jack_client_close(client);
 	    client = 0;
 	}
@@ -399,6 +402,7 @@ void GxJack::gx_jack_cleanup() {
     engine.set_stateflag(gx_engine::GxEngine::SF_INITIALIZING);
     jack_deactivate(client);
     jack_deactivate(client_insert);
+    engine.get_param().get_update_queue().set_active(false);
     jack_port_unregister(client, ports.input.port);
     jack_port_unregister(client, ports.midi_input.port);
     jack_port_unregister(client, ports.insert_out.port);
@@ -564,6 +568,8 @@ void GxJack::gx_jack_callbacks() {
     jack_on_shutdown(client, shutdown_callback_client, this);
     jack_on_shutdown(client_insert, shutdown_callback_client_insert, this);
     jack_set_buffer_size_callback(client, gx_jack_buffersize_callback, this);
+    jack_set_latency_callback(client, gx_jack_latency_callback, this);
+    jack_set_latency_callback(client_insert, gx_jack_insert_latency_callback, this);
     jack_set_port_registration_callback(client, gx_jack_portreg_callback, this);
     jack_set_port_connect_callback(client, gx_jack_portconn_callback, this);
 #ifdef HAVE_JACK_SESSION
@@ -599,6 +605,7 @@ void GxJack::gx_jack_callbacks() {
 		jack_client_real_time_priority(client));
     jack_set_process_callback(client, gx_jack_process, this);
     jack_set_process_callback(client_insert, gx_jack_insert_process, this);
+    engine.get_param().get_update_queue().set_active(true);
     if (jack_activate(client) != 0) {
         gx_print_fatal(
 	    _("Jack Activation"),
@@ -672,22 +679,29 @@ int __rt_func GxJack::gx_jack_process(jack_nframes_t nframes, void *arg) {
 	    self.check_overload();
 	}
 	self.transport_state = jack_transport_query (self.client, &self.current);
-        // gx_head DSP computing
-	self.engine.mono_chain.process(
-	    nframes,
-	    get_float_buf(self.ports.input.port, nframes),
-	    get_float_buf(self.ports.insert_out.port, nframes));
-
-        // midi input processing
+	// midi controllers may start parameter ramps from this thread
+	self.engine.get_param().get_update_queue().set_rt_thread();
+        // midi input processing, before the DSP so that controller
+        // changes apply to this period
 	if (self.ports.midi_input.port) {
 	    self.engine.controller_map.compute_midi_in(
-		jack_port_get_buffer(self.ports.midi_input.port, nframes), arg);
+		jack_port_get_buffer(self.ports.midi_input.port, nframes),
+		jack_last_frame_time(self.client), self.jack_sr);
 	}
         // jack transport support
-    if ( self.transport_state != self.old_transport_state) {
-        self.engine.controller_map.process_trans(self.transport_state);
-        self.old_transport_state = self.transport_state;
-    }
+	if (self.transport_state != self.old_transport_state) {
+	    self.engine.controller_map.process_trans(self.transport_state);
+	    self.old_transport_state = self.transport_state;
+	}
+	// ramp smoothed parameters towards their new values
+	self.engine.get_param().get_update_queue().process(nframes, self.jack_sr);
+        // gx_head DSP computing
+	float *ibuf = get_float_buf(self.ports.input.port, nframes);
+	self.engine.multitrack.begin_cycle_mono(nframes, ibuf);
+	self.engine.mono_chain.process(
+	    nframes, ibuf,
+	    get_float_buf(self.ports.insert_out.port, nframes));
+	self.engine.multitrack.end_cycle_mono(nframes);
     }
     // midi CC output processing
     void *buf = self.get_midi_buffer(nframes);
@@ -709,10 +723,11 @@ int __rt_func GxJack::gx_jack_insert_process(jack_nframes_t nframes, void *arg)
 	}
         // gx_head DSP computing
 	float *ibuf = get_float_buf(self.ports.insert_in.port, nframes);
-	self.engine.stereo_chain.process(
-	    nframes, ibuf, ibuf,
-	    get_float_buf(self.ports.output1.port, nframes),
-	    get_float_buf(self.ports.output2.port, nframes));
+	float *obuf1 = get_float_buf(self.ports.output1.port, nframes);
+	float *obuf2 = get_float_buf(self.ports.output2.port, nframes);
+	self.engine.multitrack.begin_cycle_stereo(nframes);
+	self.engine.stereo_chain.process(nframes, ibuf, ibuf, obuf1, obuf2);
+	self.engine.multitrack.end_cycle_stereo(nframes, obuf1, obuf2);
     }
     gx_system::measure_stop();
     self.engine.stereo_chain.post_rt_finished();
@@ -720,6 +735,59 @@ int __rt_func GxJack::gx_jack_insert_process(jack_nframes_t nframes, void *arg)
 }
 
 
+/****************************************************************
+ ** latency callbacks
+ ** add the latency of pipelined racks (--rack-stages) and of
+ ** units in the mono chain that report it
+ */
+
+void GxJack::set_port_latency(jack_latency_callback_mode_t mode, jack_port_t *in,
+			      jack_port_t *out, jack_nframes_t extra) {
+    jack_latency_range_t range;
+    if (mode == JackCaptureLatency) {
+	jack_port_get_latency_range(in, mode, &range);
+	range.min += extra;
+	range.max += extra;
+	jack_port_set_latency_range(out, mode, &range);
+    } else {
+	jack_port_get_latency_range(out, mode, &range);
+	range.min += extra;
+	range.max += extra;
+	jack_port_set_latency_range(in, mode, &range);
+    }
+}
+
+void GxJack::gx_jack_latency_callback(jack_latency_callback_mode_t mode, void *arg) {
+    GxJack& self = *static_cast<GxJack*>(arg);
+    set_port_latency(mode, self.ports.input.port, self.ports.insert_out.port,
+		     self.engine.get_mono_pipeline_latency() * self.jack_bs
+		     + self.engine.get_mono_latency());
+}
+
+void GxJack::gx_jack_insert_latency_callback(jack_latency_callback_mode_t mode, void *arg) {
+    GxJack& self = *static_cast<GxJack*>(arg);
+    jack_nframes_t extra = self.engine.get_stereo_pipeline_latency() * self.jack_bs;
+    if (mode == JackCaptureLatency) {
+	set_port_latency(mode, self.ports.insert_in.port, self.ports.output1.port, extra);
+	set_port_latency(mode, self.ports.insert_in.port, self.ports.output2.port, extra);
+    } else {
+	// input latency is the maximum of both outputs
+	jack_latency_range_t r1, r2;
+	jack_port_get_latency_range(self.ports.output1.port, mode, &r1);
+	jack_port_get_latency_range(self.ports.output2.port, mode, &r2);
+	r1.min = min(r1.min, r2.min) + extra;
+	r1.max = max(r1.max, r2.max) + extra;
+	jack_port_set_latency_range(self.ports.insert_in.port, mode, &r1);
+    }
+}
+
+void GxJack::on_latency_change() {
+    if (client) {
+	jack_recompute_total_latencies(client);
+    }
+}
+
+
 /****************************************************************
  ** port connection callback
  */
@@ -877,6 +945,7 @@ int GxJack::gx_jack_buffersize_callback(jack_nframes_t nframes, void* arg) {
 // ---- jack shutdown callback in case jackd shuts down on us
 void GxJack::gx_jack_shutdown_callback() {
     set_jack_exit(true);
+    engine.get_param().get_update_queue().rt_stopped();
     engine.set_stateflag(gx_engine::GxEngine::SF_INITIALIZING);
     shutdown();
 }
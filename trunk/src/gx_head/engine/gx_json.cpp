@@ -25,6 +25,7 @@
 #include "engine.h"               // NOLINT
 
 #include <sys/stat.h>
+#include <locale.h>
 
 namespace gx_system {
 
@@ -255,7 +256,8 @@ void JsonParser::reset() {
     next_depth = 0;
     next_tok = no_token;
     next_str.clear();
-    next_pos = 0;
+    read_cnt = 0;
+    next_cnt = 0;
 }
 
 JsonParser::JsonParser(istream* i)
@@ -267,7 +269,8 @@ JsonParser::JsonParser(istream* i)
       next_depth(0),
       next_tok(no_token),
       next_str(),
-      next_pos(0) {
+      read_cnt(0),
+      next_cnt(0) {
 }
 
 JsonParser::~JsonParser() {
@@ -338,8 +341,8 @@ const char* unicode2utf8(unsigned int input) {
 const char* JsonParser::readcode() {
     int code = 0;
     for (int i = 0; i < 4; i++) {
-        int n = is->get();
-        if (!is->good())
+        int n = read_char();
+        if (n == char_traits<char>::eof())
             throw JsonExceptionEOF("eof");
         if ('0' <= n && n <= '9')
             n = n - '0';
@@ -350,42 +353,44 @@ const char* JsonParser::readcode() {
     return unicode2utf8(code);
 }
 
-string JsonParser::readstring() {
-    ostringstream os("");
-    char c;
+void JsonParser::readstring() {
+    // next_str keeps its capacity, so once the parser has seen
+    // a few tokens no more allocations are needed
+    next_str.clear();
+    int c;
     do {
-        is->get(c);
-        if (!is->good())
-            return "";
+        c = read_char();
+        if (c == char_traits<char>::eof())
+            throw JsonExceptionEOF("eof");
         if (c == '\\') {
-            is->get(c);
-            if (!is->good())
-                return "";
+            c = read_char();
+            if (c == char_traits<char>::eof())
+                throw JsonExceptionEOF("eof");
             switch (c) {
-            case 'b': os << '\b'; break;
-            case 'f': os << '\f'; break;
-            case 'n': os << '\n'; break;
-            case 'r': os << '\r'; break;
-            case 't': os << '\t'; break;
-	    case '"': os << '"'; break;
-            case 'u': os << readcode(); break;
-            default: is->get(c); os << c; break;
+            case 'b': next_str += '\b'; break;
+            case 'f': next_str += '\f'; break;
+            case 'n': next_str += '\n'; break;
+            case 'r': next_str += '\r'; break;
+            case 't': next_str += '\t'; break;
+	    case '"': next_str += '"'; break;
+            case 'u': next_str += readcode(); break;
+            default: c = read_char(); next_str += static_cast<char>(c); break;
             }
         } else if (c == '"') {
-            return os.str();
+            return;
         } else {
-            os << c;
+            next_str += static_cast<char>(c);
         }
     } while (true);
 }
 
-string JsonParser::readnumber(char c) {
-    ostringstream os("");
+void JsonParser::readnumber(char c) {
     static int count_dn = 0;
-    do {
-        os << c;
-        c = is->peek();
-        switch (c) {
+    next_str.clear();
+    while (true) {
+        next_str += c;
+        int n = peek_char();
+        switch (n) {
         case '+': case '-': case '0': case '1': case '2': case '3': case '4':
         case '5': case '6': case '7': case '8': case '9': case 'e': case 'E':
         case '.': 
@@ -399,24 +404,22 @@ string JsonParser::readnumber(char c) {
 			}
 			break;
         default:
-            return os.str();
+            return;
         }
-        is->get(c);
-    } while (is->good());
-    return "";
+        c = read_char();
+    }
 }
 
 JsonParser::token JsonParser::read_value_token(char c) {
-    ostringstream os("");
-    do {
-        os << c;
-        c = is->peek();
-	if (c < 'a' || c > 'z') {
+    next_str.clear();
+    while (true) {
+        next_str += c;
+        int n = peek_char();
+	if (n < 'a' || n > 'z') {
 	    break;
         }
-        is->get(c);
-    } while (is->good());
-    next_str = os.str();
+        c = read_char();
+    }
     if (next_str == "null") {
 	return value_null;
     }
@@ -436,17 +439,17 @@ void JsonParser::read_next() {
         next_tok = end_token;
         return;
     }
-    char c;
+    int c;
     nl = false;
     while (true) {
         do {
-            is->get(c);
-            if (!is->good())
+            c = read_char();
+            if (c == char_traits<char>::eof())
                 throw JsonExceptionEOF("eof");
             if (c == '\n')
                 nl = true;
         } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
-	next_pos = is->tellg();
+	next_cnt = read_cnt - 1;
         switch (c) {
         case '[': next_tok = begin_array; next_depth++; break;
 
@@ -459,26 +462,28 @@ void JsonParser::read_next() {
         case ',': continue;
 
         case '"':
-            next_str = readstring();
-             *is >> c;
-            if (!is->good())
+            readstring();
+            while ((c = peek_char()) == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                read_char();
+            }
+            if (c == char_traits<char>::eof())
                 throw JsonExceptionEOF("eof");
             if (c == ':') {
+                read_char();
                 next_tok = value_key;
             } else {
-                is->unget();
                 next_tok = value_string;
             }
             break;
 
         case '-': case '0': case '1': case '2': case '3': case '4':
         case '5': case '6': case '7': case '8': case '9':
-            next_str = readnumber(c);
+            readnumber(c);
             next_tok = value_number;
             break;
         // read denormal value
 		case 'n': case 'a': case 'i': case 'f':
-            next_str = readnumber(c);
+            readnumber(c);
             next_tok = value_number;
             break;
 
@@ -508,6 +513,29 @@ JsonParser::token JsonParser::next(token expect) {
     return cur_tok;
 }
 
+// number conversion must not depend on the current LC_NUMERIC
+// setting (gtk sets the user locale at startup)
+static locale_t c_numeric_locale() {
+    static locale_t loc = newlocale(LC_NUMERIC_MASK, "C", 0);
+    return loc;
+}
+
+float JsonParser::current_value_float() {
+    float f = strtof_l(str.c_str(), 0, c_numeric_locale());
+    if (!isfinite(f)) { // denormal value like "nan", "inf"
+	return 0;
+    }
+    return f;
+}
+
+double JsonParser::current_value_double() {
+    double d = strtod_l(str.c_str(), 0, c_numeric_locale());
+    if (!isfinite(d)) {
+	return 0;
+    }
+    return d;
+}
+
 bool JsonParser::read_kv(const char *key, float& v) {
     if (str == key) {
 	next(value_number);
@@ -1700,6 +1728,17 @@ Glib::ustring PresetBanks::get_name(int n) {
 AbstractStateIO::~AbstractStateIO() {}
 AbstractPresetIO::~AbstractPresetIO() {}
 
+// a PresetIO may keep a precompiled version of the preset, if
+// true is returned commit_preset() can be called directly
+bool AbstractPresetIO::read_snapshot(PresetFile&, const Glib::ustring&) {
+    return false;
+}
+
+// called after a preset of the bank has been loaded (outside of
+// the ramp down / up of the preset switch)
+void AbstractPresetIO::compile_bank(PresetFile&) {
+}
+
 // seq_ may not yet be initialized, only use address!
 GxSettingsBase::GxSettingsBase(gx_engine::EngineControl& seq_)
     : state_io(),
@@ -1719,11 +1758,16 @@ GxSettingsBase::~GxSettingsBase() {
 bool GxSettingsBase::loadsetting(PresetFile *p, const Glib::ustring& name) {
     try {
 	if (p) {
-	    JsonParser *jp = p->create_reader(name);
-	    preset_io->read_preset(*jp, p->get_header());
-	    seq.wait_ramp_down_finished();
-	    preset_io->commit_preset();
-	    delete jp;
+	    if (preset_io->read_snapshot(*p, name)) {
+		seq.wait_ramp_down_finished();
+		preset_io->commit_preset();
+	    } else {
+		JsonParser *jp = p->create_reader(name);
+		preset_io->read_preset(*jp, p->get_header());
+		seq.wait_ramp_down_finished();
+		preset_io->commit_preset();
+		delete jp;
+	    }
 	    gx_print_info(
 		_("loaded preset"),
 		boost::format(_("%1% from file %2%")) % name % p->get_filename());
@@ -1785,6 +1829,8 @@ void GxSettingsBase::load_preset(PresetFile* pf, const Glib::ustring& name) {
     seq.start_ramp_down();
     bool modules_changed = loadsetting(pf, name);
     seq.start_ramp_up();
+    // prepare the next switch in this bank (no-op if up to date)
+    preset_io->compile_bank(*pf);
     // if no modules changed either there was no change (then
     // rack_changed should not be set anyhow) or the modules
     // could not be installed because jack is not initialized.
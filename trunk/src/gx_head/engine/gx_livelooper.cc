@@ -26,57 +26,184 @@
 
 
 
-int LiveLooper::FileResampler::setup(int _inputRate, int _outputRate)
+/****************************************************************
+ ** class LiveLooper::Tape
+ */
+
+static const int wav_header_size = 44;
+
+static inline void put_le(char *p, unsigned int v, int n)
 {
-    const int qual = 16; 
-    inputRate = _inputRate;
-    outputRate = _outputRate;
-    if (inputRate == outputRate) {
-    return 0;
+    for (int i = 0; i < n; i++) {
+        p[i] = (v >> (8*i)) & 0xff;
     }
-    // resampler
-    int ret = r_file.setup(inputRate, outputRate, 1, qual);
-    if (ret) {
-    return ret;
-    }
-    // k == filtlen() == 2 * qual
-    // pre-fill with k-1 zeros
-    r_file.inp_count = r_file.filtlen() - 1;
-    r_file.out_count = 1;
-    r_file.inp_data = r_file.out_data = 0;
-    r_file.process();
-    return 0;
 }
 
-int LiveLooper::FileResampler::run(int count, float *input, float *output)
+// canonical header of a mono 32 bit float wav file
+static void wav_header(char *h, int rate, int frames)
+{
+    unsigned int data = frames * sizeof(float);
+    memcpy(h, "RIFF", 4);
+    put_le(h+4, 36 + data, 4);
+    memcpy(h+8, "WAVEfmt ", 8);
+    put_le(h+16, 16, 4);
+    put_le(h+20, 3, 2);  // WAVE_FORMAT_IEEE_FLOAT
+    put_le(h+22, 1, 2);
+    put_le(h+24, rate, 4);
+    put_le(h+28, rate * sizeof(float), 4);
+    put_le(h+32, sizeof(float), 2);
+    put_le(h+34, 32, 2);
+    memcpy(h+36, "data", 4);
+    put_le(h+40, data, 4);
+}
+
+static bool pwrite_all(int fd, const void *buf, size_t n, off_t off)
 {
-    if (inputRate == outputRate) {
-    memcpy(output, input, count*sizeof(float));
-    return count;
+    const char *p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t k = pwrite(fd, p, n, off);
+        if (k < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += k;
+        n -= k;
+        off += k;
     }
-    r_file.inp_count = count;
-    r_file.inp_data = input;
-    int m = max_out_count(count);
-    r_file.out_count = m;
-    r_file.out_data = output;
-    r_file.process();
-    assert(r_file.inp_count == 0);
-    assert(r_file.out_count <= 1);
-    return m - r_file.out_count;
+    return true;
 }
 
+static inline off_t frame_offset(int pos)
+{
+    return wav_header_size + off_t(pos) * sizeof(float);
+}
 
+// new empty loop file in dir with room for frames
+bool LiveLooper::Tape::create(const std::string& dir, int frames, int rate)
+{
+    release();
+    std::string tmpl = dir + ".tapeXXXXXX";
+    std::vector<char> name(tmpl.begin(), tmpl.end());
+    name.push_back('\0');
+    fd = mkstemp(&name[0]);
+    if (fd < 0) {
+        return false;
+    }
+    fname = &name[0];
+    char h[wav_header_size];
+    wav_header(h, rate, 0);
+    npages = (frames + page_size - 1) / page_size;
+    if (!pwrite_all(fd, h, sizeof(h), 0)) {
+        release();
+        return false;
+    }
+    pages = new float*[npages];
+    dirty = new int[npages];
+    for (int i = 0; i < npages; i++) {
+        pages[i] = 0;
+        dirty[i] = 0;
+    }
+    size = frames;
+    return true;
+}
+
+bool LiveLooper::Tape::write_frames(int pos, const float *buf, int n)
+{
+    return pwrite_all(fd, buf, n * sizeof(float), frame_offset(pos));
+}
+
+// the part after the end of the file is silence
+bool LiveLooper::Tape::read_page(int n, float *buf)
+{
+    size_t len = page_size * sizeof(float);
+    size_t got = 0;
+    off_t off = frame_offset(n * page_size);
+    bool ok = true;
+    while (got < len) {
+        ssize_t k = pread(fd, reinterpret_cast<char*>(buf) + got, len - got, off + got);
+        if (k < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        if (k == 0) {
+            break;
+        }
+        got += k;
+    }
+    memset(reinterpret_cast<char*>(buf) + got, 0, len - got);
+    return ok;
+}
+
+bool LiveLooper::Tape::write_page(int n, const float *buf)
+{
+    return write_frames(n * page_size, buf, page_size);
+}
+
+// cut the file to the recorded frames, complete the header and move
+// it to target; the resident pages must have been written before
+bool LiveLooper::Tape::finish(int frames, int rate, const std::string& target)
+{
+    char h[wav_header_size];
+    wav_header(h, rate, frames);
+    bool ok = (ftruncate(fd, frame_offset(frames)) == 0
+               && pwrite_all(fd, h, sizeof(h), 0)
+               && fchmod(fd, 0644) == 0
+               && fsync(fd) == 0
+               && rename(fname.c_str(), target.c_str()) == 0);
+    if (ok) {
+        fname.clear();
+    }
+    release();
+    return ok;
+}
+
+// give the resident pages back to pool (dirty pages are lost); the
+// rt thread must not use the tape any more
+void LiveLooper::Tape::drop_pages(std::vector<float*>& pool)
+{
+    for (int i = 0; i < npages; i++) {
+        if (pages[i]) {
+            pool.push_back(pages[i]);
+            pages[i] = 0;
+        }
+    }
+}
+
+// close and remove the loop file (if not moved by finish())
+void LiveLooper::Tape::release()
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!fname.empty()) {
+        unlink(fname.c_str());
+    }
+    delete[] pages;
+    delete[] dirty;
+    fd = -1;
+    fname.clear();
+    npages = 0;
+    pages = 0;
+    dirty = 0;
+    size = 0;
+}
+
+
+/****************************************************************
+ ** class LiveLooper
+ */
 
 LiveLooper::LiveLooper(ParamMap& param_, sigc::slot<void> sync_, const string& loop_dir_)
     : PluginDef(),
-      tape1(NULL),
-      tape1_size(4194304),
-      tape2(NULL),
-      tape2_size(4194304),
-      tape3(NULL),
-      tape3_size(4194304),
-      tape4(NULL),
-      tape4_size(4194304),
+      tape1_size(0),
+      tape2_size(0),
+      tape3_size(0),
+      tape4_size(0),
       save1(false),
       save2(false),
       save3(false),
@@ -92,7 +219,19 @@ LiveLooper::LiveLooper(ParamMap& param_, sigc::slot<void> sync_, const string& l
       param(param_),
       mem_allocated(false),
       sync(sync_),
-      smp(),
+      tapes(),
+      page_mem(0),
+      free_pages(),
+      rt_cycle(0),
+      tape_gen(),
+      jobs(),
+      done(),
+      job_mutex(),
+      tape_mutex(),
+      m_trig(),
+      m_pthr(0),
+      stop_worker(false),
+      load_done(),
       plugin() {
     version = PLUGINDEF_VERSION;
     id = "dubber";
@@ -110,38 +249,51 @@ LiveLooper::LiveLooper(ParamMap& param_, sigc::slot<void> sync_, const string& l
     clear_state = clear_state_f_static;
     delete_instance = del_instance;
     plugin = this;
+    load_done.connect(sigc::mem_fun(this, &LiveLooper::on_load_done));
+    sem_init(&m_trig, 0, 0);
+    start_worker();
 }
 
 LiveLooper::~LiveLooper() {
     activate(false);
+    // the worker finishes the queued saves before it exits
+    stop_worker = true;
+    sem_post(&m_trig);
+    if (m_pthr) {
+        pthread_join(m_pthr, NULL);
+    }
+    for (std::list<TapeJob*>::iterator i = jobs.begin(); i != jobs.end(); ++i) {
+        delete *i;
+    }
+    for (std::list<TapeJob*>::iterator i = done.begin(); i != done.end(); ++i) {
+        delete *i;
+    }
+    free_pool();
 }
 
+// new loop files read as silence
 inline void LiveLooper::clear_state_f()
 {
     for (int i=0; i<2; i++) fRec0[i] = 0;
     for (int i=0; i<2; i++) iVec0[i] = 0;
-    for (int i=0; i<tape1_size; i++) tape1[i] = 0;
     for (int i=0; i<2; i++) RecSize1[i] = 0;
     for (int i=0; i<2; i++) fRec1[i] = 0;
     for (int i=0; i<2; i++) fRec2[i] = 0;
     for (int i=0; i<2; i++) iRec3[i] = 0;
     for (int i=0; i<2; i++) iRec4[i] = 0;
     for (int i=0; i<2; i++) iVec2[i] = 0;
-    for (int i=0; i<tape2_size; i++) tape2[i] = 0;
     for (int i=0; i<2; i++) RecSize2[i] = 0;
     for (int i=0; i<2; i++) fRec6[i] = 0;
     for (int i=0; i<2; i++) fRec7[i] = 0;
     for (int i=0; i<2; i++) iRec8[i] = 0;
     for (int i=0; i<2; i++) iRec9[i] = 0;
     for (int i=0; i<2; i++) iVec4[i] = 0;
-    for (int i=0; i<tape3_size; i++) tape3[i] = 0;
     for (int i=0; i<2; i++) RecSize3[i] = 0;
     for (int i=0; i<2; i++) fRec11[i] = 0;
     for (int i=0; i<2; i++) fRec12[i] = 0;
     for (int i=0; i<2; i++) iRec13[i] = 0;
     for (int i=0; i<2; i++) iRec14[i] = 0;
     for (int i=0; i<2; i++) iVec6[i] = 0;
-    for (int i=0; i<tape4_size; i++) tape4[i] = 0;
     for (int i=0; i<2; i++) RecSize4[i] = 0;
     for (int i=0; i<2; i++) fRec16[i] = 0;
     for (int i=0; i<2; i++) fRec17[i] = 0;
@@ -180,192 +332,481 @@ void LiveLooper::init_static(unsigned int samplingFreq, PluginDef *p)
     static_cast<LiveLooper*>(p)->init(samplingFreq);
 }
 
+// set the rt variables of tapes[nr], holding frames of recorded data
+void LiveLooper::set_tape(int nr, int frames)
+{
+    Tape& t = tapes[nr];
+    switch (nr) {
+    case 0:
+        tape1_size = t.size;
+        RecSize1[1] = frames;
+        IOTAR1= frames - int(frames*(100-fclips1)*0.01);
+        break;
+    case 1:
+        tape2_size = t.size;
+        RecSize2[1] = frames;
+        IOTAR2= frames - int(frames*(100-fclips2)*0.01);
+        break;
+    case 2:
+        tape3_size = t.size;
+        RecSize3[1] = frames;
+        IOTAR3= frames - int(frames*(100-fclips3)*0.01);
+        break;
+    case 3:
+        tape4_size = t.size;
+        RecSize4[1] = frames;
+        IOTAR4= frames - int(frames*(100-fclips4)*0.01);
+        break;
+    }
+}
+
+// length of a tape
+int LiveLooper::max_tape_frames(int rate)
+{
+    return min(INT_MAX / int(sizeof(float)), max_tape_seconds * rate);
+}
+
+// locked memory for the resident pages of all tapes (including the
+// ones handed over to save jobs); caller holds tape_mutex
+bool LiveLooper::alloc_pool()
+{
+    if (page_mem) {
+        return true;
+    }
+    size_t len = size_t(pool_pages) * Tape::page_size * sizeof(float);
+    void *p = mmap(0, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    if (mlock(p, len) != 0) {
+        memset(p, 0, len);
+    }
+    page_mem = static_cast<float*>(p);
+    for (int i = 0; i < pool_pages; i++) {
+        free_pages.push_back(page_mem + i * Tape::page_size);
+    }
+    return true;
+}
+
+// the pool is kept while save jobs still hold pages of it; caller
+// holds tape_mutex (or the worker has stopped)
+void LiveLooper::free_pool()
+{
+    if (!page_mem || mem_allocated || free_pages.size() != static_cast<size_t>(pool_pages)) {
+        return;
+    }
+    munmap(page_mem, size_t(pool_pages) * Tape::page_size * sizeof(float));
+    page_mem = 0;
+    free_pages.clear();
+}
+
 void LiveLooper::mem_alloc()
 {
-    try {
-        if (!tape1) tape1 = new float[tape1_size];
-        if (!tape2) tape2 = new float[tape2_size];
-        if (!tape3) tape3 = new float[tape3_size];
-        if (!tape4) tape4 = new float[tape4_size];
-        } catch(...) {
-            gx_print_error("dubber", "out of memory");
+    boost::mutex::scoped_lock lock(tape_mutex);
+    if (!alloc_pool()) {
+        gx_print_error("dubber", "out of memory");
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (!tapes[i].pages && !tapes[i].create(loop_dir, max_tape_frames(fSamplingFreq), fSamplingFreq)) {
+            gx_print_error("dubber", Glib::ustring::compose(
+                _("can't create tape file in %1"), loop_dir));
             return;
         }
+        set_tape(i, 0);
+    }
     mem_allocated = true;
     gx_system::atomic_set(&ready,1);
+    sem_post(&m_trig);
 }
 
 void LiveLooper::mem_free()
 {
     gx_system::atomic_set(&ready,0);
     mem_allocated = false;
-    if (tape1) { delete[] tape1; tape1 = 0; }
-    if (tape2) { delete[] tape2; tape2 = 0; }
-    if (tape3) { delete[] tape3; tape3 = 0; }
-    if (tape4) { delete[] tape4; tape4 = 0; }
-}
-
-int LiveLooper::do_resample(int inrate, int insize, float *input, int maxsize) {
-    float *getout = 0;
-    try {
-        getout = new float[maxsize];
-        } catch(...) {
-            gx_print_error("dubber", "out of memory");
-            return 0;
-        }  
-    smp.run(insize, input, getout);
-    memset(input,0,maxsize*sizeof(float));
-    for(int i = 0; i < maxsize; i++) {
-        input[i] = getout[i];
-    }
-    delete[] getout;
-    gx_print_info("dubber", Glib::ustring::compose(
-        _("resampling from %1 to %2"), inrate, fSamplingFreq));
+    boost::mutex::scoped_lock lock(tape_mutex);
+    for (int i = 0; i < 4; i++) {
+        tape_gen[i]++; // drop pending loads
+        tapes[i].drop_pages(free_pages);
+        tapes[i].release();
+    }
+    free_pool();
+}
+
+/*
+ ** tape worker: loads and saves tapes and streams the pages around
+ ** the heads (all file access of the looper)
+ */
+
+void LiveLooper::start_worker()
+{
+    if (pthread_create(&m_pthr, NULL, run_worker, reinterpret_cast<void*>(this))) {
+        m_pthr = 0;
+        gx_print_error("dubber", _("can't start tape thread"));
+    }
+}
 
-    return maxsize;
+void *LiveLooper::run_worker(void *p)
+{
+    static_cast<LiveLooper*>(p)->worker();
+    return NULL;
 }
 
-int LiveLooper::do_mono(int c, int f, float *oIn, float *tape, int n) {
-    int p = 0;
-    for(int i = 0; i < (c *f)-c; i+=c) {
-        for(int j = 0; j < c; j++)
-            tape[p] += oIn[i + j];
-        tape[p] /= c;
-        if ( p >= n) break;
-        p++;
+void LiveLooper::worker()
+{
+    for (;;) {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 100000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000000000;
+        }
+        sem_timedwait(&m_trig, &ts);
+        for (;;) {
+            TapeJob *job;
+            {
+                boost::mutex::scoped_lock lock(job_mutex);
+                if (jobs.empty()) {
+                    break;
+                }
+                job = jobs.front();
+                jobs.pop_front();
+            }
+            if (job->type == TapeJob::save) {
+                run_save(*job);
+                delete job;
+            } else if (run_load(*job)) {
+                {
+                    boost::mutex::scoped_lock lock(job_mutex);
+                    done.push_back(job);
+                }
+                load_done();
+            } else {
+                delete job;
+            }
+        }
+        if (stop_worker) {
+            break;
+        }
+        stream_tapes();
     }
-    return p;
 }
 
-inline int LiveLooper::load_from_wave(std::string fname, float **tape, int tape_size)
+// pages the rt thread needs next: around the record head, ahead of
+// and behind the play head, and at both ends of the loop where the
+// heads jump to; returns the number of entries in pg
+int LiveLooper::wanted_pages(int nr, int *pg)
 {
-    SF_INFO sfinfo;
-    int n,f,c,r,i;
-    int fSize = 0;
-    bool res = false;
-    sfinfo.format = 0;
-    SNDFILE *sf = sf_open(fname.c_str(),SFM_READ,&sfinfo);
-    if (sf ) {
-        gx_print_info("dubber", Glib::ustring::compose(
-           _("load file %1 "), fname));
-        f = i = sfinfo.frames;
-        c = sfinfo.channels;
-        r = sfinfo.samplerate;
-        n = min(tape_size,f*c);
-        if( c==1 ) {
-            if (r != fSamplingFreq) {
-                smp.setup(r, fSamplingFreq);
-                i = smp.max_out_count(f);
-                res = true;
+    const int rec_size[4] = { RecSize1[0], RecSize2[0], RecSize3[0], RecSize4[0] };
+    const int size[4] = { tape1_size, tape2_size, tape3_size, tape4_size };
+    const int rec_head[4] = { IOTA1, IOTA2, IOTA3, IOTA4 };
+    const float play_head[4] = { IOTAR1, IOTAR2, IOTAR3, IOTAR4 };
+    const float clip[4] = { fclip1, fclip2, fclip3, fclip4 };
+    const float clips[4] = { fclips1, fclips2, fclips3, fclips4 };
+    int len = min(size[nr]-1, rec_size[nr]);
+    int start = len - int(len*(100-clips[nr])*0.01);
+    int end = int(len*clip[nr]*0.01);
+    int p = int(play_head[nr]);
+    const int ps = Tape::page_size;
+    int pos[] = { rec_head[nr], rec_head[nr] + ps,
+                  p - ps, p, p + ps, p + 2 * ps,
+                  start, start + ps, end - ps, end };
+    int n = 0;
+    for (unsigned int i = 0; i < sizeof(pos) / sizeof(pos[0]); i++) {
+        if (pos[i] < 0 || pos[i] >= size[nr]) {
+            continue;
+        }
+        int k = pos[i] >> Tape::page_bits;
+        if (std::find(pg, pg + n, k) == pg + n) {
+            pg[n++] = k;
+        }
+    }
+    return n;
+}
+
+// after a page pointer has been cleared, wait until the rt thread
+// can't use the page any more
+void LiveLooper::wait_rt_cycle()
+{
+    int c = gx_system::atomic_get(rt_cycle);
+    if (!(c & 1)) {
+        return;
+    }
+    while (gx_system::atomic_get(rt_cycle) == c) {
+        usleep(1000);
+    }
+}
+
+// make the wanted pages resident, write pages recorded behind the
+// record head to the loop file and evict pages which aren't wanted
+// any more
+void LiveLooper::stream_tapes()
+{
+    if (!gx_system::atomic_get(ready)) {
+        return;
+    }
+    const int rec_head[4] = { IOTA1, IOTA2, IOTA3, IOTA4 };
+    boost::mutex::scoped_lock lock(tape_mutex);
+    int wanted[4][10];
+    int nwanted[4];
+    std::vector<std::pair<int, int> > evicted;
+    for (int i = 0; i < 4; i++) {
+        Tape& t = tapes[i];
+        nwanted[i] = t.pages ? wanted_pages(i, wanted[i]) : 0;
+        for (int k = 0; k < t.npages; k++) {
+            if (t.pages[k] && std::find(wanted[i], wanted[i]+nwanted[i], k) == wanted[i]+nwanted[i]) {
+                evicted.push_back(std::make_pair(i, k));
             }
-            if(i>n) {
-                delete[] *tape;
-                *tape = NULL;
-                try {
-                    *tape = new float[i];
-                    } catch(...) {
-                    gx_print_error("dubber", "out of memory");
-                    return 0;
-                    }
-                n=i;
+        }
+    }
+    if (!evicted.empty()) {
+        std::vector<float*> bufs;
+        for (unsigned int j = 0; j < evicted.size(); j++) {
+            Tape& t = tapes[evicted[j].first];
+            bufs.push_back(t.pages[evicted[j].second]);
+            gx_system::atomic_set_0(&t.pages[evicted[j].second]);
+        }
+        wait_rt_cycle();
+        for (unsigned int j = 0; j < evicted.size(); j++) {
+            Tape& t = tapes[evicted[j].first];
+            int k = evicted[j].second;
+            if (t.dirty[k]) {
+                t.dirty[k] = 0;
+                if (!t.write_page(k, bufs[j])) {
+                    gx_print_error("dubber", _("can't write tape file"));
+                }
             }
-            fSize = sf_read_float(sf,*tape,n);
-            if (res) fSize = do_resample(r, f, *tape, n);
-            sf_close(sf);
-            return fSize;
-        } else if (c>1) {
-            float *oIn = 0;
-            try {
-                oIn = new float[c * f];
-                } catch(...) {
-                    gx_print_error("dubber", "out of memory");
-                    return 0;
+            free_pages.push_back(bufs[j]);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        Tape& t = tapes[i];
+        int rec_page = rec_head[i] >> Tape::page_bits;
+        for (int k = 0; k < t.npages; k++) {
+            float *p = t.pages[k];
+            if (p && k != rec_page && t.dirty[k]) {
+                // the rt thread sets the flag again if it still writes
+                gx_system::atomic_set(&t.dirty[k], 0);
+                if (!t.write_page(k, p)) {
+                    gx_print_error("dubber", _("can't write tape file"));
                 }
-            if (r != fSamplingFreq) {
-                smp.setup(r, fSamplingFreq);
-                i = smp.max_out_count(f);
-                res = true;
             }
-            if(i>n) {
-                delete[] *tape;
-                *tape = NULL;
-                try {
-                    *tape = new float[i];
-                    } catch(...) {
-                    gx_print_error("dubber", "out of memory");
-                    return 0;
-                    }
-                n=i;
+        }
+        for (int j = 0; j < nwanted[i]; j++) {
+            int k = wanted[i][j];
+            if (t.pages[k] || free_pages.empty()) {
+                continue;
             }
-            sf_read_float(sf, oIn, c * f);
-            memset(*tape,0,n*sizeof(float));
-            int p = do_mono(c, f, oIn, *tape,  n);
-            gx_print_info("dubber", Glib::ustring::compose(
-                _("mix down to mono file %1 "), fname));
-            delete[] oIn;
-            if (res) p = do_resample(r, p, *tape, n);
-            sf_close(sf);
-            return p;
+            float *p = free_pages.back();
+            free_pages.pop_back();
+            if (!t.read_page(k, p)) {
+                gx_print_error("dubber", _("can't read tape file"));
+            }
+            gx_system::atomic_set(&t.pages[k], p);
         }
     }
-    return fSize;
 }
 
-inline void LiveLooper::load_array(std::string name)
+void LiveLooper::queue_job(TapeJob *job)
 {
-    RecSize1[1] = load_from_wave(loop_dir+name+"1.wav", &tape1, tape1_size);
-    tape1_size = max(4194304,RecSize1[1]);
-    IOTAR1= RecSize1[1] - int(RecSize1[1]*(100-fclips1)*0.01);
-    
-    RecSize2[1] = load_from_wave(loop_dir+name+"2.wav", &tape2, tape2_size);
-    tape2_size = max(4194304,RecSize2[1]);
-    IOTAR2= RecSize2[1] - int(RecSize2[1]*(100-fclips2)*0.01);
-    
-    RecSize3[1] = load_from_wave(loop_dir+name+"3.wav", &tape3, tape3_size);
-    tape3_size = max(4194304,RecSize3[1]);
-    IOTAR3= RecSize3[1] - int(RecSize3[1]*(100-fclips3)*0.01);
-    
-    RecSize4[1] = load_from_wave(loop_dir+name+"4.wav", &tape4, tape4_size);
-    tape4_size = max(4194304,RecSize4[1]);
-    IOTAR4= RecSize4[1] - int(RecSize4[1]*(100-fclips4)*0.01);
-    
-    cur_name = preset_name;
+    {
+        boost::mutex::scoped_lock lock(job_mutex);
+        jobs.push_back(job);
+    }
+    sem_post(&m_trig);
 }
 
-inline void LiveLooper::save_to_wave(std::string fname, float *tape, float fSize, int tape_size)
+void LiveLooper::queue_load(int nr, const std::string& fname, bool mark_save)
 {
-    SF_INFO sfinfo ;
-    sfinfo.channels = 1;
-    sfinfo.samplerate = fSamplingFreq;
-    sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
-    
-    SNDFILE * sf = sf_open(fname.c_str(), SFM_WRITE, &sfinfo);
-    if (sf) {
-        size_t lSize = tape_size - int(fSize/fConst2);
-        sf_write_float(sf,tape, lSize);
-        sf_write_sync(sf);
+    TapeJob *job = new TapeJob(TapeJob::load, nr, ++tape_gen[nr], fname);
+    job->rate = fSamplingFreq;
+    job->mark_save = mark_save;
+    queue_job(job);
+}
+
+// hands tape nr over to the worker, which writes the resident pages
+// and moves the loop file to fname; the rt thread must not use the
+// tape any more; caller holds tape_mutex
+void LiveLooper::queue_save(int nr, const std::string& fname, float rectime)
+{
+    Tape& t = tapes[nr];
+    if (!t.pages) {
+        return;
     }
-    sf_close(sf);
+    TapeJob *job = new TapeJob(TapeJob::save, nr, tape_gen[nr], fname);
+    job->rate = fSamplingFreq;
+    job->frames = max(0, min(t.size, t.size - int(rectime/fConst2)));
+    job->tape = t;
+    t = Tape();
+    queue_job(job);
 }
 
-inline void LiveLooper::save_array(std::string name)
+// runs in the worker: read, mix down and resample the file into the
+// loop file of a new tape, block by block, so only a block of the
+// file is held in RAM
+bool LiveLooper::run_load(TapeJob& job)
 {
-    if (name.compare("tape")==0 || save_p) {
-        if (save1) {
-            save_to_wave(loop_dir+name+"1.wav",tape1,rectime0, tape1_size);
-            save1 = false;
+    const int blocksize = 65536;
+    SF_INFO sfinfo;
+    sfinfo.format = 0;
+    SNDFILE *sf = sf_open(job.fname.c_str(),SFM_READ,&sfinfo);
+    if (!sf) {
+        return false;
+    }
+    gx_print_info("dubber", Glib::ustring::compose(
+        _("load file %1 "), job.fname));
+    int f = min(sfinfo.frames, static_cast<sf_count_t>(INT_MAX / sizeof(float) / 2));
+    int c = sfinfo.channels;
+    int r = sfinfo.samplerate;
+    StreamingResampler smp;
+    bool res = (r != job.rate);
+    int n = f;
+    if (res) {
+        if (!smp.setup(r, job.rate, 1)) {
+            gx_print_error("dubber", Glib::ustring::compose(
+                _("can't resample %1"), job.fname));
+            sf_close(sf);
+            return false;
+        }
+        gx_print_info("dubber", Glib::ustring::compose(
+            _("resampling from %1 to %2"), r, job.rate));
+        n = smp.get_max_out_size(f);
+    }
+    if (c > 1) {
+        gx_print_info("dubber", Glib::ustring::compose(
+            _("mix down to mono file %1 "), job.fname));
+    }
+    if (!job.tape.create(loop_dir, max(n, max_tape_frames(job.rate)), job.rate)) {
+        gx_print_error("dubber", Glib::ustring::compose(
+            _("can't create tape file in %1"), loop_dir));
+        sf_close(sf);
+        return false;
+    }
+    std::vector<float> ibuf(blocksize * c);
+    std::vector<float> mbuf(c > 1 ? blocksize : 0);
+    std::vector<float> obuf(res ? smp.get_max_out_size(blocksize) : 0);
+    int pos = 0;
+    for (;;) {
+        if (job.gen != tape_gen[job.nr]) {
+            // outdated: tape has been replaced or freed meanwhile
+            sf_close(sf);
+            return false;
+        }
+        int k = sf_readf_float(sf, &ibuf[0], blocksize);
+        if (k <= 0) {
+            break;
+        }
+        float *p = &ibuf[0];
+        if (c > 1) {
+            for (int i = 0; i < k; i++) {
+                float s = 0;
+                for (int j = 0; j < c; j++) {
+                    s += ibuf[i*c+j];
+                }
+                mbuf[i] = s / c;
+            }
+            p = &mbuf[0];
+        }
+        if (res) {
+            k = smp.process(k, p, &obuf[0]);
+            p = &obuf[0];
         }
-        if (save2) {
-            save_to_wave(loop_dir+name+"2.wav",tape2,rectime1, tape2_size);
-            save2 = false;
+        k = min(k, job.tape.size - pos);
+        if (!job.tape.write_frames(pos, p, k)) {
+            break;
+        }
+        pos += k;
+    }
+    if (res) {
+        int k = min(smp.flush(&obuf[0]), job.tape.size - pos);
+        if (job.tape.write_frames(pos, &obuf[0], k)) {
+            pos += k;
+        }
+    }
+    sf_close(sf);
+    job.frames = pos;
+    return true;
+}
+
+// runs in the worker: write the pages which are still resident and
+// move the loop file into place; only the part of the tape which
+// hasn't been written behind the record head is left to write
+void LiveLooper::run_save(TapeJob& job)
+{
+    Tape& t = job.tape;
+    bool ok = true;
+    for (int k = 0; k < t.npages; k++) {
+        if (t.pages[k] && t.dirty[k]) {
+            ok = t.write_page(k, t.pages[k]) && ok;
         }
-        if (save3) {
-            save_to_wave(loop_dir+name+"3.wav",tape3,rectime2, tape3_size);
-            save3 = false;
+    }
+    {
+        boost::mutex::scoped_lock lock(tape_mutex);
+        t.drop_pages(free_pages);
+        free_pool();
+    }
+    if (!ok || !t.finish(job.frames, job.rate, job.fname)) {
+        gx_print_error("dubber", Glib::ustring::compose(
+            _("can't write %1"), job.fname));
+    }
+}
+
+// runs in the ui thread: exchange the loaded tapes
+void LiveLooper::on_load_done()
+{
+    std::list<TapeJob*> l;
+    {
+        boost::mutex::scoped_lock lock(job_mutex);
+        l.swap(done);
+    }
+    bool *save[4] = { &save1, &save2, &save3, &save4 };
+    float *rectime[4] = { &rectime0, &rectime1, &rectime2, &rectime3 };
+    for (std::list<TapeJob*>::iterator i = l.begin(); i != l.end(); ++i) {
+        TapeJob *job = *i;
+        int nr = job->nr;
+        if (mem_allocated && job->gen == tape_gen[nr]) {
+            gx_system::atomic_set(&ready,0);
+            sync();
+            {
+                boost::mutex::scoped_lock lock(tape_mutex);
+                if (job->mark_save && *save[nr] && (cur_name.compare("tape")==0 || save_p)) {
+                    queue_save(nr, loop_dir+cur_name+gx_system::to_string(nr+1)+".wav", *rectime[nr]);
+                } else {
+                    tapes[nr].drop_pages(free_pages);
+                    tapes[nr].release();
+                }
+                tapes[nr] = job->tape;
+                job->tape = Tape();
+                set_tape(nr, job->frames);
+            }
+            *save[nr] = job->mark_save;
+            gx_system::atomic_set(&ready,1);
+            sem_post(&m_trig);
         }
-        if (save4) {
-            save_to_wave(loop_dir+name+"4.wav",tape4,rectime3, tape4_size);
-            save4 = false;
+        delete job;
+    }
+}
+
+inline void LiveLooper::load_array(std::string name)
+{
+    for (int i = 0; i < 4; i++) {
+        queue_load(i, loop_dir+name+gx_system::to_string(i+1)+".wav", false);
+    }
+    cur_name = preset_name;
+}
+
+inline void LiveLooper::save_array(std::string name)
+{
+    if (name.compare("tape")==0 || save_p) {
+        bool *save[4] = { &save1, &save2, &save3, &save4 };
+        float *rectime[4] = { &rectime0, &rectime1, &rectime2, &rectime3 };
+        boost::mutex::scoped_lock lock(tape_mutex);
+        for (int i = 0; i < 4; i++) {
+            if (*save[i]) {
+                queue_save(i, loop_dir+name+gx_system::to_string(i+1)+".wav", *rectime[i]);
+                *save[i] = false;
+            }
         }
     }
 }
@@ -379,6 +820,7 @@ int LiveLooper::activate(bool start)
             load_array(preset_name);
         }
     } else if (mem_allocated) {
+        gx_system::atomic_set(&ready,0);
         save_array(cur_name);
         mem_free();
         load_file1 = "tape1";
@@ -394,76 +836,27 @@ int LiveLooper::activate_static(bool start, PluginDef *p)
     return static_cast<LiveLooper*>(p)->activate(start);
 }
 
-void LiveLooper::load_tape1() {
-    if (!load_file1.empty()) {
-        gx_system::atomic_set(&ready,0);
-        sync();
-        if (cur_name.compare("tape")==0 || save_p) {
-            if (save1) {
-                save_to_wave(loop_dir+cur_name+"1.wav",tape1,rectime0, tape1_size);
-                save1 = false;
-            }
-        }
-        RecSize1[1] = load_from_wave(load_file1, &tape1, tape1_size);
-        tape1_size = max(4194304,RecSize1[1]);
-        IOTAR1= RecSize1[1] - int(RecSize1[1]*(100-fclips1)*0.01);
-        save1 = true;
-        gx_system::atomic_set(&ready,1);
+// the current tape keeps playing until the file is loaded
+void LiveLooper::load_tape(int nr, const Glib::ustring& load_file) {
+    if (!load_file.empty() && mem_allocated) {
+        queue_load(nr, load_file, true);
     }
 }
 
+void LiveLooper::load_tape1() {
+    load_tape(0, load_file1);
+}
+
 void LiveLooper::load_tape2() {
-    if (!load_file2.empty()) {
-        gx_system::atomic_set(&ready,0);
-        sync();
-        if (cur_name.compare("tape")==0 || save_p) {
-            if (save2) {
-                save_to_wave(loop_dir+cur_name+"2.wav",tape2,rectime1,tape2_size);
-                save2 = false;
-            }
-        }
-        RecSize2[1] = load_from_wave(load_file2, &tape2, tape2_size);
-        tape2_size = max(4194304,RecSize2[1]);
-        IOTAR2= RecSize2[1] - int(RecSize2[1]*(100-fclips2)*0.01);
-        save2 = true;
-        gx_system::atomic_set(&ready,1);
-    }
+    load_tape(1, load_file2);
 }
 
 void LiveLooper::load_tape3() {
-    if (!load_file3.empty()) {
-        gx_system::atomic_set(&ready,0);
-        sync();
-        if (cur_name.compare("tape")==0 || save_p) {
-            if (save3) {
-                save_to_wave(loop_dir+cur_name+"3.wav",tape3,rectime2,tape3_size);
-                save3 = false;
-            }
-        }
-        RecSize3[1] = load_from_wave(load_file3, &tape3, tape3_size);
-        tape3_size = max(4194304,RecSize3[1]);
-        IOTAR3= RecSize3[1] - int(RecSize3[1]*(100-fclips3)*0.01);
-        save3 = true;
-        gx_system::atomic_set(&ready,1);
-    }
+    load_tape(2, load_file3);
 }
 
 void LiveLooper::load_tape4() {
-    if (!load_file4.empty()) {
-        gx_system::atomic_set(&ready,0);
-        sync();
-        if (cur_name.compare("tape")==0 || save_p) {
-            if (save4) {
-                save_to_wave(loop_dir+cur_name+"4.wav",tape4,rectime3,tape4_size);
-                save4 = false;
-            }
-        }
-        RecSize4[1] = load_from_wave(load_file4, &tape4, tape4_size);
-        tape4_size = max(4194304,RecSize4[1]);
-        IOTAR4= RecSize4[1] - int(RecSize4[1]*(100-fclips4)*0.01);
-        save4 = true;
-        gx_system::atomic_set(&ready,1);
-    }
+    load_tape(3, load_file4);
 }
 
 void LiveLooper::set_p_state() {
@@ -497,6 +890,7 @@ void always_inline LiveLooper::compute(int count, float *input0, float *output0)
         memcpy(output0, input0, count * sizeof(float));
         return;
     }
+    gx_system::atomic_inc(&rt_cycle);
     // trigger save array on exit
     if(record1 || reset1) save1 = true;
     if(record2 || reset2) save2 = true;
@@ -577,7 +971,7 @@ void always_inline LiveLooper::compute(int count, float *input0, float *output0)
         int iTemp3 = fmin(tape1_size-1, (int)(tape1_size - iTemp2));
         if (iSlow3 == 1) {
         IOTA1 = IOTA1>int(iTemp3*iClip1)? iTemp3 - int(iTemp3*iClips1):IOTA1+1;
-        tape1[IOTA1] = fTemp1;
+        tapes[0].put(IOTA1, fTemp1);
         }
         if (rplay1) {
         IOTAR1 = IOTAR1-speed1< (iTemp3 - int(iTemp3*iClips1))? int(iTemp3*iClip1):(IOTAR1-speed1)-1;
@@ -598,7 +992,7 @@ void always_inline LiveLooper::compute(int count, float *input0, float *output0)
         int iTemp7 = fmin(tape2_size-1, (int)(tape2_size - iTemp6));
         if (iSlow6 == 1) {
         IOTA2 = IOTA2>int(iTemp7*iClip2)? iTemp7 - int(iTemp7*iClips2):IOTA2+1;
-        tape2[IOTA2] = fTemp5;
+        tapes[1].put(IOTA2, fTemp5);
         }
         if (rplay2) {
         IOTAR2 = IOTAR2-speed2< (iTemp7 - int(iTemp7*iClips2))? int(iTemp7*iClip2):(IOTAR2-speed2)-1;
@@ -619,7 +1013,7 @@ void always_inline LiveLooper::compute(int count, float *input0, float *output0)
         int iTemp11 = fmin(tape3_size-1, (int)(tape3_size - iTemp10));
         if (iSlow9 == 1) {
         IOTA3 = IOTA3>int(iTemp11*iClip3)? iTemp11 - int(iTemp11*iClips3):IOTA3+1;
-        tape3[IOTA3] = fTemp9;
+        tapes[2].put(IOTA3, fTemp9);
         }
         if (rplay3) {
         IOTAR3 = IOTAR3-speed3< (iTemp11 - int(iTemp11*iClips3))? int(iTemp11*iClip3):(IOTAR3-speed3)-1;
@@ -640,7 +1034,7 @@ void always_inline LiveLooper::compute(int count, float *input0, float *output0)
         int iTemp15 = fmin(tape4_size-1, (int)(tape4_size - iTemp14));
         if (iSlow12 == 1) {
         IOTA4 = IOTA4>int(iTemp15*iClip4)? iTemp15 - int(iTemp15*iClips4):IOTA4+1;
-        tape4[IOTA4] = fTemp13;
+        tapes[3].put(IOTA4, fTemp13);
         }
         if (rplay4) {
         IOTAR4 = IOTAR4-speed4< (iTemp15 - int(iTemp15*iClips4))? int(iTemp15*iClip4):(IOTAR4-speed4)-1;
@@ -653,7 +1047,11 @@ void always_inline LiveLooper::compute(int count, float *input0, float *output0)
         fRec17[0] = fmax(0.0f, fmin(1.0f, (fRec17[1] + fTemp16)));
         iRec18[0] = ((int(((fRec17[1] >= 1.0f) & (iRec19[1] != iTemp15))))?iTemp15:iRec18[1]);
         iRec19[0] = ((int(((fRec17[1] <= 0.0f) & (iRec18[1] != iTemp15))))?iTemp15:iRec19[1]);
-        output0[i] = (float)((fSlow15 * ((fSlow14 * ((fRec17[0] * tape4[int(IOTAR4)]) + ((1.0f - fRec17[0]) * tape4[int(IOTAR4)]))) + ((fSlow11 * ((fRec12[0] * tape3[int(IOTAR3)]) + ((1.0f - fRec12[0]) * tape3[int(IOTAR3)]))) + ((fSlow8 * ((fRec7[0] * tape2[int(IOTAR2)]) + ((1.0f - fRec7[0]) * tape2[int(IOTAR2)]))) + (fSlow5 * ((fRec2[0] * tape1[int(IOTAR1)]) + ((1.0f - fRec2[0]) * tape1[int(IOTAR1)]))))))) + (fTemp0));
+        float fTape1 = tapes[0].get(int(IOTAR1));
+        float fTape2 = tapes[1].get(int(IOTAR2));
+        float fTape3 = tapes[2].get(int(IOTAR3));
+        float fTape4 = tapes[3].get(int(IOTAR4));
+        output0[i] = (float)((fSlow15 * ((fSlow14 * ((fRec17[0] * fTape4) + ((1.0f - fRec17[0]) * fTape4))) + ((fSlow11 * ((fRec12[0] * fTape3) + ((1.0f - fRec12[0]) * fTape3))) + ((fSlow8 * ((fRec7[0] * fTape2) + ((1.0f - fRec7[0]) * fTape2))) + (fSlow5 * ((fRec2[0] * fTape1) + ((1.0f - fRec2[0]) * fTape1))))))) + (fTemp0));
         // post processing
         iRec19[1] = iRec19[0];
         iRec18[1] = iRec18[0];
@@ -681,6 +1079,7 @@ void always_inline LiveLooper::compute(int count, float *input0, float *output0)
         iVec0[1] = iVec0[0];
         fRec0[1] = fRec0[0];
     }
+    gx_system::atomic_inc(&rt_cycle);
 }
 
 void __rt_func LiveLooper::compute_static(int count, float *input0, float *output0, PluginDef *p)
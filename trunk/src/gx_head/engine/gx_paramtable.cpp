@@ -26,6 +26,11 @@
 #include <iostream>
 #endif
 
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
 #include "engine.h"               // NOLINT
 
 namespace gx_engine {
@@ -442,15 +447,13 @@ MidiControllerList::MidiControllerList()
     : map(),
       last_midi_control_value(),
       last_midi_control(-2),
-      program_change(-1),
-      mute_change(-1),
-      bank_change(-1),
-      time0(0),
+      event_queue(),
+      event_write(0),
+      event_read(0),
+      event_fd(eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)),
+      event_conn(),
       bpm_(9),
       mp(),
-      pgm_chg(),
-      mute_chg(),
-      bank_chg(),
       changed(),
       new_program(),
       new_mute_state(),
@@ -459,9 +462,12 @@ MidiControllerList::MidiControllerList()
     for (int i = 0; i < ControllerArray::array_size; ++i) {
 	last_midi_control_value[i] = -1;
     }
-    pgm_chg.connect(sigc::mem_fun(*this, &MidiControllerList::on_pgm_chg));
-    mute_chg.connect(sigc::mem_fun(*this, &MidiControllerList::on_mute_chg));
-    bank_chg.connect(sigc::mem_fun(*this, &MidiControllerList::on_bank_chg));
+    if (event_fd < 0) {
+	gx_print_error("MidiControllerList", _("can't create eventfd for MIDI events"));
+    } else {
+	event_conn = Glib::signal_io().connect(
+	    sigc::mem_fun(*this, &MidiControllerList::on_midi_events), event_fd, Glib::IO_IN);
+    }
     Glib::signal_timeout().connect(
 	sigc::mem_fun(this, &MidiControllerList::check_midi_values), 60);
 }
@@ -500,28 +506,42 @@ void MidiControllerList::update_from_controllers() {
     }
 }
 
-void MidiControllerList::on_pgm_chg() {
-    int pgm;
-    do {
-	pgm = gx_system::atomic_get(program_change);
-    } while (!gx_system::atomic_compare_and_exchange(&program_change, pgm, -1));
-    new_program(pgm);
+MidiControllerList::~MidiControllerList() {
+    event_conn.disconnect();
+    if (event_fd >= 0) {
+	close(event_fd);
+    }
 }
 
-void MidiControllerList::on_mute_chg() {
-    int mute;
-    do {
-	mute = gx_system::atomic_get(mute_change);
-    } while (!gx_system::atomic_compare_and_exchange(&mute_change, mute, -1));
-    new_mute_state(mute);
+// RT: queue an event for the GUI thread, dropped when the queue is full
+inline bool MidiControllerList::post_event(int type, int value) {
+    unsigned int w = event_write;
+    if (w - gx_system::atomic_get(event_read) >= event_queue_size) {
+	return false;
+    }
+    midi_event& ev = event_queue[w & (event_queue_size-1)];
+    ev.type = type;
+    ev.value = value;
+    gx_system::atomic_set(&event_write, w+1);
+    return true;
 }
 
-void MidiControllerList::on_bank_chg() {
-    int bk;
-    do {
-	bk = gx_system::atomic_get(bank_change);
-    } while (!gx_system::atomic_compare_and_exchange(&bank_change, bk, -1));
-    new_bank(bk);
+bool MidiControllerList::on_midi_events(Glib::IOCondition cond) {
+    uint64_t cnt;
+    if (read(event_fd, &cnt, sizeof(cnt)) != sizeof(cnt)) {
+	// spurious wakeup, queue is checked anyway
+    }
+    unsigned int w = gx_system::atomic_get(event_write);
+    for (unsigned int r = event_read; r != w; ++r) {
+	midi_event ev = event_queue[r & (event_queue_size-1)];
+	gx_system::atomic_set(&event_read, r+1);
+	switch (ev.type) {
+	case ev_program: new_program(ev.value); break;
+	case ev_mute:    new_mute_state(ev.value); break;
+	case ev_bank:    new_bank(ev.value); break;
+	}
+    }
+    return true;
 }
 
 void MidiControllerList::set_config_mode(bool mode, int ctl) {
@@ -662,32 +682,28 @@ void MidiControllerList::process_trans(int transport_state) {
 }
 
 // ----- jack process callback for the midi input
-void MidiControllerList::compute_midi_in(void* midi_input_port_buf, void *arg) {
+// period_start: jack frame time of the first frame of this period
+void MidiControllerList::compute_midi_in(void* midi_input_port_buf, unsigned int period_start, unsigned int sr) {
     jack_midi_event_t in_event;
     jack_nframes_t event_count = jack_midi_get_event_count(midi_input_port_buf);
+    bool posted = false;
     unsigned int i;
     for (i = 0; i < event_count; i++) {
         jack_midi_event_get(&in_event, midi_input_port_buf, i);
         if ((in_event.buffer[0] & 0xf0) == 0xc0) {  // program change on any midi channel
-            gx_system::atomic_set(&program_change, in_event.buffer[1]);
-            pgm_chg();
+            posted |= post_event(ev_program, in_event.buffer[1]);
         } else if ((in_event.buffer[0] & 0xf0) == 0xb0) {   // controller
 			if (in_event.buffer[1]== 120) { // engine mute by All Sound Off on any midi channel
-				gx_system::atomic_set(&mute_change, in_event.buffer[2]);
-				 mute_chg();
+				posted |= post_event(ev_mute, in_event.buffer[2]);
 			} else if (in_event.buffer[1]== 32) { // bank change on any midi channel
-				gx_system::atomic_set(&bank_change, in_event.buffer[2]);
-				 bank_chg();
+				posted |= post_event(ev_bank, in_event.buffer[2]);
 			} else {
 				set_ctr_val(in_event.buffer[1], in_event.buffer[2]);
 			}
         } else if ((in_event.buffer[0] ) > 0xf0) {   // midi clock
             if ((in_event.buffer[0] ) == 0xf8) {   // midi beat clock
-                clock_gettime(CLOCK_MONOTONIC, &ts1);
-                gx_jack::GxJack& jack = *static_cast<gx_jack::GxJack*>(arg);
-                static unsigned int sr = jack.get_jack_sr();
-                time0 = (ts1.tv_sec*1000000000.0)+(ts1.tv_nsec)+
-                        (1000000000.0/(double)(sr/(double)in_event.time));
+                // event time in ns on the jack frame clock
+                double time0 = (period_start + in_event.time) * (1000000000.0 / sr);
                 if (mp.time_to_bpm(time0, &bpm_)) {
                     set_bpm_val(bpm_);
                 }
@@ -703,6 +719,12 @@ void MidiControllerList::compute_midi_in(void* midi_input_port_buf, void *arg) {
             }
         }
     }
+    if (posted) {
+        // one wakeup per period for the GUI thread
+        uint64_t one = 1;
+        ssize_t n = write(event_fd, &one, sizeof(one));
+        (void)n;
+    }
 }
 
 /****************************************************************
@@ -1017,7 +1039,8 @@ void FloatParameter::serializeJSON(gx_system::JsonWriter& jw) {
 }
 
 FloatParameter::ParameterV(gx_system::JsonParser& jp)
-    : Parameter(jp_next(jp, "Parameter")), json_value(0), value(&value_storage), std_value(0), lower(), upper(), step() {
+    : Parameter(jp_next(jp, "Parameter")), json_value(0), value(&value_storage), std_value(0), lower(), upper(), step(),
+      update_queue(0), smoothing(0), target(0) {
     while (jp.peek() != gx_system::JsonParser::end_object) {
 	jp.next(gx_system::JsonParser::value_key);
 	if (jp.read_kv("lower", lower) ||
@@ -1039,16 +1062,28 @@ FloatParameter::~ParameterV() {
 
 bool FloatParameter::set(float val) const {
     float v = min(max(val, lower), upper);
-    if (v != *value) {
-	*value = v;
+    if (v != get_value()) {
+	target = v;
+	if (!update_queue || !update_queue->push(const_cast<FloatParameter*>(this), v)) {
+	    *value = v;
+	}
 	changed(v);
 	return true;
     }
     return false;
 }
 
+void FloatParameter::set_smoothing(ParamUpdateQueue *q, float ms) {
+    if (update_queue && !q) {
+	update_queue->forget(this);
+    }
+    target = *value;
+    smoothing = ms;
+    update_queue = q;
+}
+
 bool FloatParameter::on_off_value() {
-    return *value != 0;
+    return get_value() != 0;
 }
 
 float FloatParameter::idx_from_id(string v_id) {
@@ -1073,8 +1108,13 @@ bool FloatParameter::midi_set(float n, float high, float llimit, float ulimit) {
         assert(false);
         return false;
     }
-    if (v != *value) {
-	*value = v;
+    if (v != get_value()) {
+	if (update_queue) {
+	    target = v;
+	    update_queue->midi_ramp(this, v);
+	} else {
+	    *value = v;
+	}
 	return true;
     }
     return false;
@@ -1101,15 +1141,20 @@ bool FloatParameter::midi_set_bpm(float n, float high, float llimit, float ulimi
         assert(false);
         return false;
     }
-    if (v != *value) {
-	*value = v;
+    if (v != get_value()) {
+	if (update_queue) {
+	    target = v;
+	    update_queue->midi_ramp(this, v);
+	} else {
+	    *value = v;
+	}
 	return true;
     }
     return false;
 }
 
 void FloatParameter::trigger_changed() {
-    changed(*value);
+    changed(get_value());
 }
 
 void FloatParameter::stdJSON_value() {
@@ -1117,7 +1162,7 @@ void FloatParameter::stdJSON_value() {
 }
 
 void FloatParameter::writeJSON(gx_system::JsonWriter& jw) const {
-    jw.write_kv(_id.c_str(), *value);
+    jw.write_kv(_id.c_str(), get_value());
 }
 
 void FloatParameter::readJSON_value(gx_system::JsonParser& jp) {
@@ -1130,7 +1175,7 @@ void FloatParameter::readJSON_value(gx_system::JsonParser& jp) {
 }
 
 bool FloatParameter::compareJSON_value() {
-    return abs(json_value - *value) < 5*FLT_EPSILON;
+    return abs(json_value - get_value()) < 5*FLT_EPSILON;
 }
 
 void FloatParameter::setJSON_value() {
@@ -1729,13 +1774,215 @@ void StringParameter::setJSON_value() {
 }
 
 
+/****************************************************************
+ ** Parameter Update Queue
+ */
+
+const float ParamUpdateQueue::default_smoothing = 20.0;
+
+ParamUpdateQueue::ParamUpdateQueue()
+    : events(),
+      write_pos(0),
+      read_pos(0),
+      ramps(),
+      num_ramps(0),
+      active(0),
+      period_ms(0),
+      rt_thread(),
+      sync_sem() {
+    sem_init(&sync_sem, 0, 0);
+}
+
+ParamUpdateQueue::~ParamUpdateQueue() {
+    sem_destroy(&sync_sem);
+}
+
+bool ParamUpdateQueue::put(FloatParameter *p, float v, bool forget) {
+    unsigned int w = write_pos;
+    if (w - gx_system::atomic_get(read_pos) >= queue_size) {
+	return false;
+    }
+    Event& e = events[w & (queue_size-1)];
+    e.param = p;
+    e.value = v;
+    e.forget = forget;
+    gx_system::atomic_set(&write_pos, w+1);
+    return true;
+}
+
+bool ParamUpdateQueue::push(FloatParameter *p, float v) {
+    // when the queue is full the caller falls back to a direct
+    // write; a running ramp for p will end at p->target anyhow
+    if (!gx_system::atomic_get(active)) {
+	return false;
+    }
+    return put(p, v, false);
+}
+
+void ParamUpdateQueue::remove_ramp(FloatParameter *p) {
+    for (int i = 0; i < num_ramps; i++) {
+	if (ramps[i].param == p) {
+	    ramps[i] = ramps[--num_ramps];
+	    return;
+	}
+    }
+}
+
+void ParamUpdateQueue::start_ramp(FloatParameter *p, float v) {
+    int n = 0;
+    if (period_ms > 0) {
+	n = static_cast<int>(p->smoothing / period_ms + 0.5);
+    }
+    Ramp *r = 0;
+    for (int i = 0; i < num_ramps; i++) {
+	if (ramps[i].param == p) {
+	    r = &ramps[i];
+	    break;
+	}
+    }
+    if (n < 1 || (!r && num_ramps == max_ramps)) {
+	if (r) {
+	    remove_ramp(p);
+	}
+	*p->value = v;
+	return;
+    }
+    if (!r) {
+	r = &ramps[num_ramps++];
+	r->param = p;
+    }
+    r->step = (v - *p->value) / n;
+    r->count = n;
+}
+
+// midi controllers are set in the RT thread (midi input) and in the
+// UI thread (preset load, controller assignment); only the RT thread
+// may touch the ramps, the UI thread goes through the queue
+void ParamUpdateQueue::midi_ramp(FloatParameter *p, float v) {
+    if (pthread_equal(pthread_self(), rt_thread)) {
+	start_ramp(p, v);
+    } else if (!push(p, v)) {
+	*p->value = v;
+    }
+}
+
+void ParamUpdateQueue::process(unsigned int nframes, unsigned int samplerate) {
+    period_ms = (1000.0 * nframes) / samplerate;
+    unsigned int w = gx_system::atomic_get(write_pos);
+    unsigned int r = read_pos;
+    bool forgotten = false;
+    for ( ; r != w; r++) {
+	Event& e = events[r & (queue_size-1)];
+	if (e.forget) {
+	    remove_ramp(e.param);
+	    forgotten = true;
+	} else {
+	    start_ramp(e.param, e.value);
+	}
+    }
+    gx_system::atomic_set(&read_pos, r);
+    if (forgotten) {
+	int val;
+	sem_getvalue(&sync_sem, &val);
+	if (val == 0) {
+	    sem_post(&sync_sem);
+	}
+    }
+    for (int i = 0; i < num_ramps; ) {
+	Ramp& rp = ramps[i];
+	if (--rp.count <= 0) {
+	    *rp.param->value = rp.param->target;
+	    rp = ramps[--num_ramps];
+	} else {
+	    *rp.param->value += rp.step;
+	    i++;
+	}
+    }
+}
+
+void ParamUpdateQueue::drain() {
+    // only called when the RT thread doesn't run process()
+    for (unsigned int r = read_pos; r != write_pos; r++) {
+	Event& e = events[r & (queue_size-1)];
+	if (!e.forget) {
+	    *e.param->value = e.param->target;
+	}
+    }
+    read_pos = write_pos;
+    for (int i = 0; i < num_ramps; i++) {
+	*ramps[i].param->value = ramps[i].param->target;
+    }
+    num_ramps = 0;
+}
+
+// on == false: the RT thread must not run process() anymore
+void ParamUpdateQueue::set_active(bool on) {
+    if (!on) {
+	// also after rt_stopped(), which leaves draining to us
+	gx_system::atomic_set(&active, 0);
+	drain();
+    } else if (!gx_system::atomic_get(active)) {
+	period_ms = 0;
+	gx_system::atomic_set(&active, 1);
+    }
+}
+
+// callable from any thread (e.g. jack shutdown callback) when the
+// RT thread is gone; wakes up a waiting forget()
+void ParamUpdateQueue::rt_stopped() {
+    gx_system::atomic_set(&active, 0);
+    sem_post(&sync_sem);
+}
+
+// wait for process() to handle a forget event (or for rt_stopped());
+// the timeout only limits the time until the caller checks again
+void ParamUpdateQueue::wait_rt() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    const long ns_in_sec = 1000000000;
+    ts.tv_nsec += ns_in_sec / 10;
+    if (ts.tv_nsec >= ns_in_sec) {
+	ts.tv_nsec -= ns_in_sec;
+	ts.tv_sec += 1;
+    }
+    while (sem_timedwait(&sync_sem, &ts) == -1 && errno == EINTR);
+}
+
+void ParamUpdateQueue::forget(FloatParameter *p) {
+    // make sure the RT thread holds no reference to p before
+    // the parameter gets deleted: queue a forget event and wait
+    // until process() has handled it
+    unsigned int w = 0;
+    bool queued = false;
+    while (gx_system::atomic_get(active)) {
+	if (!queued) {
+	    // a full queue is emptied by the next period
+	    queued = put(p, 0, true);
+	    w = write_pos;
+	} else if (static_cast<int>(gx_system::atomic_get(read_pos) - w) >= 0) {
+	    return;
+	}
+	wait_rt();
+    }
+    // RT thread not running
+    for (unsigned int r = read_pos; r != write_pos; r++) {
+	Event& e = events[r & (queue_size-1)];
+	if (e.param == p) {
+	    e.forget = true;
+	}
+    }
+    remove_ramp(p);
+}
+
+
 /****************************************************************
  ** Parameter Map
  */
 
 ParamMap::ParamMap()
     : id_map(),
-      replace_mode(false) {
+      replace_mode(false),
+      update_queue() {
 }
 
 ParamMap::~ParamMap() {
@@ -1933,6 +2180,9 @@ void ParamMap::unregister(Parameter *p) {
     if (!p) {
 	return;
     }
+    if (p->isFloat() && p->getFloat().is_smoothed()) {
+	update_queue.forget(&p->getFloat());
+    }
     insert_remove(p, false);
     id_map.erase(p->id());
     delete p;
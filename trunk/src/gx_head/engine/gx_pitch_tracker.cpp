@@ -21,6 +21,9 @@
 /* ------- This is the guitarix tuner, part of gx_engine_audio.cpp ------- */
 
 #include "engine.h"
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 
 /****************************************************************
  ** Pitch Tracker
@@ -28,6 +31,16 @@
  ** some code and ideas taken from K4Guitune (William Spinelli)
  ** changed to NSDF method (some code from tartini / Philip McLeod)
  **
+ ** the audio thread only fills a ring buffer, the tracker thread
+ ** copies the analysis window out of it
+ **
+ ** the autocorrelation is updated per block: the window is split
+ ** into blocks, and for each block distance the cross spectra of
+ ** all block pairs in the window are kept as a running sum. A new
+ ** block adds its pairs and removes those of the block leaving the
+ ** window, which costs one small FFT and O(lags) operations. The
+ ** FFT of the whole window is only used as fallback.
+ **
  */
 
 namespace gx_engine {
@@ -36,9 +49,22 @@ namespace gx_engine {
 static const int DOWNSAMPLE = 2;
 static const float SIGNAL_THRESHOLD_ON = 0.001;
 static const float SIGNAL_THRESHOLD_OFF = 0.0009;
-static const float TRACKER_PERIOD = 0.1;
+static const float TRACKER_PERIOD = 0.025;
 // The size of the read buffer
 static const int FFT_SIZE = 2048;
+// ring buffer: analysis window plus room for the blocks the audio
+// thread writes while the tracker thread copies the window
+static const int RING_SIZE = 4 * FFT_SIZE;
+// block size of the incremental autocorrelation
+static const int BLOCK_SIZE = 128;
+static const int MAX_BLOCKS = FFT_SIZE / BLOCK_SIZE;
+// block distances needed for lags up to FFT_SIZE/2
+static const int MAX_PARTS = ((FFT_SIZE+1) / 2 - 1) / BLOCK_SIZE + 2;
+// spectrum of a zero-padded block: real parts, then imaginary parts
+static const int SPEC_SIZE = 2 * (BLOCK_SIZE + 1);
+// time (in seconds) after which the incremental autocorrelation is
+// seeded again to get rid of accumulated rounding errors
+static const float FULL_PERIOD = 1.0;
 
 
 void *PitchTracker::static_run(void *p) {
@@ -54,31 +80,50 @@ PitchTracker::PitchTracker()
       resamp(),
       m_sampleRate(),
       m_freq(-1),
+      m_confidence(0),
       signal_threshold_on(SIGNAL_THRESHOLD_ON),
       signal_threshold_off(SIGNAL_THRESHOLD_OFF),
       tracker_period(TRACKER_PERIOD),
       m_buffersize(),
       m_fftSize(),
-      m_buffer(new float[FFT_SIZE]),
+      m_buffer(new float[RING_SIZE]),
       m_bufferIndex(0),
+      m_written(0),
+      m_maxBlock(0),
       m_input(new float[FFT_SIZE]),
+      m_nblocks(0),
+      m_nparts(0),
+      m_processed(0),
+      m_sinceFull(0),
+      m_blocks(0),
+      m_blockPos(0),
+      m_corrValid(false),
+      m_spectra(new float[(MAX_BLOCKS+1) * SPEC_SIZE]),
+      m_parts(new float[MAX_PARTS * SPEC_SIZE]),
+      m_corr(new float[MAX_PARTS * BLOCK_SIZE]),
       m_audioLevel(false),
       m_fftwPlanFFT(0),
-      m_fftwPlanIFFT(0) {
+      m_fftwPlanIFFT(0),
+      m_fftwPlanBlock(0),
+      m_fftwPlanBlockInv(0) {
     const int size = FFT_SIZE + (FFT_SIZE+1) / 2;
     m_fftwBufferTime = reinterpret_cast<float*>
                        (fftwf_malloc(size * sizeof(*m_fftwBufferTime)));
     m_fftwBufferFreq = reinterpret_cast<float*>
                        (fftwf_malloc(size * sizeof(*m_fftwBufferFreq)));
 
-    memset(m_buffer, 0, FFT_SIZE * sizeof(*m_buffer));
+    memset(m_buffer, 0, RING_SIZE * sizeof(*m_buffer));
     memset(m_input, 0, FFT_SIZE * sizeof(*m_input));
+    memset(m_spectra, 0, (MAX_BLOCKS+1) * SPEC_SIZE * sizeof(*m_spectra));
+    memset(m_parts, 0, MAX_PARTS * SPEC_SIZE * sizeof(*m_parts));
+    memset(m_corr, 0, MAX_PARTS * BLOCK_SIZE * sizeof(*m_corr));
     memset(m_fftwBufferTime, 0, size * sizeof(*m_fftwBufferTime));
     memset(m_fftwBufferFreq, 0, size * sizeof(*m_fftwBufferFreq));
 
     sem_init(&m_trig, 0, 0);
 
-    if (!m_buffer || !m_input || !m_fftwBufferTime || !m_fftwBufferFreq) {
+    if (!m_buffer || !m_input || !m_spectra || !m_parts || !m_corr
+        || !m_fftwBufferTime || !m_fftwBufferFreq) {
 	gx_print_error("PitchTracker", "out of memory");
         error = true;
     }
@@ -89,8 +134,13 @@ PitchTracker::~PitchTracker() {
     stop_thread();
     fftwf_destroy_plan(m_fftwPlanFFT);
     fftwf_destroy_plan(m_fftwPlanIFFT);
+    fftwf_destroy_plan(m_fftwPlanBlock);
+    fftwf_destroy_plan(m_fftwPlanBlockInv);
     fftwf_free(m_fftwBufferTime);
     fftwf_free(m_fftwBufferFreq);
+    delete[] m_corr;
+    delete[] m_parts;
+    delete[] m_spectra;
     delete[] m_input;
     delete[] m_buffer;
 }
@@ -99,7 +149,7 @@ void PitchTracker::set_fast_note_detection(bool v) {
     if (v) {
 	signal_threshold_on = SIGNAL_THRESHOLD_ON * 5;
 	signal_threshold_off = SIGNAL_THRESHOLD_OFF * 5;
-	tracker_period = TRACKER_PERIOD / 10;
+	tracker_period = TRACKER_PERIOD / 4;
     } else {
 	signal_threshold_on = SIGNAL_THRESHOLD_ON;
 	signal_threshold_off = SIGNAL_THRESHOLD_OFF;
@@ -127,9 +177,24 @@ bool PitchTracker::setParameters(int priority, int policy, int sampleRate, int b
         m_fftwPlanIFFT = fftwf_plan_r2r_1d(
                              m_fftSize, m_fftwBufferFreq, m_fftwBufferTime,
                              FFTW_HC2R, FFTW_ESTIMATE);
+        m_nparts = ((m_buffersize+1) / 2 - 1) / BLOCK_SIZE + 2;
+        if (m_buffersize % BLOCK_SIZE == 0 && m_nparts <= m_buffersize / BLOCK_SIZE) {
+            m_nblocks = m_buffersize / BLOCK_SIZE;
+        } else {
+            m_nblocks = 0;
+        }
+        m_corrValid = false;
+    }
+    if (!m_fftwPlanBlock) {
+        m_fftwPlanBlock = fftwf_plan_r2r_1d(
+                            2 * BLOCK_SIZE, m_fftwBufferTime, m_fftwBufferFreq,
+                            FFTW_R2HC, FFTW_ESTIMATE);
+        m_fftwPlanBlockInv = fftwf_plan_r2r_1d(
+                             2 * BLOCK_SIZE, m_fftwBufferFreq, m_fftwBufferTime,
+                             FFTW_HC2R, FFTW_ESTIMATE);
     }
 
-    if (!m_fftwPlanFFT || !m_fftwPlanIFFT) {
+    if (!m_fftwPlanFFT || !m_fftwPlanIFFT || !m_fftwPlanBlock || !m_fftwPlanBlockInv) {
         error = true;
 	gx_print_error("PitchTracker", "can't allocate FFTW plan");
         return false;
@@ -184,51 +249,63 @@ void PitchTracker::init(int priority, int policy, unsigned int samplerate) {
 void PitchTracker::reset() {
     tick = 0;
     m_bufferIndex = 0;
+    gx_system::atomic_set(&m_written, 0);
+    m_maxBlock = 0;
     resamp.reset();
     m_freq = -1;
+    m_confidence = 0;
 }
 
 void PitchTracker::add(int count, float* input) {
     if (error) {
         return;
     }
+    unsigned int written = m_written;
     resamp.inp_count = count;
     resamp.inp_data = input;
     for (;;) {
         resamp.out_data = &m_buffer[m_bufferIndex];
-        int n = FFT_SIZE - m_bufferIndex;
+        int n = RING_SIZE - m_bufferIndex;
         resamp.out_count = n;
         resamp.process();
         n -= resamp.out_count; // n := number of output samples
-        if (!n) { // all soaked up by filter
-            return;
+        if (!n) {
+            break;
         }
-        m_bufferIndex = (m_bufferIndex + n) % FFT_SIZE;
+        m_bufferIndex = (m_bufferIndex + n) % RING_SIZE;
+        written += n;
         if (resamp.inp_count == 0) {
             break;
         }
     }
+    if (written == m_written) { // all soaked up by filter
+        return;
+    }
+    if (written - m_written > m_maxBlock) {
+        m_maxBlock = written - m_written;
+    }
+    gx_system::atomic_set(&m_written, written);
     if (++tick * count >= m_sampleRate * DOWNSAMPLE * tracker_period) {
         if (busy) {
             return;
         }
         busy = true;
         tick = 0;
-        copy();
         sem_post(&m_trig);
     }
 }
 
-void PitchTracker::copy() {
-    int start = (FFT_SIZE + m_bufferIndex - m_buffersize) % FFT_SIZE;
-    int end = (FFT_SIZE + m_bufferIndex) % FFT_SIZE;
-    int cnt = 0;
-    if (start >= end) {
-        cnt = FFT_SIZE - start;
-        memcpy(m_input, &m_buffer[start], cnt * sizeof(*m_input));
-        start = 0;
-    }
-    memcpy(&m_input[cnt], &m_buffer[start], (end - start) * sizeof(*m_input));
+// copy len samples starting at first into dst; returns false if
+// the audio thread might have overwritten some of them meanwhile.
+// The audio thread fills the buffer before it publishes m_written,
+// so one block more than published may already be overwritten.
+bool PitchTracker::copy(unsigned int first, int len, float *dst) {
+    int start = first % RING_SIZE;
+    int cnt = min(len, RING_SIZE - start);
+    memcpy(dst, &m_buffer[start], cnt * sizeof(*dst));
+    memcpy(&dst[cnt], m_buffer, (len - cnt) * sizeof(*dst));
+    return (gx_system::atomic_get(m_written) - first + m_maxBlock
+            <= static_cast<unsigned int>(RING_SIZE));
 }
 
 inline float sq(float x) {
@@ -318,6 +395,119 @@ static int findsubMaximum(float *input, int len, float threshold) {
     return -1;
 }
 
+// acc += sign * a * conj(b) for n complex values
+// (spectra with real and imaginary parts SPEC_SIZE/2 apart)
+static inline void cmac_conj(float *acc, const float *a, const float *b, int n, float sign) {
+    const int im = SPEC_SIZE / 2;
+    int k = 0;
+#if defined(__SSE__)
+    {
+        const __m128 s = _mm_set1_ps(sign);
+        for (; k <= n-4; k += 4) {
+            __m128 ar = _mm_loadu_ps(a+k);
+            __m128 ai = _mm_loadu_ps(a+im+k);
+            __m128 br = _mm_mul_ps(s, _mm_loadu_ps(b+k));
+            __m128 bi = _mm_mul_ps(s, _mm_loadu_ps(b+im+k));
+            _mm_storeu_ps(acc+k, _mm_add_ps(_mm_loadu_ps(acc+k),
+                          _mm_add_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi))));
+            _mm_storeu_ps(acc+im+k, _mm_add_ps(_mm_loadu_ps(acc+im+k),
+                          _mm_sub_ps(_mm_mul_ps(ai, br), _mm_mul_ps(ar, bi))));
+        }
+    }
+#endif
+    for (; k < n; k++) {
+        float br = sign * b[k];
+        float bi = sign * b[im+k];
+        acc[k] += a[k] * br + a[im+k] * bi;
+        acc[im+k] += a[im+k] * br - a[k] * bi;
+    }
+}
+
+// autocorrelation of the window in m_input via FFT (fallback when
+// the window is no multiple of the block size); the result for lag
+// k+1 is in m_fftwBufferTime[k]
+void PitchTracker::fft_correlation() {
+    memcpy(m_fftwBufferTime, m_input, m_buffersize * sizeof(*m_fftwBufferTime));
+    memset(m_fftwBufferTime+m_buffersize, 0, (m_fftSize - m_buffersize) * sizeof(*m_fftwBufferTime));
+    fftwf_execute(m_fftwPlanFFT);
+    for (int k = 1; k < m_fftSize/2; k++) {
+        m_fftwBufferFreq[k] = sq(m_fftwBufferFreq[k]) + sq(m_fftwBufferFreq[m_fftSize-k]);
+        m_fftwBufferFreq[m_fftSize-k] = 0.0;
+    }
+    m_fftwBufferFreq[0] = sq(m_fftwBufferFreq[0]);
+    m_fftwBufferFreq[m_fftSize/2] = sq(m_fftwBufferFreq[m_fftSize/2]);
+
+    fftwf_execute(m_fftwPlanIFFT);
+
+    for (int k = 0; k < m_fftSize - m_buffersize; k++) {
+        m_fftwBufferTime[k] = m_fftwBufferTime[k+1] / static_cast<float>(m_fftSize);
+    }
+}
+
+// add one block to the incremental correlation; when the window is
+// full, the pairs of the oldest block are removed
+void PitchTracker::add_block(const float *block) {
+    memcpy(m_fftwBufferTime, block, BLOCK_SIZE * sizeof(*m_fftwBufferTime));
+    memset(m_fftwBufferTime+BLOCK_SIZE, 0, BLOCK_SIZE * sizeof(*m_fftwBufferTime));
+    fftwf_execute(m_fftwPlanBlock);
+    // halfcomplex -> real and imaginary parts
+    const int ring = m_nblocks + 1;
+    float *x = m_spectra + m_blockPos * SPEC_SIZE;
+    float *xi = x + SPEC_SIZE / 2;
+    x[0] = m_fftwBufferFreq[0];
+    xi[0] = 0.0;
+    for (int k = 1; k < BLOCK_SIZE; k++) {
+        x[k] = m_fftwBufferFreq[k];
+        xi[k] = m_fftwBufferFreq[2*BLOCK_SIZE-k];
+    }
+    x[BLOCK_SIZE] = m_fftwBufferFreq[BLOCK_SIZE];
+    xi[BLOCK_SIZE] = 0.0;
+
+    if (m_blocks == m_nblocks) {
+        int old = (m_blockPos + 1) % ring;
+        for (int k = 0; k < m_nparts; k++) {
+            cmac_conj(m_parts + k * SPEC_SIZE, m_spectra + ((old + k) % ring) * SPEC_SIZE,
+                      m_spectra + old * SPEC_SIZE, BLOCK_SIZE+1, -1.0);
+        }
+        m_blocks--;
+    }
+    for (int k = 0; k < m_nparts && k <= m_blocks; k++) {
+        cmac_conj(m_parts + k * SPEC_SIZE, x,
+                  m_spectra + ((m_blockPos + ring - k) % ring) * SPEC_SIZE, BLOCK_SIZE+1, 1.0);
+    }
+    m_blocks++;
+    m_blockPos = (m_blockPos + 1) % ring;
+}
+
+// assemble the autocorrelation of the window from the running sums:
+// block distance k contributes to the lags (k-1)*BLOCK_SIZE+1 ..
+// (k+1)*BLOCK_SIZE-1, the result for lag k is in m_corr[k]
+void PitchTracker::block_correlation() {
+    const float norm = 1.0 / (2 * BLOCK_SIZE);
+    memset(m_corr, 0, m_nparts * BLOCK_SIZE * sizeof(*m_corr));
+    for (int k = 0; k < m_nparts; k++) {
+        const float *p = m_parts + k * SPEC_SIZE;
+        const float *pi = p + SPEC_SIZE / 2;
+        m_fftwBufferFreq[0] = p[0];
+        for (int j = 1; j < BLOCK_SIZE; j++) {
+            m_fftwBufferFreq[j] = p[j];
+            m_fftwBufferFreq[2*BLOCK_SIZE-j] = pi[j];
+        }
+        m_fftwBufferFreq[BLOCK_SIZE] = p[BLOCK_SIZE];
+        fftwf_execute(m_fftwPlanBlockInv);
+        float *c = m_corr + k * BLOCK_SIZE;
+        for (int j = 0; j < BLOCK_SIZE; j++) {
+            c[j] += norm * m_fftwBufferTime[j];
+        }
+        if (k > 0) {
+            c -= BLOCK_SIZE;
+            for (int j = 0; j < BLOCK_SIZE; j++) {
+                c[j] += norm * m_fftwBufferTime[BLOCK_SIZE+j];
+            }
+        }
+    }
+}
+
 void PitchTracker::run() {
     for (;;) {
         busy = false;
@@ -325,13 +515,42 @@ void PitchTracker::run() {
         if (error) {
             continue;
         }
+        unsigned int end = gx_system::atomic_get(m_written);
+        if (m_nblocks) {
+            // complete blocks since the last run
+            unsigned int pending = end - m_processed;
+            pending -= pending % BLOCK_SIZE;
+            if (!m_corrValid || pending > static_cast<unsigned int>(m_buffersize)
+                || m_sinceFull >= m_sampleRate * FULL_PERIOD) {
+                // (re)seed: push all blocks of the current window
+                m_processed = end - m_buffersize;
+                m_sinceFull = 0;
+                m_blocks = 0;
+                m_blockPos = 0;
+                memset(m_parts, 0, m_nparts * SPEC_SIZE * sizeof(*m_parts));
+            } else if (pending == 0) {
+                continue;
+            } else {
+                end = m_processed + pending;
+            }
+        }
+        if (!copy(end - m_buffersize, m_buffersize, m_input)) {
+            m_corrValid = false;
+            continue;
+        }
         float sum = 0.0;
+        double sumSq = 0.0;
         for (int k = 0; k < m_buffersize; ++k) {
             sum += fabs(m_input[k]);
+            sumSq += sq(m_input[k]);
         }
         float threshold = (m_audioLevel ? signal_threshold_off : signal_threshold_on);
         m_audioLevel = (sum / m_buffersize >= threshold);
         if ( m_audioLevel == false ) {
+            // no need to follow the signal, seed
+            // again when it comes back
+            m_corrValid = false;
+            m_confidence = 0;
 	    if (m_freq != 0) {
 		m_freq = 0;
 		new_freq();
@@ -339,47 +558,51 @@ void PitchTracker::run() {
             continue;
         }
 
-        memcpy(m_fftwBufferTime, m_input, m_buffersize * sizeof(*m_fftwBufferTime));
-        memset(m_fftwBufferTime+m_buffersize, 0, (m_fftSize - m_buffersize) * sizeof(*m_fftwBufferTime));
-        fftwf_execute(m_fftwPlanFFT);
-        for (int k = 1; k < m_fftSize/2; k++) {
-            m_fftwBufferFreq[k] = sq(m_fftwBufferFreq[k]) + sq(m_fftwBufferFreq[m_fftSize-k]);
-            m_fftwBufferFreq[m_fftSize-k] = 0.0;
-        }
-        m_fftwBufferFreq[0] = sq(m_fftwBufferFreq[0]);
-        m_fftwBufferFreq[m_fftSize/2] = sq(m_fftwBufferFreq[m_fftSize/2]);
-
-        fftwf_execute(m_fftwPlanIFFT);
-
-        double sumSq = 2.0 * static_cast<double>(m_fftwBufferTime[0]) / static_cast<double>(m_fftSize);
-        for (int k = 0; k < m_fftSize - m_buffersize; k++) {
-            m_fftwBufferTime[k] = m_fftwBufferTime[k+1] / static_cast<float>(m_fftSize);
+        // nsdf[k]: normalized square difference function for lag k+1
+        float *nsdf;
+        if (m_nblocks) {
+            for (unsigned int n = end - m_processed; n > 0; n -= BLOCK_SIZE) {
+                add_block(m_input + m_buffersize - n);
+            }
+            m_sinceFull += end - m_processed;
+            m_processed = end;
+            m_corrValid = true;
+            block_correlation();
+            nsdf = m_corr + 1;
+        } else {
+            fft_correlation();
+            nsdf = m_fftwBufferTime;
         }
 
+        sumSq *= 2.0;
         int count = (m_buffersize + 1) / 2;
         for (int k = 0; k < count; k++) {
             sumSq  -= sq(m_input[m_buffersize-1-k]) + sq(m_input[k]);
             // dividing by zero is very slow, so deal with it seperately
             if (sumSq > 0.0) {
-                m_fftwBufferTime[k] *= 2.0 / sumSq;
+                nsdf[k] *= 2.0 / sumSq;
             } else {
-                m_fftwBufferTime[k] = 0.0;
+                nsdf[k] = 0.0;
             }
         }
 	const float thres = 0.99; // was 0.6
-        int maxAutocorrIndex = findsubMaximum(m_fftwBufferTime, count, thres);
+        int maxAutocorrIndex = findsubMaximum(nsdf, count, thres);
 
         float x = 0.0;
+        float confidence = 0.0;
         if (maxAutocorrIndex >= 0) {
-            parabolaTurningPoint(m_fftwBufferTime[maxAutocorrIndex-1],
-                                 m_fftwBufferTime[maxAutocorrIndex],
-                                 m_fftwBufferTime[maxAutocorrIndex+1],
+            parabolaTurningPoint(nsdf[maxAutocorrIndex-1],
+                                 nsdf[maxAutocorrIndex],
+                                 nsdf[maxAutocorrIndex+1],
                                  maxAutocorrIndex+1, &x);
             x = m_sampleRate / x;
             if (x > 999.0) {  // precision drops above 1000 Hz
                 x = 0.0;
+            } else {
+                confidence = max(0.0f, min(1.0f, nsdf[maxAutocorrIndex]));
             }
         }
+        m_confidence = confidence;
 	if (m_freq != x) {
 	    m_freq = x;
 	    new_freq();
@@ -23,6 +23,74 @@
 
 namespace gx_engine {
 
+/****************************************************************
+ ** class PluginLoad
+ */
+
+void PluginLoad::Accum::reset() {
+    count = 0;
+    minimum = ~0U;
+    maximum = 0;
+    sum = 0;
+    end = 0;
+    memset(hist, 0, sizeof(hist));
+}
+
+PluginLoad::PluginLoad()
+    : work(),
+      window_start(0),
+      snap(),
+      seq(0) {
+    work.reset();
+    snap[0].reset();
+    snap[1].reset();
+}
+
+// lower limit of histogram bucket b in microseconds
+float PluginLoad::bucket_limit(int b) {
+    if (b < 4) {
+	return b * 64 * 1e-3;
+    }
+    int msb = (b >> 2) + 1;
+    return ((4 | (b & 3)) << (msb - 2)) * 64 * 1e-3;
+}
+
+bool PluginLoad::get(PluginLoadInfo& info) {
+    Accum a;
+    // the rt thread writes the other slot and only reuses this one
+    // after the next publication, so the copy is consistent if the
+    // sequence number didn't change meanwhile
+    while (true) {
+	int s = gx_system::atomic_get(seq);
+	a = snap[s & 1];
+	if (gx_system::atomic_get(seq) == s) {
+	    break;
+	}
+    }
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (!a.count || to_ns(ts) - a.end > 2 * window_ns) {
+	info.count = 0;
+	return false; // not running (anymore)
+    }
+    info.count = a.count;
+    info.mean = a.sum * 1e-3 / a.count;
+    info.minimum = a.minimum * 1e-3;
+    info.maximum = a.maximum * 1e-3;
+    unsigned int limit = a.count - a.count / 100;
+    unsigned int n = 0;
+    int b;
+    for (b = 0; b < bucket_count-1; b++) {
+	n += a.hist[b];
+	if (n >= limit) {
+	    break;
+	}
+    }
+    info.p99 = min(bucket_limit(b+1), info.maximum);
+    return true;
+}
+
+
 /****************************************************************
  ** class ParamRegImpl
  */
@@ -80,6 +148,10 @@ float *ParamRegImpl::registerVar_(const char* id, const char* name, const char*
     } else {
 	assert(false);
     }
+    if (tp[i] == 'Z') { // ramp value changes in the RT thread
+	p->getFloat().set_smoothing(&pmap->get_update_queue(), ParamUpdateQueue::default_smoothing);
+	i++;
+    }
     if (tp[i] == 'O') {
 	p->setSavable(false);
     }
@@ -179,10 +251,18 @@ Plugin::Plugin(PluginDef *pl)
       p_plug_visible(0),
       p_on_off(0),
       p_position(0),
-      p_effect_post_pre(0) {
+      p_effect_post_pre(0),
+      p_oversample(0),
+      oversampler(0),
+      load(),
+      rec_track(0) {
     set_pdef(pl);
 }
 
+Plugin::~Plugin() {
+    delete oversampler;
+}
+
 static void delete_plugindef_instance(PluginDef *p) {
     free((void*)(p->id));
     free((void*)(p->name));
@@ -204,7 +284,11 @@ Plugin::Plugin(gx_system::JsonParser& jp, ParamMap& pmap)
       p_plug_visible(0),
       p_on_off(0),
       p_position(0),
-      p_effect_post_pre(0) {
+      p_effect_post_pre(0),
+      p_oversample(0),
+      oversampler(0),
+      load(),
+      rec_track(0) {
     PluginDef *p = new PluginDef();
     p->delete_instance = delete_plugindef_instance;
     jp.next(gx_system::JsonParser::begin_object);
@@ -257,6 +341,10 @@ Plugin::Plugin(gx_system::JsonParser& jp, ParamMap& pmap)
     p_on_off = &pmap[s+".on_off"].getBool();
     p_position = &pmap[s+".position"].getInt();
     p_effect_post_pre = &pmap[s+".pp"].getInt();
+    id = s+".oversample";
+    if (pmap.hasId(id)) {
+	p_oversample = &pmap[id].getInt();
+    }
     set_pdef(p);
 }
 
@@ -327,6 +415,25 @@ void Plugin::register_vars(ParamMap& param, EngineControl& seq) {
 	p_effect_post_pre->signal_changed_int().connect(
 	    sigc::hide(sigc::mem_fun(seq, &EngineControl::set_rack_changed)));
     }
+    if (pdef->flags & PGN_OVERSAMPLE) {
+	// the new factor is applied by the next chain commit
+	static const value_pair oversample_values[] = {{N_("off")}, {N_("2x")}, {N_("4x")}, {0}};
+	p_oversample = param.reg_enum_par(s + ".oversample", N_("Oversampling"), oversample_values, (int*)0, 0);
+	p_oversample->signal_changed_int().connect(
+	    sigc::hide(sigc::mem_fun(seq, &EngineControl::set_rack_changed)));
+	if (!oversampler) {
+	    oversampler = new gx_resample::Oversampler();
+	}
+    }
+}
+
+// called with the processing chain of the plugin stopped or ramped down
+void Plugin::update_oversample(unsigned int samplerate) {
+    int factor = 1 << p_oversample->get_value();
+    oversampler->setup(factor, pdef->stereo_audio ? 2 : 1);
+    if (samplerate && pdef->set_samplerate) {
+	pdef->set_samplerate(samplerate * factor, pdef);
+    }
 }
 
 void Plugin::copy_position(const Plugin& plugin) {
@@ -643,6 +750,7 @@ void PluginList::unregisterParameter(Plugin *pl, ParamMap& param) {
     param.unregister(pl->p_box_visible);
     param.unregister(pl->p_plug_visible);
     param.unregister(pl->p_effect_post_pre);
+    param.unregister(pl->p_oversample);
     std::vector<const std::string*> l;
     if (pd->register_params) {
 	string s = pd->id;
@@ -751,7 +859,7 @@ void PluginList::set_samplerate(int samplerate) {
     for (pluginmap::iterator p = pmap.begin(); p != pmap.end(); p++) {
 	inifunc f = p->second->get_pdef()->set_samplerate;
 	if (f) {
-	    f(samplerate, p->second->get_pdef());
+	    f(samplerate * p->second->get_oversample(), p->second->get_pdef());
 	}
     }
 }
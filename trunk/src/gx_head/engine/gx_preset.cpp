@@ -46,17 +46,170 @@ PresetIO::PresetIO(gx_engine::MidiControllerList& mctrl_,
       opt(opt_),
       plist(),
       m(0),
-      rack_units(rack_units_) {
+      rack_units(rack_units_),
+      compiled_banks(),
+      snapshot(0) {
+    // snapshots hold Parameter pointers
+    param.signal_insert_remove().connect(
+	sigc::mem_fun(*this, &PresetIO::on_param_insert_remove));
 }
 
 PresetIO::~PresetIO() {
     clear();
+    clear_snapshots();
 }
 
 void PresetIO::clear() {
     plist.clear();
     delete m;
     m = 0;
+    snapshot = 0;
+}
+
+CompiledBank::~CompiledBank() {
+    for (std::map<Glib::ustring, PresetSnapshot*>::iterator i = presets.begin(); i != presets.end(); ++i) {
+	delete i->second;
+    }
+}
+
+void PresetIO::clear_snapshots() {
+    snapshot = 0;
+    for (std::map<std::string, CompiledBank*>::iterator i = compiled_banks.begin(); i != compiled_banks.end(); ++i) {
+	delete i->second;
+    }
+    compiled_banks.clear();
+}
+
+FileStamp::FileStamp(const std::string& filename)
+    : mtime(), ctime(), size(0) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+	return;
+    }
+    mtime = st.st_mtim;
+    ctime = st.st_ctim;
+    size = st.st_size;
+}
+
+bool FileStamp::operator==(const FileStamp& f) const {
+    return (mtime.tv_sec == f.mtime.tv_sec && mtime.tv_nsec == f.mtime.tv_nsec
+	    && ctime.tv_sec == f.ctime.tv_sec && ctime.tv_nsec == f.ctime.tv_nsec
+	    && size == f.size);
+}
+
+bool PresetIO::take_snapshot(PresetSnapshot& s) {
+    for (gx_engine::paramlist::iterator i = plist.begin(); i != plist.end(); ++i) {
+	gx_engine::Parameter *p = *i;
+	if (p->isFloat()) {
+	    s.values.push_back(PresetSnapshot::Value(p, p->getFloat().get_json_value()));
+	} else if (p->isInt()) {
+	    s.values.push_back(PresetSnapshot::Value(p, p->getInt().get_json_value()));
+	} else if (p->isBool()) {
+	    s.values.push_back(PresetSnapshot::Value(p, p->getBool().get_json_value()));
+	} else {
+	    gx_engine::JConvParameter *jp = dynamic_cast<gx_engine::JConvParameter*>(p);
+	    if (!jp) {
+		return false; // not supported, use the json path
+	    }
+	    s.values.push_back(PresetSnapshot::Value(p, s.jconv.size()));
+	    s.jconv.push_back(jp->get_json_value());
+	}
+    }
+    s.midi = m;
+    m = 0;
+    s.mono = rack_units.mono;
+    s.stereo = rack_units.stereo;
+    return true;
+}
+
+void PresetIO::compile_presets(gx_system::PresetFile& pf, CompiledBank& cb) {
+    // read_parameters() sets the rack unit order as side effect
+    std::vector<std::string> mono = rack_units.mono;
+    std::vector<std::string> stereo = rack_units.stereo;
+    cb.stamp = FileStamp(pf.get_filename());
+    cb.midi_in_preset = midi_in_preset();
+    for (int n = 0; n < pf.size(); n++) {
+	gx_system::JsonParser *jp = 0;
+	try {
+	    jp = pf.create_reader(n);
+	    read_preset(*jp, pf.get_header());
+	    PresetSnapshot *s = new PresetSnapshot();
+	    if (take_snapshot(*s)) {
+		cb.presets[pf.get_name(n)] = s;
+	    } else {
+		delete s;
+	    }
+	} catch (gx_system::JsonException& e) {
+	    // not compiled, error will be reported when loaded
+	}
+	delete jp;
+	clear();
+    }
+    rack_units.mono = mono;
+    rack_units.stereo = stereo;
+}
+
+bool PresetIO::is_current(const std::string& filename, const CompiledBank& cb) {
+    return cb.stamp == FileStamp(filename) && cb.midi_in_preset == midi_in_preset();
+}
+
+// compiles all presets of the bank (scratch banks are rewritten on
+// every preset change and always use the json path)
+void PresetIO::compile_bank(gx_system::PresetFile& pf) {
+    const std::string& fn = pf.get_filename();
+    if (fn.empty() || pf.get_type() == gx_system::PresetFile::PRESET_SCRATCH) {
+	return;
+    }
+    CompiledBank*& cb = compiled_banks[fn];
+    if (cb && is_current(fn, *cb)) {
+	return;
+    }
+    delete cb;
+    cb = new CompiledBank();
+    compile_presets(pf, *cb);
+}
+
+// only uses an already compiled bank, so the preset switch never
+// waits for a whole bank to be parsed; stale or missing banks fall
+// back to the json path until compile_bank() is called again
+bool PresetIO::read_snapshot(gx_system::PresetFile& pf, const Glib::ustring& name) {
+    clear();
+    std::map<std::string, CompiledBank*>::iterator b = compiled_banks.find(pf.get_filename());
+    if (b == compiled_banks.end()) {
+	return false;
+    }
+    CompiledBank *cb = b->second;
+    if (!is_current(b->first, *cb)) {
+	delete cb;
+	compiled_banks.erase(b);
+	return false;
+    }
+    std::map<Glib::ustring, PresetSnapshot*>::iterator i = cb->presets.find(name);
+    if (i == cb->presets.end()) {
+	return false;
+    }
+    snapshot = i->second;
+    rack_units.mono = snapshot->mono;
+    rack_units.stereo = snapshot->stereo;
+    return true;
+}
+
+void PresetIO::apply_snapshot(const PresetSnapshot& s) {
+    for (std::vector<PresetSnapshot::Value>::const_iterator i = s.values.begin(); i != s.values.end(); ++i) {
+	gx_engine::Parameter *p = i->param;
+	if (p->isFloat()) {
+	    p->getFloat().set(i->value);
+	} else if (p->isInt()) {
+	    p->getInt().set(static_cast<int>(i->value));
+	} else if (p->isBool()) {
+	    p->getBool().set(i->value != 0);
+	} else {
+	    static_cast<gx_engine::JConvParameter*>(p)->set(s.jconv[static_cast<int>(i->value)]);
+	}
+    }
+    if (s.midi) {
+	mctrl.set_controller_array(*s.midi);
+    }
 }
 
 bool PresetIO::midi_in_preset() {
@@ -451,11 +604,15 @@ void PresetIO::read_intern(gx_system::JsonParser &jp, bool *has_midi, const gx_s
 }
 
 void PresetIO::commit_preset() {
-    for (gx_engine::paramlist::iterator i = plist.begin(); i != plist.end(); ++i) {
-        (*i)->setJSON_value();
-    }
-    if (m) {
-        mctrl.set_controller_array(*m);
+    if (snapshot) {
+	apply_snapshot(*snapshot);
+    } else {
+	for (gx_engine::paramlist::iterator i = plist.begin(); i != plist.end(); ++i) {
+	    (*i)->setJSON_value();
+	}
+	if (m) {
+	    mctrl.set_controller_array(*m);
+	}
     }
     clear();
     mctrl.update_from_controllers();
@@ -474,6 +631,7 @@ void PresetIO::write_intern(gx_system::JsonWriter &w, bool write_midi) {
 }
 
 void PresetIO::write_preset(gx_system::JsonWriter& jw) {
+    clear_snapshots(); // a bank file is modified
     write_intern(jw, midi_in_preset());
 }
 
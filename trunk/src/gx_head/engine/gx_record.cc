@@ -26,19 +26,55 @@
 
 
 
-#define MAXRECSIZE 131072
-#define MAXFILESIZE INT_MAX-MAXRECSIZE // 2147352576  //2147483648-MAXRECSIZE
+#define RECRINGSIZE 524288  // samples buffered between rt and disk thread
+#define RECBATCHSIZE 32768  // samples per disk write
+#define MAXFILESIZE INT_MAX-RECBATCHSIZE
+
+/****************************************************************
+ ** class RecordRing
+ */
+
+void RecordRing::alloc(unsigned int frames, int channels_) {
+    unsigned int n = 1;
+    while (n < frames * channels_) {
+        n <<= 1;
+    }
+    if (n != size || channels_ != channels) {
+        delete[] buffer;
+        buffer = new float[n];
+        size = n;
+        channels = channels_;
+    }
+    reset();
+}
+
+void RecordRing::read(unsigned int frames, float *out, int stride) {
+    unsigned int r = rpos;
+    for (unsigned int i = 0; i < frames; i++, out += stride) {
+        for (int c = 0; c < channels; c++) {
+            out[c] = buffer[r++ & (size-1)];
+        }
+    }
+    gx_system::atomic_set(&rpos, r);
+}
+
+/****************************************************************
+ ** class SCapture
+ */
 
 SCapture::SCapture(EngineControl& engine_, int channel_)
     : PluginDef(),
       recfile(NULL),
       engine(engine_),
       channel(channel_),
-      fRec0(0),
-      fRec1(0),
-      tape(fRec0),
+      recording(false),
+      post_pos(0),
+      filesize(0),
+      ring(),
+      tape(0),
       m_pthr(0),
-      keep_stream(false),
+      stop_count(0),
+      stops_written(0),
       mem_allocated(false),
       err(false) {
     version = PLUGINDEF_VERSION;
@@ -99,16 +135,35 @@ inline std::string SCapture::get_ffilename() {
 void SCapture::disc_stream() {
     for (;;) {
         sem_wait(&m_trig);
+        flush_ring();
+    }
+}
+
+// write everything the rt thread has put into the ring in batches,
+// close the file when recording has been stopped in the meantime
+void SCapture::flush_ring() {
+    int stops = gx_system::atomic_get(stop_count);
+    for (;;) {
+        unsigned int frames = std::min(ring.read_space(), static_cast<unsigned int>(RECBATCHSIZE / channel));
+        if (!frames) {
+            break;
+        }
         if (!recfile) {
             recfile = open_stream(get_ffilename());
         }
-        save_to_wave(recfile, tape, savesize);
-        filesize +=savesize;
-        if ((!keep_stream && recfile) || (filesize >MAXFILESIZE && is_wav)) {
+        ring.read(frames, tape, channel);
+        save_to_wave(recfile, tape, frames * channel);
+        filesize += frames * channel;
+        if (filesize > MAXFILESIZE && is_wav) {
             close_stream(&recfile);
             filesize = 0;
         }
     }
+    if (stops != stops_written) {
+        stops_written = stops;
+        close_stream(&recfile);
+        filesize = 0;
+    }
 }
 
 void *SCapture::run_thread(void *p) {
@@ -144,8 +199,6 @@ void SCapture::start_thread() {
 
 inline void SCapture::clear_state_f()
 {
-    for (int i=0; i<MAXRECSIZE; i++) fRec0[i] = 0;
-    for (int i=0; i<MAXRECSIZE; i++) fRec1[i] = 0;
     for (int i=0; i<2; i++) fRecb0[i] = 0;
     for (int i=0; i<2; i++) iRecb1[i] = 0;
     for (int i=0; i<2; i++) fRecb2[i] = 0;
@@ -160,7 +213,8 @@ void SCapture::clear_state_f_static(PluginDef *p)
 inline void SCapture::init(unsigned int samplingFreq)
 {
     fSamplingFreq = samplingFreq;
-    IOTA = 0;
+    recording = false;
+    post_pos = 0;
     fConst0 = (1.0f / float(fmin(192000, fmax(1, fSamplingFreq))));
 }
 
@@ -171,9 +225,10 @@ void SCapture::init_static(unsigned int samplingFreq, PluginDef *p)
 
 inline void SCapture::save_to_wave(SNDFILE * sf, float *tape, int lSize)
 {
+    // no sf_write_sync(): the page cache takes care of the data,
+    // forcing it to disk for every batch only stalls the thread
     if (sf) {
         sf_write_float(sf,tape, lSize);
-        sf_write_sync(sf);
     }
 }
 
@@ -197,16 +252,16 @@ inline void SCapture::close_stream(SNDFILE **sf)
 
 void SCapture::mem_alloc()
 {
-    if (!fRec0) fRec0 = new float[MAXRECSIZE];
-    if (!fRec1) fRec1 = new float[MAXRECSIZE];
+    ring.alloc(RECRINGSIZE / channel, channel);
+    if (!tape) tape = new float[RECBATCHSIZE];
     mem_allocated = true;
 }
 
 void SCapture::mem_free()
 {
     mem_allocated = false;
-    if (fRec0) { delete fRec0; fRec0 = 0; }
-    if (fRec1) { delete fRec1; fRec1 = 0; }
+    ring.release();
+    if (tape) { delete[] tape; tape = 0; }
 }
 
 int SCapture::activate(bool start)
@@ -227,12 +282,35 @@ int SCapture::activate_static(bool start, PluginDef *p)
     return static_cast<SCapture*>(p)->activate(start);
 }
 
+// publish the recorded block and wake up the disk thread when a
+// batch is ready or recording has been stopped
+inline void SCapture::post_record(int count, int iSlow0, bool rec)
+{
+    if (iSlow0) {
+        recording = true;
+        if (rec) {
+            ring.end_write();
+        }
+        post_pos += count;
+        if (post_pos * channel >= RECBATCHSIZE) {
+            post_pos = 0;
+            sem_post(&m_trig);
+        }
+    } else if (recording) {
+        recording = false;
+        post_pos = 0;
+        gx_system::atomic_inc(&stop_count);
+        sem_post(&m_trig);
+    }
+}
+
 void always_inline SCapture::compute(int count, float *input0, float *output0)
 {
     if (err) fcheckbox0 = 0.0;
     int     iSlow0 = int(fcheckbox0);
     fcheckbox1 = 1-int(fRecb2[0]);
     float 	fSlow0 = (0.0010000000000000009f * powf(10,(0.05f * fslider0)));
+    bool    rec = iSlow0 && ring.begin_write(count);
     for (int i=0; i<count; i++) {
         float fTemp0 = (float)input0[i];
         fRecC0[0] = (fSlow0 + (0.999f * fRecC0[1]));
@@ -244,27 +322,8 @@ void always_inline SCapture::compute(int count, float *input0, float *output0)
         iRecb1[0] = ((iTemp1)?(1 + iRecb1[1]):1);
         fRecb2[0] = ((iTemp1)?fRecb2[1]:fRecb0[1]);
         
-        if (iSlow0) { //record
-            if (iA) {
-                fRec1[IOTA] = fTemp1;
-            } else {
-                fRec0[IOTA] = fTemp1;
-            }
-            IOTA = (IOTA<MAXRECSIZE-1) ? IOTA+1 : 0; 
-            if (!IOTA) { // when buffer is full, flush to stream
-                iA = iA ? 0 : 1 ;
-                tape = iA ? fRec0 : fRec1;
-                keep_stream = true;
-                savesize = MAXRECSIZE;
-                sem_post(&m_trig);
-            }
-        } else if (IOTA) { // when record stoped, flush the rest to stream
-            tape = iA ? fRec1 : fRec0;
-            savesize = IOTA;
-            keep_stream = false;
-            sem_post(&m_trig);
-            IOTA = 0;
-            iA = 0;
+        if (rec) { //record
+            ring.put(fTemp1);
         }
         output0[i] = fTemp0;
         // post processing
@@ -273,6 +332,7 @@ void always_inline SCapture::compute(int count, float *input0, float *output0)
         fRecb0[1] = fRecb0[0];
         fRecC0[1] = fRecC0[0];
     }
+    post_record(count, iSlow0, rec);
 }
 
 void __rt_func SCapture::compute_static(int count, float *input0, float *output0, PluginDef *p)
@@ -286,6 +346,7 @@ void always_inline SCapture::compute_st(int count, float *input0, float *input1,
     int iSlow0 = int(fcheckbox0);
     fcheckbox1 = 1-int(fRecb2[0]);
     float 	fSlow0 = (0.0010000000000000009f * powf(10,(0.05f * fslider0)));
+    bool    rec = iSlow0 && ring.begin_write(count);
     for (int i=0; i<count; i++) {
         float fTemp0 = (float)input0[i];
         float fTemp1 = (float)input1[i];
@@ -299,29 +360,9 @@ void always_inline SCapture::compute_st(int count, float *input0, float *input1,
         iRecb1[0] = ((iTemp1)?(1 + iRecb1[1]):1);
         fRecb2[0] = ((iTemp1)?fRecb2[1]:fRecb0[1]);
         
-        if (iSlow0) { //record
-            if (iA) {
-                fRec1[IOTA] = fTemp2;
-                fRec1[IOTA+1] = fTemp3;
-            } else {
-                fRec0[IOTA] = fTemp2;
-                fRec0[IOTA+1] = fTemp3;
-            }
-            IOTA = (IOTA<MAXRECSIZE-2) ? IOTA+2 : 0; 
-            if (!IOTA) { // when buffer is full, flush to stream
-                iA = iA ? 0 : 1 ;
-                tape = iA ? fRec0 : fRec1;
-                keep_stream = true;
-                savesize = MAXRECSIZE;
-                sem_post(&m_trig);
-            }
-        } else if (IOTA) { // when record stoped, flush the rest to stream
-            tape = iA ? fRec1 : fRec0;
-            savesize = IOTA;
-            keep_stream = false;
-            sem_post(&m_trig);
-            IOTA = 0;
-            iA = 0;
+        if (rec) { //record
+            ring.put(fTemp2);
+            ring.put(fTemp3);
         }
         output0[i] = fTemp0;
         output1[i] = fTemp1;
@@ -331,6 +372,7 @@ void always_inline SCapture::compute_st(int count, float *input0, float *input1,
         fRecb0[1] = fRecb0[0];
         fRecC0[1] = fRecC0[0];
     }
+    post_record(count, iSlow0, rec);
 }
 
 void SCapture::compute_static_st(int count, float *input0, float *input1, float *output0, float *output1, PluginDef *p)
@@ -413,3 +455,349 @@ void SCapture::del_instance(PluginDef *p)
     delete static_cast<SCapture*>(p);
 }
 
+
+/****************************************************************
+ ** class MultiTrackRecorder
+ */
+
+MultiTrackRecorder::MultiTrackRecorder(EngineControl& engine_, ParamMap& param, ParameterGroups& groups)
+    : engine(engine_),
+      tracks(),
+      ntracks(0),
+      nchannels(0),
+      input_track(0),
+      output_track(0),
+      side_frames(),
+      request(),
+      post_frames(0),
+      post_interval(0),
+      state(st_idle),
+      record(false),
+      taps(),
+      split(0),
+      sf(0),
+      diskbuf(0),
+      m_trig(),
+      m_pthr(0),
+      thread_started(false),
+      p_record(0),
+      overrun(),
+      overrun_reported(false) {
+    static const value_pair split_values[] = {{"multichannel"},{"tracks"},{0}};
+    groups.insert("multitrack", N_("Multitrack Recorder"));
+    p_record = param.reg_par("multitrack.rec", N_("Record"), &record, false, false);
+    p_record->setSavable(false);
+    p_record->signal_changed().connect(
+	sigc::mem_fun(this, &MultiTrackRecorder::on_record));
+    param.reg_string("multitrack.taps", N_("Tap points"), &taps, "input,output");
+    param.reg_non_midi_enum_par("multitrack.split", N_("File layout"), split_values, &split, false);
+    overrun.connect(sigc::mem_fun(this, &MultiTrackRecorder::on_overrun));
+    sem_init(&m_trig, 0, 0);
+}
+
+MultiTrackRecorder::~MultiTrackRecorder() {
+    if (thread_started) {
+	pthread_cancel(m_pthr);
+	pthread_join(m_pthr, NULL);
+    }
+    close_files();
+    clear_taps();
+    delete[] diskbuf;
+}
+
+void MultiTrackRecorder::on_record(bool v) {
+    if (v) {
+	if (!start()) {
+	    p_record->set(false);
+	}
+    } else {
+	stop();
+    }
+}
+
+void MultiTrackRecorder::on_overrun() {
+    gx_print_error(_("multitrack recorder"), _("disk too slow, recording stopped"));
+    p_record->set(false);
+}
+
+// remove the tap pointers of the last take (only called when no
+// track is active, so the rt thread doesn't write anymore)
+void MultiTrackRecorder::clear_taps() {
+    for (int i = 0; i < ntracks; i++) {
+	RecordTrack *t = &tracks[i];
+	if (t == input_track || t == output_track) {
+	    continue;
+	}
+	Plugin *pl = engine.pluginlist.find_plugin(t->name);
+	if (pl && pl->rec_track == t) {
+	    gx_system::atomic_set(&pl->rec_track, static_cast<RecordTrack*>(0));
+	}
+    }
+    gx_system::atomic_set(&input_track, static_cast<RecordTrack*>(0));
+    gx_system::atomic_set(&output_track, static_cast<RecordTrack*>(0));
+}
+
+RecordTrack *MultiTrackRecorder::add_track(const std::string& name, int side, int channels) {
+    if (ntracks == max_tracks) {
+	gx_print_warning(
+	    _("multitrack recorder"),
+	    boost::format(_("too many tracks, %1% not recorded")) % name);
+	return 0;
+    }
+    RecordTrack& t = tracks[ntracks++];
+    t.ring.alloc(ring_seconds * engine.get_samplerate(), channels);
+    t.name = name;
+    t.side = side;
+    t.frames = 0;
+    t.sf = 0;
+    nchannels += channels;
+    return &t;
+}
+
+static std::string file_safe(const std::string& s) {
+    std::string r = s;
+    for (std::string::iterator i = r.begin(); i != r.end(); ++i) {
+	if (!isalnum(*i) && *i != '-') {
+	    *i = '_';
+	}
+    }
+    return r;
+}
+
+std::string MultiTrackRecorder::get_basename() {
+    struct stat sb;
+    std::string pPath = getenv("HOME");
+    pPath += "/gxrecord/";
+    if (!(stat(pPath.c_str(), &sb) == 0 && S_ISDIR(sb.st_mode))) {
+        mkdir(pPath.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    }
+    for (int i = 0; ; i++) {
+	std::string base = pPath + "guitarix_multitrack" + gx_system::to_string(i);
+	bool used = (stat((base + ".wav").c_str(), &sb) == 0);
+	for (int j = 0; j < ntracks && !used; j++) {
+	    used = (stat((base + "_" + file_safe(tracks[j].name) + ".wav").c_str(), &sb) == 0);
+	}
+	if (!used) {
+	    return base;
+	}
+    }
+}
+
+SNDFILE *MultiTrackRecorder::open_file(const std::string& fname, int channels) {
+    SF_INFO sfinfo;
+    sfinfo.channels = channels;
+    sfinfo.samplerate = engine.get_samplerate();
+    // RF64 lifts the 4GB limit of wav, long multichannel takes reach it fast
+    sfinfo.format = SF_FORMAT_RF64 | SF_FORMAT_FLOAT;
+    SNDFILE *f = sf_open(fname.c_str(), SFM_WRITE, &sfinfo);
+    if (!f) {
+	gx_print_error(
+	    _("multitrack recorder"),
+	    boost::format(_("can't open %1%: %2%")) % fname % sf_strerror(0));
+    }
+    return f;
+}
+
+void MultiTrackRecorder::close_files() {
+    if (sf) {
+	sf_close(sf);
+	sf = 0;
+    }
+    for (int i = 0; i < ntracks; i++) {
+	if (tracks[i].sf) {
+	    sf_close(tracks[i].sf);
+	    tracks[i].sf = 0;
+	}
+    }
+}
+
+bool MultiTrackRecorder::start() {
+    if (gx_system::atomic_get(state) != st_idle) {
+	gx_print_warning(_("multitrack recorder"), _("last take is still being written"));
+	return false;
+    }
+    clear_taps();
+    ntracks = nchannels = 0;
+    std::istringstream is(taps.raw());
+    std::string tok;
+    while (std::getline(is, tok, ',')) {
+	size_t b = tok.find_first_not_of(" \t");
+	if (b == std::string::npos) {
+	    continue;
+	}
+	tok = tok.substr(b, tok.find_last_not_of(" \t") - b + 1);
+	if (tok == "input") {
+	    if (!input_track) {
+		gx_system::atomic_set(&input_track, add_track(tok, side_mono, 1));
+	    }
+	} else if (tok == "output") {
+	    if (!output_track) {
+		gx_system::atomic_set(&output_track, add_track(tok, side_stereo, 2));
+	    }
+	} else {
+	    Plugin *pl = engine.pluginlist.find_plugin(tok);
+	    if (!pl || !(pl->get_pdef()->mono_audio || pl->get_pdef()->stereo_audio)) {
+		gx_print_warning(
+		    _("multitrack recorder"),
+		    boost::format(_("no rack unit %1%")) % tok);
+		continue;
+	    }
+	    if (pl->rec_track) {
+		continue;
+	    }
+	    bool mono = pl->get_pdef()->mono_audio;
+	    RecordTrack *t = add_track(tok, mono ? side_mono : side_stereo, mono ? 1 : 2);
+	    if (t) {
+		gx_system::atomic_set(&pl->rec_track, t);
+	    }
+	}
+    }
+    if (!ntracks) {
+	gx_print_warning(_("multitrack recorder"), _("no tap points selected"));
+	return false;
+    }
+    std::string base = get_basename();
+    bool ok = true;
+    if (split) {
+	for (int i = 0; i < ntracks && ok; i++) {
+	    tracks[i].sf = open_file(base + "_" + file_safe(tracks[i].name) + ".wav",
+				     tracks[i].ring.get_channels());
+	    ok = (tracks[i].sf != 0);
+	}
+    } else {
+	sf = open_file(base + ".wav", nchannels);
+	ok = (sf != 0);
+    }
+    if (ok && !thread_started) {
+	start_thread();
+	ok = thread_started;
+    }
+    if (!ok) {
+	close_files();
+	clear_taps();
+	ntracks = 0;
+	return false;
+    }
+    delete[] diskbuf;
+    diskbuf = new float[batch_frames * nchannels];
+    post_interval = engine.get_samplerate() / 4;
+    overrun_reported = false;
+    gx_print_info(
+	_("multitrack recorder"),
+	boost::format(_("recording %1% tracks to %2%")) % ntracks % base);
+    gx_system::atomic_set(&state, st_running);
+    gx_system::atomic_set(&request[side_mono], req_start);
+    return true;
+}
+
+void MultiTrackRecorder::stop() {
+    if (gx_system::atomic_get(state) != st_running) {
+	return;
+    }
+    gx_system::atomic_set(&state, st_draining);
+    gx_system::atomic_set(&request[side_mono], req_stop);
+    sem_post(&m_trig);
+}
+
+// multichannel: write the frames available in all tracks, interleaved
+// in tap order; file per track: write each track on its own
+void MultiTrackRecorder::write_tracks() {
+    if (sf) {
+	for (;;) {
+	    unsigned int n = batch_frames;
+	    for (int i = 0; i < ntracks; i++) {
+		n = std::min(n, tracks[i].ring.read_space());
+	    }
+	    if (!n) {
+		break;
+	    }
+	    float *p = diskbuf;
+	    for (int i = 0; i < ntracks; i++) {
+		tracks[i].ring.read(n, p, nchannels);
+		p += tracks[i].ring.get_channels();
+	    }
+	    sf_writef_float(sf, diskbuf, n);
+	}
+    } else {
+	for (int i = 0; i < ntracks; i++) {
+	    RecordTrack& t = tracks[i];
+	    for (;;) {
+		unsigned int n = std::min(static_cast<unsigned int>(batch_frames), t.ring.read_space());
+		if (!n || !t.sf) {
+		    break;
+		}
+		t.ring.read(n, diskbuf, t.ring.get_channels());
+		sf_writef_float(t.sf, diskbuf, n);
+	    }
+	}
+    }
+}
+
+void MultiTrackRecorder::disc_stream() {
+    for (;;) {
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += 1;
+	bool timeout = (sem_timedwait(&m_trig, &ts) != 0 && errno == ETIMEDOUT);
+	int st = gx_system::atomic_get(state);
+	if (st == st_idle) {
+	    continue;
+	}
+	if (st == st_running && !overrun_reported) {
+	    for (int i = 0; i < ntracks; i++) {
+		if (tracks[i].ring.get_overflow()) {
+		    overrun_reported = true;
+		    overrun();
+		    break;
+		}
+	    }
+	}
+	if (st == st_draining) {
+	    bool pending = (gx_system::atomic_get(request[side_mono]) != req_none
+			    || gx_system::atomic_get(request[side_stereo]) != req_none);
+	    if (pending && timeout) {
+		// engine not running: no process cycle will take the request
+		gx_system::atomic_set(&request[side_mono], req_none);
+		gx_system::atomic_set(&request[side_stereo], req_none);
+		for (int i = 0; i < ntracks; i++) {
+		    tracks[i].active = false;
+		}
+		pending = false;
+	    }
+	    if (!pending) {
+		write_tracks();
+		close_files();
+		gx_system::atomic_set(&state, st_idle);
+		continue;
+	    }
+	}
+	write_tracks();
+    }
+}
+
+void *MultiTrackRecorder::run_thread(void *p) {
+    (reinterpret_cast<MultiTrackRecorder *>(p))->disc_stream();
+    return NULL;
+}
+
+void MultiTrackRecorder::start_thread() {
+    pthread_attr_t      attr;
+    struct sched_param  spar;
+    int priority, policy;
+    engine.get_sched_priority(policy, priority, 12);
+    spar.sched_priority = priority;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_JOINABLE );
+    pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, NULL);
+    pthread_attr_setschedpolicy(&attr, policy);
+    pthread_attr_setschedparam(&attr, &spar);
+    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    if (pthread_create(&m_pthr, &attr, run_thread,
+                       reinterpret_cast<void*>(this))) {
+	gx_print_error(_("multitrack recorder"), _("can't start disk thread"));
+    } else {
+	thread_started = true;
+    }
+    pthread_attr_destroy(&attr);
+}
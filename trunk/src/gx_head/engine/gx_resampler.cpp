@@ -187,4 +187,131 @@ int StreamingResampler::flush(float *output)
 	return olen - out_count;
 }
 
+/****************************************************************
+ ** class HalfbandUpsampler, class HalfbandDownsampler
+ */
+
+// Blackman windowed sinc; c[k] belongs to the taps at offset 2k+1
+// left and right of the center tap (which is fixed at 0.5)
+void HalfbandFilter::design(int n)
+{
+	assert(n > 0 && n <= max_taps);
+	taps = n;
+	int center = 2 * n - 1;
+	double sum = 0;
+	for (int k = 0; k < n; k++) {
+		int d = 2 * k + 1;
+		double w = 0.42 + 0.5 * cos(M_PI * d / center) + 0.08 * cos(2 * M_PI * d / center);
+		double v = w * sin(M_PI * d / 2) / (M_PI * d);
+		coeffs[k] = v;
+		sum += v;
+	}
+	// unity gain at DC: both sides sum up to 0.5
+	for (int k = 0; k < n; k++) {
+		coeffs[k] *= 0.25 / sum;
+	}
+}
+
+void HalfbandUpsampler::setup(int n)
+{
+	design(n);
+	memset(buf, 0, sizeof(buf));
+}
+
+// output[2i] is the filtered branch, output[2i+1] the delayed input
+// (latency: 2*taps-1 output samples); the inner loops run over the
+// block and are simple enough to be vectorized by the compiler
+void __rt_func HalfbandUpsampler::process(int count, const float *input, float *output)
+{
+	assert(count <= max_block);
+	int hist = 2 * taps - 1;
+	float *x = buf + hist;
+	memcpy(x, input, count * sizeof(float));
+	memset(acc, 0, count * sizeof(float));
+	for (int k = 0; k < taps; k++) {
+		const float c = 2 * coeffs[k];
+		const float *a = x + k + 1 - taps;
+		const float *b = x - taps - k;
+		for (int i = 0; i < count; i++) {
+			acc[i] += c * (a[i] + b[i]);
+		}
+	}
+	const float *d = x + 1 - taps;
+	for (int i = 0; i < count; i++) {
+		output[2*i] = acc[i];
+		output[2*i+1] = d[i];
+	}
+	memmove(buf, buf + count, hist * sizeof(float));
+}
+
+void HalfbandDownsampler::setup(int n)
+{
+	design(n);
+	memset(even, 0, sizeof(even));
+	memset(odd, 0, sizeof(odd));
+}
+
+void __rt_func HalfbandDownsampler::process(int count, const float *input, float *output)
+{
+	assert(count <= max_block);
+	int hist = 2 * taps - 1;
+	float *e = even + hist;
+	float *o = odd + taps;
+	for (int i = 0; i < count; i++) {
+		e[i] = input[2*i];
+		o[i] = input[2*i+1];
+	}
+	const float *d = o - taps;
+	for (int i = 0; i < count; i++) {
+		output[i] = 0.5f * d[i];
+	}
+	for (int k = 0; k < taps; k++) {
+		const float c = coeffs[k];
+		const float *a = e + k + 1 - taps;
+		const float *b = e - taps - k;
+		for (int i = 0; i < count; i++) {
+			output[i] += c * (a[i] + b[i]);
+		}
+	}
+	memmove(even, even + count, hist * sizeof(float));
+	memmove(odd, odd + count, taps * sizeof(float));
+}
+
+/****************************************************************
+ ** class Oversampler
+ */
+
+// first stage needs a steep transition, the second one only has
+// to suppress the images above the original band
+static const int oversample_taps_1 = 12; // 47 tap FIR
+static const int oversample_taps_2 = 6;  // 23 tap FIR
+
+// round trip latency in frames at the engine rate (rounded): each
+// halfband up / down pair adds 2*taps-1 samples at its output rate
+int Oversampler::get_latency() const
+{
+	int n = 0; // in half frames
+	if (factor >= 2) {
+		n += 2 * (2 * oversample_taps_1 - 1);
+	}
+	if (factor == 4) {
+		n += 2 * oversample_taps_2 - 1;
+	}
+	return (n + 1) / 2;
+}
+
+void Oversampler::setup(int factor_, int nchannels)
+{
+	assert(factor_ == 1 || factor_ == 2 || factor_ == max_factor);
+	assert(nchannels <= max_channels);
+	factor = factor_;
+	for (int i = 0; i < nchannels; i++) {
+		Channel& c = chan[i];
+		c.up1.setup(oversample_taps_1);
+		c.down1.setup(oversample_taps_1);
+		c.up2.setup(oversample_taps_2);
+		c.down2.setup(oversample_taps_2);
+	}
+}
+
 } // namespace gx_resample
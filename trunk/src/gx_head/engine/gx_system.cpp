@@ -461,8 +461,12 @@ CmdlineOptions::CmdlineOptions()
       liveplaygui(false),
       mute(false),
       setbank(),
+      render(false),
+      render_preset(),
+      render_files(),
       sporadic_overload(0),
       idle_thread_timeout(0),
+      rack_stages(1),
       convolver_watchdog(true),
       xrun_watchdog(false),
       lterminal(false),
@@ -553,6 +557,14 @@ CmdlineOptions::CmdlineOptions()
     opt_bank.set_long_name("bank");
     opt_bank.set_description("set bank and preset to load at startup");
     opt_bank.set_arg_description("BANK:PRESET (A:0-Z:9)");
+    Glib::OptionEntry opt_render;
+    opt_render.set_short_name('R');
+    opt_render.set_long_name("render");
+    opt_render.set_description("process audio files offline, without jack");
+    Glib::OptionEntry opt_render_preset;
+    opt_render_preset.set_long_name("preset");
+    opt_render_preset.set_description("preset to load for --render");
+    opt_render_preset.set_arg_description("BANKNAME:PRESETNAME");
     main_group.add_entry(opt_version, version);
     main_group.add_entry(opt_nogui, nogui);
     main_group.add_entry(opt_rpcport, rpcport);
@@ -561,6 +573,8 @@ CmdlineOptions::CmdlineOptions()
     main_group.add_entry(opt_liveplaygui, liveplaygui);
     main_group.add_entry(opt_mute, mute);
     main_group.add_entry(opt_bank, setbank);
+    main_group.add_entry(opt_render, render);
+    main_group.add_entry(opt_render_preset, render_preset);
     set_main_group(main_group);
 
     // style options
@@ -616,6 +630,11 @@ CmdlineOptions::CmdlineOptions()
     opt_jack_servername.set_long_name("server-name");
     opt_jack_servername.set_description("JACK server name to connect to");
     opt_jack_servername.set_arg_description("NAME");
+    Glib::OptionEntry opt_rack_stages;
+    opt_rack_stages.set_long_name("rack-stages");
+    opt_rack_stages.set_description(
+	"run each rack pipelined in N stages on N cores (adds N-1 periods latency, default: 1)");
+    opt_rack_stages.set_arg_description("N");
     optgroup_jack.add_entry(opt_jack_input, jack_input);
     optgroup_jack.add_entry(opt_jack_output, jack_outputs);
     optgroup_jack.add_entry(opt_jack_midi, jack_midi);
@@ -624,6 +643,7 @@ CmdlineOptions::CmdlineOptions()
     optgroup_jack.add_entry(opt_jack_uuid, jack_uuid);
     optgroup_jack.add_entry(opt_jack_uuid2, jack_uuid2);
     optgroup_jack.add_entry(opt_jack_servername, jack_servername);
+    optgroup_jack.add_entry(opt_rack_stages, rack_stages);
 
     // Engine overload options
     Glib::OptionEntry opt_watchdog_idle;
@@ -860,8 +880,23 @@ void CmdlineOptions::process(int argc, char** argv) {
              << endl;
         exit(0);
     }
+    if (render) {
+	// remaining arguments are pairs of input and output file
+	for (int i = 1; i < argc; ++i) {
+	    render_files.push_back(argv[i]);
+	}
+	if (render_files.empty() || render_files.size() % 2) {
+	    throw Glib::OptionError(
+		Glib::OptionError::BAD_VALUE,
+		_("--render needs pairs of INFILE OUTFILE"));
+	}
+    } else if (!render_preset.empty()) {
+	throw Glib::OptionError(
+	    Glib::OptionError::BAD_VALUE,
+	    _("--preset can only be used with --render"));
+    }
 #ifdef NDEBUG
-    if (argc > 1) {
+    if (argc > 1 && !render) {
 	throw GxFatalError(
 	    string("unknown argument on command line: ")+argv[1]);
     }
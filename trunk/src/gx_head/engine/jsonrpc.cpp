@@ -19,6 +19,7 @@
 #include "jsonrpc.h"
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 #if HAVE_BLUEZ
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/rfcomm.h>
@@ -237,7 +238,13 @@ CmdConnection::CmdConnection(GxService& serv_, const Glib::RefPtr<Gio::SocketCon
       current_offset(0),
       midi_config_mode(false),
       flags(),
-      maxlevel() {
+      maxlevel(),
+      telemetry_streams(0),
+      telemetry_binary(false),
+      telemetry_interval(0),
+      telemetry_elapsed(0),
+      pending_set(),
+      pending_set_index() {
     jp.start_parser();
 }
 
@@ -622,6 +629,7 @@ void CmdConnection::call(gx_system::JsonWriter& jw, const methodnames *mn, JsonA
 	jw.begin_object();
 	jw.write_kv("frequency", serv.jack.get_engine().tuner.get_freq());
 	jw.write_kv("note", serv.jack.get_engine().tuner.get_note());
+	jw.write_kv("confidence", serv.jack.get_engine().tuner.get_confidence());
 	jw.end_object();
     }
 
@@ -644,25 +652,64 @@ void CmdConnection::call(gx_system::JsonWriter& jw, const methodnames *mn, JsonA
 	jw.end_array();
     }
 
+    FUNCTION(get_plugin_load) {
+	gx_engine::GxEngine& engine = serv.jack.get_engine();
+	jw.begin_object();
+	jw.write_kv("period", engine.get_samplerate() ?
+		    engine.get_buffersize() * 1e6 / engine.get_samplerate() : 0.0);
+	jw.write_key("units");
+	jw.begin_object();
+	for (gx_engine::PluginList::pluginmap::iterator i = engine.pluginlist.begin();
+	     i != engine.pluginlist.end(); ++i) {
+	    gx_engine::PluginLoadInfo info;
+	    if (!i->second->load.get(info)) {
+		continue;
+	    }
+	    jw.write_key(i->first);
+	    jw.begin_array();
+	    jw.write(info.count);
+	    jw.write(info.mean);
+	    jw.write(info.minimum);
+	    jw.write(info.maximum);
+	    jw.write(info.p99);
+	    jw.end_array();
+	}
+	jw.end_object();
+	jw.end_object();
+    }
+
     FUNCTION(get_tuner_freq) {
 	jw.write(serv.jack.get_engine().tuner.get_freq());
     }
 
     FUNCTION(get_oscilloscope_info) {
-	jw.begin_array();
-	jw.write(static_cast<int>(round(serv.jack.get_jcpu_load())));
-	jw.write(serv.jack.get_time_is()/100000);
-	jw.write(serv.jack.get_is_rt());
-	jw.write(serv.jack.get_jack_bs());
-	unsigned int sz = serv.jack.get_engine().oscilloscope.get_size();
-	float *p = serv.jack.get_engine().oscilloscope.get_buffer();
-	jw.write(sz);
-	jw.begin_array();
-	for (unsigned int i = 0; i < sz; i++) {
-	    jw.write(*p++);
+	write_oscilloscope_info(jw, false);
+    }
+
+    FUNCTION(enable_telemetry_stream) {
+	// params: rate [Hz], encoding ("binary" or "json"), stream names
+	int rate = max(1, min(params[0]->getInt(), 50));
+	telemetry_binary = (params[1]->getString() == "binary");
+	telemetry_streams = 0;
+	for (unsigned int i = 2; i < params.size(); i++) {
+	    const Glib::ustring& s = params[i]->getString();
+	    if (s == "freq") {
+		telemetry_streams |= t_freq;
+	    } else if (s == "meter") {
+		telemetry_streams |= t_meter;
+	    } else if (s == "osc") {
+		telemetry_streams |= t_osc;
+	    } else {
+		throw RpcError(-32602, Glib::ustring::compose("Invalid param -- unknown stream %1", s));
+	    }
 	}
-	jw.end_array();
-	jw.end_array();
+	telemetry_interval = 1000 / rate;
+	telemetry_elapsed = telemetry_interval;
+	serv.update_telemetry_timer();
+	jw.begin_object();
+	jw.write_kv("rate", rate);
+	jw.write_kv("encoding", telemetry_binary ? "binary" : "json");
+	jw.end_object();
     }
 
     FUNCTION(get_oscilloscope_mul_buffer) {
@@ -1113,6 +1160,11 @@ void CmdConnection::notify(gx_system::JsonStringWriter& jw, const methodnames *m
 	serv.jack.get_engine().tuner.used_for_display(params[0]->getInt());
     }
 
+    PROCEDURE(disable_telemetry_stream) {
+	telemetry_streams = 0;
+	serv.update_telemetry_timer();
+    }
+
     PROCEDURE(clear_oscilloscope_buffer) {
 	serv.jack.get_engine().oscilloscope.clear_buffer();
     }
@@ -1125,6 +1177,82 @@ void CmdConnection::notify(gx_system::JsonStringWriter& jw, const methodnames *m
     END_FUNCTION_SWITCH(cerr << "Method not found: " << mn->name << endl; assert(false));
 }
 
+void CmdConnection::write_oscilloscope_info(gx_system::JsonWriter& jw, bool binary) {
+    jw.begin_array();
+    jw.write(static_cast<int>(round(serv.jack.get_jcpu_load())));
+    jw.write(serv.jack.get_time_is()/100000);
+    jw.write(serv.jack.get_is_rt());
+    jw.write(serv.jack.get_jack_bs());
+    unsigned int sz = serv.jack.get_engine().oscilloscope.get_size();
+    float *p = serv.jack.get_engine().oscilloscope.get_buffer();
+    jw.write(sz);
+    if (binary) {
+	// float32 little endian, base64 encoded: about 5.3 bytes
+	// per sample instead of 10..15 for the decimal text
+	std::string buf(4 * sz, '\0');
+	for (unsigned int i = 0; i < sz; i++) {
+	    uint32_t v;
+	    memcpy(&v, p++, sizeof(v));
+	    buf[4*i]   = v & 0xff;
+	    buf[4*i+1] = (v >> 8) & 0xff;
+	    buf[4*i+2] = (v >> 16) & 0xff;
+	    buf[4*i+3] = (v >> 24) & 0xff;
+	}
+	gchar *b = g_base64_encode(reinterpret_cast<const guchar*>(buf.data()), buf.size());
+	jw.write(b);
+	g_free(b);
+    } else {
+	jw.begin_array();
+	for (unsigned int i = 0; i < sz; i++) {
+	    jw.write(*p++);
+	}
+	jw.end_array();
+    }
+    jw.end_array();
+}
+
+void CmdConnection::send_telemetry(int tick) {
+    if (!telemetry_streams) {
+	return;
+    }
+    telemetry_elapsed += tick;
+    if (telemetry_elapsed < telemetry_interval) {
+	return;
+    }
+    if (outgoing.size() > 0) {
+	// client (or link) doesn't keep up: drop the frame, the next
+	// one carries the current values and the accumulated peaks
+	return;
+    }
+    telemetry_elapsed = 0;
+    gx_engine::GxEngine& engine = serv.jack.get_engine();
+    gx_system::JsonStringWriter jw;
+    send_notify_begin(jw, "telemetry");
+    jw.begin_object();
+    if (telemetry_streams & t_freq) {
+	jw.write_key("freq");
+	jw.begin_array();
+	jw.write(engine.tuner.get_freq());
+	jw.write(engine.tuner.get_note());
+	jw.end_array();
+    }
+    if (telemetry_streams & t_meter) {
+	jw.write_key("meter");
+	jw.begin_array();
+	for (unsigned int i = 0; i < gx_engine::MaxLevel::channelcount; i++) {
+	    jw.write(maxlevel[i]);
+	    maxlevel[i] = 0.0;
+	}
+	jw.end_array();
+    }
+    if ((telemetry_streams & t_osc) && engine.oscilloscope.plugin.get_on_off()) {
+	jw.write_key("osc");
+	write_oscilloscope_info(jw, telemetry_binary);
+    }
+    jw.end_object();
+    send_notify_end(jw);
+}
+
 void CmdConnection::write_error(gx_system::JsonWriter& jw, int code, const char *message) {
     jw.write_key("error");
     jw.begin_object();
@@ -1133,6 +1261,54 @@ void CmdConnection::write_error(gx_system::JsonWriter& jw, int code, const char
     jw.end_object();
 }
 
+// JsonObject values refer to the position in the message buffer
+// and can't be kept after the message has been processed
+static bool set_can_be_merged(JsonArray& params) {
+    if (params.size() & 1) {
+	return false;
+    }
+    for (unsigned int i = 1; i < params.size(); i += 2) {
+	if (dynamic_cast<JsonObject*>(params[i])) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+void CmdConnection::queue_set(JsonArray& params) {
+    for (unsigned int i = 0; i < params.size(); i += 2) {
+	const Glib::ustring& attr = params[i]->getString();
+	std::map<std::string, unsigned int>::iterator j = pending_set_index.find(attr);
+	if (j == pending_set_index.end()) {
+	    pending_set_index[attr] = pending_set.size();
+	    pending_set.push_back(params.at(i));
+	    pending_set.push_back(params.at(i+1));
+	    params.at(i) = 0;
+	    params.at(i+1) = 0;
+	} else {
+	    // older value is deleted with params
+	    std::swap(pending_set.at(j->second+1), params.at(i+1));
+	}
+    }
+}
+
+void CmdConnection::flush_set() {
+    if (pending_set.empty()) {
+	return;
+    }
+    JsonArray params;
+    params.swap(pending_set);
+    pending_set_index.clear();
+    gx_system::JsonStringWriter jw;
+    try {
+	notify(jw, in_word_set("set", 3), params);
+    } catch (RpcError& e) {
+	error_response(jw, e.code, Glib::ustring("set: ") + e.message);
+	jw.finish();
+	send(jw);
+    }
+}
+
 bool CmdConnection::request(gx_system::JsonStringParser& jp, gx_system::JsonStringWriter& jw, bool batch_start) {
     Glib::ustring method;
     JsonArray params;
@@ -1178,9 +1354,15 @@ bool CmdConnection::request(gx_system::JsonStringParser& jp, gx_system::JsonStri
     }
     try {
 	if (id.empty()) {
-	    notify(jw, p, params);
+	    if (p->m_id == RPNM_set && set_can_be_merged(params)) {
+		queue_set(params);
+	    } else {
+		flush_set();
+		notify(jw, p, params);
+	    }
 	    return false;
 	} else {
+	    flush_set();
 	    if (batch_start) {
 		jw.begin_array();
 	    }
@@ -1206,28 +1388,32 @@ void CmdConnection::error_response(gx_system::JsonWriter& jw, int code, const ch
     jw.end_object();
 }
 
-static bool sendbytes(int fd, const std::string& s, unsigned int *off) {
-    unsigned int len = s.size() - *off;
-    int n = write(fd, s.c_str() + *off, len);
-    if (n <= 0) {
-	return false;
-    }
-    len -= n;
-    if (len > 0) {
-	*off += n;
-    } else {
-	*off = 0;
-    }
-    return true;
-}
-
 bool CmdConnection::on_data_out(Glib::IOCondition cond) {
+    // write as much of the queue as the socket takes with one
+    // system call
+    const int max_iov = 64;
     int fd = connection->get_socket()->get_fd();
     while (outgoing.size() > 0) {
-	if (!sendbytes(fd, outgoing.front(), &current_offset)) {
+	struct iovec iov[max_iov];
+	int cnt = 0;
+	for (std::list<std::string>::iterator i = outgoing.begin();
+	     i != outgoing.end() && cnt < max_iov; ++i, ++cnt) {
+	    unsigned int off = (cnt == 0 ? current_offset : 0);
+	    iov[cnt].iov_base = const_cast<char*>(i->data()) + off;
+	    iov[cnt].iov_len = i->size() - off;
+	}
+	ssize_t n = writev(fd, iov, cnt);
+	if (n <= 0) {
 	    return true;
 	}
-	if (current_offset == 0) {
+	while (n > 0) {
+	    ssize_t len = outgoing.front().size() - current_offset;
+	    if (n < len) {
+		current_offset += n;
+		break;
+	    }
+	    n -= len;
+	    current_offset = 0;
 	    outgoing.pop_front();
 	}
     }
@@ -1236,46 +1422,60 @@ bool CmdConnection::on_data_out(Glib::IOCondition cond) {
 
 bool CmdConnection::on_data_in(Glib::IOCondition cond) {
     Glib::RefPtr<Gio::Socket> sock = connection->get_socket();
-    char buf[1000];
+    char buf[16384];
     while (true) {
 	int n;
 	try {
 	    n = sock->receive(buf, sizeof(buf));
 	} catch(Glib::Error e) {
 	    if (e.code() == Gio::Error::WOULD_BLOCK) {
+		// all available input processed
+		flush_set();
 		return true;
 	    }
+	    flush_set();
 	    serv.remove_connection(this);
 	    return false;
 	}
 	if (n <= 0) {
+	    flush_set();
 	    serv.remove_connection(this);
 	    return false;
 	}
+	// messages are terminated by newline
 	char *p = buf;
-	while (n-- > 0) {
-	    jp.put(*p);
-	    if (*p == '\n') {
-		process(jp);
-		jp.reset();
+	char *end = buf + n;
+	while (p < end) {
+	    char *q = static_cast<char*>(memchr(p, '\n', end - p));
+	    if (!q) {
+		jp.put(p, end - p);
+		break;
 	    }
-	    p++;
+	    jp.put(p, q + 1 - p);
+	    process(jp);
+	    jp.reset();
+	    p = q + 1;
 	}
     }
 }
 
 void CmdConnection::send(gx_system::JsonStringWriter& jw) {
     std::string s = jw.get_string();
-    if (outgoing.size() == 0) {
-	assert(current_offset == 0);
-	ssize_t len = s.size();
-	ssize_t n = write(connection->get_socket()->get_fd(), s.c_str(), len);
-	if (n == len) {
-	    return;
-	}
-	current_offset = max<ssize_t>(0, n);
+    if (outgoing.size() > 0) {
+	// on_data_out is already waiting for the socket
+	outgoing.push_back(std::string());
+	outgoing.back().swap(s);
+	return;
+    }
+    assert(current_offset == 0);
+    ssize_t len = s.size();
+    ssize_t n = write(connection->get_socket()->get_fd(), s.c_str(), len);
+    if (n == len) {
+	return;
     }
-    outgoing.push_back(s);
+    current_offset = max<ssize_t>(0, n);
+    outgoing.push_back(std::string());
+    outgoing.back().swap(s);
     Glib::signal_io().connect(
 	sigc::mem_fun(this, &CmdConnection::on_data_out),
 	connection->get_socket()->get_fd(), Glib::IO_OUT);
@@ -1639,7 +1839,9 @@ GxService::GxService(gx_preset::GxSettings& settings_, gx_jack::GxJack& jack_,
       connection_list(),
       jwc(0),
       preg_map(0),
-      maxlevel() {
+      maxlevel(),
+      telemetry_conn(),
+      telemetry_tick(0) {
     if (*port == 0) {
 	*port = add_any_inet_port();
     } else {
@@ -2050,6 +2252,7 @@ void GxService::remove_connection(CmdConnection *p) {
 	if (*i == p) {
 	    connection_list.erase(i);
 	    delete p;
+	    update_telemetry_timer();
 	    return;
 	}
     }
@@ -2134,6 +2337,35 @@ void GxService::broadcast(gx_system::JsonStringWriter& jw, CmdConnection::msg_ty
     }
 }
 
+void GxService::update_telemetry_timer() {
+    // one timer for all connections, ticking at the fastest
+    // requested rate
+    int tick = 0;
+    for (std::list<CmdConnection*>::iterator p = connection_list.begin(); p != connection_list.end(); ++p) {
+	int t = (*p)->get_telemetry_interval();
+	if (t && (!tick || t < tick)) {
+	    tick = t;
+	}
+    }
+    if (tick == telemetry_tick) {
+	return;
+    }
+    telemetry_conn.disconnect();
+    telemetry_tick = tick;
+    if (tick) {
+	telemetry_conn = Glib::signal_timeout().connect(
+	    sigc::mem_fun(this, &GxService::on_telemetry_timeout), tick);
+    }
+}
+
+bool GxService::on_telemetry_timeout() {
+    update_maxlevel();
+    for (std::list<CmdConnection*>::iterator p = connection_list.begin(); p != connection_list.end(); ++p) {
+	(*p)->send_telemetry(telemetry_tick);
+    }
+    return true;
+}
+
 void GxService::update_maxlevel(CmdConnection *curr) {
     gx_engine::MaxLevel& m = jack.get_engine().maxlevel;
     for (unsigned int i = 0; i < m.channelcount; i++) {
@@ -55,9 +55,9 @@ hash (register const char *str, register unsigned int len)
       165, 165, 165, 165, 165, 165, 165, 165, 165, 165,
       165, 165, 165, 165, 165, 165, 165, 165, 165, 165,
       165, 165, 165, 165, 165,  70, 165,  30,  20,  40,
-       45,  10, 165,  10,   0,  55,  10,  15,  25,  50,
-       10,  15,  55,  30,   0,   0,   0,  65,   0,  30,
-      165,  10, 165, 165, 165, 165, 165, 165
+       45,  10, 165,  10,   5,  55,  16,  15,  25,  50,
+       10,  15,  55,  18,   0,   0,   0,  86,   5,  61,
+      165,  15, 165, 165, 165, 165, 165, 165
     };
   register int hval = len;
 
@@ -88,7 +88,7 @@ in_word_set (register const char *str, register unsigned int len)
 {
   enum
     {
-      TOTAL_KEYWORDS = 77,
+      TOTAL_KEYWORDS = 80,
       MIN_WORD_LENGTH = 3,
       MAX_WORD_LENGTH = 27,
       MIN_HASH_VALUE = 3,
@@ -99,10 +99,11 @@ in_word_set (register const char *str, register unsigned int len)
     {
       {""}, {""}, {""},
       {"set", RPNM_set},
-      {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""},
-      {"switch_tuner", RPNM_switch_tuner},
+      {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""},
       {"get", RPCM_get},
-      {""}, {""}, {""}, {""}, {""},
+      {""}, {""}, {""},
+      {"switch_tuner", RPNM_switch_tuner},
+      {""},
       {"setpreset", RPNM_setpreset},
       {""}, {""}, {""},
       {"rename_preset", RPCM_rename_preset},
@@ -151,16 +152,16 @@ in_word_set (register const char *str, register unsigned int len)
       {"midi_size", RPCM_midi_size},
       {"pf_insert_after", RPNM_pf_insert_after},
       {"insert_rack_unit", RPNM_insert_rack_unit},
-      {"pf_save", RPNM_pf_save},
-      {""}, {""},
+      {""}, {""}, {""},
       {"pluginlist", RPCM_pluginlist},
-      {""}, {""},
+      {""},
+      {"pf_save", RPNM_pf_save},
       {"parameterlist", RPCM_parameterlist},
       {""},
       {"midi_set_config_mode", RPNM_midi_set_config_mode},
       {"pf_insert_before", RPNM_pf_insert_before},
       {"ladspaloader_update_plugins", RPCM_ladspaloader_update_plugins},
-      {"unlisten", RPNM_unlisten},
+      {""},
       {"get_max_input_level", RPCM_get_max_input_level},
       {"get_max_output_level", RPCM_get_max_output_level},
       {"sendcc", RPNM_sendcc},
@@ -170,39 +171,43 @@ in_word_set (register const char *str, register unsigned int len)
       {"midi_get_config_mode", RPCM_midi_get_config_mode},
       {""},
       {"erase_preset", RPNM_erase_preset},
-      {""},
+      {"enable_telemetry_stream", RPCM_enable_telemetry_stream},
       {"bank_insert_content", RPCM_bank_insert_content},
-      {"get_tuning", RPCM_get_tuning},
+      {"get_plugin_load", RPCM_get_plugin_load},
       {""},
       {"load_impresp_dirs", RPCM_load_impresp_dirs},
       {"plugin_preset_list_save", RPNM_plugin_preset_list_save},
       {"midi_set_current_control", RPNM_midi_set_current_control},
       {"plugin_preset_list_remove", RPNM_plugin_preset_list_remove},
       {"tuner_switcher_toggle", RPNM_tuner_switcher_toggle},
-      {"tuner_used_for_display", RPNM_tuner_used_for_display},
+      {""},
       {"tuner_switcher_activate", RPNM_tuner_switcher_activate},
-      {"queryunit", RPCM_queryunit},
+      {"unlisten", RPNM_unlisten},
       {"tuner_switcher_deactivate", RPNM_tuner_switcher_deactivate},
-      {""}, {""},
-      {"jack_cpu_load", RPCM_jack_cpu_load},
       {""},
-      {"get_tuner_switcher_active", RPCM_get_tuner_switcher_active},
-      {""}, {""}, {""}, {""},
+      {"tuner_used_for_display", RPNM_tuner_used_for_display},
+      {""}, {""}, {""}, {""}, {""},
+      {"queryunit", RPCM_queryunit},
+      {"jack_cpu_load", RPCM_jack_cpu_load},
       {"midi_deleteParameter", RPNM_midi_deleteParameter},
-      {""}, {""},
+      {"get_tuning", RPCM_get_tuning},
+      {""},
       {"midi_modifyCurrent", RPNM_midi_modifyCurrent},
-      {"get_tuner_freq", RPCM_get_tuner_freq},
-      {"bank_insert_new", RPCM_bank_insert_new},
       {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""},
-      {""}, {""}, {""},
+      {"get_tuner_freq", RPCM_get_tuner_freq},
+      {""}, {""},
+      {"get_tuner_switcher_active", RPCM_get_tuner_switcher_active},
+      {""},
       {"plugin_preset_list_load", RPCM_plugin_preset_list_load},
       {"plugin_load_ui", RPCM_plugin_load_ui},
       {"clear_oscilloscope_buffer", RPNM_clear_oscilloscope_buffer},
       {""}, {""}, {""}, {""}, {""}, {""}, {""},
       {"get_midi_controller_map", RPCM_get_midi_controller_map},
+      {"disable_telemetry_stream", RPNM_disable_telemetry_stream},
+      {""}, {""}, {""}, {""}, {""}, {""},
+      {"bank_insert_new", RPCM_bank_insert_new},
       {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""},
-      {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""}, {""},
-      {""}, {""},
+      {""}, {""}, {""},
       {"pf_append", RPNM_pf_append}
     };
 
@@ -269,6 +274,7 @@ const jsonrpc_method_def jsonrpc_method_list[] = {
 	{ "pluginlist", true },
 	{ "plugin_load_ui", true },
 	{ "get_rack_unit_order", true },
+	{ "get_plugin_load", true },
 	{ "insert_rack_unit", false },
 	{ "remove_rack_unit", false },
 	{ "queryunit", true },
@@ -290,6 +296,8 @@ const jsonrpc_method_def jsonrpc_method_list[] = {
 	{ "get_oscilloscope_mul_buffer", true },
 	{ "clear_oscilloscope_buffer", false },
 	{ "get_oscilloscope_info", true },
+	{ "enable_telemetry_stream", true },
+	{ "disable_telemetry_stream", false },
 	{ "reload_impresp_list", false },
 	{ "load_impresp_dirs", true },
 	{ "read_audio", true },
@@ -52,6 +52,7 @@ enum jsonrpc_method {
 	RPCM_pluginlist,
 	RPCM_plugin_load_ui,
 	RPCM_get_rack_unit_order,
+	RPCM_get_plugin_load,
 	RPNM_insert_rack_unit,
 	RPNM_remove_rack_unit,
 	RPCM_queryunit,
@@ -73,6 +74,8 @@ enum jsonrpc_method {
 	RPCM_get_oscilloscope_mul_buffer,
 	RPNM_clear_oscilloscope_buffer,
 	RPCM_get_oscilloscope_info,
+	RPCM_enable_telemetry_stream,
+	RPNM_disable_telemetry_stream,
 	RPNM_reload_impresp_list,
 	RPCM_load_impresp_dirs,
 	RPCM_read_audio,
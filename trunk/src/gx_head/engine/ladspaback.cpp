@@ -19,6 +19,12 @@
 #include <lrdf.h>
 #include <ladspa.h>
 #include <dlfcn.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <algorithm>
 
 #include "engine.h"
 
@@ -927,22 +933,21 @@ void LadspaPluginList::add_plugin(const LADSPA_Descriptor& desc, pluginmap& d, c
 }
 
 //static
-void LadspaPluginList::load_defs(const std::string& path, pluginmap& d) {
+// (called in a LadspaScanner worker process, so errors are returned
+// instead of being logged)
+std::string LadspaPluginList::load_defs(const std::string& path, pluginmap& d) {
     void *handle;
     handle = dlopen(path.c_str(), RTLD_LOCAL|RTLD_NOW);
     if (!handle) {
-	gx_print_warning(
-	    "ladspalist",
-	    ustring::compose(_("Cannot open plugin: %1\n"), dlerror()));
-        return;
+	return ustring::compose(_("Cannot open plugin: %1\n"), dlerror());
     }
     LADSPA_Descriptor_Function ladspa_descriptor = (LADSPA_Descriptor_Function)dlsym(handle, "ladspa_descriptor");
     const char *dlsym_error = dlerror();
     if (dlsym_error) {
-	gx_print_warning("ladspalist", dlsym_error);
+	std::string err = dlsym_error;
         dlclose(handle);
         handle = 0;
-        return;
+        return err;
     }
     int i = 0;
     while (true) {
@@ -954,6 +959,7 @@ void LadspaPluginList::load_defs(const std::string& path, pluginmap& d) {
 	i += 1;
     }
     dlclose(handle);
+    return "";
 }
 
 bool PluginDesc::check_changed() {
@@ -1250,9 +1256,18 @@ LadspaPluginList::LadspaPluginList()
       lv2_ControlPort(lilv_new_uri(world, LV2_CORE__ControlPort)),
       lv2_InputPort(lilv_new_uri(world, LV2_CORE__InputPort)),
       lv2_OutputPort(lilv_new_uri(world, LV2_CORE__OutputPort)),
-      lv2_connectionOptional(lilv_new_uri(world, LV2_CORE__connectionOptional)) {
-    lilv_world_load_all(world);
-    lv2_plugins = lilv_world_get_all_plugins(world);
+      lv2_connectionOptional(lilv_new_uri(world, LV2_CORE__connectionOptional)),
+      plugin_found(),
+      scan_progress() {
+}
+
+// loading all bundles is expensive; only done when the plugin catalog
+// can't be used
+void LadspaPluginList::load_lv2_world() {
+    if (!lv2_plugins) {
+	lilv_world_load_all(world);
+	lv2_plugins = lilv_world_get_all_plugins(world);
+    }
 }
 
 static bool in_1_based_range(unsigned long uid) {
@@ -1458,7 +1473,7 @@ void LadspaPluginList::get_presets(LV2Preset *pdata) {
 	lilv_nodes_free(presets);
 }
 
-void LadspaPluginList::add_plugin(const LilvPlugin* plugin, pluginmap& d, gx_system::CmdlineOptions& options) {
+PluginDesc *LadspaPluginList::add_plugin(const LilvPlugin* plugin, gx_system::CmdlineOptions& options) {
         
     // check for requested features 
 	LilvNodes* requests = lilv_plugin_get_required_features(plugin);
@@ -1466,7 +1481,7 @@ void LadspaPluginList::add_plugin(const LilvPlugin* plugin, pluginmap& d, gx_sys
 		const char* uri = lilv_node_as_uri(lilv_nodes_get(requests, f));
 		if (uri) {
             lilv_nodes_free(requests);
-           return;
+           return 0;
 		}
 	} 
 	lilv_nodes_free(requests);
@@ -1549,9 +1564,9 @@ void LadspaPluginList::add_plugin(const LilvPlugin* plugin, pluginmap& d, gx_sys
 	for (std::vector<PortDesc*>::iterator i = ctrl_ports.begin(); i != ctrl_ports.end(); ++i) {
 	    delete *i;
 	}
-	return;
+	return 0;
     }
-    PluginDesc* p = d[lilv_node_as_string(lilv_plugin_get_uri(plugin))] = new PluginDesc(world, plugin, tp, ctrl_ports);
+    PluginDesc* p = new PluginDesc(world, plugin, tp, ctrl_ports);
     pdata.has_preset = false;
     if (options.reload_lv2_presets) {
 		if (p->path.size() != 0) {
@@ -1562,36 +1577,641 @@ void LadspaPluginList::add_plugin(const LilvPlugin* plugin, pluginmap& d, gx_sys
 			get_presets(&pdata);
 		}
     }
+    return p;
+}
+
+/****************************************************************
+ ** class PluginCatalog
+ **
+ ** plugin descriptions of the last scan, stored per LADSPA library
+ ** and LV2 bundle together with a stamp (modification time and size)
+ ** of the files they were read from
+ */
+
+static const int catalog_version = 1;
+
+#define stamp_attributes G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," G_FILE_ATTRIBUTE_STANDARD_SIZE
+
+class PluginCatalog {
+public:
+    typedef std::map<std::string, std::string> stringmap;
+    struct Entry {
+	std::string stamp;
+	bool failed;		// library crashed the scanner
+	stringmap plugins;	// plugin key -> serialized PluginDesc
+	Entry(): stamp(), failed(false), plugins() {}
+	bool operator==(const Entry& e) const {
+	    return stamp == e.stamp && failed == e.failed && plugins == e.plugins; }
+    };
+    typedef std::map<std::string, Entry> entrymap;
+    stringmap rdf;
+    entrymap ladspa;
+    bool lv2_complete;
+    entrymap lv2;
+private:
+    static void read_entries(JsonParser& jp, entrymap& m);
+    static void write_entries(JsonWriter& jw, entrymap& m);
+public:
+    PluginCatalog(): rdf(), ladspa(), lv2_complete(false), lv2() {}
+    bool operator==(const PluginCatalog& c) const {
+	return rdf == c.rdf && ladspa == c.ladspa && lv2_complete == c.lv2_complete && lv2 == c.lv2; }
+    void clear();
+    void load(const std::string& fname);
+    void save(const std::string& fname);
+};
 
+void PluginCatalog::clear() {
+    rdf.clear();
+    ladspa.clear();
+    lv2_complete = false;
+    lv2.clear();
 }
 
-void LadspaPluginList::lv2_load(pluginmap& d, gx_system::CmdlineOptions& options) {
-    for (LilvIter* it = lilv_plugins_begin(lv2_plugins);
-	  !lilv_plugins_is_end(lv2_plugins, it);
-	  it = lilv_plugins_next(lv2_plugins, it)) {
-		add_plugin(lilv_plugins_get(lv2_plugins, it), d, options);
-		if (options.reload_lv2_presets) {
-			if (pdata.has_preset && pdata.cline.size() != 0) {
-				pdata.cline.replace(pdata.cline.end()-2,pdata.cline.end()-1,"");
-				pdata.cline  += "]\n";
-				std::string pfile = options.get_lv2_preset_dir();
-				pfile += "lv2_";
-				pfile += pdata.sname;
-				ofstream os (pfile.c_str());
-				os << pdata.cline;
-				os.close();
-			}
-			pdata.has_preset = false;
+//static
+void PluginCatalog::read_entries(JsonParser& jp, entrymap& m) {
+    jp.next(JsonParser::begin_array);
+    while (jp.peek() != JsonParser::end_array) {
+	jp.next(JsonParser::begin_array);
+	jp.next(JsonParser::value_string);
+	Entry& e = m[jp.current_value()];
+	jp.next(JsonParser::value_string);
+	e.stamp = jp.current_value();
+	jp.next(JsonParser::value_number);
+	e.failed = jp.current_value_int();
+	jp.next(JsonParser::begin_object);
+	while (jp.peek() != JsonParser::end_object) {
+	    jp.next(JsonParser::value_key);
+	    std::string key = jp.current_value();
+	    gx_system::JsonStringWriter jw;
+	    jp.copy_object(jw);
+	    e.plugins[key] = jw.get_string();
+	}
+	jp.next(JsonParser::end_object);
+	jp.next(JsonParser::end_array);
+    }
+    jp.next(JsonParser::end_array);
+}
+
+//static
+void PluginCatalog::write_entries(JsonWriter& jw, entrymap& m) {
+    jw.begin_array(true);
+    for (entrymap::iterator i = m.begin(); i != m.end(); ++i) {
+	jw.begin_array();
+	jw.write(i->first);
+	jw.write(i->second.stamp);
+	jw.write(i->second.failed);
+	jw.begin_object();
+	for (stringmap::iterator p = i->second.plugins.begin(); p != i->second.plugins.end(); ++p) {
+	    jw.write_key(p->first);
+	    jw.write_lit(p->second);
+	}
+	jw.end_object();
+	jw.end_array(true);
+    }
+    jw.end_array(true);
+}
+
+void PluginCatalog::load(const std::string& fname) {
+    ifstream is(fname.c_str());
+    if (is.fail()) {
+	return;
+    }
+    try {
+	JsonParser jp(&is);
+	jp.next(JsonParser::begin_object);
+	jp.next(JsonParser::value_key);
+	if (jp.current_value() != "version") {
+	    throw JsonException("version expected");
+	}
+	jp.next(JsonParser::value_number);
+	if (jp.current_value_int() != catalog_version) {
+	    return; // different format: everything will be rescanned
+	}
+	while (jp.peek() != JsonParser::end_object) {
+	    jp.next(JsonParser::value_key);
+	    if (jp.current_value() == "rdf") {
+		jp.next(JsonParser::begin_array);
+		while (jp.peek() != JsonParser::end_array) {
+		    jp.next(JsonParser::begin_array);
+		    jp.next(JsonParser::value_string);
+		    std::string path = jp.current_value();
+		    jp.next(JsonParser::value_string);
+		    rdf[path] = jp.current_value();
+		    jp.next(JsonParser::end_array);
 		}
+		jp.next(JsonParser::end_array);
+	    } else if (jp.current_value() == "ladspa") {
+		read_entries(jp, ladspa);
+	    } else if (jp.current_value() == "lv2") {
+		read_entries(jp, lv2);
+	    } else if (jp.read_kv("lv2_complete", lv2_complete)) {
+	    } else {
+		jp.skip_object();
+	    }
+	}
+	jp.next(JsonParser::end_object);
+	jp.close();
+    } catch (JsonException& e) {
+	gx_print_warning(
+	    "ladspalist", ustring::compose(_("ignoring damaged plugin catalog %1"), fname));
+	clear();
     }
-    options.reload_lv2_presets = false;
+    is.close();
 }
 
-static bool cmp_plugins(const PluginDesc *a, const PluginDesc *b) {
-    return ustring(a->Name) < ustring(b->Name);
+void PluginCatalog::save(const std::string& fname) {
+    std::string tfname = fname + ".tmp";
+    ofstream tfile(tfname.c_str());
+    JsonWriter jw(&tfile);
+    jw.begin_object(true);
+    jw.write_kv("version", catalog_version);
+    jw.write_key("rdf");
+    jw.begin_array(true);
+    for (stringmap::iterator i = rdf.begin(); i != rdf.end(); ++i) {
+	jw.begin_array();
+	jw.write(i->first);
+	jw.write(i->second);
+	jw.end_array(true);
+    }
+    jw.end_array(true);
+    jw.write_key("ladspa");
+    write_entries(jw, ladspa);
+    jw.write_kv("lv2_complete", lv2_complete);
+    jw.write_key("lv2");
+    write_entries(jw, lv2);
+    jw.end_object(true);
+    jw.close();
+    tfile.close();
+    if (tfile.fail()) {
+	gx_print_error(
+	    "ladspalist", ustring::compose(_("error writing plugin catalog '%1'"), tfname));
+	unlink(tfname.c_str());
+	return;
+    }
+    if (rename(tfname.c_str(), fname.c_str()) != 0) {
+	char buf[100];
+	char *p = strerror_r(errno, buf, sizeof(buf));
+	gx_print_error(
+	    "ladspalist",ustring::compose(_("error renaming plugin catalog '%1': %2"), fname, p));
+    }
 }
 
-void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std::string>& old_not_found) {
+static std::string file_stamp(const Glib::RefPtr<Gio::FileInfo>& info) {
+    return ustring::compose(
+	"%1.%2:%3",
+	info->get_attribute_uint64(G_FILE_ATTRIBUTE_TIME_MODIFIED),
+	info->get_attribute_uint32(G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC),
+	info->get_size());
+}
+
+// newest modification time, total size and number of the files in
+// an LV2 bundle
+static std::string bundle_stamp(const Glib::RefPtr<Gio::File>& bundle) {
+    guint64 mtime = 0;
+    goffset size = 0;
+    int n = 0;
+    try {
+	Glib::RefPtr<Gio::FileEnumerator> child_enumeration =
+	    bundle->enumerate_children(stamp_attributes);
+	Glib::RefPtr<Gio::FileInfo> file_info;
+	while ((file_info = child_enumeration->next_file()) != 0) {
+	    guint64 t = file_info->get_attribute_uint64(G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC
+		+ file_info->get_attribute_uint32(G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	    mtime = std::max(mtime, t);
+	    size += file_info->get_size();
+	    n += 1;
+	}
+    } catch (Glib::Error& e) {
+	return "";
+    }
+    return ustring::compose("%1:%2:%3", mtime, size, n);
+}
+
+static void find_lv2_bundles(PluginCatalog::stringmap& bundles) {
+    gx_system::PathList pl("LV2_PATH");
+    if (!pl.size()) {
+	pl.add(Glib::build_filename(Glib::get_home_dir(), ".lv2"));
+	pl.add("/usr/lib/lv2");
+	pl.add("/usr/local/lib/lv2");
+	pl.add("/usr/lib64/lv2");
+	pl.add("/usr/local/lib64/lv2");
+    }
+    for (gx_system::PathList::iterator it = pl.begin(); it != pl.end(); ++it) {
+        Glib::RefPtr<Gio::File> file = *it;
+        if (!file->query_exists()) {
+            continue;
+        }
+        Glib::RefPtr<Gio::FileEnumerator> child_enumeration =
+            file->enumerate_children(G_FILE_ATTRIBUTE_STANDARD_NAME
+                                     "," G_FILE_ATTRIBUTE_STANDARD_TYPE);
+        Glib::RefPtr<Gio::FileInfo> file_info;
+
+        while ((file_info = child_enumeration->next_file()) != 0) {
+	    if (file_info->get_file_type() != Gio::FILE_TYPE_DIRECTORY) {
+		continue;
+	    }
+	    std::string nm = file_info->get_attribute_byte_string(G_FILE_ATTRIBUTE_STANDARD_NAME);
+	    std::string stamp = bundle_stamp(file->get_child(nm));
+	    if (!stamp.empty()) {
+		bundles[Glib::build_filename(file->get_path(), nm)] = stamp;
+	    }
+	}
+    }
+}
+
+static std::string bundle_path(const LilvPlugin* plugin) {
+    std::string p;
+    try {
+	p = Glib::filename_from_uri(lilv_node_as_uri(lilv_plugin_get_bundle_uri(plugin)));
+    } catch (Glib::ConvertError& e) {
+	return "";
+    }
+    if (p.size() > 1 && p[p.size()-1] == '/') {
+	p.erase(p.size()-1);
+    }
+    return p;
+}
+
+
+/****************************************************************
+ ** class LadspaScanner
+ **
+ ** dlopens LADSPA libraries in worker processes, so that a crashing
+ ** or hanging library can't take the engine down; each worker writes
+ ** one JSON line per library, tagged with the library path, into its
+ ** pipe (result_fd; stdout goes to stderr, libraries may print).
+ **
+ ** Workers are a fresh image of the guitarix binary started with
+ ** scan_option (see scanner_main()): posix_spawn doesn't duplicate
+ ** the address space of the running engine, so the jack thread gets
+ ** no copy-on-write faults while the libraries are scanned.
+ */
+
+class LadspaScanner {
+public:
+    enum status { scanned, crashed, aborted };
+    struct Result {
+	std::string path;
+	status st;
+	std::string error;
+	PluginCatalog::stringmap plugins;
+	Result(): path(), st(scanned), error(), plugins() {}
+    };
+private:
+    struct Worker {
+	pid_t pid;
+	int fd;
+	std::vector<std::string> libs;
+	unsigned int next;	// first library not yet reported
+	std::string buf;
+	gint64 last_activity;
+	Worker(): pid(-1), fd(-1), libs(), next(0), buf(), last_activity(0) {}
+    };
+    std::vector<Worker> workers;
+    std::list<Result> results;
+    unsigned int count;
+    static const gint64 timeout = 30 * G_USEC_PER_SEC;
+    static const int result_fd = 3;
+    static bool write_all(int fd, const std::string& s);
+    static std::string scan_library(const std::string& path);
+    pid_t spawn(Worker& w, int fd);
+    void start(Worker& w);
+    void stop(Worker& w, bool kill_worker);
+    void worker_finished(Worker& w, status st);
+    void read_worker(Worker& w);
+    void add_result(Worker& w, const std::string& line);
+public:
+    LadspaScanner(const std::vector<std::string>& libs);
+    ~LadspaScanner();
+    unsigned int size() const { return count; }
+    bool next(Result& r);
+    static const char scan_option[];
+    static void run_worker(int argc, char *argv[]);
+};
+
+const char LadspaScanner::scan_option[] = "--ladspa-scan";
+
+LadspaScanner::LadspaScanner(const std::vector<std::string>& libs)
+    : workers(), results(), count(libs.size()) {
+    if (libs.empty()) {
+	return;
+    }
+    long ncpu = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    workers.resize(std::min(static_cast<size_t>(ncpu), libs.size()));
+    for (unsigned int i = 0; i < libs.size(); ++i) {
+	workers[i % workers.size()].libs.push_back(libs[i]);
+    }
+    for (std::vector<Worker>::iterator w = workers.begin(); w != workers.end(); ++w) {
+	start(*w);
+    }
+}
+
+LadspaScanner::~LadspaScanner() {
+    for (std::vector<Worker>::iterator w = workers.begin(); w != workers.end(); ++w) {
+	if (w->fd >= 0) {
+	    stop(*w, true);
+	}
+    }
+}
+
+//static
+bool LadspaScanner::write_all(int fd, const std::string& s) {
+    const char *p = s.data();
+    size_t n = s.size();
+    while (n > 0) {
+	ssize_t r = write(fd, p, n);
+	if (r < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    return false;
+	}
+	p += r;
+	n -= r;
+    }
+    return true;
+}
+
+//static
+std::string LadspaScanner::scan_library(const std::string& path) {
+    LadspaPluginList::pluginmap d;
+    std::string error = LadspaPluginList::load_defs(path, d);
+    gx_system::JsonStringWriter jw;
+    jw.begin_array();
+    jw.write(path);
+    jw.write(error);
+    jw.begin_object();
+    for (LadspaPluginList::pluginmap::iterator i = d.begin(); i != d.end(); ++i) {
+	jw.write_key(i->first);
+	i->second->serializeJSON(jw);
+	delete i->second;
+    }
+    jw.end_object();
+    jw.end_array();
+    jw.finish();
+    return jw.get_string();
+}
+
+// worker process: argv[2..] are the libraries to scan, results go
+// to result_fd
+//static
+void LadspaScanner::run_worker(int argc, char *argv[]) {
+    for (int i = 2; i < argc; ++i) {
+	if (!write_all(result_fd, scan_library(argv[i]))) {
+	    break;
+	}
+    }
+}
+
+// returns the pid, or -1 if the worker couldn't be started
+pid_t LadspaScanner::spawn(Worker& w, int fd) {
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>("guitarix"));
+    argv.push_back(const_cast<char*>(scan_option));
+    for (unsigned int i = w.next; i < w.libs.size(); ++i) {
+	argv.push_back(const_cast<char*>(w.libs[i].c_str()));
+    }
+    argv.push_back(0);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fd, result_fd);
+    posix_spawn_file_actions_adddup2(&actions, 2, 1);
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    posix_spawnattr_setsigmask(&attr, &sigs);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    pid_t pid;
+    int rc = posix_spawn(&pid, "/proc/self/exe", &actions, &attr, &argv[0], environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return rc == 0 ? pid : -1;
+}
+
+void LadspaScanner::start(Worker& w) {
+    int fds[2];
+    pid_t pid = -1;
+    // close-on-exec: workers must not inherit each others pipes
+    // (dup2 to result_fd clears the flag for the write end, which
+    // therefore must not already be result_fd)
+    if (pipe2(fds, O_CLOEXEC) == 0) {
+	if (fds[1] == result_fd) {
+	    fds[1] = fcntl(result_fd, F_DUPFD_CLOEXEC, result_fd+1);
+	    close(result_fd);
+	}
+	pid = fds[1] < 0 ? -1 : spawn(w, fds[1]);
+	if (pid < 0) {
+	    close(fds[0]);
+	    if (fds[1] >= 0) {
+		close(fds[1]);
+	    }
+	}
+    }
+    if (pid < 0) {
+	gx_print_warning(
+	    "ladspalist", _("can't start plugin scanner process, scanning in-process"));
+	for (unsigned int i = w.next; i < w.libs.size(); ++i) {
+	    add_result(w, scan_library(w.libs[i]));
+	}
+	return;
+    }
+    close(fds[1]);
+    w.pid = pid;
+    w.fd = fds[0];
+    w.buf.clear();
+    w.last_activity = g_get_monotonic_time();
+}
+
+void LadspaScanner::stop(Worker& w, bool kill_worker) {
+    if (kill_worker) {
+	kill(w.pid, SIGKILL);
+    }
+    close(w.fd);
+    w.fd = -1;
+    // fails with ECHILD if the SIGCHLD handler was faster
+    while (waitpid(w.pid, 0, 0) < 0 && errno == EINTR);
+    w.pid = -1;
+}
+
+// pipe closed or worker timed out: if a library is still unreported
+// it is the culprit, the rest of the list gets a new worker
+void LadspaScanner::worker_finished(Worker& w, status st) {
+    stop(w, st == aborted);
+    if (w.next < w.libs.size()) {
+	Result r;
+	r.path = w.libs[w.next++];
+	r.st = st;
+	results.push_back(r);
+	if (w.next < w.libs.size()) {
+	    start(w);
+	}
+    }
+}
+
+// a result line is matched to its library by the path it carries;
+// lines which don't parse or don't name an unreported library of
+// this worker are dropped (the library is then reported by
+// worker_finished())
+void LadspaScanner::add_result(Worker& w, const std::string& line) {
+    Result r;
+    try {
+	std::istringstream is(line);
+	JsonParser jp(&is);
+	jp.next(JsonParser::begin_array);
+	jp.next(JsonParser::value_string);
+	r.path = jp.current_value();
+	jp.next(JsonParser::value_string);
+	r.error = jp.current_value();
+	jp.next(JsonParser::begin_object);
+	while (jp.peek() != JsonParser::end_object) {
+	    jp.next(JsonParser::value_key);
+	    std::string key = jp.current_value();
+	    gx_system::JsonStringWriter jw;
+	    jp.copy_object(jw);
+	    r.plugins[key] = jw.get_string();
+	}
+	jp.next(JsonParser::end_object);
+	jp.next(JsonParser::end_array);
+    } catch (JsonException& e) {
+	return;
+    }
+    std::vector<std::string>::iterator i = std::find(w.libs.begin() + w.next, w.libs.end(), r.path);
+    if (i == w.libs.end()) {
+	return;
+    }
+    // a worker scans its list in order, so skipped libraries
+    // produced no result line
+    for (unsigned int k = i - w.libs.begin(); w.next < k; ) {
+	Result a;
+	a.path = w.libs[w.next++];
+	a.st = aborted;
+	a.error = _("garbled scanner output");
+	results.push_back(a);
+    }
+    w.next++;
+    results.push_back(r);
+}
+
+void LadspaScanner::read_worker(Worker& w) {
+    char buf[4096];
+    ssize_t n = read(w.fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) {
+	return;
+    }
+    if (n <= 0) {
+	worker_finished(w, crashed);
+	return;
+    }
+    w.last_activity = g_get_monotonic_time();
+    w.buf.append(buf, n);
+    size_t pos;
+    while ((pos = w.buf.find('\n')) != std::string::npos) {
+	add_result(w, w.buf.substr(0, pos));
+	w.buf.erase(0, pos+1);
+    }
+}
+
+// blocks until the next library has been scanned, returns false
+// when all libraries are done
+bool LadspaScanner::next(Result& r) {
+    while (results.empty()) {
+	std::vector<pollfd> fds;
+	std::vector<Worker*> active;
+	for (std::vector<Worker>::iterator w = workers.begin(); w != workers.end(); ++w) {
+	    if (w->fd >= 0) {
+		pollfd p;
+		p.fd = w->fd;
+		p.events = POLLIN;
+		p.revents = 0;
+		fds.push_back(p);
+		active.push_back(&*w);
+	    }
+	}
+	if (fds.empty()) {
+	    return false;
+	}
+	int n = poll(&fds[0], fds.size(), 1000);
+	gint64 now = g_get_monotonic_time();
+	for (unsigned int i = 0; i < fds.size(); ++i) {
+	    if (n > 0 && fds[i].revents) {
+		read_worker(*active[i]);
+	    } else if (now - active[i]->last_activity > timeout) {
+		worker_finished(*active[i], aborted);
+	    }
+	}
+    }
+    r = results.front();
+    results.pop_front();
+    return true;
+}
+
+
+bool is_scanner(int argc, char *argv[]) {
+    return argc > 1 && strcmp(argv[1], LadspaScanner::scan_option) == 0;
+}
+
+void scanner_main(int argc, char *argv[]) {
+    LadspaScanner::run_worker(argc, argv);
+}
+
+
+/****************************************************************
+ ** LadspaPluginList: loading
+ */
+
+//static
+std::string LadspaPluginList::serialize_plugin(PluginDesc *pd) {
+    gx_system::JsonStringWriter jw;
+    pd->serializeJSON(jw);
+    return jw.get_string();
+}
+
+//static
+PluginDesc *LadspaPluginList::create_plugin(const std::string& s) {
+    std::istringstream is(s);
+    JsonParser jp(&is);
+    return new PluginDesc(jp);
+}
+
+// apply selection and user settings and pass the plugin on to the
+// display while the rest is still loading
+void LadspaPluginList::add_found(pluginmap& d, const std::string& key, PluginDesc *pd,
+				 gx_system::CmdlineOptions& options, const std::set<std::string>& selected) {
+    if (d.find(key) != d.end()) {
+	delete pd; // same UniqueID in 2 libraries: first one wins
+	return;
+    }
+    d[key] = pd;
+    if (selected.find(key) != selected.end()) {
+	pd->set_active(true);
+	pd->active_set = true;
+    }
+    pd->fixup();
+    std::string s;
+    if (pd->is_lv2) {
+	s = gx_system::encode_filename(pd->path) + ".js";
+    } else {
+	s = gx_engine::LadspaLoader::get_ladspa_filename(key);
+    }
+    std::string fname = options.get_plugin_filepath(s);
+    if (access(fname.c_str(), F_OK) != 0) {
+	fname = options.get_factory_filepath(s);
+	if (access(fname.c_str(), F_OK) != 0) {
+	    fname = "";
+	}
+    }
+    if (!fname.empty()) {
+	pd->set_state(fname);
+    }
+    plugin_found(pd);
+}
+
+// use the catalog entries of unchanged libraries, return the rest
+// in scan
+void LadspaPluginList::ladspa_load_cached(
+    pluginmap& d, std::vector<std::string>& scan, gx_system::CmdlineOptions& options,
+    PluginCatalog& old_catalog, PluginCatalog& catalog, const std::set<std::string>& selected) {
     gx_system::PathList pl("LADSPA_PATH");
     if (!pl.size()) {
         pl.add("/usr/lib/ladspa");
@@ -1599,7 +2219,7 @@ void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std:
         pl.add("/usr/lib64/ladspa");
         pl.add("/usr/local/lib64/ladspa");
     }
-    pluginmap d;
+    PluginCatalog::stringmap libs;
     for (gx_system::PathList::iterator it = pl.begin(); it != pl.end(); ++it) {
         Glib::RefPtr<Gio::File> file = *it;
         if (!file->query_exists()) {
@@ -1608,7 +2228,8 @@ void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std:
         Glib::RefPtr<Gio::FileEnumerator> child_enumeration =
             file->enumerate_children(G_FILE_ATTRIBUTE_STANDARD_NAME
                                      "," G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME
-                                     "," G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+                                     "," G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+				     "," stamp_attributes);
         Glib::RefPtr<Gio::FileInfo> file_info;
 
         while ((file_info = child_enumeration->next_file()) != 0) {
@@ -1617,8 +2238,7 @@ void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std:
                 if (lib_is_blacklisted(nm)) {
                     continue;
                 }
-		//printf("opening %s/%s\n", file->get_path().c_str(), nm.c_str());
-		load_defs(Glib::build_filename(file->get_path(), nm), d);
+		libs[Glib::build_filename(file->get_path(), nm)] = file_stamp(file_info);
             }
         }
     }
@@ -1627,7 +2247,6 @@ void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std:
         rpl.add("/usr/share/ladspa/rdf");
         rpl.add("/usr/local/share/ladspa/rdf");
     }
-    lrdf_init();
     for (gx_system::PathList::iterator it = rpl.begin(); it != rpl.end(); ++it) {
         Glib::RefPtr<Gio::File> file = *it;
         if (!file->query_exists()) {
@@ -1636,7 +2255,8 @@ void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std:
         Glib::RefPtr<Gio::FileEnumerator> child_enumeration =
             file->enumerate_children(G_FILE_ATTRIBUTE_STANDARD_NAME
                                      "," G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME
-                                     "," G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+                                     "," G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+				     "," stamp_attributes);
         Glib::RefPtr<Gio::FileInfo> file_info;
 
         while ((file_info = child_enumeration->next_file()) != 0) {
@@ -1646,22 +2266,172 @@ void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std:
                 if (lib_is_blacklisted(nm)) {
                     continue;
                 }
-                lrdf_read_file(("file://"+Glib::build_filename(file->get_path(), nm)).c_str());
+		catalog.rdf[Glib::build_filename(file->get_path(), nm)] = file_stamp(file_info);
             }
         }
     }
+    // the catalog holds the descriptions with RDF data applied, so
+    // any RDF change invalidates all of them (except known crashers)
+    bool rdf_changed = (catalog.rdf != old_catalog.rdf);
+    for (PluginCatalog::stringmap::iterator i = libs.begin(); i != libs.end(); ++i) {
+	PluginCatalog::entrymap::iterator e = old_catalog.ladspa.find(i->first);
+	if (e != old_catalog.ladspa.end() && e->second.stamp == i->second
+	    && (e->second.failed || !rdf_changed)) {
+	    catalog.ladspa[i->first] = e->second;
+	    for (PluginCatalog::stringmap::iterator p = e->second.plugins.begin(); p != e->second.plugins.end(); ++p) {
+		add_found(d, p->first, create_plugin(p->second), options, selected);
+	    }
+	} else {
+	    catalog.ladspa[i->first].stamp = i->second;
+	    scan.push_back(i->first);
+	}
+    }
+}
+
+void LadspaPluginList::ladspa_collect(LadspaScanner& scanner, pluginmap& d, gx_system::CmdlineOptions& options,
+				      PluginCatalog& catalog, const std::set<std::string>& selected) {
+    if (!scanner.size()) {
+	return;
+    }
+    pluginmap dn;
+    unsigned int done = 0;
+    scan_progress(done, scanner.size());
+    LadspaScanner::Result r;
+    while (scanner.next(r)) {
+	scan_progress(++done, scanner.size());
+	if (r.st == LadspaScanner::aborted) {
+	    // not cached, will be tried again next time
+	    gx_print_warning(
+		"ladspalist", ustring::compose(
+		    _("scanning plugin library %1 failed: %2"), r.path,
+		    r.error.empty() ? _("timeout") : r.error));
+	    catalog.ladspa.erase(r.path);
+	    continue;
+	}
+	if (r.st == LadspaScanner::crashed) {
+	    gx_print_warning(
+		"ladspalist", ustring::compose(
+		    _("plugin library %1 crashed, ignored until it is changed"), r.path));
+	    catalog.ladspa[r.path].failed = true;
+	    continue;
+	}
+	if (!r.error.empty()) {
+	    gx_print_warning("ladspalist", r.error);
+	}
+	for (PluginCatalog::stringmap::iterator p = r.plugins.begin(); p != r.plugins.end(); ++p) {
+	    if (dn.find(p->first) == dn.end()) {
+		dn[p->first] = create_plugin(p->second);
+	    }
+	}
+    }
+    if (dn.empty()) {
+	return;
+    }
+    lrdf_init();
+    for (PluginCatalog::stringmap::iterator i = catalog.rdf.begin(); i != catalog.rdf.end(); ++i) {
+	lrdf_read_file(("file://"+i->first).c_str());
+    }
     std::vector<unsigned long> not_found;
     std::set<unsigned long> seen;
     std::vector<ustring> base;
     locale_t loc = newlocale(LC_ALL, "C", 0);
     uselocale(loc);
-    descend(LADSPA_BASE "Plugin", d, not_found, seen, base);
+    descend(LADSPA_BASE "Plugin", dn, not_found, seen, base);
     uselocale(LC_GLOBAL_LOCALE);
     freelocale(loc);
     lrdf_cleanup();
+    for (pluginmap::iterator i = dn.begin(); i != dn.end(); ++i) {
+	catalog.ladspa[i->second->path].plugins[i->first] = serialize_plugin(i->second);
+	add_found(d, i->first, i->second, options, selected);
+    }
+}
+
+void LadspaPluginList::lv2_load(pluginmap& d, gx_system::CmdlineOptions& options,
+				PluginCatalog& old_catalog, PluginCatalog& catalog, const std::set<std::string>& selected) {
+    PluginCatalog::stringmap bundles;
+    find_lv2_bundles(bundles);
+    for (PluginCatalog::stringmap::iterator b = bundles.begin(); b != bundles.end(); ++b) {
+	catalog.lv2[b->first].stamp = b->second;
+    }
+    if (!options.reload_lv2_presets && old_catalog.lv2_complete && old_catalog.lv2.size() == catalog.lv2.size()) {
+	bool unchanged = true;
+	for (PluginCatalog::entrymap::iterator e = catalog.lv2.begin(), o = old_catalog.lv2.begin();
+	     e != catalog.lv2.end(); ++e, ++o) {
+	    if (e->first != o->first || e->second.stamp != o->second.stamp) {
+		unchanged = false;
+		break;
+	    }
+	}
+	if (unchanged) {
+	    // no need to load the lilv world at all
+	    catalog.lv2 = old_catalog.lv2;
+	    catalog.lv2_complete = true;
+	    for (PluginCatalog::entrymap::iterator e = catalog.lv2.begin(); e != catalog.lv2.end(); ++e) {
+		for (PluginCatalog::stringmap::iterator p = e->second.plugins.begin(); p != e->second.plugins.end(); ++p) {
+		    add_found(d, p->first, create_plugin(p->second), options, selected);
+		}
+	    }
+	    return;
+	}
+    }
+    load_lv2_world();
+    bool complete = true;
+    for (LilvIter* it = lilv_plugins_begin(lv2_plugins);
+	  !lilv_plugins_is_end(lv2_plugins, it);
+	  it = lilv_plugins_next(lv2_plugins, it)) {
+		const LilvPlugin* plugin = lilv_plugins_get(lv2_plugins, it);
+		std::string uri = lilv_node_as_string(lilv_plugin_get_uri(plugin));
+		PluginCatalog::entrymap::iterator e = catalog.lv2.find(bundle_path(plugin));
+		if (e == catalog.lv2.end()) {
+			complete = false; // bundle outside the known directories
+		} else if (!options.reload_lv2_presets) {
+			PluginCatalog::entrymap::iterator o = old_catalog.lv2.find(e->first);
+			if (o != old_catalog.lv2.end() && o->second.stamp == e->second.stamp) {
+				// plugins missing in an unchanged bundle have been rejected before
+				PluginCatalog::stringmap::iterator p = o->second.plugins.find(uri);
+				if (p != o->second.plugins.end()) {
+					e->second.plugins.insert(*p);
+					add_found(d, uri, create_plugin(p->second), options, selected);
+				}
+				continue;
+			}
+		}
+		PluginDesc *pd = add_plugin(plugin, options);
+		if (options.reload_lv2_presets) {
+			if (pdata.has_preset && pdata.cline.size() != 0) {
+				pdata.cline.replace(pdata.cline.end()-2,pdata.cline.end()-1,"");
+				pdata.cline  += "]\n";
+				std::string pfile = options.get_lv2_preset_dir();
+				pfile += "lv2_";
+				pfile += pdata.sname;
+				ofstream os (pfile.c_str());
+				os << pdata.cline;
+				os.close();
+			}
+			pdata.has_preset = false;
+		}
+		if (!pd) {
+			continue;
+		}
+		// use the serialized form, so that the plugin is the same
+		// whether scanned now or taken from the catalog
+		std::string s = serialize_plugin(pd);
+		delete pd;
+		if (e != catalog.lv2.end()) {
+			e->second.plugins[uri] = s;
+		}
+		add_found(d, uri, create_plugin(s), options, selected);
+    }
+    catalog.lv2_complete = complete;
+    options.reload_lv2_presets = false;
+}
 
-    lv2_load(d, options);
+static bool cmp_plugins(const PluginDesc *a, const PluginDesc *b) {
+    return ustring(a->Name) < ustring(b->Name);
+}
 
+void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std::string>& old_not_found) {
+    std::vector<std::string> selection;
     ifstream is(options.get_ladspa_config_filename().c_str());
     if (!is.fail()) {
 	try {
@@ -1678,12 +2448,7 @@ void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std:
 		    unsigned long uid = jp.current_value_uint();
 		    key = make_key(uid);
 		}
-		if (d.find(key) == d.end()) {
-		    old_not_found.push_back(key);
-		} else {
-		    d[key]->set_active(true);
-		    d[key]->active_set = true;
-		}
+		selection.push_back(key);
 		jp.next(JsonParser::value_string); // Label
 		jp.next(JsonParser::end_array);
 	    }
@@ -1696,23 +2461,24 @@ void LadspaPluginList::load(gx_system::CmdlineOptions& options, std::vector<std:
 	}
 	is.close();
     }
-    for (pluginmap::iterator v = d.begin(); v != d.end(); ++v) {
-	v->second->fixup();
-	std::string s;
-	if (v->second->is_lv2) {
-	    s = gx_system::encode_filename(v->second->path) + ".js";
-	} else {
-	    s = gx_engine::LadspaLoader::get_ladspa_filename(v->first);
-	}
-	std::string fname = options.get_plugin_filepath(s);
-	if (access(fname.c_str(), F_OK) != 0) {
-	    fname = options.get_factory_filepath(s);
-	    if (access(fname.c_str(), F_OK) != 0) {
-		fname = "";
-	    }
-	}
-	if (!fname.empty()) {
-	    v->second->set_state(fname);
+    std::set<std::string> selected(selection.begin(), selection.end());
+    PluginCatalog old_catalog;
+    old_catalog.load(options.get_plugin_catalog_filename());
+    PluginCatalog catalog;
+    pluginmap d;
+    std::vector<std::string> scan;
+    ladspa_load_cached(d, scan, options, old_catalog, catalog, selected);
+    // changed LADSPA libraries are scanned by child processes while
+    // the LV2 plugins are loaded
+    LadspaScanner scanner(scan);
+    lv2_load(d, options, old_catalog, catalog, selected);
+    ladspa_collect(scanner, d, options, catalog, selected);
+    if (!(catalog == old_catalog)) {
+	catalog.save(options.get_plugin_catalog_filename());
+    }
+    for (std::vector<std::string>::iterator i = selection.begin(); i != selection.end(); ++i) {
+	if (d.find(*i) == d.end()) {
+	    old_not_found.push_back(*i);
 	}
     }
     for (pluginmap::iterator i = d.begin(); i != d.end(); ++i) {
@@ -1779,7 +2545,9 @@ void LadspaPluginList::save(gx_system::CmdlineOptions& options) {
 void LadspaPluginList::readJSON(gx_system::JsonParser& jp) {
     jp.next(gx_system::JsonParser::begin_array);
     while (jp.peek() != gx_system::JsonParser::end_array) {
-	push_back(new ladspa::PluginDesc(jp));
+	PluginDesc *pd = new ladspa::PluginDesc(jp);
+	push_back(pd);
+	plugin_found(pd);
     }
     jp.next(gx_system::JsonParser::end_array);
 }
@@ -18,6 +18,10 @@
 
 #include <dlfcn.h>
 #include <ladspa.h>
+#include "lv2/lv2plug.in/ns/ext/atom/atom.h"
+#include "lv2/lv2plug.in/ns/ext/buf-size/buf-size.h"
+#include "lv2/lv2plug.in/ns/ext/options/options.h"
+#include "lv2/lv2plug.in/ns/ext/worker/worker.h"
 
 #include "engine.h"
 
@@ -490,8 +494,8 @@ int LadspaDsp::registerparam(const ParamReg& reg) {
 	    switch (d->tp) {
 	    case tp_none:           tp = "S";  break;
 	    case tp_int:            tp = "S";  break;
-	    case tp_scale:          tp = "S";  break;
-	    case tp_scale_log:      tp = "SL"; break;
+	    case tp_scale:          tp = "SZ"; break;
+	    case tp_scale_log:      tp = "SLZ"; break;
 	    case tp_toggle:         tp = "B";  break;
 	    case tp_display:        tp = "SO"; break;
 	    case tp_display_toggle: tp = "BO"; break;
@@ -599,12 +603,225 @@ void LadspaDsp::del_instance(PluginDef *plugin) {
 }
 
 
+/****************************************************************
+ ** class LV2Urids
+ **
+ ** process wide URI <-> URID table for hosted LV2 plugins
+ */
+
+class LV2Urids {
+private:
+    boost::mutex mutex;
+    std::map<std::string, LV2_URID> ids;
+    std::vector<const char*> uris;  // URID n is uris[n-1], points into ids
+    LV2_URID_Map map_data;
+    LV2_URID_Unmap unmap_data;
+    static LV2_URID do_map(LV2_URID_Map_Handle handle, const char *uri);
+    static const char *do_unmap(LV2_URID_Unmap_Handle handle, LV2_URID urid);
+public:
+    LV2_Feature map_feature;
+    LV2_Feature unmap_feature;
+    LV2Urids();
+    LV2_URID map(const char *uri);
+    const char *unmap(LV2_URID urid);
+};
+
+static LV2Urids lv2_urids;
+
+LV2Urids::LV2Urids()
+    : mutex(), ids(), uris(), map_data(), unmap_data(), map_feature(), unmap_feature() {
+    map_data.handle = this;
+    map_data.map = do_map;
+    unmap_data.handle = this;
+    unmap_data.unmap = do_unmap;
+    map_feature.URI = LV2_URID__map;
+    map_feature.data = &map_data;
+    unmap_feature.URI = LV2_URID__unmap;
+    unmap_feature.data = &unmap_data;
+}
+
+LV2_URID LV2Urids::map(const char *uri) {
+    boost::mutex::scoped_lock lock(mutex);
+    std::pair<std::map<std::string, LV2_URID>::iterator, bool> r =
+	ids.insert(std::pair<std::string, LV2_URID>(uri, uris.size() + 1));
+    if (r.second) {
+	uris.push_back(r.first->first.c_str());
+    }
+    return r.first->second;
+}
+
+const char *LV2Urids::unmap(LV2_URID urid) {
+    boost::mutex::scoped_lock lock(mutex);
+    if (urid == 0 || urid > uris.size()) {
+	return 0;
+    }
+    return uris[urid-1];
+}
+
+LV2_URID LV2Urids::do_map(LV2_URID_Map_Handle handle, const char *uri) {
+    return static_cast<LV2Urids*>(handle)->map(uri);
+}
+
+const char *LV2Urids::do_unmap(LV2_URID_Unmap_Handle handle, LV2_URID urid) {
+    return static_cast<LV2Urids*>(handle)->unmap(urid);
+}
+
+
+/****************************************************************
+ ** class LV2Worker
+ **
+ ** host side of the LV2 worker extension: requests scheduled
+ ** from run() are passed through a ringbuffer to a non-realtime
+ ** thread, responses are handed back to the plugin after the
+ ** next run() in the audio thread.
+ */
+
+class LV2Worker {
+private:
+    enum { ring_size = 16384 };
+    const LV2_Worker_Interface *iface;
+    LV2_Handle handle;
+    jack_ringbuffer_t *requests;
+    jack_ringbuffer_t *responses;
+    std::vector<char> work_buf;
+    std::vector<char> response_buf;
+    sem_t trig;
+    pthread_t thread;
+    volatile bool stop;
+    LV2_Worker_Schedule schedule;
+    static bool write_msg(jack_ringbuffer_t *rb, uint32_t size, const void *data);
+    static bool read_msg(jack_ringbuffer_t *rb, std::vector<char>& buf, uint32_t *size);
+    static LV2_Worker_Status schedule_work(LV2_Worker_Schedule_Handle h, uint32_t size, const void *data);
+    static LV2_Worker_Status respond(LV2_Worker_Respond_Handle h, uint32_t size, const void *data);
+    static void *run_thread(void *p);
+    void run();
+public:
+    LV2_Feature feature;
+    LV2Worker();
+    ~LV2Worker();
+    void set_instance(LilvInstance *instance);
+    inline void end_run();
+};
+
+LV2Worker::LV2Worker()
+    : iface(), handle(), requests(jack_ringbuffer_create(ring_size)),
+      responses(jack_ringbuffer_create(ring_size)), work_buf(ring_size),
+      response_buf(ring_size), trig(), thread(), stop(false), schedule(), feature() {
+    jack_ringbuffer_mlock(requests);
+    jack_ringbuffer_mlock(responses);
+    sem_init(&trig, 0, 0);
+    schedule.handle = this;
+    schedule.schedule_work = schedule_work;
+    feature.URI = LV2_WORKER__schedule;
+    feature.data = &schedule;
+}
+
+LV2Worker::~LV2Worker() {
+    if (thread) {
+	stop = true;
+	sem_post(&trig);
+	pthread_join(thread, NULL);
+    }
+    sem_destroy(&trig);
+    jack_ringbuffer_free(requests);
+    jack_ringbuffer_free(responses);
+}
+
+void LV2Worker::set_instance(LilvInstance *instance) {
+    iface = static_cast<const LV2_Worker_Interface*>(
+	lilv_instance_get_extension_data(instance, LV2_WORKER__interface));
+    handle = lilv_instance_get_handle(instance);
+    if (!iface) {
+	return;
+    }
+    // requests scheduled while instantiating are still in the ring
+    if (pthread_create(&thread, NULL, run_thread, this)) {
+	thread = 0;
+	gx_print_error("lv2loader", _("can't start LV2 worker thread"));
+    }
+}
+
+bool LV2Worker::write_msg(jack_ringbuffer_t *rb, uint32_t size, const void *data) {
+    if (jack_ringbuffer_write_space(rb) < sizeof(size) + size) {
+	return false;
+    }
+    jack_ringbuffer_write(rb, reinterpret_cast<const char*>(&size), sizeof(size));
+    jack_ringbuffer_write(rb, static_cast<const char*>(data), size);
+    return true;
+}
+
+bool LV2Worker::read_msg(jack_ringbuffer_t *rb, std::vector<char>& buf, uint32_t *size) {
+    uint32_t sz;
+    if (jack_ringbuffer_read_space(rb) < sizeof(sz)) {
+	return false;
+    }
+    jack_ringbuffer_peek(rb, reinterpret_cast<char*>(&sz), sizeof(sz));
+    if (jack_ringbuffer_read_space(rb) < sizeof(sz) + sz) {
+	return false; // writer not finished yet
+    }
+    jack_ringbuffer_read_advance(rb, sizeof(sz));
+    jack_ringbuffer_read(rb, &buf[0], sz);
+    *size = sz;
+    return true;
+}
+
+LV2_Worker_Status LV2Worker::schedule_work(LV2_Worker_Schedule_Handle h, uint32_t size, const void *data) {
+    LV2Worker& self = *static_cast<LV2Worker*>(h);
+    if (!write_msg(self.requests, size, data)) {
+	return LV2_WORKER_ERR_NO_SPACE;
+    }
+    sem_post(&self.trig);
+    return LV2_WORKER_SUCCESS;
+}
+
+LV2_Worker_Status LV2Worker::respond(LV2_Worker_Respond_Handle h, uint32_t size, const void *data) {
+    if (!write_msg(static_cast<LV2Worker*>(h)->responses, size, data)) {
+	return LV2_WORKER_ERR_NO_SPACE;
+    }
+    return LV2_WORKER_SUCCESS;
+}
+
+void *LV2Worker::run_thread(void *p) {
+    static_cast<LV2Worker*>(p)->run();
+    return NULL;
+}
+
+void LV2Worker::run() {
+    for (;;) {
+	sem_wait(&trig);
+	if (stop) {
+	    break;
+	}
+	uint32_t size;
+	while (read_msg(requests, work_buf, &size)) {
+	    iface->work(handle, respond, this, size, &work_buf[0]);
+	}
+    }
+}
+
+inline void LV2Worker::end_run() {
+    if (!iface) {
+	return;
+    }
+    uint32_t size;
+    while (read_msg(responses, response_buf, &size)) {
+	if (iface->work_response) {
+	    iface->work_response(handle, size, &response_buf[0]);
+	}
+    }
+    if (iface->end_run) {
+	iface->end_run(handle);
+    }
+}
+
+
 /****************************************************************
  ** class Lv2Dsp
  */
 
 class Lv2Dsp: public PluginDef {
 private:
+    enum { max_block_length = 8192 };
     static void init(unsigned int samplingFreq, PluginDef *plugin);
     static void mono_process(int count, float *input, float *output, PluginDef *plugin);
     static void stereo_process(int count, float *input1, float *input2, float *output1, float *output2, PluginDef *plugin);
@@ -621,7 +838,18 @@ private:
     Glib::ustring name_str;
     const plugdesc *pd;
     bool is_activated;
-    void connect(const LilvNode* tp, int i, float *v);
+    unsigned int audio_in[2];
+    unsigned int audio_out[2];
+    float *wet_buf;
+    bool use_worker;
+    LV2Worker *worker;
+    int32_t block_length[2];
+    LV2_Options_Option options[3];
+    LV2_Feature options_feature;
+    const LV2_Feature *features[6];
+    void map_audio_ports();
+    void setup_options();
+    inline void run(int count);
     inline void cleanup();
     void set_shortname();
     float dry_wet;
@@ -636,6 +864,8 @@ public:
     void set_plugdesc(const plugdesc* pd_);
 };
 
+static const LV2_Feature lv2_bounded_block_length = { LV2_BUF_SIZE__boundedBlockLength, 0 };
+
 Lv2Dsp *Lv2Dsp::create(const plugdesc *plug, const LadspaLoader& loader) {
     LilvNode* plugin_uri = lilv_new_uri(loader.world, plug->path.c_str());
     const LilvPlugin* plugin = lilv_plugins_get_by_uri(loader.lv2_plugins, plugin_uri);
@@ -666,7 +896,9 @@ Lv2Dsp *Lv2Dsp::create(const plugdesc *plug, const LadspaLoader& loader) {
 
 Lv2Dsp::Lv2Dsp(const plugdesc *plug, const LilvPlugin* plugin_, const LadspaLoader& loader_, bool mono)
     : PluginDef(), loader(loader_), plugin(plugin_), name_node(lilv_plugin_get_name(plugin_)), instance(),
-      ports(new LADSPA_Data[lilv_plugin_get_num_ports(plugin_)]), name_str(), pd(plug), is_activated(false) {
+      ports(new LADSPA_Data[lilv_plugin_get_num_ports(plugin_)]), name_str(), pd(plug), is_activated(false),
+      audio_in(), audio_out(), wet_buf(new float[2*max_block_length]), use_worker(false), worker(),
+      block_length(), options(), options_feature(), features() {
     version = PLUGINDEF_VERSION;
     id = pd->id_str.c_str();
     category = pd->category.c_str();
@@ -683,6 +915,13 @@ Lv2Dsp::Lv2Dsp(const plugdesc *plug, const LilvPlugin* plugin_, const LadspaLoad
     register_params = registerparam;
     load_ui = uiloader;
     delete_instance = del_instance;
+    map_audio_ports();
+    setup_options();
+    LilvNode *schedule = lilv_new_uri(loader.world, LV2_WORKER__schedule);
+    LilvNode *iface = lilv_new_uri(loader.world, LV2_WORKER__interface);
+    use_worker = lilv_plugin_has_feature(plugin, schedule) || lilv_plugin_has_extension_data(plugin, iface);
+    lilv_node_free(schedule);
+    lilv_node_free(iface);
 }
 
 inline void Lv2Dsp::cleanup() {
@@ -691,6 +930,9 @@ inline void Lv2Dsp::cleanup() {
 	    activate(true, this);
 	}
 	activate(false, this);
+	// worker thread must not call into a freed instance
+	delete worker;
+	worker = 0;
 	if (!(pd->quirks & no_cleanup)) {
 	    lilv_instance_free(instance);
 	}
@@ -701,6 +943,7 @@ inline void Lv2Dsp::cleanup() {
 Lv2Dsp::~Lv2Dsp() {
     cleanup();
     delete[] ports;
+    delete[] wet_buf;
     lilv_node_free(name_node);
 }
 
@@ -709,6 +952,9 @@ int Lv2Dsp::activate(bool start, PluginDef *plugin) {
     if (start == self.is_activated) {
 	return 0;
     }
+    if (!self.instance) {
+	return -1;
+    }
     self.is_activated = start;
     if (start) {
 	lilv_instance_activate(self.instance);
@@ -718,22 +964,50 @@ int Lv2Dsp::activate(bool start, PluginDef *plugin) {
     return 0;
 }
 
-void Lv2Dsp::connect(const LilvNode* tp, int i, float *v) {
+// audio port indices are resolved once, the process functions
+// only connect buffers
+void Lv2Dsp::map_audio_ports() {
+    unsigned int n_in = 0;
+    unsigned int n_out = 0;
     unsigned int num_ports = lilv_plugin_get_num_ports(plugin);
     for (unsigned int n = 0; n < num_ports; ++n) {
 	const LilvPort* port = lilv_plugin_get_port_by_index(plugin, n);
 	if (!lilv_port_is_a(plugin, port, loader.lv2_AudioPort)) {
 	    continue;
 	}
-	if (lilv_port_is_a(plugin, port, tp)) {
-	    if (i == 0) {
-		lilv_instance_connect_port(instance, n, v);
-		return;
+	if (lilv_port_is_a(plugin, port, loader.lv2_InputPort)) {
+	    if (n_in < 2) {
+		audio_in[n_in++] = n;
+	    }
+	} else if (lilv_port_is_a(plugin, port, loader.lv2_OutputPort)) {
+	    if (n_out < 2) {
+		audio_out[n_out++] = n;
 	    }
-	    i -= 1;
 	}
     }
-    gx_print_error("lv2loader", _("audio port not found"));
+}
+
+// run() is never called with more than max_block_length frames
+// (process functions split larger periods)
+void Lv2Dsp::setup_options() {
+    block_length[0] = 1;
+    block_length[1] = max_block_length;
+    LV2_URID atom_int = lv2_urids.map(LV2_ATOM__Int);
+    options[0].context = LV2_OPTIONS_INSTANCE;
+    options[0].subject = 0;
+    options[0].key = lv2_urids.map(LV2_BUF_SIZE__minBlockLength);
+    options[0].size = sizeof(int32_t);
+    options[0].type = atom_int;
+    options[0].value = &block_length[0];
+    options[1].context = LV2_OPTIONS_INSTANCE;
+    options[1].subject = 0;
+    options[1].key = lv2_urids.map(LV2_BUF_SIZE__maxBlockLength);
+    options[1].size = sizeof(int32_t);
+    options[1].type = atom_int;
+    options[1].value = &block_length[1];
+    // options[2] stays zeroed as terminator
+    options_feature.URI = LV2_OPTIONS__options;
+    options_feature.data = options;
 }
 
 void Lv2Dsp::set_plugdesc(const plugdesc* pd_) {
@@ -761,13 +1035,39 @@ void Lv2Dsp::init(unsigned int samplingFreq, PluginDef *pldef) {
     if (samplingFreq == 0) {
 	return;
     }
-    self.instance = lilv_plugin_instantiate(self.plugin, samplingFreq, 0);
+    int nf = 0;
+    self.features[nf++] = &lv2_urids.map_feature;
+    self.features[nf++] = &lv2_urids.unmap_feature;
+    self.features[nf++] = &self.options_feature;
+    self.features[nf++] = &lv2_bounded_block_length;
+    if (self.use_worker) {
+	self.worker = new LV2Worker();
+	self.features[nf++] = &self.worker->feature;
+    }
+    self.features[nf] = 0;
+    self.instance = lilv_plugin_instantiate(self.plugin, samplingFreq, self.features);
+    if (!self.instance) {
+	gx_print_error("lv2loader",ustring::compose(_("Cannot instantiate LV2 plugin: %1"), self.name));
+	delete self.worker;
+	self.worker = 0;
+	return;
+    }
+    if (self.worker) {
+	self.worker->set_instance(self.instance);
+    }
     int n = 0;
     for (std::vector<paradesc*>::const_iterator it = self.pd->names.begin(); it != self.pd->names.end(); ++it, ++n) {
 	lilv_instance_connect_port(self.instance, (*it)->index, &self.ports[(*it)->index]);
     }
 }
 
+inline void Lv2Dsp::run(int count) {
+    lilv_instance_run(instance, count);
+    if (worker) {
+	worker->end_run();
+    }
+}
+
 inline void Lv2Dsp::mono_dry_wet(int count, float *input0, float *input1, float *output0)
 {
 	double 	fSlow0 = (0.01 * dry_wet);
@@ -779,17 +1079,24 @@ inline void Lv2Dsp::mono_dry_wet(int count, float *input0, float *input1, float
 
 void Lv2Dsp::mono_process(int count, float *input, float *output, PluginDef *plugin) {
     Lv2Dsp& self = *static_cast<Lv2Dsp*>(plugin);
+    if (!self.instance) {
+	if (output != input) {
+	    memcpy(output, input, count * sizeof(float));
+	}
+	return;
+    }
     assert(self.is_activated);
-    if (self.pd->add_wet_dry) {
-	float wet_out[count];
-	self.connect(self.loader.lv2_InputPort, 0, input);
-	self.connect(self.loader.lv2_OutputPort, 0, wet_out);
-	lilv_instance_run(self.instance, count);
-	self.mono_dry_wet(count, input, wet_out, output);
-    } else {
-	self.connect(self.loader.lv2_InputPort, 0, input);
-	self.connect(self.loader.lv2_OutputPort, 0, output);
-	lilv_instance_run(self.instance, count);
+    for (int i = 0; i < count; i += max_block_length) {
+	int n = min(count - i, static_cast<int>(max_block_length));
+	lilv_instance_connect_port(self.instance, self.audio_in[0], input+i);
+	if (self.pd->add_wet_dry) {
+	    lilv_instance_connect_port(self.instance, self.audio_out[0], self.wet_buf);
+	    self.run(n);
+	    self.mono_dry_wet(n, input+i, self.wet_buf, output+i);
+	} else {
+	    lilv_instance_connect_port(self.instance, self.audio_out[0], output+i);
+	    self.run(n);
+	}
     }
 }
 
@@ -805,22 +1112,32 @@ inline void Lv2Dsp::stereo_dry_wet(int count, float *input0, float *input1, floa
 
 void Lv2Dsp::stereo_process(int count, float *input1, float *input2, float *output1, float *output2, PluginDef *plugin) {
     Lv2Dsp& self = *static_cast<Lv2Dsp*>(plugin);
+    if (!self.instance) {
+	if (output1 != input1) {
+	    memcpy(output1, input1, count * sizeof(float));
+	}
+	if (output2 != input2) {
+	    memcpy(output2, input2, count * sizeof(float));
+	}
+	return;
+    }
     assert(self.is_activated);
-    if (self.pd->add_wet_dry) {
-	float wet_out1[count];
-	float wet_out2[count];
-	self.connect(self.loader.lv2_InputPort, 0, input1);
-	self.connect(self.loader.lv2_InputPort, 1, input2);
-	self.connect(self.loader.lv2_OutputPort, 0, wet_out1);
-	self.connect(self.loader.lv2_OutputPort, 1, wet_out2);
-	lilv_instance_run(self.instance, count);
-	self.stereo_dry_wet(count, input1, input2, wet_out1, wet_out2, output1, output2);
-    } else {
-	self.connect(self.loader.lv2_InputPort, 0, input1);
-	self.connect(self.loader.lv2_InputPort, 1, input2);
-	self.connect(self.loader.lv2_OutputPort, 0, output1);
-	self.connect(self.loader.lv2_OutputPort, 1, output2);
-	lilv_instance_run(self.instance, count);
+    for (int i = 0; i < count; i += max_block_length) {
+	int n = min(count - i, static_cast<int>(max_block_length));
+	lilv_instance_connect_port(self.instance, self.audio_in[0], input1+i);
+	lilv_instance_connect_port(self.instance, self.audio_in[1], input2+i);
+	if (self.pd->add_wet_dry) {
+	    float *wet_out1 = self.wet_buf;
+	    float *wet_out2 = self.wet_buf + max_block_length;
+	    lilv_instance_connect_port(self.instance, self.audio_out[0], wet_out1);
+	    lilv_instance_connect_port(self.instance, self.audio_out[1], wet_out2);
+	    self.run(n);
+	    self.stereo_dry_wet(n, input1+i, input2+i, wet_out1, wet_out2, output1+i, output2+i);
+	} else {
+	    lilv_instance_connect_port(self.instance, self.audio_out[0], output1+i);
+	    lilv_instance_connect_port(self.instance, self.audio_out[1], output2+i);
+	    self.run(n);
+	}
     }
 }
 
@@ -864,8 +1181,8 @@ int Lv2Dsp::registerparam(const ParamReg& reg) {
 	    switch (d->tp) {
 	    case tp_none:           tp = "S";  break;
 	    case tp_int:            tp = "S";  break;
-	    case tp_scale:          tp = "S";  break;
-	    case tp_scale_log:      tp = "SL"; break;
+	    case tp_scale:          tp = "SZ"; break;
+	    case tp_scale_log:      tp = "SLZ"; break;
 	    case tp_toggle:         tp = "B";  break;
 	    case tp_display:        tp = "SO"; break;
 	    case tp_display_toggle: tp = "BO"; break;
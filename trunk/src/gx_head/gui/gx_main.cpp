@@ -28,6 +28,7 @@
 #include <gtkmm/main.h>     // NOLINT
 #include <gxwmm/init.h>     // NOLINT
 #include <string>           // NOLINT
+#include <sys/wait.h>       // NOLINT
 #include "jsonrpc.h"
 
 #ifdef HAVE_AVAHI
@@ -402,6 +403,85 @@ static void mainHeadless(int argc, char *argv[]) {
     gx_child_process::childprocs.killall();
 }
 
+static bool render_file(gx_system::CmdlineOptions& options,
+			const std::string& infile, const std::string& outfile) {
+    gx_engine::GxMachine machine(options);
+    machine.loadstate();
+    machine.disable_autosave(true);
+    Glib::ustring preset = options.get_render_preset();
+    if (!preset.empty()) {
+	Glib::ustring::size_type n = preset.find(':');
+	Glib::ustring bank = preset.substr(0, n);
+	Glib::ustring name = (n == Glib::ustring::npos ? "" : preset.substr(n+1));
+	if (machine.get_bank_index(bank) < 0) {
+	    cerr << "bank not found: " << bank << endl;
+	    return false;
+	}
+	gx_system::PresetFileGui *pf = machine.get_bank_file(bank);
+	if (!pf->has_entry(name)) {
+	    cerr << "preset not found: " << preset << endl;
+	    return false;
+	}
+	machine.load_preset(pf, name);
+    }
+    return machine.render(infile, outfile);
+}
+
+static void mainRender(int argc, char *argv[]) {
+    Glib::init();
+    Gio::init();
+
+    gx_system::CmdlineOptions options;
+    options.parse(argc, argv);
+    options.process(argc, argv);
+    const std::vector<std::string>& files = options.get_render_files();
+    if (files.size() == 2) {
+	if (!render_file(options, files[0], files[1])) {
+	    exit(1);
+	}
+	return;
+    }
+    // batch: one process per file pair (the engine is not
+    // reentrant), as many at a time as there are cores
+    long ncpu = max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    long running = 0;
+    int failed = 0;
+    for (unsigned int i = 0; i < files.size() || running > 0; ) {
+	if (i < files.size() && running < ncpu) {
+	    pid_t pid = fork();
+	    if (pid == 0) {
+		bool ok = false;
+		try {
+		    ok = render_file(options, files[i], files[i+1]);
+		} catch (...) {
+		    cerr << "error while rendering " << files[i] << endl;
+		}
+		_exit(ok ? 0 : 1);
+	    }
+	    if (pid < 0) {
+		cerr << "fork failed, " << files[i] << " not rendered" << endl;
+		failed += 1;
+	    } else {
+		running += 1;
+	    }
+	    i += 2;
+	    continue;
+	}
+	int status;
+	if (wait(&status) < 0) {
+	    break;
+	}
+	running -= 1;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+	    failed += 1;
+	}
+    }
+    if (failed) {
+	cerr << failed << " file(s) failed" << endl;
+	exit(1);
+    }
+}
+
 static void exception_handler() {
     try {
 	throw; // re-throw current exception
@@ -572,6 +652,15 @@ static bool is_headless(int argc, char *argv[]) {
     return false;
 }
 
+static bool is_render(int argc, char *argv[]) {
+    for (int i = 0; i < argc; ++i) {
+	if (strcmp(argv[i], "-R") == 0 || strcmp(argv[i], "--render") == 0) {
+	    return true;
+	}
+    }
+    return false;
+}
+
 static bool is_frontend(int argc, char *argv[]) {
     for (int i = 0; i < argc; ++i) {
 	if (strcmp(argv[i], "-G") == 0 || strcmp(argv[i], "--onlygui") == 0) {
@@ -599,7 +688,11 @@ int main(int argc, char *argv[]) {
 	    Glib::thread_init();
 	}
 #endif
-	if (is_headless(argc, argv)) {
+	if (ladspa::is_scanner(argc, argv)) {
+	    ladspa::scanner_main(argc, argv);
+	} else if (is_render(argc, argv)) {
+	    mainRender(argc, argv);
+	} else if (is_headless(argc, argv)) {
 	    mainHeadless(argc, argv);
 	} else if (is_frontend(argc, argv)) {
 	    mainFront(argc, argv);
@@ -878,6 +878,38 @@ void MainWindow::on_show_values() {
     gtk_rc_reset_styles(gtk_settings_get_default());
 }
 
+void MainWindow::on_show_plugin_load() {
+    if (actions.show_plugin_load->get_active()) {
+	update_plugin_load(); // show the last snapshot right away
+	plugin_load_conn = Glib::signal_timeout().connect_seconds(
+	    sigc::mem_fun(*this, &MainWindow::update_plugin_load), 1);
+    } else {
+	plugin_load_conn.disconnect();
+	for (PluginDict::iterator i = plugin_dict.begin(); i != plugin_dict.end(); ++i) {
+	    if (i->second->rackbox) {
+		i->second->rackbox->set_load(0, 0);
+	    }
+	}
+    }
+}
+
+bool MainWindow::update_plugin_load() {
+    std::map<std::string,gx_engine::PluginLoadInfo> load;
+    float period = machine.get_plugin_load(load);
+    for (PluginDict::iterator i = plugin_dict.begin(); i != plugin_dict.end(); ++i) {
+	if (!i->second->rackbox) {
+	    continue;
+	}
+	std::map<std::string,gx_engine::PluginLoadInfo>::iterator l = load.find(i->first);
+	if (l == load.end()) {
+	    i->second->rackbox->set_load(0, 0);
+	} else {
+	    i->second->rackbox->set_load(&l->second, period);
+	}
+    }
+    return true;
+}
+
 void MainWindow::on_preset_action() {
     bool v = options.system_show_presets = actions.presets->get_active();
     if (!v && preset_scrolledbox->get_mapped()) {
@@ -948,9 +980,15 @@ bool MainWindow::on_visibility_notify(GdkEventVisibility *ev) {
 	return false;
     }
     is_visible = v;
+    update_refresh_pause();
     return false;
 }
 
+// no display refresh while the window can't be seen
+void MainWindow::update_refresh_pause() {
+    boxbuilder.pause_refresh(is_hidden || !is_visible);
+}
+
 void MainWindow::on_live_play() {
     live_play->on_live_play(actions.live_play);
 }
@@ -1513,6 +1551,11 @@ void MainWindow::create_actions() {
     actions.group->add(actions.show_values,
 		       sigc::mem_fun(*this, &MainWindow::on_show_values));
 
+    actions.show_plugin_load = Gtk::ToggleAction::create(
+	"ShowPluginLoad",_("Show Plugin _Load"), "", false);
+    actions.group->add(actions.show_plugin_load,
+		       sigc::mem_fun(*this, &MainWindow::on_show_plugin_load));
+
     actions.tooltips = Gtk::ToggleAction::create(
 	"ShowTooltips", _("Show _Tooltips"), "", true);
     actions.group->add(
@@ -2413,6 +2456,8 @@ bool MainWindow::on_window_state_changed(GdkEventWindowState* event) {
     if (event->changed_mask & event->new_window_state & (Gdk::WINDOW_STATE_ICONIFIED|Gdk::WINDOW_STATE_WITHDRAWN)) {
 	window->get_window()->get_root_origin(options.mainwin_x, options.mainwin_y);
     }
+    is_hidden = event->new_window_state & (Gdk::WINDOW_STATE_ICONIFIED|Gdk::WINDOW_STATE_WITHDRAWN);
+    update_refresh_pause();
     return false;
 }
 
@@ -2518,6 +2563,7 @@ MainWindow::MainWindow(gx_engine::GxMachineBase& machine_, gx_system::CmdlineOpt
       stereorackcontainer(PLUGIN_TYPE_STEREO, *this),
       pre_act(false),
       is_visible(false),
+      is_hidden(false),
       drag_icon(0),
       preset_list_menu_bank(),
       preset_list_merge_id(0),
@@ -2550,7 +2596,8 @@ MainWindow::MainWindow(gx_engine::GxMachineBase& machine_, gx_system::CmdlineOpt
       keyswitch(machine, sigc::mem_fun(this, &MainWindow::display_preset_msg)),
       groupmap(),
       ladspalist_window(),
-      szg_rack_units(Gtk::SizeGroup::create(Gtk::SIZE_GROUP_HORIZONTAL)) {
+      szg_rack_units(Gtk::SizeGroup::create(Gtk::SIZE_GROUP_HORIZONTAL)),
+      plugin_load_conn() {
 
     convolver_filename_label.set_ellipsize(Pango::ELLIPSIZE_END);
     convolver_mono_filename_label.set_ellipsize(Pango::ELLIPSIZE_END);
@@ -2922,6 +2969,7 @@ MainWindow::~MainWindow() {
     if (actions.presets->get_active()) {
 	options.preset_window_height = preset_scrolledbox->get_allocation().get_height();
     }
+    plugin_load_conn.disconnect();
     plugin_dict.cleanup();
     delete live_play;
     delete preset_window;
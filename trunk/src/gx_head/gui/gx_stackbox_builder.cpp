@@ -97,6 +97,162 @@ Gtk::Widget *WidgetStack::add(Gtk::Widget *w, const Glib::ustring& label) {
     return w;
 }
 
+/****************************************************************
+ ** class RefreshScheduler
+ */
+
+RefreshScheduler::RefreshScheduler(gx_engine::GxMachineBase& machine_)
+    : machine(machine_), entries(), timer(), paused(false),
+      local(machine_.get_jack() != 0) {
+    machine.signal_parameter_insert_remove().connect(
+	sigc::mem_fun(*this, &RefreshScheduler::on_param_insert_remove));
+}
+
+RefreshScheduler::~RefreshScheduler() {
+    timer.disconnect();
+    for (std::list<Entry>::iterator i = entries.begin(); i != entries.end(); ++i) {
+	if (i->widget) {
+	    i->widget->remove_destroy_notify_callback(&*i);
+	}
+    }
+}
+
+gx_engine::Parameter *RefreshScheduler::resolve(const std::string& id) {
+    if (id.empty() || !machine.parameter_hasId(id)) {
+	return 0;
+    }
+    return &machine.get_parameter(id);
+}
+
+void RefreshScheduler::add(display_type tp, Gtk::Widget *w, const std::string& id,
+			   const std::string& idl, const std::string& idh) {
+    Entry e;
+    e.tp = tp;
+    e.widget = w;
+    e.param = resolve(id);
+    e.on_off = resolve(id.substr(0, id.find_last_of(".")+1)+"on_off");
+    e.low = resolve(idl);
+    e.high = resolve(idh);
+    e.valid = false;
+    e.last = e.last_low = e.last_high = 0;
+    e.settle = 0;
+    if (!e.param || (tp == port_display && (!e.low || !e.high))) {
+	return;
+    }
+    entries.push_back(e);
+    w->add_destroy_notify_callback(&entries.back(), on_widget_destroyed);
+    update_timer();
+}
+
+void *RefreshScheduler::on_widget_destroyed(void *data) {
+    static_cast<Entry*>(data)->widget = 0;
+    return 0;
+}
+
+void RefreshScheduler::on_param_insert_remove(gx_engine::Parameter *p, bool inserted) {
+    if (inserted) {
+	return;
+    }
+    for (std::list<Entry>::iterator i = entries.begin(); i != entries.end(); ++i) {
+	if (i->param == p || i->on_off == p || i->low == p || i->high == p) {
+	    i->param = 0;
+	}
+    }
+}
+
+inline float RefreshScheduler::get_value(gx_engine::Parameter *p) {
+    if (local) {
+	return p->getFloat().get_value();
+    }
+    return machine.get_parameter_value<float>(p->id());
+}
+
+inline bool RefreshScheduler::is_on(const Entry& e) {
+    return !e.on_off || e.on_off->getBool().get_value();
+}
+
+void RefreshScheduler::refresh(Entry& e) {
+    switch (e.tp) {
+    case meter_display: {
+	float v = (is_on(e) ? get_value(e.param) : 0.0001);
+	if (e.valid && v == e.last) {
+	    // let the peak hold of the meter run out
+	    if (e.settle == 0) {
+		return;
+	    }
+	    e.settle -= 1;
+	} else {
+	    e.settle = meter_hold;
+	}
+	e.valid = true;
+	e.last = v;
+	static_cast<Gxw::FastMeter*>(e.widget)->set_by_power(v);
+	break;
+    }
+    case value_display: {
+	if (!is_on(e)) {
+	    return;
+	}
+	float v = get_value(e.param);
+	if (e.valid && v == e.last) {
+	    return;
+	}
+	e.valid = true;
+	e.last = v;
+	e.param->signal_changed_float()(v);
+	break;
+    }
+    case port_display: {
+	if (!is_on(e)) {
+	    return;
+	}
+	float v = get_value(e.param);
+	float low = get_value(e.low);
+	float high = 100-get_value(e.high);
+	if (e.valid && v == e.last && low == e.last_low && high == e.last_high) {
+	    return;
+	}
+	e.valid = true;
+	e.last = v;
+	e.last_low = low;
+	e.last_high = high;
+	static_cast<Gxw::PortDisplay*>(e.widget)->set_state(int(low),int(high));
+	e.param->signal_changed_float()(v+(low + high)*0.001);
+	break;
+    }
+    }
+}
+
+bool RefreshScheduler::on_timeout() {
+    for (std::list<Entry>::iterator i = entries.begin(); i != entries.end(); ) {
+	if (!i->widget || !i->param) {
+	    if (i->widget) {
+		i->widget->remove_destroy_notify_callback(&*i);
+	    }
+	    i = entries.erase(i);
+	    continue;
+	}
+	refresh(*i);
+	++i;
+    }
+    return !entries.empty();
+}
+
+void RefreshScheduler::update_timer() {
+    if (paused || entries.empty()) {
+	timer.disconnect();
+    } else if (!timer.connected()) {
+	timer = Glib::signal_timeout().connect(
+	    sigc::mem_fun(*this, &RefreshScheduler::on_timeout), refresh_ms);
+    }
+}
+
+void RefreshScheduler::set_paused(bool v) {
+    paused = v;
+    update_timer();
+}
+
+
 /****************************************************************
  ** class StackBoxBuilder
  */
@@ -104,7 +260,7 @@ Gtk::Widget *WidgetStack::add(Gtk::Widget *w, const Glib::ustring& label) {
 StackBoxBuilder::StackBoxBuilder(
     gx_engine::GxMachineBase& machine_, Gxw::WaveView &fWaveView_, Gtk::Label &convolver_filename_label_,
     Gtk::Label &convolver_mono_filename_label_, Glib::RefPtr<Gdk::Pixbuf> window_icon_)
-    : fBox(), machine(machine_),
+    : fBox(), machine(machine_), refresh(machine_),
       fWaveView(fWaveView_), convolver_filename_label(convolver_filename_label_),
       convolver_mono_filename_label(convolver_mono_filename_label_),
       widget(), accels(), window_icon(window_icon_), next_flags(0) {
@@ -295,24 +451,11 @@ void StackBoxBuilder::set_next_flags(int flags) {
     next_flags = flags;
 }
 
-bool StackBoxBuilder::set_simple(Gxw::FastMeter *fastmeter,const std::string id) {
-    if (machine.parameter_hasId(id)) {
-    if (machine.get_parameter_value<bool>(id.substr(0,id.find_last_of(".")+1)+"on_off"))
-    fastmeter->set_by_power(machine.get_parameter_value<float>(id));
-    else
-    fastmeter->set_by_power(0.0001);
-    return true;
-    } else {
-    return false;
-    }
-}
-
 void StackBoxBuilder::create_simple_meter(const std::string& id) {
     Gxw::FastMeter *fastmeter = new Gxw::FastMeter();
     fastmeter->set_hold_count(5);
     fastmeter->set_property("dimen",5);
-    Glib::signal_timeout().connect(sigc::bind<Gxw::FastMeter*>(sigc::bind<const std::string>(
-      sigc::mem_fun(*this, &StackBoxBuilder::set_simple),id), fastmeter), 60);
+    refresh.add_meter(fastmeter, id);
     fastmeter->set_by_power(0.0001);
     GxPaintBox *box =  new GxPaintBox(pb_amp_expose);
     box->set_border_width(2);
@@ -325,8 +468,7 @@ void StackBoxBuilder::create_simple_c_meter(const std::string& id, const std::st
     Gxw::FastMeter *fastmeter = new Gxw::FastMeter();
     fastmeter->set_hold_count(5);
     fastmeter->set_property("dimen",5);
-    Glib::signal_timeout().connect(sigc::bind<Gxw::FastMeter*>(sigc::bind<const std::string>(
-      sigc::mem_fun(*this, &StackBoxBuilder::set_simple),id), fastmeter), 60);
+    refresh.add_meter(fastmeter, id);
     fastmeter->set_by_power(0.0001);
     Gxw::LevelSlider *w = new UiRegler<Gxw::LevelSlider>(machine, idm);
     w->set_name("lmw");
@@ -368,39 +510,13 @@ void StackBoxBuilder::create_simple_c_meter(const std::string& id, const std::st
 }
 
 
-bool StackBoxBuilder::set_engine_value(const std::string id) {
-    if (machine.parameter_hasId(id)) {
-    if (machine.get_parameter_value<bool>(id.substr(0,id.find_last_of(".")+1)+"on_off"))
-      machine.signal_parameter_value<float>(id)(machine.get_parameter_value<float>(id));
-    return true;
-    } else {
-    return false;
-    }
-}
-
 void StackBoxBuilder::create_port_display(const std::string& id, const char *label) {
     CpBaseCaption *w = new UiReglerWithCaption<Gxw::PortDisplay>(machine, id);
-    Glib::signal_timeout().connect(sigc::bind<const std::string>(
-      sigc::mem_fun(*this, &StackBoxBuilder::set_engine_value),id), 60);
+    refresh.add_value(w, id);
 	w->set_rack_label(label);
 	addwidget(w);
 }
 
-bool StackBoxBuilder::set_pd_value(Gxw::PortDisplay *w, const std::string id, const std::string& idl, const std::string& idh) {
-    if (machine.parameter_hasId(id)) {
-    if (machine.get_parameter_value<bool>(id.substr(0,id.find_last_of(".")+1)+"on_off")) {
-      float low = machine.get_parameter_value<float>(idl);
-      float high = 100-machine.get_parameter_value<float>(idh);
-      w->set_state(int(low),int(high));
-      float set = (low + high)*0.001;
-      machine.signal_parameter_value<float>(id)(machine.get_parameter_value<float>(id)+set);
-    }
-    return true;
-    } else {
-    return false;
-    }
-}
-    
 void StackBoxBuilder::create_p_display(const std::string& id, const std::string& idl, const std::string& idh) {
     Gxw::PortDisplay *w = new UiRegler<Gxw::PortDisplay>(machine, id);
 	w->set_name("playhead");
@@ -412,15 +528,13 @@ void StackBoxBuilder::create_p_display(const std::string& id, const std::string&
     e_box->add(*manage(static_cast<Gtk::Widget*>(w)));
     addwidget(e_box);
     e_box->show_all();
-    Glib::signal_timeout().connect(sigc::bind<Gxw::PortDisplay*>(sigc::bind<const std::string>(
-      sigc::bind<const std::string>(sigc::bind<const std::string>(
-      sigc::mem_fun(*this, &StackBoxBuilder::set_pd_value),idh),idl),id),w ), 60);
+    refresh.add_port_display(w, id, idl, idh);
 }
 
 void StackBoxBuilder::create_feedback_switch(const char *sw_type, const std::string& id) {
-	addwidget(UiSwitch::create(machine, sw_type, id));
-    Glib::signal_timeout().connect(sigc::bind<const std::string>(
-      sigc::mem_fun(*this, &StackBoxBuilder::set_engine_value),id), 60);
+    Gtk::Widget *w = UiSwitch::create(machine, sw_type, id);
+	addwidget(w);
+    refresh.add_value(w, id);
 }
 
 void StackBoxBuilder::load_file(const std::string& id, const std::string& idf) {
@@ -483,8 +597,7 @@ void StackBoxBuilder::create_fload_switch(const char *sw_type, const std::string
 
 void StackBoxBuilder::create_feedback_slider(const std::string& id, const char *label) {
 	UiMasterReglerWithCaption<Gxw::HSlider> *w = new UiMasterReglerWithCaption<Gxw::HSlider>(machine, id);
-    Glib::signal_timeout().connect(sigc::bind<const std::string>(
-      sigc::mem_fun(*this, &StackBoxBuilder::set_engine_value),id), 60);
+    refresh.add_value(w, id);
 	w->set_label(label);
 	addwidget(w);
     }
@@ -76,10 +76,8 @@ PluginDisplay::PluginDisplay(gx_engine::GxMachineBase& machine_, Glib::RefPtr<Gd
       enum_liststore(new EnumListStore), port_liststore(new PortListStore),
       plugin_liststore(new PluginListStore), masteridx_liststore(new MasterIdxListStore),
       on_reordered_conn(), display_type_list(), display_type_list_sr(), output_type_list(),
-      finished_callback(finished_callback_)
+      finished_callback(finished_callback_), loading(true), load_conn()
 {
-    std::vector<std::string> old_not_found;
-    machine.load_ladspalist(old_not_found, pluginlist);
     bld = gx_gui::GxBuilder::create_from_file(machine.get_options().get_builder_filepath("ladspaliste.glade"));
     bld->get_toplevel("window1", window);
     bld->find_widget("treeview1", treeview1);
@@ -280,14 +278,55 @@ PluginDisplay::PluginDisplay(gx_engine::GxMachineBase& machine_, Glib::RefPtr<Gd
     bld->find_widget("select_none", b);
     gtk_activatable_set_related_action(GTK_ACTIVATABLE(b->gobj()), actiongroup->get_action("SelectNoneAction")->gobj());
 
+    pluginlist.signal_plugin_found().connect(sigc::mem_fun(this, &PluginDisplay::on_plugin_found));
+    pluginlist.signal_scan_progress().connect(sigc::mem_fun(this, &PluginDisplay::on_scan_progress));
     window->set_icon(icon);
+    window->set_sensitive(false);
     window->show();
+    load_conn = Glib::signal_idle().connect(
+	sigc::bind_return(sigc::mem_fun(this, &PluginDisplay::load_plugins), false));
 }
 
 PluginDisplay::~PluginDisplay() {
+    load_conn.disconnect();
     delete window;
 }
 
+// called when the window is visible, so that the plugins can be
+// listed while they are being loaded. The found / progress handlers
+// run the main loop; the window is modal (and insensitive) until
+// loading has finished, so no window of the application takes user
+// input while the loader is on the stack.
+void PluginDisplay::load_plugins() {
+    std::vector<std::string> old_not_found;
+    window->set_modal(true);
+    machine.load_ladspalist(old_not_found, pluginlist);
+    window->set_modal(false);
+    loading = false;
+    window->set_sensitive(true);
+    set_title();
+    load();
+}
+
+void PluginDisplay::on_plugin_found(PluginDesc *p) {
+    if (is_shown(p)) {
+	Gtk::TreeIter it = plugin_liststore->append();
+	it->set_value(plugin_liststore->col.name, ustring(p->Name));
+	it->set_value(plugin_liststore->col.active, p->active);
+	it->set_value(plugin_liststore->col.pdesc, p);
+    }
+    while (Gtk::Main::events_pending()) {
+	Gtk::Main::iteration(false);
+    }
+}
+
+void PluginDisplay::on_scan_progress(unsigned int done, unsigned int total) {
+    window->set_title(ustring::compose(_("Scanning LADSPA plugins (%1/%2)"), done, total));
+    while (Gtk::Main::events_pending()) {
+	Gtk::Main::iteration(false);
+    }
+}
+
 static void split(std::vector<ustring>& strvec, const ustring& str) {
     size_t start = 0, np = ustring::npos;
     while (true) {
@@ -517,6 +556,9 @@ bool PluginDisplay::check_exit() {
 }
 
 bool PluginDisplay::on_delete_event(GdkEventAny *) {
+    if (loading) {
+	return true;
+    }
     return !check_exit();
 }
 
@@ -558,30 +600,32 @@ void PluginDisplay::display_category(const Gtk::TreeIter& it) {
     }
 }
 
-void PluginDisplay::load() {
+bool PluginDisplay::is_shown(PluginDesc *p) {
     int a = combobox_mono_stereo->get_model()->get_path(combobox_mono_stereo->get_active())[0];
-    bool s = selected_only->get_active();
-    bool c = changed_only->get_active();
-    bool d = ladspa_only->get_active();
-    bool e = lv2_only->get_active();
+    if (selected_only->get_active() && !p->active) {
+	return false;
+    }
+    else if (changed_only->get_active() && !p->has_settings) {
+	return false;
+    }
+    else if (ladspa_only->get_active() && p->is_lv2) {
+	return false;
+    }
+    else if (lv2_only->get_active() && !p->is_lv2) {
+	return false;
+    }
+    if ((a == 1 && p->tp != 0) || (a == 2 && p->tp != 1)) {
+	return false;
+    }
+    return true;
+}
+
+void PluginDisplay::load() {
     plugin_liststore->clear();
     for (std::vector<PluginDesc*>::iterator v = pluginlist.begin(); v != pluginlist.end(); ++v) {
-	if (s && !(*v)->active) {
+	if (!is_shown(*v)) {
 	    continue;
 	}
-	else if (c && !(*v)->has_settings) {
-	    continue;
-	}
-	else if (d && (*v)->is_lv2) {
-	    continue;
-	}
- 	else if (e && !(*v)->is_lv2) {
-	    continue;
-	}
-	if ((a == 1 && (*v)->tp != 0) || (a == 2 && (*v)->tp != 1)) {
-	    continue;
-	}
-
 	Gtk::TreeIter it = plugin_liststore->append();
 	it->set_value(plugin_liststore->col.name, ustring((*v)->Name));
 	it->set_value(plugin_liststore->col.active, (*v)->active);
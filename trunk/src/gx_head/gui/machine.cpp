@@ -169,6 +169,11 @@ GxMachine::~GxMachine() {
 #endif
 }
 
+bool GxMachine::render(const std::string& infile, const std::string& outfile) {
+    gx_engine::OfflineRender r(engine);
+    return r.render(infile, outfile);
+}
+
 void GxMachine::on_jack_load_change() {
     gx_engine::MidiAudioBuffer::Load l = engine.midiaudiobuffer.jack_load_status();
     if (l == gx_engine::MidiAudioBuffer::load_low && !engine.midiaudiobuffer.get_midistat()) {
@@ -321,6 +326,21 @@ void GxMachine::maxlevel_get(int channels, float *values) {
     }
 }
 
+// returns period length in microseconds
+float GxMachine::get_plugin_load(std::map<std::string,PluginLoadInfo>& load) {
+    load.clear();
+    for (PluginList::pluginmap::iterator i = engine.pluginlist.begin(); i != engine.pluginlist.end(); ++i) {
+	PluginLoadInfo info;
+	if (i->second->load.get(info)) {
+	    load[i->first] = info;
+	}
+    }
+    if (!engine.get_samplerate()) {
+	return 0;
+    }
+    return engine.get_buffersize() * 1e6 / engine.get_samplerate();
+}
+
 void GxMachine::get_oscilloscope_info(int& load, int& frames, bool& is_rt, jack_nframes_t& bsize) {
     load = static_cast<int>(round(jack.get_jcpu_load()));
     frames = jack.get_time_is()/100000;
@@ -659,6 +679,10 @@ bool GxMachine::parameter_hasId(const std::string& id) {
     return pmap.hasId(id);
 }
 
+sigc::signal<void,Parameter*,bool> GxMachine::signal_parameter_insert_remove() {
+    return pmap.signal_insert_remove();
+}
+
 void GxMachine::reset_unit(const PluginDef *pdef) const {
     pmap.reset_unit(pdef);
 }
@@ -840,6 +864,14 @@ GxMachineRemote::GxMachineRemote(gx_system::CmdlineOptions& options_)
       oscilloscope_size_change(),
       oscilloscope_buffer(0),
       oscilloscope_buffer_size(0),
+      oscilloscope_info(),
+      telemetry_streams(0),
+      telemetry_read(0),
+      telemetry_frames(0),
+      telemetry_unused(0),
+      telemetry_conn(),
+      tuner_freq(0),
+      maxlevel(),
       tuner_switcher_display(),
       tuner_switcher_set_state(),
       tuner_switcher_selection_done() {
@@ -890,6 +922,7 @@ GxMachineRemote::GxMachineRemote(gx_system::CmdlineOptions& options_)
 }
 
 GxMachineRemote::~GxMachineRemote() {
+    telemetry_conn.disconnect();
     jw->close();
     delete jw;
     writebuf->close();
@@ -1135,6 +1168,8 @@ void GxMachineRemote::handle_notify(gx_system::JsonStringParser *jp) {
 	    oscilloscope_buffer_size = sz;
 	}
 	oscilloscope_size_change(sz);
+    } else if (method == "telemetry") {
+	read_telemetry(jp);
     } else if (method == "show_tuner") {
 	jp->next(gx_system::JsonParser::value_number);
 	tuner_switcher_selection_done(jp->current_value_int());
@@ -1221,33 +1256,37 @@ bool GxMachineRemote::socket_input_handler(Glib::IOCondition cond) {
 	    return false;
 	}
 	char *p = buf;
-	while (n-- > 0) {
-	    jp->put(*p);
-	    if (*p == '\n') {
-		jp->start_parser();
-		try {
-		    jp->next(gx_system::JsonParser::begin_object);
-		    jp->next(gx_system::JsonParser::value_key); // "jsonrpc"
-		    jp->next(gx_system::JsonParser::value_string); // "2.0"
-		    jp->next(gx_system::JsonParser::value_key); // "method"
-		    handle_notify(jp);
-		} catch (gx_system::JsonException e) {
-		    cerr << "JsonException: " << e.what() << ": '" << jp->get_string() << "'" << endl;
-		    assert(false);
-		}
-		if (n == 0) {
-		    int avail = socket_get_available_bytes(socket);
-		    if (avail == 0) {
-			delete jp;
-			return true;
-		    } else if (avail < 0) {
-			socket_error(4);
-		    }
+	char *end = buf + n;
+	while (p < end) {
+	    char *q = static_cast<char*>(memchr(p, '\n', end - p));
+	    if (!q) {
+		jp->put(p, end - p);
+		break;
+	    }
+	    jp->put(p, q + 1 - p);
+	    p = q + 1;
+	    jp->start_parser();
+	    try {
+		jp->next(gx_system::JsonParser::begin_object);
+		jp->next(gx_system::JsonParser::value_key); // "jsonrpc"
+		jp->next(gx_system::JsonParser::value_string); // "2.0"
+		jp->next(gx_system::JsonParser::value_key); // "method"
+		handle_notify(jp);
+	    } catch (gx_system::JsonException e) {
+		cerr << "JsonException: " << e.what() << ": '" << jp->get_string() << "'" << endl;
+		assert(false);
+	    }
+	    if (p == end) {
+		int avail = socket_get_available_bytes(socket);
+		if (avail == 0) {
+		    delete jp;
+		    return true;
+		} else if (avail < 0) {
+		    socket_error(4);
 		}
-		delete jp;
-		jp = new gx_system::JsonStringParser;
 	    }
-	    p++;
+	    delete jp;
+	    jp = new gx_system::JsonStringParser;
 	}
     }
 }
@@ -1676,7 +1715,104 @@ sigc::signal<void, unsigned int>& GxMachineRemote::signal_oscilloscope_size_chan
     return oscilloscope_size_change;
 }
 
+/*
+** Tuner frequency, meter levels and oscilloscope data are pushed
+** by the server at telemetry_rate once they have been requested;
+** the getters below just return the last received values. A
+** stream nobody asked for during 2 seconds is unsubscribed (from an
+** idle callback: the call waits for the server's reply and must not
+** run inside the notify handler).
+*/
+
+static const int telemetry_rate = 25; // frames per second
+
+bool GxMachineRemote::request_telemetry(int stream) {
+    telemetry_read |= stream;
+    telemetry_unused &= ~stream;
+    if (telemetry_streams & stream) {
+	return true;
+    }
+    set_telemetry_streams(telemetry_streams | stream);
+    return false;
+}
+
+void GxMachineRemote::set_telemetry_streams(int streams) {
+    telemetry_streams = streams;
+    telemetry_frames = 0;
+    if (!streams) {
+	START_NOTIFY(disable_telemetry_stream);
+	SEND();
+	return;
+    }
+    START_CALL(enable_telemetry_stream);
+    jw->write(telemetry_rate);
+    jw->write("binary");
+    if (streams & CmdConnection::t_freq) {
+	jw->write("freq");
+    }
+    if (streams & CmdConnection::t_meter) {
+	jw->write("meter");
+    }
+    if (streams & CmdConnection::t_osc) {
+	jw->write("osc");
+    }
+    START_RECEIVE();
+    // negotiated rate and encoding; read_telemetry handles
+    // both encodings
+    jp->skip_object();
+    END_RECEIVE();
+}
+
+bool GxMachineRemote::drop_unused_telemetry() {
+    int streams = telemetry_streams & ~telemetry_unused;
+    telemetry_unused = 0;
+    if (streams != telemetry_streams) {
+	set_telemetry_streams(streams);
+    }
+    return false;
+}
+
+void GxMachineRemote::read_telemetry(gx_system::JsonParser *jp) {
+    jp->next(gx_system::JsonParser::begin_object);
+    while (jp->peek() != gx_system::JsonParser::end_object) {
+	jp->next(gx_system::JsonParser::value_key);
+	if (jp->current_value() == "freq") {
+	    jp->next(gx_system::JsonParser::begin_array);
+	    jp->next(gx_system::JsonParser::value_number);
+	    tuner_freq = jp->current_value_float();
+	    jp->next(gx_system::JsonParser::value_number); // note
+	    jp->next(gx_system::JsonParser::end_array);
+	} else if (jp->current_value() == "meter") {
+	    jp->next(gx_system::JsonParser::begin_array);
+	    for (unsigned int i = 0; jp->peek() != gx_system::JsonParser::end_array; i++) {
+		jp->next(gx_system::JsonParser::value_number);
+		if (i < MaxLevel::channelcount) {
+		    maxlevel[i] = max(maxlevel[i], jp->current_value_float());
+		}
+	    }
+	    jp->next(gx_system::JsonParser::end_array);
+	} else if (jp->current_value() == "osc") {
+	    read_oscilloscope_info(jp);
+	} else {
+	    jp->skip_object();
+	}
+    }
+    jp->next(gx_system::JsonParser::end_object);
+    if (++telemetry_frames >= 2 * telemetry_rate) {
+	telemetry_unused = telemetry_streams & ~telemetry_read;
+	if (telemetry_unused && !telemetry_conn.connected()) {
+	    telemetry_conn = Glib::signal_idle().connect(
+		sigc::mem_fun(this, &GxMachineRemote::drop_unused_telemetry));
+	}
+	telemetry_read = 0;
+	telemetry_frames = 0;
+    }
+}
+
 float GxMachineRemote::get_tuner_freq() {
+    if (request_telemetry(CmdConnection::t_freq)) {
+	return tuner_freq;
+    }
     START_CALL(get_tuner_freq);
     START_RECEIVE(0);
     jp->next(gx_system::JsonParser::value_number);
@@ -1685,6 +1821,17 @@ float GxMachineRemote::get_tuner_freq() {
 }
 
 void GxMachineRemote::maxlevel_get(int channels, float *values) {
+    if (request_telemetry(CmdConnection::t_meter)) {
+	for (int i = 0; i < channels; i++) {
+	    if (i < static_cast<int>(MaxLevel::channelcount)) {
+		values[i] = maxlevel[i];
+		maxlevel[i] = 0.0;
+	    } else {
+		values[i] = 0.0;
+	    }
+	}
+	return;
+    }
     START_CALL(get_max_output_level);
     jw->write(channels);
     START_RECEIVE();
@@ -1700,18 +1847,53 @@ void GxMachineRemote::maxlevel_get(int channels, float *values) {
     END_RECEIVE();
 }
 
-void GxMachineRemote::get_oscilloscope_info(int& load, int& frames, bool& is_rt, jack_nframes_t& bsize) {
-    START_CALL(get_oscilloscope_info);
-    START_RECEIVE();
+float GxMachineRemote::get_plugin_load(std::map<std::string,PluginLoadInfo>& load) {
+    load.clear();
+    float period = 0;
+    START_CALL(get_plugin_load);
+    START_RECEIVE(0);
+    jp->next(gx_system::JsonParser::begin_object);
+    while (jp->peek() != gx_system::JsonParser::end_object) {
+	jp->next(gx_system::JsonParser::value_key);
+	if (jp->read_kv("period", period)) {
+	} else if (jp->current_value() == "units") {
+	    jp->next(gx_system::JsonParser::begin_object);
+	    while (jp->peek() != gx_system::JsonParser::end_object) {
+		jp->next(gx_system::JsonParser::value_key);
+		PluginLoadInfo& info = load[jp->current_value()];
+		jp->next(gx_system::JsonParser::begin_array);
+		jp->next(gx_system::JsonParser::value_number);
+		info.count = jp->current_value_int();
+		jp->next(gx_system::JsonParser::value_number);
+		info.mean = jp->current_value_float();
+		jp->next(gx_system::JsonParser::value_number);
+		info.minimum = jp->current_value_float();
+		jp->next(gx_system::JsonParser::value_number);
+		info.maximum = jp->current_value_float();
+		jp->next(gx_system::JsonParser::value_number);
+		info.p99 = jp->current_value_float();
+		jp->next(gx_system::JsonParser::end_array);
+	    }
+	    jp->next(gx_system::JsonParser::end_object);
+	} else {
+	    jp->skip_object();
+	}
+    }
+    jp->next(gx_system::JsonParser::end_object);
+    return period;
+    END_RECEIVE(return 0);
+}
+
+void GxMachineRemote::read_oscilloscope_info(gx_system::JsonParser *jp) {
     jp->next(gx_system::JsonParser::begin_array);
     jp->next(gx_system::JsonParser::value_number);
-    load = jp->current_value_int();
+    oscilloscope_info.load = jp->current_value_int();
     jp->next(gx_system::JsonParser::value_number);
-    frames = jp->current_value_int();
+    oscilloscope_info.frames = jp->current_value_int();
     jp->next(gx_system::JsonParser::value_number);
-    is_rt = jp->current_value_int();
+    oscilloscope_info.is_rt = jp->current_value_int();
     jp->next(gx_system::JsonParser::value_number);
-    bsize = jp->current_value_int();
+    oscilloscope_info.bsize = jp->current_value_int();
     jp->next(gx_system::JsonParser::value_number);
     unsigned int sz = jp->current_value_int();
     if (oscilloscope_buffer_size != sz) {
@@ -1720,15 +1902,39 @@ void GxMachineRemote::get_oscilloscope_info(int& load, int& frames, bool& is_rt,
 	oscilloscope_buffer_size = sz;
 	oscilloscope_size_change(sz);
     }
-    jp->next(gx_system::JsonParser::begin_array);
     float *p = oscilloscope_buffer;
-    while (jp->peek() != gx_system::JsonParser::end_array) {
-	jp->next(gx_system::JsonParser::value_number);
-	*p++ = jp->current_value_float();
+    if (jp->peek() == gx_system::JsonParser::value_string) {
+	// binary: base64 encoded float32 little endian
+	jp->next(gx_system::JsonParser::value_string);
+	gsize len;
+	guchar *b = g_base64_decode(jp->current_value().c_str(), &len);
+	for (gsize i = 0; i + 3 < len && i < 4 * sz; i += 4) {
+	    uint32_t v = b[i] | (b[i+1] << 8) | (b[i+2] << 16) | (uint32_t(b[i+3]) << 24);
+	    memcpy(p++, &v, sizeof(v));
+	}
+	g_free(b);
+    } else {
+	jp->next(gx_system::JsonParser::begin_array);
+	while (jp->peek() != gx_system::JsonParser::end_array) {
+	    jp->next(gx_system::JsonParser::value_number);
+	    *p++ = jp->current_value_float();
+	}
+	jp->next(gx_system::JsonParser::end_array);
     }
     jp->next(gx_system::JsonParser::end_array);
-    jp->next(gx_system::JsonParser::end_array);
-    END_RECEIVE();
+}
+
+void GxMachineRemote::get_oscilloscope_info(int& load, int& frames, bool& is_rt, jack_nframes_t& bsize) {
+    if (!request_telemetry(CmdConnection::t_osc)) {
+	START_CALL(get_oscilloscope_info);
+	START_RECEIVE();
+	read_oscilloscope_info(jp);
+	END_RECEIVE();
+    }
+    load = oscilloscope_info.load;
+    frames = oscilloscope_info.frames;
+    is_rt = oscilloscope_info.is_rt;
+    bsize = oscilloscope_info.bsize;
 }
 
 gx_system::CmdlineOptions& GxMachineRemote::get_options() const {
@@ -2282,6 +2488,10 @@ bool GxMachineRemote::parameter_hasId(const std::string& id) {
     return pmap.hasId(id);
 }
 
+sigc::signal<void,Parameter*,bool> GxMachineRemote::signal_parameter_insert_remove() {
+    return pmap.signal_insert_remove();
+}
+
 void GxMachineRemote::reset_unit(const PluginDef *pdef) const {
     pmap.reset_unit(pdef);
 }
@@ -382,6 +382,7 @@ MiniRackBox::MiniRackBox(RackBox& rb, gx_system::CmdlineOptions& options)
       mb_expand_button(),
       mb_delete_button(),
       preset_button(),
+      load_label(),
       on_off_switch("minitoggle"),
       toggle_on_off(rb.main.get_machine(), &on_off_switch, rb.plugin.plugin->id_on_off()) {
     if (strcmp(rb.plugin.get_id(), "ampstack") != 0) { // FIXME
@@ -426,9 +427,28 @@ MiniRackBox::MiniRackBox(RackBox& rb, gx_system::CmdlineOptions& options)
 	preset_button = rb.make_preset_button();
 	box->pack_end(*manage(preset_button), Gtk::PACK_SHRINK);
     }
+    load_label.set_name("rack_load_label");
+    Pango::FontDescription font_desc = load_label.get_style()->get_font();
+    font_desc.set_size(int(6.5*Pango::SCALE));
+    load_label.modify_font(font_desc);
+    load_label.set_no_show_all(true);
+    box->pack_end(load_label, Gtk::PACK_SHRINK, 4);
     show_all();
 }
 
+void MiniRackBox::set_load(const gx_engine::PluginLoadInfo *info, float period) {
+    if (!info) {
+	load_label.hide();
+	return;
+    }
+    float pc = period > 0 ? 100 * info->mean / period : 0;
+    load_label.set_text((boost::format("%.1f%%") % pc).str());
+    load_label.set_tooltip_text(
+	(boost::format(_("DSP time per period (us)\nmean %1$.1f  min %2$.1f\nmax %3$.1f  p99 %4$.1f"))
+	 % info->mean % info->minimum % info->maximum % info->p99).str());
+    load_label.show();
+}
+
 void MiniRackBox::pack(Gtk::Widget *w) {
     if (w) {
 	mconbox.pack_start(*manage(w), Gtk::PACK_SHRINK, 4);
@@ -37,11 +37,14 @@
 #include <map>
 #include <algorithm>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <boost/format.hpp>
 #include <boost/thread/mutex.hpp>
 #include <glibmm/i18n.h>     // NOLINT
 #include <glibmm/optioncontext.h>   // NOLINT
 #include <glibmm/dispatcher.h>
+#include <glibmm/main.h>
 #include <glibmm/miscutils.h>
 #include <giomm/file.h>
 
@@ -25,6 +25,7 @@
 #ifndef SRC_HEADERS_GX_CONVOLVER_H_
 #define SRC_HEADERS_GX_CONVOLVER_H_
 
+#include <stdint.h>
 #include <zita-convolver.h>
 #include <gxwmm/gainline.h>
 
@@ -103,9 +104,14 @@ protected:
                        unsigned int& size, unsigned int& bufsize);
     unsigned int buffersize;
     unsigned int samplerate;
-    GxConvolverBase(): ready(false), sync(false), buffersize(), samplerate() {}
+    static std::string wisdom_file;
+    GxConvolverBase(): ready(false), sync(false), buffersize(), samplerate() {
+        set_options(OPT_FFTW_MEASURE);
+    }
     ~GxConvolverBase();
 public:
+    static void load_wisdom(const std::string& fname);
+    static void save_wisdom();
     inline void set_buffersize(unsigned int sz) { buffersize = sz; }
     inline unsigned int get_buffersize() { return buffersize; }
     inline void set_samplerate(unsigned int sr) { samplerate = sr; }
@@ -149,12 +155,55 @@ inline void GxConvolver::compute_interpolation(
 }
 
 
+/*
+** process wide cache of resampled impulse responses
+**
+** Entries are keyed by content (64 bit hash and length of the
+** original data) and the sample rates; only the resampled data is
+** stored. An entry is refcounted by the convolvers currently using
+** it; unused entries are kept in LRU order up to max_unused, so
+** switching back to a model doesn't resample again.
+*/
+
+class IRCache {
+public:
+    class Entry {
+    private:
+        friend class IRCache;
+        uint64_t hash;
+        int count;
+        unsigned int imprate;
+        unsigned int samplerate;
+        std::vector<float> data;
+        int refcount;
+    public:
+        int size() const { return data.size(); }
+        float *get() { return &data[0]; }
+    };
+private:
+    enum { max_unused = 16 };
+    boost::mutex mutex;
+    std::list<Entry*> entries; // most recently used first
+    static uint64_t calc_hash(int count, const float *impresp);
+    void trim();
+public:
+    IRCache(): mutex(), entries() {}
+    ~IRCache();
+    Entry *acquire(gx_resample::BufferResampler& resamp, int count, float *impresp,
+                   unsigned int imprate, unsigned int samplerate);
+    void release(Entry *e);
+    static IRCache instance;
+};
+
 class GxSimpleConvolver: public GxConvolverBase {
 private:
     gx_resample::BufferResampler& resamp;
+    IRCache::Entry *ir;
+    float *get_ir(int *count, float *impresp, unsigned int imprate);
 public:
     GxSimpleConvolver(gx_resample::BufferResampler& resamp_)
-	: GxConvolverBase(), resamp(resamp_) {}
+	: GxConvolverBase(), resamp(resamp_), ir(0) {}
+    ~GxSimpleConvolver();
     bool configure(int count, float *impresp, unsigned int imprate);
     bool update(int count, float *impresp, unsigned int imprate);
     bool compute(int count, float* input, float *output);
@@ -96,6 +96,7 @@ public:
     SCapture record;
     SCapture record_st;
     smbPitchShift detune;
+    MultiTrackRecorder multitrack;
     //
 public:
     GxEngine(const string& plugin_dir, ParameterGroups& groups, const gx_system::CmdlineOptions& options);
@@ -105,6 +106,23 @@ public:
     sigc::signal<void,Plugin*,PluginChange::pc>& signal_plugin_changed() { return plugin_changed; }
 };
 
+/****************************************************************
+ ** class OfflineRender
+ ** drives the engine from a sound file instead of jack
+ ** (faster than realtime, convolvers in sync mode)
+ */
+
+class OfflineRender {
+private:
+    GxEngine& engine;
+    unsigned int buffersize;
+    void set_convolver_sync(bool v);
+public:
+    enum { default_buffersize = 256 };
+    OfflineRender(GxEngine& engine, unsigned int buffersize = default_buffersize);
+    bool render(const std::string& infile, const std::string& outfile);
+};
+
 /* ------------------------------------------------------------------- */
 } /* end of gx_engine namespace */
 #endif  // SRC_HEADERS_GX_ENGINE_H_
@@ -98,6 +98,7 @@ public:
     Glib::Dispatcher& signal_freq_changed() { return pitch_tracker.new_freq; }
     float get_freq() { return pitch_tracker.get_estimated_freq(); }
     float get_note() { return pitch_tracker.get_estimated_note(); }
+    float get_confidence() { return pitch_tracker.get_estimated_confidence(); }
 };
 
 
@@ -319,6 +320,7 @@ public:
 	ParamMap &pmap, const string& id, ConvolverAdapter &conv, GxJConvSettings *v);
     bool set(const GxJConvSettings& val) const;
     const GxJConvSettings& get_value() const { return *value; }
+    const GxJConvSettings& get_json_value() const { return json_value; }
     virtual void stdJSON_value();
     virtual bool on_off_value();
     virtual void writeJSON(gx_system::JsonWriter& jw) const;
@@ -408,9 +410,27 @@ public:
  */
 
 
+/*
+** Two convolver instances are used: while conv is running, a
+** changed impulse response is loaded into the spare instance, which
+** is then handed to the RT thread (pending). The RT thread switches
+** at the start of a period and crossfades (equal power) from the old
+** instance (fading) to the new one. The spare instance is configured
+** in the GUI thread (update timeout).
+*/
+
 class BaseConvolver: protected PluginDef {
+private:
+    GxSimpleConvolver conv1;
+    GxSimpleConvolver conv2;
+    GxSimpleConvolver *pending; // set by fade_to(), taken over by RT thread
+    GxSimpleConvolver *fading;  // RT thread: instance being faded out
+    int fade_pos;
+    int fade_len;
+    float fade_sin, fade_cos;   // RT thread: crossfade gains
+    float fade_dsin, fade_dcos; // rotation per sample
 protected:
-    GxSimpleConvolver conv;
+    GxSimpleConvolver *conv;    // current instance, switched by RT thread
     boost::mutex activate_mutex;
     EngineControl& engine;
     sigc::slot<void> sync;
@@ -421,6 +441,11 @@ protected:
     void change_buffersize(unsigned int);
     int conv_start();
     bool check_update_timeout();
+    GxSimpleConvolver *get_spare();
+    bool fade_to(GxSimpleConvolver *spare);
+    void stop_all();
+    void wait_stop();
+    bool conv_compute(int count, float *buffer);
     virtual void check_update() = 0;
     virtual bool start(bool force = false) = 0;
 public:
@@ -428,7 +453,7 @@ public:
 public:
     BaseConvolver(EngineControl& engine, sigc::slot<void> sync, gx_resample::BufferResampler& resamp);
     virtual ~BaseConvolver();
-    inline void set_sync(bool val) { conv.set_sync(val); }
+    inline void set_sync(bool val) { conv1.set_sync(val); conv2.set_sync(val); }
 };
 
 /****************************************************************
@@ -609,16 +634,66 @@ public:
 class LiveLooper: public PluginDef {
 	
 	
-class FileResampler {
+// tape: the loop data lives in a mono float wav file in the loop
+// directory; the worker thread keeps the pages around the record and
+// play heads resident in locked memory (page table, 0 == not
+// resident) and writes recorded pages back to the file. The rt thread
+// only accesses resident pages: a missing page reads as silence and
+// drops writes.
+class Tape {
+public:
+    enum { page_bits = 16, page_size = 1 << page_bits };
 private:
-    Resampler r_file;
-    int inputRate, outputRate;
-    int last_in_count;
-public:
-    int setup(int _inputRate, int _outputRate);
-    int run(int count, float *input, float *output);
-    int max_out_count(int in_count) {
-	return static_cast<int>(ceil((in_count*static_cast<double>(outputRate))/inputRate)); }
+    int fd;
+    std::string fname;
+public:
+    int npages;
+    float **pages;
+    volatile int *dirty;   // written by the rt thread since the last page write
+    int size;              // in frames
+    Tape(): fd(-1), fname(), npages(), pages(), dirty(), size() {}
+    bool create(const std::string& dir, int frames, int rate);
+    bool write_frames(int pos, const float *buf, int n);
+    bool read_page(int n, float *buf);
+    bool write_page(int n, const float *buf);
+    bool finish(int frames, int rate, const std::string& target);
+    void drop_pages(std::vector<float*>& pool);
+    void release();
+    inline float get(int i) { // RT
+        unsigned int n = static_cast<unsigned int>(i) >> page_bits;
+        if (n >= static_cast<unsigned int>(npages)) {
+            return 0.0;
+        }
+        float *p = gx_system::atomic_get(pages[n]);
+        return p ? p[i & (page_size-1)] : 0.0;
+    }
+    inline void put(int i, float v) { // RT
+        unsigned int n = static_cast<unsigned int>(i) >> page_bits;
+        if (n >= static_cast<unsigned int>(npages)) {
+            return;
+        }
+        float *p = gx_system::atomic_get(pages[n]);
+        if (p) {
+            p[i & (page_size-1)] = v;
+            dirty[n] = 1;
+        }
+    }
+};
+
+// load and save requests, run by the worker thread
+struct TapeJob {
+    enum Type { load, save };
+    Type type;
+    int nr;                // tape index 0..3
+    unsigned int gen;
+    std::string fname;
+    int rate;              // load: resample to this rate
+    bool mark_save;        // load: save the tape when it is replaced
+    Tape tape;
+    int frames;
+    TapeJob(Type type_, int nr_, unsigned int gen_, const std::string& fname_)
+	: type(type_), nr(nr_), gen(gen_), fname(fname_), rate(), mark_save(), tape(), frames() {}
+    ~TapeJob() { tape.release(); }
 };
 
 private:
@@ -656,7 +731,6 @@ private:
 	float 	IOTAR2;
 	float 	IOTAR3;
 	float 	IOTAR4;
-	float *tape1;
 	int 	tape1_size;
 	float 	fConst0;
 	float 	fConst1;
@@ -673,7 +747,6 @@ private:
 	float 	gain1;
 	float 	record2;
 	int 	iVec2[2];
-	float *tape2;
 	int 	tape2_size;
 	float 	reset2;
 	int 	RecSize2[2];
@@ -687,7 +760,6 @@ private:
 	float 	gain2;
 	float 	record3;
 	int 	iVec4[2];
-	float *tape3;
 	int 	tape3_size;
 	float 	reset3;
 	int 	RecSize3[2];
@@ -701,7 +773,6 @@ private:
 	float 	gain3;
 	float 	record4;
 	int 	iVec6[2];
-	float *tape4;
 	int 	tape4_size;
 	float 	reset4;
 	int 	RecSize4[2];
@@ -734,11 +805,38 @@ private:
 	bool mem_allocated;
     sigc::slot<void> sync;
 	volatile int ready;
-    FileResampler smp;
+    enum { max_tape_seconds = 3600, pool_pages = 48 };
+    Tape tapes[4];             // tape1 .. tape4
+    float *page_mem;           // locked memory for the resident pages
+    std::vector<float*> free_pages;
+    volatile int rt_cycle;     // odd while compute() runs
+    unsigned int tape_gen[4];  // drops results of outdated load requests
+    std::list<TapeJob*> jobs;
+    std::list<TapeJob*> done;
+    boost::mutex job_mutex;
+    boost::mutex tape_mutex;   // worker streaming vs. tape exchange
+    sem_t m_trig;
+    pthread_t m_pthr;
+    volatile bool stop_worker;
+    Glib::Dispatcher load_done;
 
-    int do_resample(int inrate, int insize, float *input, int maxsize);
-    int do_mono(int c, int f, float *oIn, float *tape, int n);
     void play_all_tapes();
+    void start_worker();
+    static void *run_worker(void *p);
+    void worker();
+    void queue_job(TapeJob *job);
+    void queue_load(int nr, const std::string& fname, bool mark_save);
+    void queue_save(int nr, const std::string& fname, float rectime);
+    bool run_load(TapeJob& job);
+    void run_save(TapeJob& job);
+    void on_load_done();
+    void set_tape(int nr, int frames);
+    bool alloc_pool();
+    void free_pool();
+    int wanted_pages(int nr, int *pg);
+    void wait_rt_cycle();
+    void stream_tapes();
+    static int max_tape_frames(int rate);
     void mem_alloc();
 	void mem_free();
 	void clear_state_f();
@@ -749,9 +847,8 @@ private:
 	int register_par(const ParamReg& reg);
     void save_array(std::string name);
     void load_array(std::string name);
-    void save_to_wave(std::string fname, float *tape, float fSize, int tape_size);
-    int load_from_wave(std::string fname, float **tape, int tape_size);
     void set_p_state();
+    void load_tape(int nr, const Glib::ustring& load_file);
     void load_tape1();
     void load_tape2();
     void load_tape3();
@@ -771,6 +868,69 @@ public:
 };
 
 
+/****************************************************************
+ ** class RecordRing
+ ** lock-free single reader / single writer ring of interleaved
+ ** frames (1 or 2 channels); the rt thread writes, a disk thread
+ ** reads; a write that doesn't fit is dropped and counted
+ ** members and methods accessed by the rt thread are marked RT
+ */
+
+class RecordRing {
+private:
+    float *buffer;
+    unsigned int size;           // in samples, power of 2
+    int channels;
+    volatile unsigned int wpos;  // RT
+    volatile unsigned int rpos;
+    unsigned int wcur;           // RT: write cursor between begin_write() and end_write()
+    volatile int overflow;       // RT
+public:
+    RecordRing(): buffer(), size(), channels(1), wpos(), rpos(), wcur(), overflow() {}
+    ~RecordRing() { delete[] buffer; }
+    void alloc(unsigned int frames, int channels);
+    void release() { delete[] buffer; buffer = 0; size = 0; }
+    void reset() { wpos = rpos = wcur = 0; overflow = 0; }
+    int get_channels() const { return channels; }
+    int get_overflow() { return gx_system::atomic_get(overflow); }
+    inline bool begin_write(int count); // RT
+    inline void put(float v) { buffer[wcur++ & (size-1)] = v; } // RT
+    inline void end_write() { gx_system::atomic_set(&wpos, wcur); } // RT
+    inline void write(int count, const float *in0, const float *in1); // RT; in0 == 0: silence
+    unsigned int read_space() { return (gx_system::atomic_get(wpos) - rpos) / channels; }
+    void read(unsigned int frames, float *out, int stride);
+};
+
+inline bool RecordRing::begin_write(int count) {
+    if (!buffer || count * channels > static_cast<int>(size - (wpos - gx_system::atomic_get(rpos)))) {
+	gx_system::atomic_inc(&overflow);
+	return false;
+    }
+    wcur = wpos;
+    return true;
+}
+
+inline void RecordRing::write(int count, const float *in0, const float *in1) {
+    if (!begin_write(count)) {
+	return;
+    }
+    if (!in0) {
+	for (int i = 0; i < count * channels; i++) {
+	    put(0.0);
+	}
+    } else if (channels == 1) {
+	for (int i = 0; i < count; i++) {
+	    put(in0[i]);
+	}
+    } else {
+	for (int i = 0; i < count; i++) {
+	    put(in0[i]);
+	    put(in1[i]);
+	}
+    }
+    end_write();
+}
+
 /****************************************************************
  ** class SCapture
  */
@@ -787,16 +947,15 @@ private:
     float           fslider0;
     float           fRecC0[2];
     float           fformat;
-    int             IOTA;
-    int             iA;
-    int             savesize;
+    bool            recording;
+    unsigned int    post_pos;
     int             filesize;
-    float           *fRec0;
-    float           *fRec1;
+    RecordRing      ring;
     float           *tape;
     sem_t           m_trig;
     pthread_t       m_pthr;
-    volatile bool   keep_stream;
+    volatile int    stop_count;
+    int             stops_written;
     bool            mem_allocated;
     bool            is_wav;
     bool            err;
@@ -810,10 +969,12 @@ private:
     int         activate(bool start);
     int         load_ui_f(const UiBuilder& b, int form);
     void        init(unsigned int samplingFreq);
+    inline void post_record(int count, int iSlow0, bool rec);
     void        compute(int count, float *input0, float *output0);
     void        compute_st(int count, float *input0, float *input1, float *output0, float *output1);
     int         register_par(const ParamReg& reg);
     void        save_to_wave(SNDFILE * sf, float *tape, int lSize);
+    void        flush_ring();
     SNDFILE     *open_stream(std::string fname);
     void        close_stream(SNDFILE **sf);
     void        stop_thread();
@@ -837,6 +998,155 @@ public:
 };
 
 
+/****************************************************************
+ ** class RecordTrack, class MultiTrackRecorder
+ ** records the raw input, the outputs of selected rack units and
+ ** the final outputs sample-aligned to disk, either into one
+ ** multichannel file or one file per track; every track has its
+ ** own RecordRing, a disk thread writes them in batches
+ ** members and methods accessed by the rt thread are marked RT
+ */
+
+class RecordTrack {
+public:
+    RecordRing ring;
+    std::string name;
+    SNDFILE *sf;           // file per track mode
+    int side;              // MultiTrackRecorder::side_mono or side_stereo
+    volatile bool active;  // RT
+    unsigned int frames;   // RT: frames of the current take
+    RecordTrack(): ring(), name(), sf(), side(), active(false), frames() {}
+    inline void write(int count, const float *in0, const float *in1); // RT
+};
+
+inline void RecordTrack::write(int count, const float *in0, const float *in1) {
+    if (active) {
+	ring.write(count, in0, in1);
+	frames += count;
+    }
+}
+
+class MultiTrackRecorder {
+public:
+    enum { side_mono, side_stereo };
+    enum { max_tracks = 16 };
+private:
+    enum { req_none, req_start, req_stop };
+    enum { st_idle, st_running, st_draining };
+    enum { batch_frames = 8192, ring_seconds = 4 };
+    EngineControl& engine;
+    RecordTrack tracks[max_tracks];
+    int ntracks;
+    int nchannels;
+    RecordTrack *input_track;    // RT
+    RecordTrack *output_track;   // RT
+    unsigned int side_frames[2]; // RT: frames of the current take for each side
+    volatile int request[2];     // RT: pending start / stop for each side
+    unsigned int post_frames;    // RT
+    unsigned int post_interval;
+    volatile int state;
+    bool record;
+    Glib::ustring taps;
+    int split;
+    SNDFILE *sf;                 // multichannel file
+    float *diskbuf;
+    sem_t m_trig;
+    pthread_t m_pthr;
+    bool thread_started;
+    BoolParameter *p_record;
+    Glib::Dispatcher overrun;
+    bool overrun_reported;
+    void on_record(bool v);
+    void on_overrun();
+    bool start();
+    void stop();
+    void clear_taps();
+    RecordTrack *add_track(const std::string& name, int side, int channels);
+    SNDFILE *open_file(const std::string& fname, int channels);
+    std::string get_basename();
+    void write_tracks();
+    void close_files();
+    void disc_stream();
+    void start_thread();
+    static void *run_thread(void* p);
+    inline void handle_request(int side, bool activate); // RT
+    inline void pad_tracks(int side, int count); // RT
+public:
+    MultiTrackRecorder(EngineControl& engine, ParamMap& param, ParameterGroups& groups);
+    ~MultiTrackRecorder();
+    bool is_recording() const { return state != st_idle; }
+    inline void begin_cycle_mono(int count, float *input); // RT
+    inline void end_cycle_mono(int count); // RT
+    inline void begin_cycle_stereo(int count); // RT
+    inline void end_cycle_stereo(int count, float *output0, float *output1); // RT
+};
+
+// a take starts and stops at a cycle boundary: the mono side (amp
+// client) handles the request first and hands it on to the stereo
+// side (insert client) which runs later in the same jack cycle
+inline void MultiTrackRecorder::handle_request(int side, bool activate) {
+    for (int i = 0; i < ntracks; i++) {
+	if (tracks[i].side == side) {
+	    tracks[i].active = activate;
+	}
+    }
+    side_frames[side] = 0;
+}
+
+// tracks of a side which got no data in this cycle (unit switched
+// off, chain muted) are filled with silence to keep them aligned
+inline void MultiTrackRecorder::pad_tracks(int side, int count) {
+    side_frames[side] += count;
+    for (int i = 0; i < ntracks; i++) {
+	RecordTrack& t = tracks[i];
+	if (t.active && t.side == side && t.frames < side_frames[side]) {
+	    t.write(side_frames[side] - t.frames, 0, 0);
+	}
+    }
+}
+
+inline void MultiTrackRecorder::begin_cycle_mono(int count, float *input) {
+    int r = gx_system::atomic_get(request[side_mono]);
+    if (r != req_none && gx_system::atomic_compare_and_exchange(&request[side_mono], r, req_none)) {
+	handle_request(side_mono, r == req_start);
+	gx_system::atomic_set(&request[side_stereo], r);
+    }
+    if (input_track) {
+	input_track->write(count, input, 0);
+    }
+}
+
+inline void MultiTrackRecorder::end_cycle_mono(int count) {
+    pad_tracks(side_mono, count);
+}
+
+inline void MultiTrackRecorder::begin_cycle_stereo(int count) {
+    int r = gx_system::atomic_get(request[side_stereo]);
+    if (r != req_none && gx_system::atomic_compare_and_exchange(&request[side_stereo], r, req_none)) {
+	handle_request(side_stereo, r == req_start);
+	if (r == req_start) {
+	    post_frames = 0;
+	} else {
+	    sem_post(&m_trig);
+	}
+    }
+}
+
+inline void MultiTrackRecorder::end_cycle_stereo(int count, float *output0, float *output1) {
+    if (output_track) {
+	output_track->write(count, output0, output1);
+    }
+    pad_tracks(side_stereo, count);
+    if (gx_system::atomic_get(state) == st_running) {
+	post_frames += count;
+	if (post_frames >= post_interval) {
+	    post_frames = 0;
+	    sem_post(&m_trig);
+	}
+    }
+}
+
+
 /****************************************************************************
 *
 * NAME: smbPitchShift.cpp
@@ -861,66 +1171,62 @@ public:
 
 
 #define M_PI 3.14159265358979323846
-#define MAX_FRAME_LENGTH 8096
+
+/*
+ ** phase vocoder running at the engine rate on float data; FFT
+ ** size and hop are selected by the latency setting, the analysis
+ ** latency (FFT size - hop) is reported to jack when the dry signal
+ ** is delayed to match it
+ */
 
 class smbPitchShift : public PluginDef {
 private:
-    gx_resample::SimpleResampler resamp;
     EngineControl&  engine;
 	bool            mem_allocated;
     sigc::slot<void> sync;
 	volatile bool ready;
     ParamMap& param;
-	float gInFIFO[MAX_FRAME_LENGTH];
-	float gOutFIFO[MAX_FRAME_LENGTH];
+    float *mem;          // one fftwf_malloc block for all buffers below
+	float *gInFIFO;      // fftFrameSize
+	float *gOutFIFO;     // stepSize
+	float *gOutputAccum; // 2*fftFrameSize
+    float *hanning;      // analysis window
+    float *hanningd;     // synthesis window with overlap-add scaling
+    float *fft_time;     // fftFrameSize
+    float *fft_re;       // fftFrameSize2+1, split complex spectrum
+    float *fft_im;
+	float *gLastPhase;   // fftFrameSize2+1 for all bin arrays
+	float *gSumPhase;
+	float *gAnaFreq;
+	float *gAnaMagn;
+	float *gSynFreq;
+	float *gSynMagn;
     float *fpb;
     float *expect;
-    float *hanning;
-    float *hanningd;
-    float *resampin;
-    float *resampin2;
-    float *resampout;
-    float *indata2;
-	float gLastPhase[MAX_FRAME_LENGTH/2+1];
-	float gSumPhase[MAX_FRAME_LENGTH/2+1];
-	float gOutputAccum[2*MAX_FRAME_LENGTH];
-	float gAnaFreq[MAX_FRAME_LENGTH];
-	float gAnaMagn[MAX_FRAME_LENGTH];
-	float gSynFreq[MAX_FRAME_LENGTH];
-	float gSynMagn[MAX_FRAME_LENGTH];
 	float semitones;
 	float a,b,c,d,l;
 	float wet;
 	float dry;
-    float mpi, mpi1;
-    float tone;
-	int   octave, osamp, numSampsToResamp, numSampsToProcess, fftFrameSize, sampleRate ;
+	int   octave, sampleRate;
 	int latency;
-    int ai;
-    int aio;
-    int ii;
-	long  gRover , gInit ;
-	double magn, phase, tmp, window, real, imag;
-	double freqPerBin, freqPerBin1, freqPerBin2, expct;
-    double fftFrameSize3;
-    double fftFrameSize4;
-    double osamp1,osamp2;
-	long   i,k, qpd, index, inFifoLatency, stepSize, fftFrameSize2;
-	
-    fftwf_complex fftw_in[MAX_FRAME_LENGTH], fftw_out[MAX_FRAME_LENGTH];
+	int   fftFrameSize, fftFrameSize2, osamp, stepSize, inFifoLatency;
+	int   gRover;
+    int   band1, band2, band3; // bins of the low / middle low / middle treble limits
+	float freqPerBin1, freqPerBin2;
     fftwf_plan ftPlanForward, ftPlanInverse;
     
     inline int load_ui_f(const UiBuilder& b, int form);
 	int register_par(const ParamReg& reg);
     void change_latency();
+    void report_latency();
    
     void mem_alloc();
 	void mem_free();
     void clear_state();
 	int activate(bool start);
-	bool setParameters( int sampleRate);
+	void setParameters(int sampleRate);
+	inline void process_frame(float pitchShift);
 	void PitchShift(int count, float *indata, float *outdata);
-    void change_buffersize(unsigned int size);
     static int  activate_static(bool start, PluginDef*);
     static void del_instance(PluginDef *p);
     static int registerparam(const ParamReg& reg);
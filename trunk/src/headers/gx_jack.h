@@ -119,6 +119,11 @@ class GxJack: public sigc::trackable {
     static int          gx_jack_buffersize_callback(jack_nframes_t, void* arg);
     static int          gx_jack_process(jack_nframes_t, void* arg);
     static int          gx_jack_insert_process(jack_nframes_t, void* arg);
+    static void         gx_jack_latency_callback(jack_latency_callback_mode_t mode, void* arg);
+    static void         gx_jack_insert_latency_callback(jack_latency_callback_mode_t mode, void* arg);
+    static void         set_port_latency(jack_latency_callback_mode_t mode, jack_port_t *in,
+					 jack_port_t *out, jack_nframes_t extra);
+    void                on_latency_change();
 
     static void         shutdown_callback_client(void* arg);
     static void         shutdown_callback_client_insert(void* arg);
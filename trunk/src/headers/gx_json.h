@@ -137,24 +137,15 @@ class JsonParser {
     bool good() { return is->good(); }
     token next(token expect = no_token);
     token peek() { return next_tok; }
-    streampos get_streampos() { return next_pos + streamoff(-1); }
+    streampos get_streampos() {
+        return is->rdbuf()->pubseekoff(0, ios::cur, ios::in) - streamoff(read_cnt - next_cnt); }
     void set_streampos(streampos pos);
     void check_expect(token expect) { if ((cur_tok & expect) == 0) throw_unexpected(expect); }
-    inline string current_value() const { return str; }
+    inline const string& current_value() const { return str; }
     int current_value_int() { return atoi(str.c_str()); }
     unsigned int current_value_uint() { return atoi(str.c_str()); }
-    float current_value_float() {
-        istringstream b(str);
-        float f;
-        b >> f;
-        return f;
-    }
-    double current_value_double() {
-        istringstream b(str);
-        double d;
-        b >> d;
-        return d;
-    }
+    float current_value_float();
+    double current_value_double();
     bool read_kv(const char *key, float& v);
     bool read_kv(const char *key, double& v);
     bool read_kv(const char *key, int& i);
@@ -181,11 +172,30 @@ class JsonParser {
     int next_depth;
     token next_tok;
     string next_str;
-    streampos next_pos;
+    // characters consumed so far / before start of next token;
+    // positions are computed from these on demand (no tellg per token)
+    unsigned long read_cnt;
+    unsigned long next_cnt;
+    inline int read_char() {
+        int c = is->rdbuf()->sbumpc();
+        if (c == char_traits<char>::eof()) {
+            is->setstate(ios::eofbit|ios::failbit);
+        } else {
+            read_cnt++;
+        }
+        return c;
+    }
+    inline int peek_char() {
+        int c = is->rdbuf()->sgetc();
+        if (c == char_traits<char>::eof()) {
+            is->setstate(ios::eofbit);
+        }
+        return c;
+    }
     const char* readcode();
-    string readstring();
+    void readstring();
     token read_value_token(char c);
-    string readnumber(char c);
+    void readnumber(char c);
     void read_next();
 };
 
@@ -204,10 +214,11 @@ private:
 public:
     JsonStringParser() {}
     void put(char c) { stream.put(c); }
+    void put(const char *p, std::streamsize n) { stream.write(p, n); }
     std::ostream& get_ostream() { return stream; }
     void start_parser() { stream.seekg(0); set_stream(&stream); }
     std::string get_string() { return stream.str(); }
-    void reset() { stream.str(""); JsonParser::reset(); }
+    void reset() { stream.str(""); stream.clear(); JsonParser::reset(); }
     char peek_first_char() { stream >> ws; return stream.peek(); }
 };
 
@@ -402,6 +413,8 @@ public:
 class AbstractPresetIO {
 public:
     virtual ~AbstractPresetIO();
+    virtual bool read_snapshot(PresetFile&, const Glib::ustring&);
+    virtual void compile_bank(PresetFile&);
     virtual void read_preset(JsonParser&,const SettingsFileHeader&) = 0;
     virtual void commit_preset() = 0;
     virtual void write_preset(JsonWriter&) = 0;
@@ -320,6 +320,7 @@ public:
     void display(bool v, bool animate);
     bool get_plug_visible() { return plugin.plugin->get_plug_visible(); }
     bool get_box_visible() { return box_visible; }
+    void set_load(const gx_engine::PluginLoadInfo *info, float period) { minibox->set_load(info, period); }
 };
 
 class MiniRackBox: public Gtk::HBox {
@@ -330,6 +331,7 @@ private:
     Gtk::Button *mb_expand_button;
     Gtk::Widget *mb_delete_button;
     Gtk::Button *preset_button;
+    Gtk::Label load_label;
     Gxw::Switch on_off_switch;
     bool on_my_leave_out(GdkEventCrossing *focus);
     bool on_my_enter_in(GdkEventCrossing *focus);
@@ -340,6 +342,7 @@ public:
     MiniRackBox(RackBox& rb, gx_system::CmdlineOptions& options);
     void set_config_mode(bool mode);
     void pack(Gtk::Widget *w);
+    void set_load(const gx_engine::PluginLoadInfo *info, float period);
 };
 
 /****************************************************************
@@ -540,6 +543,7 @@ struct GxActions {
     Glib::RefPtr<UiBoolToggleAction> midi_out;
     Glib::RefPtr<UiBoolToggleAction> midi_out_plug;
     Glib::RefPtr<Gtk::ToggleAction> show_values;
+    Glib::RefPtr<Gtk::ToggleAction> show_plugin_load;
     Glib::RefPtr<Gtk::ToggleAction> tooltips;
     Glib::RefPtr<UiSwitchToggleAction> midi_in_presets;
     Glib::RefPtr<Gtk::ToggleAction> rackh;
@@ -567,7 +571,8 @@ private:
     RackContainer monorackcontainer;
     RackContainer stereorackcontainer;
     int pre_act;
-    bool is_visible;
+    bool is_visible; // not fully obscured
+    bool is_hidden;  // iconified or withdrawn
    // bool ui_sleep();
     DragIcon *drag_icon;
     Glib::ustring preset_list_menu_bank;
@@ -602,6 +607,7 @@ private:
     std::map<Glib::ustring, Gtk::ToolItemGroup*> groupmap;
     ladspa::PluginDisplay *ladspalist_window;
     Glib::RefPtr<Gtk::SizeGroup> szg_rack_units;
+    sigc::connection plugin_load_conn;
 
     // Widget pointers
     Gxw::PaintBox *tunerbox;
@@ -686,9 +692,12 @@ private:
     RackBox *add_rackbox_internal(PluginUI& plugin, Gtk::Widget *mainwidget, Gtk::Widget *miniwidget,
 				  bool mini=false, int pos=-1, bool animate=false, Gtk::Widget *bare=0);
     void on_show_values();
+    void on_show_plugin_load();
+    bool update_plugin_load();
     void create_actions();
     void add_toolitem(PluginUI& pl, Gtk::ToolItemGroup *gw);
     bool on_visibility_notify(GdkEventVisibility *ev);
+    void update_refresh_pause();
     void on_live_play();
     void on_ti_drag_begin(const Glib::RefPtr<Gdk::DragContext>& context, const PluginUI& plugin);
     void on_ti_drag_end(const Glib::RefPtr<Gdk::DragContext>& context);
@@ -37,6 +37,59 @@ public:
 };
 
 
+/****************************************************************
+ ** class RackPipeline
+ ** runs the stages of a processing chain on worker threads,
+ ** each stage working on the output of the preceding stage
+ ** from the last period (adds (stages-1) periods of latency)
+ ** a stage function gets and returns the "mono" state of its
+ ** buffers (second channel not filled, same signal as the first)
+ ** members and methods accessed by the rt thread are marked RT
+ */
+
+class RackPipeline {
+public:
+    enum { max_stages = 8, max_channels = 2 };
+    typedef bool (*stagefunc)(void *stage, int count, float *buf1, float *buf2, bool mono);
+private:
+    struct Worker {
+	RackPipeline *pipe;
+	int stage;
+	pthread_t pthr;
+	sem_t start;    // RT
+    };
+    int stages;
+    int channels;
+    unsigned int bufsize;
+    Worker workers[max_stages]; // index 0 unused, stage 0 runs in the jack thread
+    float *buffers[max_stages][max_channels]; // RT
+    bool mono[max_stages]; // RT
+    float *mem;
+    sem_t done;         // RT
+    stagefunc func;     // RT
+    void *stage_data[max_stages]; // RT
+    int count;          // RT
+    volatile bool quit;
+    bool running;
+    int nthreads;
+    int policy;
+    int priority;
+    static void *run_thread(void *p);
+    void run_stage(int stage); // RT
+public:
+    RackPipeline();
+    ~RackPipeline();
+    void set_stages(int n) { stages = max(1, min(n, int(max_stages))); }
+    inline int get_stages() const { return stages; }
+    inline bool is_active() const { return stages > 1 && running; } // RT
+    void set_buffersize(unsigned int bs, int nchannels);
+    void start_threads(int policy, int priority);
+    void stop_threads();
+    void process(int count, float *in1, float *in2, float *out1, float *out2,
+		 stagefunc f, void **stage_list); // RT
+};
+
+
 /****************************************************************
  ** class ProcessingChainBase
  ** members and methods accessed by the rt thread are marked RT
@@ -55,7 +108,9 @@ protected:
     int steps_up;		// RT; >= 1
     int steps_up_dead;		// RT; >= 0
     int steps_down;		// RT; >= 1
+    int samplerate;
     list<Plugin*> modules;
+    RackPipeline pipeline;
     inline void set_ramp_value(int n) { gx_system::atomic_set(&ramp_value, n); } // RT
     inline void set_ramp_mode(RampMode n) { gx_system::atomic_set(&ramp_mode, n); } // RT
     void try_set_ramp_mode(RampMode oldmode, RampMode newmode, int oldrv, int newrv); // RT
@@ -67,6 +122,8 @@ public:
     }
     inline int get_ramp_value() { return gx_system::atomic_get(ramp_value); } // RT
     void set_samplerate(int samplerate);
+    void update_oversample();
+    int get_oversample_latency();
     bool set_plugin_list(const list<Plugin*> &p);
     void clear_module_states();
     inline void post_rt_finished() { // RT
@@ -87,8 +144,12 @@ public:
     void start_ramp_down();
     inline void set_down_dead() { set_ramp_mode(ramp_mode_down_dead); }
     inline bool is_down_dead() { return get_ramp_mode() == ramp_mode_down_dead; }
+    inline void set_ramp_off() { set_ramp_value(steps_up); set_ramp_mode(ramp_mode_off); }
     void set_stopped(bool v);
     bool is_stopped() { return stopped; }
+    int get_pipeline_stages() { return pipeline.get_stages(); }
+    int get_pipeline_latency() { return pipeline.is_active() ? pipeline.get_stages() - 1 : 0; }
+    void start_pipeline(int policy, int priority) { pipeline.start_threads(policy, priority); }
 #ifndef NDEBUG
     void print_chain_state(const char *title);
 #endif
@@ -108,10 +169,12 @@ private:
     int current_index;
     F *current_pointer;
     void setsize(int n);
-    inline F get_audio(PluginDef *p);
+    inline F get_audio(Plugin *p);
 protected:
     F *processing_pointer; // RT
     inline F* get_rt_chain() { return gx_system::atomic_get(processing_pointer); } // RT
+    inline void get_rt_stages(F *chain, void **stage_list); // RT
+    inline bool process_serial(int count, float *buf1, float *buf2, bool mono); // RT
 public:
     ThreadSafeChainPointer();
     ~ThreadSafeChainPointer();
@@ -122,6 +185,7 @@ public:
 	}
     }
     void commit(bool clear, ParamMap& pmap);
+    void set_pipeline_stages(int n);
 };
 
 typedef void (*monochainorder)(int count, float *output, float *output1,
@@ -132,27 +196,41 @@ typedef void (*stereochainorder)(int count, float* input, float* input1,
 struct monochain_data {
     monochainorder func;
     PluginDef      *plugin;
-    monochain_data(monochainorder func_, PluginDef *plugin_): func(func_), plugin(plugin_) {}
-    monochain_data(): func(), plugin() {}
+    PluginLoad     *load;
+    gx_resample::Oversampler *oversampler;
+    RecordTrack    **rec_track;
+    monochain_data(monochainorder func_, PluginDef *plugin_, PluginLoad *load_,
+		   gx_resample::Oversampler *oversampler_, RecordTrack **rec_track_)
+	: func(func_), plugin(plugin_), load(load_), oversampler(oversampler_), rec_track(rec_track_) {}
+    monochain_data(): func(), plugin(), load(), oversampler(), rec_track() {}
+    inline void run_oversampled(int count, float *buf); // RT
+    static bool process_stage(void *stage, int count, float *buf1, float *buf2, bool mono); // RT
 };
 
 struct stereochain_data {
     stereochainorder func;
     PluginDef       *plugin;
-    stereochain_data(stereochainorder func_, PluginDef *plugin_): func(func_), plugin(plugin_) {}
-    stereochain_data(): func(), plugin() {}
+    PluginLoad      *load;
+    gx_resample::Oversampler *oversampler;
+    RecordTrack     **rec_track;
+    stereochain_data(stereochainorder func_, PluginDef *plugin_, PluginLoad *load_,
+		     gx_resample::Oversampler *oversampler_, RecordTrack **rec_track_)
+	: func(func_), plugin(plugin_), load(load_), oversampler(oversampler_), rec_track(rec_track_) {}
+    stereochain_data(): func(), plugin(), load(), oversampler(), rec_track() {}
+    inline void run_oversampled(int count, float *buf1, float *buf2); // RT
+    static bool process_stage(void *stage, int count, float *buf1, float *buf2, bool mono); // RT
 };
 
 template <>
-inline monochain_data ThreadSafeChainPointer<monochain_data>::get_audio(PluginDef *p)
+inline monochain_data ThreadSafeChainPointer<monochain_data>::get_audio(Plugin *p)
 {
-    return monochain_data(p->mono_audio, p);
+    return monochain_data(p->get_pdef()->mono_audio, p->get_pdef(), &p->load, p->get_oversampler(), &p->rec_track);
 }
 
 template <>
-inline stereochain_data ThreadSafeChainPointer<stereochain_data>::get_audio(PluginDef *p)
+inline stereochain_data ThreadSafeChainPointer<stereochain_data>::get_audio(Plugin *p)
 {
-    return stereochain_data(p->stereo_audio, p);
+    return stereochain_data(p->get_pdef()->stereo_audio, p->get_pdef(), &p->load, p->get_oversampler(), &p->rec_track);
 }
 
 template <class F>
@@ -187,10 +265,56 @@ void ThreadSafeChainPointer<F>::setsize(int n)
     current_pointer = rack_order_ptr[current_index];
 }
 
+template <class F>
+void ThreadSafeChainPointer<F>::set_pipeline_stages(int n) {
+    // must be called before the first commit, the (empty) chain
+    // needs one 0 marker per stage
+    pipeline.set_stages(n);
+    int stages = pipeline.get_stages();
+    for (int i = 0; i < 2; i++) {
+	current_index = i;
+	setsize(stages);
+	for (int j = 0; j < stages; j++) {
+	    current_pointer[j].func = 0;
+	}
+    }
+    processing_pointer = rack_order_ptr[0];
+    current_index = 1;
+    current_pointer = rack_order_ptr[1];
+}
+
+template <class F>
+inline void ThreadSafeChainPointer<F>::get_rt_stages(F *p, void **stage_list) {
+    // stages are stored as consecutive 0-terminated lists
+    for (int i = 0; i < pipeline.get_stages(); i++) {
+	stage_list[i] = p;
+	while (p->func) {
+	    ++p;
+	}
+	++p;
+    }
+}
+
+template <class F>
+inline bool ThreadSafeChainPointer<F>::process_serial(int count, float *buf1, float *buf2, bool mono) {
+    // fallback when the pipeline is not running: all stages in a row
+    F *p = get_rt_chain();
+    for (int i = 0; i < pipeline.get_stages(); i++) {
+	mono = F::process_stage(p, count, buf1, buf2, mono);
+	while (p->func) {
+	    ++p;
+	}
+	++p;
+    }
+    return mono;
+}
+
 template <class F>
 void ThreadSafeChainPointer<F>::commit(bool clear, ParamMap& pmap) {
-    setsize(modules.size()+1);  // leave one slot for 0 marker
-    int active_counter = 0;
+    update_oversample();
+    int stages = pipeline.get_stages();
+    setsize(modules.size()+stages);  // leave one slot for 0 marker per stage
+    list<Plugin*> active;
     for (list<Plugin*>::const_iterator p = modules.begin(); p != modules.end(); p++) {
 	PluginDef* pd = (*p)->get_pdef();
 	if (pd->activate_plugin) {
@@ -201,11 +325,25 @@ void ThreadSafeChainPointer<F>::commit(bool clear, ParamMap& pmap) {
 	} else if (pd->clear_state && clear) {
 	    pd->clear_state(pd);
 	}
-	F f = get_audio(pd);
+	active.push_back(*p);
+    }
+    // distribute the active modules over the pipeline stages
+    int active_counter = 0;
+    int n = active.size();
+    int stage = 0;
+    int i = 0;
+    for (list<Plugin*>::const_iterator p = active.begin(); p != active.end(); ++p, ++i) {
+	while (i >= ((stage+1) * n + stages - 1) / stages) {
+	    current_pointer[active_counter++].func = 0;
+	    stage++;
+	}
+	F f = get_audio(*p);
 	assert(f.func);
 	current_pointer[active_counter++] = f;
     }
-    current_pointer[active_counter].func = 0;
+    for ( ; stage < stages; stage++) {
+	current_pointer[active_counter++].func = 0;
+    }
     gx_system::atomic_set(&processing_pointer, current_pointer);
     set_latch();
     current_index = (current_index+1) % 2;
@@ -220,6 +358,7 @@ class MonoModuleChain: public ThreadSafeChainPointer<monochain_data> {
 public:
     MonoModuleChain(): ThreadSafeChainPointer<monochain_data>() {}
     void process(int count, float *input, float *output);
+    void set_buffersize(unsigned int bs) { pipeline.set_buffersize(bs, 1); }
     inline void print() { printlist("Mono", modules); }
 };
 
@@ -227,6 +366,7 @@ class StereoModuleChain: public ThreadSafeChainPointer<stereochain_data> {
 public:
     StereoModuleChain(): ThreadSafeChainPointer<stereochain_data>() {}
     void process(int count, float *input1, float *input2, float *output1, float *output2);
+    void set_buffersize(unsigned int bs) { pipeline.set_buffersize(bs, 2); }
     inline void print() { printlist("Stereo", modules); }
 };
 
@@ -250,6 +390,10 @@ protected:
     sigc::signal<void, unsigned int> samplerate_change;
     unsigned int buffersize;
     unsigned int samplerate;
+    // latency of units in the mono chain (in frames), reported to jack
+    map<string, int> unit_latency;
+    volatile int mono_latency;
+    sigc::signal<void> latency_change;
 public:
     enum OverloadType {		// type of overload condition
 	ov_User      = 0x1,	// idle thread probe starved
@@ -275,6 +419,9 @@ public:
     bool get_rack_changed();
     sigc::signal<void, unsigned int>& signal_buffersize_change() { return buffersize_change; }
     sigc::signal<void, unsigned int>& signal_samplerate_change() { return samplerate_change; }
+    void set_unit_latency(const char *id, int frames);
+    int get_mono_latency() { return gx_system::atomic_get(mono_latency); }
+    sigc::signal<void>& signal_latency_change() { return latency_change; }
     void add_selector(ModuleSelector& sel);
     void registerParameter(ParameterGroups& groups);
     void get_sched_priority(int &policy, int &priority, int prio_dim = 0);
@@ -305,6 +452,7 @@ protected:
     static int         sporadic_interval; // seconds; overload if at least 2 events in the timespan
 protected:
     void check_overload();
+    void on_buffersize_change(unsigned int bs);
 public:
     MonoModuleChain mono_chain;  // active modules (amp chain, input to insert output)
     StereoModuleChain stereo_chain;  // active stereo modules (effect chain, after insert input)
@@ -333,6 +481,21 @@ public:
 	mono_chain.set_down_dead();
 	stereo_chain.set_down_dead();
     }
+    void set_ramp_off() { // start at full level (offline processing)
+	mono_chain.set_ramp_off();
+	stereo_chain.set_ramp_off();
+    }
+    void set_pipeline_stages(int n) {
+	mono_chain.set_pipeline_stages(n);
+	stereo_chain.set_pipeline_stages(n);
+    }
+    // in periods; the chains run in separate jack clients, each
+    // pipeline delays its own client by stages-1 periods
+    int get_mono_pipeline_latency() { return mono_chain.get_pipeline_latency(); }
+    int get_stereo_pipeline_latency() { return stereo_chain.get_pipeline_latency(); }
+    int get_pipeline_latency() { // amp input to fx output
+	return get_mono_pipeline_latency() + get_stereo_pipeline_latency();
+    }
     bool prepare_module_lists();
     void commit_module_lists();
     virtual void set_rack_changed();
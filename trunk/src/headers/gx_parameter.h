@@ -220,6 +220,8 @@ template<class T>
 class ParameterV: public Parameter {
 };
 
+class ParamUpdateQueue;
+
 template<>
 class ParameterV<float>: public Parameter {
 private:
@@ -233,10 +235,17 @@ protected:
     float lower, upper, step;
     sigc::signal<void, float> changed;
     float value_storage;
+    ParamUpdateQueue *update_queue; // 0: value is written directly
+    float smoothing;		    // ramp time in ms
+    mutable float target;	    // last value handed to update_queue
     friend class ParamRegImpl;
+    friend class ParamUpdateQueue;
 public:
     bool set(float val) const;
-    float get_value() const { return *value; }
+    float get_value() const { return update_queue ? target : *value; }
+    float get_json_value() const { return json_value; }
+    void set_smoothing(ParamUpdateQueue *q, float ms);
+    bool is_smoothed() const { return update_queue != 0; }
     void convert_from_range(float low, float up);
     virtual void stdJSON_value();
     virtual bool on_off_value();
@@ -252,7 +261,8 @@ public:
     ParameterV(const string& id, const string& name, ctrl_type ctp, bool preset,
 	       float *v, float sv, float lv, float uv, float tv, bool ctrl, bool no_init):
 	Parameter(id, name, tp_float, ctp, preset, ctrl),
-	value(v ? v : &value_storage), std_value(sv),lower(lv),upper(uv),step(tv) {
+	value(v ? v : &value_storage), std_value(sv),lower(lv),upper(uv),step(tv),
+	update_queue(0), smoothing(0), target(0) {
 	set(no_init ? *value : sv);
     }
 #ifndef NDEBUG
@@ -298,6 +308,7 @@ protected:
 public:
     bool set(int val) const;
     int get_value() const { return *value; }
+    int get_json_value() const { return json_value; }
     virtual void stdJSON_value();
     virtual bool on_off_value();
     virtual void writeJSON(gx_system::JsonWriter& jw) const;
@@ -354,6 +365,7 @@ public:
     bool set(bool val) const;
     virtual void stdJSON_value();
     bool get_value() const { return *value; }
+    bool get_json_value() const { return json_value; }
     virtual bool on_off_value();
     virtual void writeJSON(gx_system::JsonWriter& jw) const;
     virtual bool compareJSON_value();
@@ -500,6 +512,54 @@ inline sigc::signal<void, const Glib::ustring&>& Parameter::signal_changed_strin
 }
 
 
+/****************************************************************
+ ** ParamUpdateQueue
+ **
+ ** hands value changes of smoothed FloatParameters from the
+ ** UI thread to the RT thread (single producer / single consumer,
+ ** no locks); the RT thread applies them as linear ramps
+ */
+
+class ParamUpdateQueue: boost::noncopyable {
+private:
+    enum { queue_size = 256, max_ramps = 256 }; // queue_size must be 2^n
+    struct Event {
+	FloatParameter *param;
+	float value;
+	bool forget;
+    };
+    struct Ramp {
+	FloatParameter *param;
+	float step;
+	int count;
+    };
+    Event events[queue_size];
+    volatile unsigned int write_pos;
+    volatile unsigned int read_pos;
+    Ramp ramps[max_ramps];
+    int num_ramps;
+    volatile int active;
+    float period_ms;
+    pthread_t rt_thread;
+    sem_t sync_sem;		// posted by RT after a forget event
+    bool put(FloatParameter *p, float v, bool forget);
+    void remove_ramp(FloatParameter *p);
+    void drain();
+    void wait_rt();
+public:
+    static const float default_smoothing; // ms
+    ParamUpdateQueue();
+    ~ParamUpdateQueue();
+    bool push(FloatParameter *p, float v);
+    void start_ramp(FloatParameter *p, float v); //RT
+    void midi_ramp(FloatParameter *p, float v); //RT or UI thread
+    inline void set_rt_thread() { rt_thread = pthread_self(); } //RT
+    void process(unsigned int nframes, unsigned int samplerate); //RT
+    void set_active(bool on);
+    void rt_stopped();
+    void forget(FloatParameter *p);
+};
+
 /****************************************************************
  ** ParamMap
  */
@@ -509,6 +569,7 @@ class ParamMap: boost::noncopyable {
     map<string, Parameter*> id_map;
     bool replace_mode;
     sigc::signal<void,Parameter*,bool> insert_remove;
+    ParamUpdateQueue update_queue;
 #ifndef NDEBUG
     void unique_id(Parameter* param);
     void check_id(const string& id);
@@ -544,6 +605,7 @@ class ParamMap: boost::noncopyable {
     sigc::signal<void,Parameter*,bool> signal_insert_remove() { return insert_remove; }
     void unregister(Parameter *p);
     void unregister(const string& id);
+    ParamUpdateQueue& get_update_queue() { return update_queue; }
     inline FloatParameter *reg_par(const string& id, const string& name, float *var, float std,
 				   float lower, float upper, float step) {
 	FloatParameter *p = new FloatParameter(id, name, Parameter::Continuous, true, var, std, lower, upper, step, true, replace_mode);
@@ -725,31 +787,35 @@ public:
 class MidiControllerList: public sigc::trackable {
 public:
 private:
+    // events for the GUI thread: single producer (RT), single consumer
+    enum { event_queue_size = 256 }; // must be a power of 2
+    enum { ev_program, ev_mute, ev_bank };
+    struct midi_event {
+	int type;
+	int value;
+    };
     ControllerArray        map; //RT
     int                    last_midi_control_value[ControllerArray::array_size]; //RT
     int                    last_midi_control; //RT
-    volatile gint          program_change; //RT
-    volatile gint          mute_change; //RT
-    volatile gint          bank_change; //RT
-    timespec               ts1;
-    double                 time0;
+    midi_event             event_queue[event_queue_size]; //RT
+    volatile unsigned int  event_write; //RT
+    volatile unsigned int  event_read; //RT
+    int                    event_fd;
+    sigc::connection       event_conn;
     unsigned int           bpm_;
     MidiClockToBpm         mp;
-    Glib::Dispatcher       pgm_chg;
-    Glib::Dispatcher       mute_chg;
-    Glib::Dispatcher       bank_chg;
     sigc::signal<void>     changed;
     sigc::signal<void,int> new_program;
     sigc::signal<void,int> new_mute_state;
     sigc::signal<void,int> new_bank;
     sigc::signal<void, int, int> midi_value_changed;
 private:
-    void               on_pgm_chg();
-    void               on_mute_chg();
-    void               on_bank_chg();
+    inline bool post_event(int type, int value); //RT
+    bool on_midi_events(Glib::IOCondition cond);
     bool check_midi_values();
 public:
     MidiControllerList();
+    ~MidiControllerList();
     midi_controller_list& operator[](int n) { return map[n]; }
     int size() { return map.size(); }
     void set_config_mode(bool mode, int ctl=-1);
@@ -773,7 +839,7 @@ public:
     sigc::signal<void,int>& signal_new_program() { return new_program; }
     sigc::signal<void,int>& signal_new_mute_state() { return new_mute_state; }
     sigc::signal<void,int>& signal_new_bank() { return new_bank; }
-    void compute_midi_in(void* midi_input_port_buf, void *arg);  //RT
+    void compute_midi_in(void* midi_input_port_buf, unsigned int period_start, unsigned int sr);  //RT
     void process_trans(int transport_state);  //RT
     void update_from_controller(int ctr);
     void update_from_controllers();
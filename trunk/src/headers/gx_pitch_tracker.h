@@ -38,6 +38,8 @@ class PitchTracker {
     void            add(int count, float *input);
     float           get_estimated_freq() { return m_freq < 0 ? 0 : m_freq; }
     float           get_estimated_note();
+    // NSDF peak value of the last estimate (0 .. 1, 0 == no pitch)
+    float           get_estimated_confidence() { return m_confidence; }
     void            stop_thread();
     void            reset();
     void            set_fast_note_detection(bool v);
@@ -47,7 +49,10 @@ class PitchTracker {
     void            run();
     static void     *static_run(void* p);
     void            start_thread(int policy, int priority);
-    void            copy();
+    bool            copy(unsigned int first, int len, float *dst);
+    void            fft_correlation();
+    void            add_block(const float *block);
+    void            block_correlation();
     bool            error;
     volatile bool   busy;
     int             tick;
@@ -56,6 +61,7 @@ class PitchTracker {
     Resampler       resamp;
     int             m_sampleRate;
     float           m_freq;
+    float           m_confidence;
     // Value of the threshold above which
     // the processing is activated.
     float           signal_threshold_on;
@@ -68,12 +74,38 @@ class PitchTracker {
     int             m_buffersize;
     // Size of the FFT window.
     int             m_fftSize;
-    // The audio buffer that stores the input signal.
+    // The audio ring buffer that stores the input signal.
     float           *m_buffer;
     // Index of the first empty position in the buffer.
     int             m_bufferIndex;
-    // buffer for input signal
+    // Number of samples written to m_buffer (wraps around).
+    volatile unsigned int m_written;
+    // Largest number of samples written to m_buffer by one add().
+    unsigned int    m_maxBlock;
+    // linear copy of the analysis window
     float           *m_input;
+    // Number of blocks in the window for the incremental correlation
+    // (0: window is no multiple of the block size, always use the FFT).
+    int             m_nblocks;
+    // Number of block distances needed for the lag range.
+    int             m_nparts;
+    // Number of samples added to the incremental correlation (wraps around).
+    unsigned int    m_processed;
+    // Samples added since the incremental correlation was (re)seeded.
+    unsigned int    m_sinceFull;
+    // Number of blocks in the incremental correlation.
+    int             m_blocks;
+    // Position of the next block in m_spectra.
+    int             m_blockPos;
+    // m_parts is valid for the window ending at m_processed
+    bool            m_corrValid;
+    // Spectra of the window blocks (ring of m_nblocks+1 entries).
+    float           *m_spectra;
+    // Running sums of the cross spectra of all block pairs in the
+    // window, one entry per block distance.
+    float           *m_parts;
+    // Autocorrelation of the window assembled from m_parts.
+    float           *m_corr;
     // Whether or not the input level is high enough.
     bool            m_audioLevel;
     // Support buffer used to store signals in the time domain.
@@ -84,6 +116,9 @@ class PitchTracker {
     fftwf_plan      m_fftwPlanFFT;
     // Plan to compute the IFFT of a given signal (with additional zero-padding).
     fftwf_plan      m_fftwPlanIFFT;
+    // Plans for one zero-padded block of the incremental correlation.
+    fftwf_plan      m_fftwPlanBlock;
+    fftwf_plan      m_fftwPlanBlockInv;
 };
 
 }
@@ -167,6 +167,12 @@ enum {
     PGN_MODE_MUTE   = 0x0400, // plugin is active in mute mode
     PGN_FIXED_GUI   = 0x0800, // user cannot hide plugin GUI
     PGN_NO_PRESETS  = 0x1000,
+    PGN_OVERSAMPLE  = 0x2000, // nonlinear mono unit, register parameter to run it
+				// at 2x / 4x of the engine samplerate
+    PGN_MONO_SAFE   = 0x4000, // (stereo) outputs are equal when the inputs are; while
+				// both channels carry the same signal the stereo chain
+				// calls stereo_audio with input1 == output1 == 0 and only
+				// the first channel is computed (faust: dsp2cc --mono-safe)
     // For additional flags see struct Plugin
 };
 
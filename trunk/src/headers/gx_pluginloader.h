@@ -27,6 +27,95 @@ struct stringcomp {
 namespace gx_engine {
 
 class EngineControl;
+class RecordTrack;
+
+/****************************************************************
+ ** class PluginLoad
+ ** processing time of a plugin in the rt thread; the rt thread
+ ** accumulates into a private set and publishes it about once per
+ ** second into one of 2 snapshot slots, followed by an increment of
+ ** the sequence number. get() copies the latest snapshot without
+ ** changing it, so any number of readers see all measurements.
+ */
+
+struct PluginLoadInfo {
+    int count;		// number of periods measured
+    float mean;		// processing time per period in microseconds
+    float minimum;
+    float maximum;
+    float p99;		// 99th percentile (histogram bucket resolution)
+};
+
+class PluginLoad {
+public:
+    enum { bucket_count = 96 };
+    static const long long window_ns = 1000000000LL;
+private:
+    struct Accum {
+	unsigned int count;
+	unsigned int minimum;
+	unsigned int maximum;
+	unsigned long long sum;
+	long long end;		// CLOCK_MONOTONIC ns of last measurement
+	unsigned int hist[bucket_count];
+	void reset();
+    };
+    Accum work;			// RT
+    long long window_start;	// RT
+    Accum snap[2];
+    volatile int seq;		// snapshot snap[seq&1] is valid
+    static inline int bucket(unsigned int ns);
+    static float bucket_limit(int b);
+    static inline long long to_ns(const timespec& t) { return t.tv_sec * 1000000000LL + t.tv_nsec; }
+    inline void publish(long long now); // RT
+public:
+    PluginLoad();
+    inline void add(const timespec& t1, const timespec& t0); // RT
+    bool get(PluginLoadInfo& info);
+};
+
+/* buckets with 4 steps per octave, starting at 64ns */
+inline int PluginLoad::bucket(unsigned int ns) {
+    unsigned int v = ns >> 6;
+    if (v < 4) {
+	return v;
+    }
+    int msb = 31 - __builtin_clz(v);
+    return min(int(((msb - 1) << 2) | ((v >> (msb - 2)) & 3)), int(bucket_count - 1));
+}
+
+inline void PluginLoad::publish(long long now) {
+    int s = seq;
+    work.end = now;
+    snap[(s + 1) & 1] = work;
+    gx_system::atomic_set(&seq, s + 1);
+    work.reset();
+}
+
+inline void PluginLoad::add(const timespec& t1, const timespec& t0) {
+    long long now = to_ns(t1);
+    long long d = now - to_ns(t0);
+    if (d < 0 || d > 1000000000LL) {
+	return; // clock problem
+    }
+    unsigned int ns = d;
+    if (!work.count) {
+	window_start = now;
+    }
+    work.count += 1;
+    work.sum += ns;
+    if (ns < work.minimum) {
+	work.minimum = ns;
+    }
+    if (ns > work.maximum) {
+	work.maximum = ns;
+    }
+    work.hist[bucket(ns)] += 1;
+    if (now - window_start >= window_ns) {
+	publish(now);
+    }
+}
+
 
 /****************************************************************
  ** class Plugin
@@ -48,13 +137,18 @@ private:
     BoolParameter *p_on_off;	   // Audio Processing
     IntParameter  *p_position; // Position in Rack / Audio Processing Chain
     IntParameter  *p_effect_post_pre; // pre/post amp position (post = 0)
+    IntParameter  *p_oversample; // oversampling factor (1 << value), PGN_OVERSAMPLE only
+    gx_resample::Oversampler *oversampler;
     int pos_tmp;
 public:
+    PluginLoad load;
+    RecordTrack *rec_track; // RT: multitrack recorder tap after this unit
     PluginDef *get_pdef() { return pdef; }
     void set_pdef(PluginDef *p) { pdef = p; }
     enum { POST_WEIGHT = 2000 };
     Plugin(PluginDef *pl=0);
     Plugin(gx_system::JsonParser& jp, ParamMap& pmap);
+    ~Plugin();
     void writeJSON(gx_system::JsonWriter& jw);
     bool get_box_visible() const { return p_box_visible && p_box_visible->get_value(); }
     bool get_plug_visible() const { return p_plug_visible && p_plug_visible->get_value(); }
@@ -72,6 +166,12 @@ public:
     const std::string& id_position() const { return p_position->id(); }
     const std::string& id_effect_post_pre() const { return p_effect_post_pre->id(); }
     inline int position_weight() { return get_effect_post_pre() ? get_position() : get_position() + POST_WEIGHT; }
+    gx_resample::Oversampler *get_oversampler() { return oversampler; }
+    int get_oversample() const { return oversampler ? oversampler->get_factor() : 1; }
+    int get_oversample_latency() const { return oversampler ? oversampler->get_latency() : 0; }
+    bool oversample_changed() const {
+	return oversampler && oversampler->get_factor() != (1 << p_oversample->get_value()); }
+    void update_oversample(unsigned int samplerate);
     void register_vars(ParamMap& param, EngineControl& seq);
     void copy_position(const Plugin& plugin);
     friend class PluginListBase;
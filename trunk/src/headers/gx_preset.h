@@ -62,7 +62,44 @@ public:
     bool empty() { return m.empty(); }
 };
 
-class PresetIO: public gx_system::AbstractPresetIO {
+class PresetSnapshot: boost::noncopyable {
+public:
+    class Value {
+    public:
+	gx_engine::Parameter *param;
+	float value; // index into jconv for JConvParameter
+	Value(gx_engine::Parameter *p, float v): param(p), value(v) {}
+    };
+    std::vector<Value> values;
+    std::vector<gx_engine::GxJConvSettings> jconv;
+    gx_engine::ControllerArray *midi;
+    std::vector<std::string> mono;
+    std::vector<std::string> stereo;
+    PresetSnapshot(): values(), jconv(), midi(0), mono(), stereo() {}
+    ~PresetSnapshot() { delete midi; }
+};
+
+class FileStamp {
+public:
+    timespec mtime;
+    timespec ctime;
+    off_t size;
+    FileStamp(): mtime(), ctime(), size(0) {}
+    explicit FileStamp(const std::string& filename);
+    bool operator==(const FileStamp& f) const;
+    bool operator!=(const FileStamp& f) const { return !(*this == f); }
+};
+
+class CompiledBank: boost::noncopyable {
+public:
+    FileStamp stamp;
+    bool midi_in_preset;
+    std::map<Glib::ustring, PresetSnapshot*> presets;
+    CompiledBank(): stamp(), midi_in_preset(false), presets() {}
+    ~CompiledBank();
+};
+
+class PresetIO: public gx_system::AbstractPresetIO, public sigc::trackable {
 private:
     gx_engine::MidiControllerList& mctrl;
     gx_engine::ConvolverAdapter& convolver;
@@ -71,7 +108,15 @@ private:
     gx_engine::paramlist plist;
     gx_engine::ControllerArray *m;
     UnitRacks& rack_units;
+    std::map<std::string, CompiledBank*> compiled_banks;
+    const PresetSnapshot *snapshot;
 private:
+    void compile_presets(gx_system::PresetFile& pf, CompiledBank& cb);
+    bool is_current(const std::string& filename, const CompiledBank& cb);
+    bool take_snapshot(PresetSnapshot& s);
+    void apply_snapshot(const PresetSnapshot& s);
+    void clear_snapshots();
+    void on_param_insert_remove(gx_engine::Parameter*, bool) { clear_snapshots(); }
     void read_parameters(gx_system::JsonParser &jp, bool preset);
     void write_parameters(gx_system::JsonWriter &w, bool preset);
     void clear();
@@ -86,6 +131,8 @@ public:
     PresetIO(gx_engine::MidiControllerList& mctrl, gx_engine::ConvolverAdapter& cvr,
 	     gx_engine::ParamMap& param, gx_system::CmdlineOptions& opt, UnitRacks& rack_units);
     ~PresetIO();
+    virtual bool read_snapshot(gx_system::PresetFile& pf, const Glib::ustring& name);
+    virtual void compile_bank(gx_system::PresetFile& pf);
     void read_preset(gx_system::JsonParser &jp, const gx_system::SettingsFileHeader&);
     void commit_preset();
     void write_preset(gx_system::JsonWriter& jw);
@@ -58,5 +58,88 @@ class StreamingResampler: Resampler {
     int flush(float *output); // check source for max. output size
 };
 
+/****************************************************************
+ ** class HalfbandUpsampler, class HalfbandDownsampler
+ ** 2x polyphase halfband FIR: only the nonzero taps of one
+ ** polyphase branch are stored, the other branch is a pure delay
+ ** members and methods accessed by the rt thread are marked RT
+ */
+
+class HalfbandFilter {
+public:
+    enum { max_taps = 16, max_block = 128 };
+protected:
+    int taps;                 // nonzero coefficients on each side of the center
+    float coeffs[max_taps];
+    void design(int n);
+    HalfbandFilter(): taps(), coeffs() {}
+};
+
+class HalfbandUpsampler: public HalfbandFilter {
+private:
+    float buf[2*max_taps-1+max_block]; // history followed by current block
+    float acc[max_block];
+public:
+    HalfbandUpsampler(): HalfbandFilter(), buf(), acc() {}
+    void setup(int n);
+    void process(int count, const float *input, float *output); // RT; output: 2*count
+};
+
+class HalfbandDownsampler: public HalfbandFilter {
+private:
+    float even[2*max_taps-1+max_block]; // filtered branch
+    float odd[max_taps+max_block];      // delay branch
+public:
+    HalfbandDownsampler(): HalfbandFilter(), even(), odd() {}
+    void setup(int n);
+    void process(int count, const float *input, float *output); // RT; input: 2*count
+};
+
+/****************************************************************
+ ** class Oversampler
+ ** runs a processing function at 2x or 4x the engine rate by
+ ** cascading halfband stages; audio is handled in chunks of at
+ ** most block_size frames (use up() / down() around the call)
+ */
+
+class Oversampler {
+public:
+    enum { max_factor = 4, max_channels = 2, block_size = HalfbandFilter::max_block / 2 };
+private:
+    struct Channel {
+	HalfbandUpsampler up1, up2;
+	HalfbandDownsampler down1, down2;
+	float buf1[2*block_size];
+	float buf2[4*block_size];
+    };
+    int factor;
+    Channel chan[max_channels];
+public:
+    Oversampler(): factor(1), chan() {}
+    void setup(int factor, int nchannels);
+    inline int get_factor() const { return factor; } // RT
+    int get_latency() const;
+    inline float *up(int ch, int count, const float *input); // RT
+    inline void down(int ch, int count, float *output); // RT
+};
+
+inline float *Oversampler::up(int ch, int count, const float *input) {
+    Channel& c = chan[ch];
+    c.up1.process(count, input, c.buf1);
+    if (factor == 2) {
+	return c.buf1;
+    }
+    c.up2.process(2*count, c.buf1, c.buf2);
+    return c.buf2;
+}
+
+inline void Oversampler::down(int ch, int count, float *output) {
+    Channel& c = chan[ch];
+    if (factor == 4) {
+	c.down2.process(2*count, c.buf2, c.buf1);
+    }
+    c.down1.process(count, c.buf1, output);
+}
+
 }
 #endif  // SRC_HEADERS_GX_RESAMPLER_H_
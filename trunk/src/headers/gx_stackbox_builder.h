@@ -41,10 +41,62 @@ public:
     Gtk::Widget *add(Gtk::Widget *w, const Glib::ustring& label = Glib::ustring());
 };
 
+/****************************************************************
+ ** class RefreshScheduler
+ ** updates all engine driven displays from one timer; parameters
+ ** are resolved when the display is created, widgets are only
+ ** touched when the value changed since the last tick
+ */
+
+class RefreshScheduler {
+private:
+    enum { refresh_ms = 60, meter_hold = 5 };
+    enum display_type { meter_display, value_display, port_display };
+    struct Entry {
+	display_type tp;
+	Gtk::Widget *widget;           // 0 when destroyed
+	gx_engine::Parameter *param;   // 0 when unregistered
+	gx_engine::Parameter *on_off;  // on/off switch of the unit (may be 0)
+	gx_engine::Parameter *low;     // port display range
+	gx_engine::Parameter *high;
+	bool valid;
+	float last;
+	float last_low;
+	float last_high;
+	int settle;                    // meter hold ticks left after last change
+    };
+    gx_engine::GxMachineBase& machine;
+    std::list<Entry> entries;
+    sigc::connection timer;
+    bool paused;
+    bool local;
+    void add(display_type tp, Gtk::Widget *w, const std::string& id,
+	     const std::string& idl = "", const std::string& idh = "");
+    gx_engine::Parameter *resolve(const std::string& id);
+    inline float get_value(gx_engine::Parameter *p);
+    inline bool is_on(const Entry& e);
+    void refresh(Entry& e);
+    bool on_timeout();
+    void update_timer();
+    void on_param_insert_remove(gx_engine::Parameter *p, bool inserted);
+    static void *on_widget_destroyed(void *data);
+public:
+    RefreshScheduler(gx_engine::GxMachineBase& machine_);
+    ~RefreshScheduler();
+    void add_meter(Gxw::FastMeter *w, const std::string& id) { add(meter_display, w, id); }
+    void add_value(Gtk::Widget *w, const std::string& id) { add(value_display, w, id); }
+    void add_port_display(Gxw::PortDisplay *w, const std::string& id,
+			  const std::string& idl, const std::string& idh) {
+	add(port_display, w, id, idl, idh);
+    }
+    void set_paused(bool v);
+};
+
 class StackBoxBuilder {
 private:
     WidgetStack          fBox;
     gx_engine::GxMachineBase& machine;
+    RefreshScheduler     refresh;
     Gxw::WaveView&       fWaveView;
     Gtk::Label&          convolver_filename_label;
     Gtk::Label&          convolver_mono_filename_label;
@@ -74,7 +126,6 @@ private:
     void check_set_flags(Gxw::Regler *r);
     void create_simple_meter(const std::string& id);
     void create_simple_c_meter(const std::string& id, const std::string& idl, const char *label);
-    bool set_simple(Gxw::FastMeter *fastmeter, const std::string id);
     void create_small_rackknob(const std::string& id, const char *label);
     void create_small_rackknobr(const std::string& id);
     void create_small_rackknobr(const std::string& id, const char *label);
@@ -115,8 +166,6 @@ private:
     void create_eq_rackslider_no_caption(const std::string& id) {
 	addwidget(new UiRegler<Gxw::EqSlider>(machine, id, true));
     }
-    bool set_engine_value(const std::string id);
-    bool set_pd_value(Gxw::PortDisplay *w, const std::string id, const std::string& idl, const std::string& idh);
     void load_file(const std::string& id, const std::string& idf);
     void create_port_display(const std::string& id, const char *label);
     void create_p_display(const std::string& id, const std::string& idl, const std::string& idh);
@@ -149,6 +198,7 @@ public:
 	Gtk::Label& convolver_mono_filename_label_, Glib::RefPtr<Gdk::Pixbuf> window_icon);
     ~StackBoxBuilder();
     void set_accelgroup(Glib::RefPtr<Gtk::AccelGroup> accels_) { accels = accels_; }
+    void pause_refresh(bool v) { refresh.set_paused(v); }
     void get_box(const std::string& name, Gtk::Widget*& mainbox, Gtk::Widget*& minibox);
     void prepare();
     void fetch(Gtk::Widget*& mainbox, Gtk::Widget*& minibox);
@@ -411,8 +411,12 @@ private:
     bool liveplaygui;
     bool mute;
     Glib::ustring setbank;
+    bool render;
+    Glib::ustring render_preset;
+    std::vector<std::string> render_files;
     int sporadic_overload;
     int idle_thread_timeout;
+    int rack_stages;
     bool convolver_watchdog;
     bool xrun_watchdog;
     bool lterminal;
@@ -470,12 +474,16 @@ public:
     const std::string& get_temp_dir() const { return temp_dir; }
     const std::string& get_factory_dir() const { return factory_dir; }
     std::string get_ladspa_config_filename() const { return get_user_filepath("ladspa_defs.js"); }
+    std::string get_plugin_catalog_filename() const { return get_user_filepath("plugin_catalog.js"); }
     const Glib::ustring& get_rcset() const { return rcset; }
     bool get_clear_rc() const { return clear; }
     bool get_nogui() const { return nogui; }
     bool get_liveplaygui() const { return liveplaygui; }
     bool get_mute() const { return mute; }
     const Glib::ustring& get_setbank() { return setbank; }
+    bool get_render() const { return render; }
+    const Glib::ustring& get_render_preset() const { return render_preset; }
+    const std::vector<std::string>& get_render_files() const { return render_files; }
     int get_rpcport() const { return rpcport; }
     void set_rpcport(int port) { rpcport = port; }
     const Glib::ustring& get_rpcaddress() { return rpcaddress; }
@@ -493,6 +501,7 @@ public:
     Glib::ustring get_jack_output(unsigned int n) const;
     int get_idle_thread_timeout() const { return idle_thread_timeout; }
     int get_sporadic_overload() const { return sporadic_overload; }
+    int get_rack_stages() const { return rack_stages; }
     bool get_xrun_watchdog() const { return xrun_watchdog; }
     bool get_convolver_watchdog() const { return convolver_watchdog; }
 };
@@ -77,6 +77,11 @@ public:
 	f_units_changed,
 	END_OF_FLAGS
     };
+    enum telemetry_stream {  // bitmask for enable_telemetry_stream
+	t_freq = 0x01,
+	t_meter = 0x02,
+	t_osc = 0x04,
+    };
 private:
     GxService& serv;
     Glib::RefPtr<Gio::SocketConnection> connection;
@@ -86,6 +91,14 @@ private:
     bool midi_config_mode;
     std::bitset<END_OF_FLAGS> flags;
     float maxlevel[gx_engine::MaxLevel::channelcount];
+    int telemetry_streams;
+    bool telemetry_binary;
+    int telemetry_interval; // ms
+    int telemetry_elapsed;
+    // "set" notifications received in one read burst are merged
+    // (last value per parameter wins) and applied together
+    JsonArray pending_set;
+    std::map<std::string, unsigned int> pending_set_index;
 private:
     bool find_token(const Glib::ustring& token, msg_type *start, msg_type *end);
     void activate(int n, bool v) { flags.set(n, v); }
@@ -102,6 +115,9 @@ private:
     void listen(const Glib::ustring& tp);
     void unlisten(const Glib::ustring& tp);
     void process(gx_system::JsonStringParser& jp);
+    void queue_set(JsonArray& params);
+    void flush_set();
+    void write_oscilloscope_info(gx_system::JsonWriter& jw, bool binary);
 
 public:
     CmdConnection(GxService& serv, const Glib::RefPtr<Gio::SocketConnection>& connection_);
@@ -111,6 +127,8 @@ public:
     void send(gx_system::JsonStringWriter& jw);
     bool is_activated(msg_type n) { return flags[n]; }
     void update_maxlevel(unsigned int channel, float v) { maxlevel[channel] = max(maxlevel[channel], v); }
+    int get_telemetry_interval() { return telemetry_streams ? telemetry_interval : 0; }
+    void send_telemetry(int tick);
     friend class UiBuilderVirt;
 };
 
@@ -133,6 +151,8 @@ private:
     gx_system::JsonStringWriter *jwc;
     std::map<std::string,bool> *preg_map;
     float maxlevel[gx_engine::MaxLevel::channelcount];
+    sigc::connection telemetry_conn;
+    int telemetry_tick;
 private:
     virtual bool on_incoming(const Glib::RefPtr<Gio::SocketConnection>& connection,
 			     const Glib::RefPtr<Glib::Object>& source_object);
@@ -141,6 +161,8 @@ private:
     bool broadcast_listeners(CmdConnection::msg_type n, CmdConnection *sender = 0);
     void broadcast(gx_system::JsonStringWriter& jw, CmdConnection::msg_type n, CmdConnection *sender = 0);
     void connect_value_changed_signal(gx_engine::Parameter *p);
+    void update_telemetry_timer();
+    bool on_telemetry_timeout();
 
     // message formatting functions
     void serialize_parameter_change(gx_system::JsonWriter& jw);
@@ -175,6 +175,7 @@ private:
     ~PluginDesc();
     void serializeJSON(gx_system::JsonWriter& jw);
     friend class LadspaPluginList;
+    friend class LadspaScanner;
 public:
     void set_old();
     void clear_old() { delete old; old = 0; }
@@ -196,6 +197,9 @@ struct LV2Preset {
 	bool has_preset;
 };
 
+class PluginCatalog;
+class LadspaScanner;
+
 
 class LadspaPluginList: private std::vector<PluginDesc*> {
 private:
@@ -207,6 +211,9 @@ private:
     LilvNode* lv2_InputPort;
     LilvNode* lv2_OutputPort;
     LilvNode* lv2_connectionOptional;
+    sigc::signal<void, PluginDesc*> plugin_found;
+    sigc::signal<void, unsigned int, unsigned int> scan_progress;
+    friend class LadspaScanner;
 private:
     static char** uris;
     static size_t n_uris;
@@ -216,14 +223,24 @@ private:
     static void set_preset_values(Glib::ustring port_symbol, LV2Preset* pdata, Glib::ustring value);
     static inline std::string make_key(unsigned long unique_id) { return "ladspa://" + gx_system::to_string(unique_id); }
     static void add_plugin(const LADSPA_Descriptor& desc, pluginmap& d, const std::string& path, int index);
-    static void load_defs(const std::string& path, pluginmap& d);
+    static std::string load_defs(const std::string& path, pluginmap& d);
+    static std::string serialize_plugin(PluginDesc *pd);
+    static PluginDesc *create_plugin(const std::string& s);
     static void set_instances(const char *uri, pluginmap& d, std::vector<Glib::ustring>& label,
 			      std::vector<unsigned long>& not_found, std::set<unsigned long>& seen);
     static void descend(const char *uri, pluginmap& d,
 			std::vector<unsigned long>& not_found, std::set<unsigned long>& seen,
 			std::vector<Glib::ustring>& base);
-    void add_plugin(const LilvPlugin* plugin, pluginmap& d, gx_system::CmdlineOptions& options);
-    void lv2_load(pluginmap& d, gx_system::CmdlineOptions& options);
+    PluginDesc *add_plugin(const LilvPlugin* plugin, gx_system::CmdlineOptions& options);
+    void add_found(pluginmap& d, const std::string& key, PluginDesc *pd,
+		   gx_system::CmdlineOptions& options, const std::set<std::string>& selected);
+    void ladspa_load_cached(pluginmap& d, std::vector<std::string>& scan, gx_system::CmdlineOptions& options,
+			    PluginCatalog& old_catalog, PluginCatalog& catalog, const std::set<std::string>& selected);
+    void ladspa_collect(LadspaScanner& scanner, pluginmap& d, gx_system::CmdlineOptions& options,
+			PluginCatalog& catalog, const std::set<std::string>& selected);
+    void load_lv2_world();
+    void lv2_load(pluginmap& d, gx_system::CmdlineOptions& options,
+		  PluginCatalog& old_catalog, PluginCatalog& catalog, const std::set<std::string>& selected);
     void get_presets(LV2Preset *pdata);
 public:
     LadspaPluginList();
@@ -233,8 +250,15 @@ public:
     void writeJSON(gx_system::JsonWriter& jw);
     void load(gx_system::CmdlineOptions& options, std::vector<std::string>& old_not_found);
     void save(gx_system::CmdlineOptions& options);
+    sigc::signal<void, PluginDesc*>& signal_plugin_found() { return plugin_found; }
+    sigc::signal<void, unsigned int, unsigned int>& signal_scan_progress() { return scan_progress; }
     using std::vector<PluginDesc*>::begin;
     using std::vector<PluginDesc*>::end;
 };
 
+// plugin scanner worker process (a guitarix binary started by
+// LadspaPluginList::load to dlopen changed LADSPA libraries)
+bool is_scanner(int argc, char *argv[]);
+void scanner_main(int argc, char *argv[]);
+
 } // namespace ladspa
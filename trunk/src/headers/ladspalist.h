@@ -101,6 +101,8 @@ private:
     Glib::RefPtr<Gtk::ListStore> display_type_list_sr;
     Glib::RefPtr<Gtk::ListStore> output_type_list;
     sigc::slot<void,bool,bool> finished_callback;
+    bool loading;
+    sigc::connection load_conn;
     //
     Glib::RefPtr<Gtk::Action> quit_action;
     Glib::RefPtr<Gtk::Action> save_action;
@@ -182,7 +184,11 @@ private:
     bool check_for_changes();
     int ask_discard();
     void save_current();
+    bool is_shown(PluginDesc *p);
     void load();
+    void load_plugins();
+    void on_plugin_found(PluginDesc *p);
+    void on_scan_progress(unsigned int done, unsigned int total);
     bool do_save();
     void set_old_state(PluginDesc *p);
     void display_master_idx(const Gtk::TreeIter& it);
@@ -85,6 +85,7 @@ public:
     virtual sigc::signal<int, bool>& signal_oscilloscope_activation() = 0;
     virtual sigc::signal<void, unsigned int>& signal_oscilloscope_size_change() = 0;
     virtual void maxlevel_get(int channels, float *values) = 0;
+    virtual float get_plugin_load(std::map<std::string,PluginLoadInfo>& load) = 0;
     virtual void get_oscilloscope_info(int& load, int& frames, bool& is_rt, jack_nframes_t& bsize) = 0;
     virtual gx_system::CmdlineOptions& get_options() const = 0;
     virtual void start_socket(sigc::slot<void> quit_mainloop, const Glib::ustring& host, int port) = 0;
@@ -155,6 +156,7 @@ public:
     virtual void set_init_values() = 0;
     virtual bool parameter_hasId(const char *p) = 0;
     virtual bool parameter_hasId(const std::string& id) = 0;
+    virtual sigc::signal<void,Parameter*,bool> signal_parameter_insert_remove() = 0;
     virtual void reset_unit(const PluginDef *pdef) const = 0;
     virtual bool parameter_unit_has_std_values(const PluginDef *pdef) const = 0;
     virtual void set_parameter_value(const std::string& id, int value) = 0;
@@ -247,6 +249,7 @@ private:
 public:
     GxMachine(gx_system::CmdlineOptions& options);
     virtual ~GxMachine();
+    bool render(const std::string& infile, const std::string& outfile);
     virtual void set_state(GxEngineState state);
     virtual GxEngineState get_state();
     virtual void load_ladspalist(std::vector<std::string>& old_not_found, ladspa::LadspaPluginList& pluginlist);
@@ -267,6 +270,7 @@ public:
     virtual sigc::signal<int, bool>& signal_oscilloscope_activation();
     virtual sigc::signal<void, unsigned int>& signal_oscilloscope_size_change();
     virtual void maxlevel_get(int channels, float *values);
+    virtual float get_plugin_load(std::map<std::string,PluginLoadInfo>& load);
     virtual void get_oscilloscope_info(int& load, int& frames, bool& is_rt, jack_nframes_t& bsize);
     virtual gx_system::CmdlineOptions& get_options() const;
     virtual void start_socket(sigc::slot<void> quit_mainloop, const Glib::ustring& host, int port);
@@ -337,6 +341,7 @@ public:
     virtual void set_init_values();
     virtual bool parameter_hasId(const char *p);
     virtual bool parameter_hasId(const std::string& id);
+    virtual sigc::signal<void,Parameter*,bool> signal_parameter_insert_remove();
     virtual void reset_unit(const PluginDef *pdef) const;
     virtual bool parameter_unit_has_std_values(const PluginDef *pdef) const;
     virtual void set_parameter_value(const std::string& id, int value);
@@ -390,6 +395,19 @@ private:
     sigc::signal<void, unsigned int> oscilloscope_size_change;
     float *oscilloscope_buffer;
     unsigned int oscilloscope_buffer_size;
+    struct {
+	int load, frames;
+	bool is_rt;
+	jack_nframes_t bsize;
+    } oscilloscope_info;
+    // values pushed by the server (telemetry stream)
+    int telemetry_streams;
+    int telemetry_read;
+    int telemetry_frames;
+    int telemetry_unused;	// streams to unsubscribe from idle
+    sigc::connection telemetry_conn;
+    float tuner_freq;
+    float maxlevel[MaxLevel::channelcount];
     sigc::signal<void,const Glib::ustring&,const Glib::ustring&> tuner_switcher_display;
     sigc::signal<void,TunerSwitcher::SwitcherState> tuner_switcher_set_state;
     sigc::signal<void, bool> tuner_switcher_selection_done;
@@ -412,6 +430,11 @@ private:
     void throw_error(gx_system::JsonStringParser *jp);
     void param_signal(Parameter *p);
     void update_plugins(gx_system::JsonParser *jp);
+    bool request_telemetry(int stream);
+    void set_telemetry_streams(int streams);
+    bool drop_unused_telemetry();
+    void read_telemetry(gx_system::JsonParser *jp);
+    void read_oscilloscope_info(gx_system::JsonParser *jp);
     void create_bluetooth_socket(const Glib::ustring& bdaddr);
     void create_tcp_socket();
     virtual int _get_parameter_value_int(const std::string& id);
@@ -445,6 +468,7 @@ public:
     virtual sigc::signal<int, bool>& signal_oscilloscope_activation();
     virtual sigc::signal<void, unsigned int>& signal_oscilloscope_size_change();
     virtual void maxlevel_get(int channels, float *values);
+    virtual float get_plugin_load(std::map<std::string,PluginLoadInfo>& load);
     virtual void get_oscilloscope_info(int& load, int& frames, bool& is_rt, jack_nframes_t& bsize);
     virtual gx_system::CmdlineOptions& get_options() const;
     virtual void start_socket(sigc::slot<void> quit_mainloop, const Glib::ustring& host, int port);
@@ -515,6 +539,7 @@ public:
     virtual void set_init_values();
     virtual bool parameter_hasId(const char *p);
     virtual bool parameter_hasId(const std::string& id);
+    virtual sigc::signal<void,Parameter*,bool> signal_parameter_insert_remove();
     virtual void reset_unit(const PluginDef *pdef) const;
     virtual bool parameter_unit_has_std_values(const PluginDef *pdef) const;
     virtual void set_parameter_value(const std::string& id, int value);
@@ -309,6 +309,31 @@ int __rt_func Convproc::process (bool sync)
 }
 
 
+int Convproc::process (bool sync, float **outp)
+{
+    unsigned int k;
+    int f;
+    float *save [MAXOUT];
+
+    if (_state != ST_PROC) return 0;
+
+    if (_quantum != _minpart)
+    {
+        f = process (sync);
+        for (k = 0; k < _nout; k++) memcpy (outp [k], _outbuff [k] + _outoffs, _quantum * sizeof (float));
+        return f;
+    }
+    for (k = 0; k < _nout; k++)
+    {
+        save [k] = _outbuff [k];
+        _outbuff [k] = outp [k];
+    }
+    f = process (sync);
+    for (k = 0; k < _nout; k++) _outbuff [k] = save [k];
+    return f;
+}
+
+
 int Convproc::stop_process (void)
 {
     unsigned int k;
@@ -23,6 +23,10 @@
 #include <string.h>
 #include <stdio.h>
 #include "zita-convolver.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ENABLE_AVX_MAC
+#endif
 
 
 
@@ -313,6 +317,31 @@ int Convproc::process (bool sync)
 }
 
 
+int Convproc::process (bool sync, float **outp)
+{
+    unsigned int k;
+    int f;
+    float *save [MAXOUT];
+
+    if (_state != ST_PROC) return 0;
+
+    if (_quantum != _minpart)
+    {
+        f = process (sync);
+        for (k = 0; k < _nout; k++) memcpy (outp [k], _outbuff [k] + _outoffs, _quantum * sizeof (float));
+        return f;
+    }
+    for (k = 0; k < _nout; k++)
+    {
+        save [k] = _outbuff [k];
+        _outbuff [k] = outp [k];
+    }
+    f = process (sync);
+    for (k = 0; k < _nout; k++) _outbuff [k] = save [k];
+    return f;
+}
+
+
 int Convproc::stop_process (void)
 {
     unsigned int k;
@@ -394,6 +423,65 @@ void Convproc::print (FILE *F)
 typedef float FV4 __attribute__ ((vector_size(16)));
 
 
+// The fftw planner is not thread safe.
+static pthread_mutex_t plan_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+// Complex multiply-accumulate D [k] += A [k] * B [k], k in [0, n).
+// The implementation is selected once at load time by cpu detection.
+typedef void (*macfunc)(fftwf_complex *D, const fftwf_complex *A, const fftwf_complex *B, unsigned int n);
+
+static void mac_scalar (fftwf_complex *D, const fftwf_complex *A, const fftwf_complex *B, unsigned int n)
+{
+    unsigned int k;
+
+    for (k = 0; k < n; k++)
+    {
+	D [k][0] += A [k][0] * B [k][0] - A [k][1] * B [k][1];
+	D [k][1] += A [k][0] * B [k][1] + A [k][1] * B [k][0];
+    }
+}
+
+#ifdef ENABLE_AVX_MAC
+
+__attribute__ ((target ("avx,fma")))
+static void mac_avx (fftwf_complex *D, const fftwf_complex *A, const fftwf_complex *B, unsigned int n)
+{
+    unsigned int  k;
+    float         *d = (float *) D;
+    const float   *a = (const float *) A;
+    const float   *b = (const float *) B;
+    __m256        va, vb, p;
+
+    // 4 interleaved complex values per register
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+	va = _mm256_loadu_ps (a);
+	vb = _mm256_loadu_ps (b);
+	p = _mm256_mul_ps (_mm256_permute_ps (va, 0xb1), _mm256_movehdup_ps (vb));
+	p = _mm256_fmaddsub_ps (va, _mm256_moveldup_ps (vb), p);
+	_mm256_storeu_ps (d, _mm256_add_ps (_mm256_loadu_ps (d), p));
+	a += 8;
+	b += 8;
+	d += 8;
+    }
+    if (k < n) mac_scalar (D + k, A + k, B + k, n - k);
+}
+
+#endif
+
+static macfunc select_mac (void)
+{
+#ifdef ENABLE_AVX_MAC
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx") && __builtin_cpu_supports ("fma")) return mac_avx;
+#endif
+    return mac_scalar;
+}
+
+static const macfunc mac_func = select_mac ();
+
+
 Convlevel::Convlevel (void) :
     _stat (ST_IDLE),
     _npar (0),
@@ -422,7 +510,7 @@ void *Convlevel::alloc_aligned (size_t size)
 {
     void *p;
 
-    if (posix_memalign (&p, 16, size)) throw (Converror (Converror::MEM_ALLOC));
+    if (posix_memalign (&p, 32, size)) throw (Converror (Converror::MEM_ALLOC));
     memset (p, 0, size);
     return p;
 }
@@ -445,8 +533,10 @@ void Convlevel::configure (int prio,
     _time_data = (float *)(alloc_aligned (2 * _parsize * sizeof (float)));
     _prep_data = (float *)(alloc_aligned (2 * _parsize * sizeof (float)));
     _freq_data = (fftwf_complex *)(alloc_aligned ((_parsize + 1) * sizeof (fftwf_complex)));
+    pthread_mutex_lock (&plan_mutex);
     _plan_r2c = fftwf_plan_dft_r2c_1d (2 * _parsize, _time_data, _freq_data, fftwopt);
     _plan_c2r = fftwf_plan_dft_c2r_1d (2 * _parsize, _freq_data, _time_data, fftwopt);
+    pthread_mutex_unlock (&plan_mutex);
     if (_plan_r2c && _plan_c2r) return;
     throw (Converror (Converror::MEM_ALLOC));
 }
@@ -690,8 +780,10 @@ void Convlevel::cleanup (void)
     }
     _out_list = 0;
 
+    pthread_mutex_lock (&plan_mutex);
     fftwf_destroy_plan (_plan_r2c);
     fftwf_destroy_plan (_plan_c2r);
+    pthread_mutex_unlock (&plan_mutex);
     free (_time_data);
     free (_prep_data);
     free (_freq_data);
@@ -810,11 +902,7 @@ void Convlevel::process (bool skip)
 			else
 #endif
 			{
-			    for (k = 0; k <= _parsize; k++)
-			    {
-				_freq_data [k][0] += ffta [k][0] * fftb [k][0] - ffta [k][1] * fftb [k][1];
-				_freq_data [k][1] += ffta [k][0] * fftb [k][1] + ffta [k][1] * fftb [k][0];
-			    }
+			    mac_func (_freq_data, ffta, fftb, _parsize + 1);
 			}
 		    }
 		    if (i == 0) i = _npar;
@@ -28,6 +28,9 @@
 
 #define ZITA_CONVOLVER_MAJOR_VERSION 3
 
+// guitarix extension: Convproc::process (sync, outp)
+#define ZITA_CONVOLVER_OUTPUT_BUFFERS 1
+
 
 extern int zita_convolver_major_version (void);
 
@@ -407,6 +410,13 @@ public:
 
     int process (bool sync = false);
 
+    // Like process(), but the output is delivered in the caller
+    // owned buffers outp [0 .. nout-1] (quantum frames each). If
+    // quantum == minpart the levels accumulate directly into these
+    // buffers and the copy from outdata() is avoided. The input must
+    // still be written to inpdata() before the call.
+    int process (bool sync, float **outp);
+
     int stop_process (void);
 
     bool check_stop (void);
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2009, 2010 Hermann Meyer, James Warden, Andreas Degert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * ---------------------------------------------------------------------------
+ *
+ *    Parse a preset bank with the old and the current JsonParser and
+ *    compare the run time. Build with tools/build-json-bench, which
+ *    extracts both parser versions from gx_json.{h,cpp}.
+ *
+ * ----------------------------------------------------------------------------
+ */
+
+#include <glibmm/ustring.h>
+
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <locale.h>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+static void gx_print_warning(const char *, const string&) {}
+
+namespace old_json {
+#include "json-old.inc"
+}
+
+namespace new_json {
+#include "json-new.inc"
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Result {
+    unsigned long tokens;
+    unsigned long chars;
+    double numsum;
+    double secs;
+};
+
+// walk all tokens of the bank, like PresetFile / GxSettingsBase do
+template <class P>
+static Result parse(const string& data, int loops) {
+    Result r = { 0, 0, 0, 0 };
+    double t0 = now();
+    for (int i = 0; i < loops; i++) {
+        istringstream is(data);
+        P jp(&is);
+        typename P::token tok;
+        while ((tok = jp.next()) != P::end_token) {
+            r.tokens++;
+            switch (tok) {
+            case P::value_number:
+                r.numsum += jp.current_value_float();
+                // fall through
+            case P::value_string:
+            case P::value_key:
+                r.chars += jp.current_value().size();
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    r.secs = now() - t0;
+    return r;
+}
+
+static void report(const char *name, const Result& r, size_t bytes, int loops) {
+    cout << name << ": " << r.secs << " s, "
+         << bytes * loops / r.secs / (1024*1024) << " MB/s, "
+         << r.tokens / loops << " tokens" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        cerr << "usage: " << argv[0] << " bankfile [loops]" << endl;
+        return 1;
+    }
+    ifstream f(argv[1]);
+    if (!f.good()) {
+        cerr << argv[1] << ": can't open" << endl;
+        return 1;
+    }
+    ostringstream b;
+    b << f.rdbuf();
+    string data = b.str();
+    int loops = argc > 2 ? atoi(argv[2]) : 20;
+    if (loops < 1) {
+        loops = 1;
+    }
+    setlocale(LC_NUMERIC, "C");
+    Result o, n;
+    try {
+        o = parse<old_json::JsonParser>(data, loops);
+        n = parse<new_json::JsonParser>(data, loops);
+    } catch (exception& e) {
+        cerr << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+    report("old", o, data.size(), loops);
+    report("new", n, data.size(), loops);
+    cout << "speedup: " << o.secs / n.secs << endl;
+    if (o.tokens != n.tokens || o.chars != n.chars || o.numsum != n.numsum) {
+        cerr << "parser results differ!" << endl;
+        return 1;
+    }
+    return 0;
+}
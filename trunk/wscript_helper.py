@@ -32,6 +32,11 @@ def get_faust_args(bld):
         float_arg.append('--vectorize')
         if not bld.env['FAUST_DOUBLE']:
             arg.append('--vectorize')
+    vs = bld.env['FAUST_VECTOR_SIZE']
+    if vs:
+        for l in arg, float_arg, double_arg:
+            if '--vectorize' in l:
+                l.append('--vector-size=%d' % vs)
     add_args = bld.env['FAUST_OPTIONS']
     if add_args:
         add_args = "--add=%s" % add_args
@@ -39,3 +44,16 @@ def get_faust_args(bld):
         double_arg.append(add_args)
         arg.append(add_args)
     return arg, float_arg, double_arg
+
+def split_faust_sources(bld, sources, keep_double):
+    """split sources into (default, double) lists
+
+    in the --faust-simd build the modules in keep_double are
+    numerically unstable in float (low frequency high order iir
+    filters etc.) and must be compiled with double precision; other
+    builds (including --faust-float) are not changed
+    """
+    if not bld.env['FAUST_SIMD']:
+        return sources, []
+    return ([s for s in sources if s not in keep_double],
+            [s for s in sources if s in keep_double])